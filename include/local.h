@@ -337,6 +337,8 @@ static inline int snd_open_device(const char *filename, int fmode)
 	snd1_config_check_hop
 #define snd_config_search_alias_hooks \
 	snd1_config_search_alias_hooks
+#define snd_config_generation \
+	snd1_config_generation
 
 /* dlobj cache */
 void *snd_dlobj_cache_get(const char *lib, const char *name, const char *version, int verbose);
@@ -352,6 +354,8 @@ int snd_config_search_alias_hooks(snd_config_t *config,
                                   const char *base, const char *key,
 				  snd_config_t **result);
 
+unsigned int snd_config_generation(void);
+
 int _snd_conf_generic_id(const char *id);
 
 /* convenience macros */
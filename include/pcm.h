@@ -512,6 +512,11 @@ int snd_pcm_info(snd_pcm_t *pcm, snd_pcm_info_t *info);
 int snd_pcm_hw_params_current(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 int snd_pcm_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 int snd_pcm_hw_free(snd_pcm_t *pcm);
+int snd_pcm_refine_cache_flush(void);
+void snd_pcm_refine_cache_stats(unsigned long *hits, unsigned long *misses);
+int snd_pcm_open_cache_flush(void);
+void snd_pcm_open_cache_stats(unsigned long *hits, unsigned long *misses);
+size_t snd_pcm_buffer_memory(snd_pcm_t *pcm);
 int snd_pcm_sw_params_current(snd_pcm_t *pcm, snd_pcm_sw_params_t *params);
 int snd_pcm_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params);
 int snd_pcm_prepare(snd_pcm_t *pcm);
@@ -526,6 +531,9 @@ int snd_pcm_hwsync(snd_pcm_t *pcm);
 int snd_pcm_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp);
 int snd_pcm_resume(snd_pcm_t *pcm);
 int snd_pcm_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail, snd_htimestamp_t *tstamp);
+int snd_pcm_snapshot(snd_pcm_t *pcm, snd_pcm_state_t *state,
+		     snd_pcm_uframes_t *availp, snd_pcm_sframes_t *delayp,
+		     snd_htimestamp_t *tstamp);
 snd_pcm_sframes_t snd_pcm_avail(snd_pcm_t *pcm);
 snd_pcm_sframes_t snd_pcm_avail_update(snd_pcm_t *pcm);
 int snd_pcm_avail_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *availp, snd_pcm_sframes_t *delayp);
@@ -1089,6 +1097,51 @@ int snd_pcm_status_dump(snd_pcm_status_t *status, snd_output_t *out);
 
 /** \} */
 
+/**
+ * \defgroup PCM_Stats Runtime Statistics
+ * \ingroup PCM
+ * See the \ref pcm_stats page for more details.
+ * \{
+ */
+
+/** PCM runtime counters */
+typedef enum _snd_pcm_stat {
+	/** avail_update calls */
+	SND_PCM_STAT_AVAIL_UPDATE = 0,
+	/** frames transferred by this PCM */
+	SND_PCM_STAT_FRAMES,
+	/** SYNC_PTR ioctls */
+	SND_PCM_STAT_IOCTL_SYNC_PTR,
+	/** HWSYNC and DELAY ioctls */
+	SND_PCM_STAT_IOCTL_HWSYNC,
+	/** read/write ioctls */
+	SND_PCM_STAT_IOCTL_XFER,
+	/** stream control ioctls (start, stop, prepare, ...) */
+	SND_PCM_STAT_IOCTL_CONTROL,
+	/** underruns / overruns seen */
+	SND_PCM_STAT_XRUN,
+	/** successful #snd_pcm_recover() calls */
+	SND_PCM_STAT_RECOVER,
+	/** poll wakeups */
+	SND_PCM_STAT_WAKEUP,
+	/** poll wakeups without any event for the application */
+	SND_PCM_STAT_SPURIOUS_WAKEUP,
+	SND_PCM_STAT_LAST = SND_PCM_STAT_SPURIOUS_WAKEUP
+} snd_pcm_stat_t;
+
+/** number of buckets of the wake-to-transfer latency histogram */
+#define SND_PCM_STATS_LATENCY_BUCKETS	24
+
+const char *snd_pcm_stat_name(snd_pcm_stat_t stat);
+int snd_pcm_stats_get(snd_pcm_t *pcm, snd_pcm_stat_t stat,
+		      unsigned long long *value);
+int snd_pcm_stats_latency(snd_pcm_t *pcm, unsigned int bucket,
+			  unsigned long long *count);
+int snd_pcm_stats_reset(snd_pcm_t *pcm);
+int snd_pcm_stats_dump(snd_pcm_t *pcm, snd_output_t *out);
+
+/** \} */
+
 /**
  * \defgroup PCM_Direct Direct Access (MMAP) Functions
  * \ingroup PCM
@@ -1158,6 +1211,30 @@ int snd_pcm_areas_copy_wrap(const snd_pcm_channel_area_t *dst_channels,
 			    const unsigned int channels,
 			    snd_pcm_uframes_t frames,
 			    const snd_pcm_format_t format);
+int snd_pcm_areas_mulaw_decode(const snd_pcm_channel_area_t *dst_channels,
+			       snd_pcm_uframes_t dst_offset,
+			       const snd_pcm_channel_area_t *src_channels,
+			       snd_pcm_uframes_t src_offset,
+			       unsigned int channels, snd_pcm_uframes_t frames,
+			       snd_pcm_format_t format);
+int snd_pcm_areas_mulaw_encode(const snd_pcm_channel_area_t *dst_channels,
+			       snd_pcm_uframes_t dst_offset,
+			       const snd_pcm_channel_area_t *src_channels,
+			       snd_pcm_uframes_t src_offset,
+			       unsigned int channels, snd_pcm_uframes_t frames,
+			       snd_pcm_format_t format);
+int snd_pcm_areas_alaw_decode(const snd_pcm_channel_area_t *dst_channels,
+			      snd_pcm_uframes_t dst_offset,
+			      const snd_pcm_channel_area_t *src_channels,
+			      snd_pcm_uframes_t src_offset,
+			      unsigned int channels, snd_pcm_uframes_t frames,
+			      snd_pcm_format_t format);
+int snd_pcm_areas_alaw_encode(const snd_pcm_channel_area_t *dst_channels,
+			      snd_pcm_uframes_t dst_offset,
+			      const snd_pcm_channel_area_t *src_channels,
+			      snd_pcm_uframes_t src_offset,
+			      unsigned int channels, snd_pcm_uframes_t frames,
+			      snd_pcm_format_t format);
 
 /** \} */
 
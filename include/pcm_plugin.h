@@ -73,6 +73,8 @@ int snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 		     snd_config_t *root ATTRIBUTE_UNUSED, snd_config_t *conf,
 		     snd_pcm_stream_t stream, int mode);
+int snd_pcm_hw_sync_ptr_stats(snd_pcm_t *pcm, unsigned long *issued,
+			      unsigned long *avoided);
 
 /*
  *  Copy plugin
@@ -38,7 +38,7 @@ extern "C" {
 /**
  * Protocol version
  */
-#define SND_PCM_RATE_PLUGIN_VERSION	0x010002
+#define SND_PCM_RATE_PLUGIN_VERSION	0x010003
 
 /** hw_params information for a single side */
 typedef struct snd_pcm_rate_side_info {
@@ -55,6 +55,14 @@ typedef struct snd_pcm_rate_info {
 	unsigned int channels;
 } snd_pcm_rate_info_t;
 
+/** Flags of get_supported_formats */
+enum {
+	/** the converter takes only interleaved areas */
+	SND_PCM_RATE_FLAG_INTERLEAVED = (1U << 0),
+	/** the input and output formats have to be identical */
+	SND_PCM_RATE_FLAG_SYNC_FORMATS = (1U << 1),
+};
+
 /** Callback table of rate-converter */
 typedef struct snd_pcm_rate_ops {
 	/**
@@ -114,6 +122,16 @@ typedef struct snd_pcm_rate_ops {
 	 * new ops since version 0x010002
 	 */
 	void (*dump)(void *obj, snd_output_t *out);
+	/**
+	 * return the formats the converter works in, as masks of
+	 * (1ULL << SND_PCM_FORMAT_XXX), and SND_PCM_RATE_FLAG_XXX flags;
+	 * the streams are converted to them, init gets the chosen ones;
+	 * without this op, convert gets the formats of the streams;
+	 * new ops since version 0x010003
+	 */
+	int (*get_supported_formats)(void *obj, uint64_t *in_formats,
+				     uint64_t *out_formats,
+				     unsigned int *flags);
 } snd_pcm_rate_ops_t;
 
 /** open function type */
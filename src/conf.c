@@ -3473,6 +3473,7 @@ struct _snd_config_update {
 #endif /* DOC_HIDDEN */
 
 static snd_config_update_t *snd_config_global_update = NULL;
+static unsigned int snd_config_global_generation;
 
 static int snd_config_hooks_call(snd_config_t *root, snd_config_t *config, snd_config_t *private_data)
 {
@@ -4042,6 +4043,8 @@ int snd_config_update(void)
 
 	snd_config_lock();
 	err = snd_config_update_r(&snd_config, &snd_config_global_update, NULL);
+	if (err > 0)
+		snd_config_global_generation++;
 	snd_config_unlock();
 	return err;
 }
@@ -4065,6 +4068,8 @@ int snd_config_update_ref(snd_config_t **top)
 		*top = NULL;
 	snd_config_lock();
 	err = snd_config_update_r(&snd_config, &snd_config_global_update, NULL);
+	if (err > 0)
+		snd_config_global_generation++;
 	if (err >= 0) {
 		if (snd_config) {
 			if (top) {
@@ -4150,6 +4155,7 @@ int snd_config_update_free_global(void)
 	if (snd_config_global_update)
 		snd_config_update_free(snd_config_global_update);
 	snd_config_global_update = NULL;
+	snd_config_global_generation++;
 	snd_config_unlock();
 	/* FIXME: better to place this in another place... */
 	snd_dlobj_cache_cleanup();
@@ -4157,6 +4163,19 @@ int snd_config_update_free_global(void)
 	return 0;
 }
 
+#ifndef DOC_HIDDEN
+/* a counter bumped whenever the global configuration tree is reloaded */
+unsigned int snd_config_generation(void)
+{
+	unsigned int generation;
+
+	snd_config_lock();
+	generation = snd_config_global_generation;
+	snd_config_unlock();
+	return generation;
+}
+#endif
+
 /**
  * \brief Returns an iterator pointing to a node's first child.
  * \param[in] config Handle to a configuration node.
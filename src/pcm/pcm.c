@@ -502,6 +502,71 @@ LIBASOUND_THREAD_SAFE=0 aplay foo.wav
 \endcode
 for making the debugging easier.
 
+The thread-safe functions serialize on a per-handle lock.  Threads which only
+watch the stream (watchdogs, level meters) should use #snd_pcm_snapshot()
+instead of #snd_pcm_avail(), #snd_pcm_delay() or #snd_pcm_state(): it returns
+the position and state published by the last transfer or state change of
+the I/O thread without taking the lock, so it never delays that thread.
+
+\section pcm_refine_cache Hardware parameters cache
+
+Applications which open the same PCM with the same parameters over and over
+may set the environment variable LIBASOUND_REFINE_CACHE to 1. The library
+then remembers the results of the hardware parameter refinement for named
+PCMs and replays them on the next #snd_pcm_hw_params() call, instead of
+walking the whole plugin chain again. The cache is keyed by the PCM name,
+type, stream, mode, the device at the end of the chain and the generation
+of the global configuration. #snd_pcm_refine_cache_stats() returns the hit
+and miss counters, #snd_pcm_refine_cache_flush() drops the cache, e.g.
+after the capabilities of a device changed.
+
+\section pcm_open_cache PCM definition cache
+
+Each #snd_pcm_open() call looks up the PCM definition in the global
+configuration and expands its arguments and functions, which may take
+milliseconds for a complex "default" PCM. When the environment variable
+LIBASOUND_OPEN_CACHE is set to 1, the expanded definitions and the resolved
+plugin types are remembered per name (arguments included) until the global
+configuration is reloaded. Definitions which depend on other run-time state,
+e.g. the presence of a card, are not re-evaluated while cached; call
+#snd_pcm_open_cache_flush() when that state changes.
+#snd_pcm_open_cache_stats() returns the hit and miss counters.
+
+\section pcm_buffer_memory Intermediate buffers
+
+The buffers which the library allocates itself, the ring buffers of the
+plugins and of the emulated mmap access and the work buffers of the
+conversion plugins, are aligned to 64 bytes. When the environment variable
+LIBASOUND_HUGEPAGES is set to 1, buffers of 2MB and more are backed by
+transparent huge pages; with 2, explicit huge pages (hugetlbfs) are tried
+first. #snd_pcm_buffer_memory() returns the memory used by these buffers
+for one handle or for the whole process; #snd_pcm_dump() prints it for
+each handle of a chain.
+
+\section pcm_mmap_mirror Mirrored ring buffers
+
+The ring buffers which the library allocates itself (for plugins and
+for the emulated mmap access) normally end at the buffer boundary, so
+#snd_pcm_mmap_begin() returns a shorter area near the wrap around and the
+caller needs a second pass. When the environment variable
+LIBASOUND_MMAP_MIRROR is set to 1, interleaved buffers of a page aligned
+size are backed by a memory file mapped twice back to back; the memory
+behind the end of the buffer is its start again and the area returned by
+#snd_pcm_mmap_begin() may run past the end of the buffer. Buffers which
+cannot be mirrored silently use the ordinary allocation.
+
+\section pcm_stats Runtime statistics
+
+When the library is configured with --enable-pcm-stats, every PCM handle of
+a plugin chain counts its avail_update calls, transferred frames, xruns,
+successful #snd_pcm_recover() calls, poll wakeups (and the spurious ones
+without any event) and, for the hw plugin, the issued ioctls. A histogram
+keeps the latency from a poll wakeup to the next read, write or commit.
+#snd_pcm_stats_get() and #snd_pcm_stats_latency() read the values of one
+handle, #snd_pcm_dump() prints them for the whole chain. Without the
+configure option the collection code is not compiled in and the accessors
+return -ENOSYS.
+
 \section pcm_dev_names PCM naming conventions
 
 The ALSA library uses a generic string representation for names of devices.
@@ -655,6 +720,7 @@ playback devices.
 #include <sys/mman.h>
 #include <limits.h>
 #include "pcm_local.h"
+#include "pcm_simd.h"
 
 #ifndef DOC_HIDDEN
 /* return specific error codes for known bad PCM states */
@@ -695,6 +761,69 @@ static int bad_pcm_state(snd_pcm_t *pcm, unsigned int supported_states)
 		return err;
 	return -EBADFD;
 }
+
+/* keep the published state, only refresh the position */
+#define SNAPSHOT_KEEP_STATE	(-1)
+
+#ifdef BUILD_PCM_STATS
+/*
+ * Count an xrun once, when an operation fails with -EPIPE or a state
+ * query finds it; any other state ends it.  This runs for every caller,
+ * also the ones whose snapshot update is dropped below.
+ */
+static void pcm_stats_xrun(snd_pcm_t *pcm, int err, int state)
+{
+	if (err == -EPIPE || state == SND_PCM_STATE_XRUN) {
+		if (!__atomic_exchange_n(&pcm->stats.xrun, 1, __ATOMIC_RELAXED))
+			snd_pcm_stats_inc(pcm, SND_PCM_STAT_XRUN);
+	} else if (state != SNAPSHOT_KEEP_STATE) {
+		__atomic_store_n(&pcm->stats.xrun, 0, __ATOMIC_RELAXED);
+	}
+}
+#else
+#define pcm_stats_xrun(pcm, err, state)	do { } while (0)
+#endif
+
+/*
+ * Publish the current position for snd_pcm_snapshot().  A failed
+ * operation (other than -EAGAIN) may have changed the state behind our
+ * back, so it is queried again.  The writer never waits: if another
+ * thread is publishing right now, this update is simply dropped.
+ */
+static void pcm_snapshot_publish(snd_pcm_t *pcm, int err, int state)
+{
+	snd_pcm_pos_snapshot_t *snap = &pcm->snapshot;
+	snd_pcm_uframes_t hw_ptr = 0, appl_ptr = 0;
+	snd_pcm_uframes_t buffer_size = 0, boundary = 0;
+	snd_htimestamp_t tstamp;
+	unsigned int seq;
+
+	if (err < 0 && err != -EAGAIN)
+		state = __snd_pcm_state(pcm);
+	pcm_stats_xrun(pcm, err, state);
+	if (__atomic_exchange_n(&snap->busy, 1, __ATOMIC_ACQUIRE))
+		return;
+	if (pcm->setup && pcm->hw.ptr && pcm->appl.ptr) {
+		hw_ptr = *pcm->hw.ptr;
+		appl_ptr = *pcm->appl.ptr;
+		buffer_size = pcm->buffer_size;
+		boundary = pcm->boundary;
+	}
+	gettimestamp(&tstamp, pcm->tstamp_type);
+	seq = __atomic_load_n(&snap->seq, __ATOMIC_RELAXED);
+	__atomic_store_n(&snap->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	if (state != SNAPSHOT_KEEP_STATE)
+		__atomic_store_n(&snap->state, state, __ATOMIC_RELAXED);
+	__atomic_store_n(&snap->hw_ptr, hw_ptr, __ATOMIC_RELAXED);
+	__atomic_store_n(&snap->appl_ptr, appl_ptr, __ATOMIC_RELAXED);
+	__atomic_store_n(&snap->buffer_size, buffer_size, __ATOMIC_RELAXED);
+	__atomic_store_n(&snap->boundary, boundary, __ATOMIC_RELAXED);
+	__atomic_store_n(&snap->tstamp.tv_sec, tstamp.tv_sec, __ATOMIC_RELAXED);
+	__atomic_store_n(&snap->tstamp.tv_nsec, tstamp.tv_nsec, __ATOMIC_RELAXED);
+	__atomic_store_n(&snap->seq, seq + 2, __ATOMIC_RELEASE);
+	__atomic_store_n(&snap->busy, 0, __ATOMIC_RELEASE);
+}
 #endif
 
 /**
@@ -929,6 +1058,7 @@ int snd_pcm_hw_free(snd_pcm_t *pcm)
 	//        snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED);
 	err = pcm->ops->hw_free(pcm->op_arg);
 	pcm->setup = 0;
+	pcm_snapshot_publish(pcm, 0, SND_PCM_STATE_OPEN);
 	if (err < 0)
 		return err;
 	return 0;
@@ -983,6 +1113,7 @@ int snd_pcm_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
 	pcm->silence_threshold = params->silence_threshold;
 	pcm->silence_size = params->silence_size;
 	pcm->boundary = params->boundary;
+	pcm_snapshot_publish(pcm, 0, SNAPSHOT_KEEP_STATE);
 	__snd_pcm_unlock(pcm);
 	return 0;
 }
@@ -1002,6 +1133,7 @@ int snd_pcm_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
 	assert(pcm && status);
 	snd_pcm_lock(pcm);
 	err = pcm->fast_ops->status(pcm->fast_op_arg, status);
+	pcm_snapshot_publish(pcm, err, err < 0 ? SNAPSHOT_KEEP_STATE : (int)status->state);
 	snd_pcm_unlock(pcm);
 
 	return err;
@@ -1024,6 +1156,7 @@ snd_pcm_state_t snd_pcm_state(snd_pcm_t *pcm)
 	assert(pcm);
 	snd_pcm_lock(pcm);
 	state = __snd_pcm_state(pcm);
+	pcm_snapshot_publish(pcm, 0, state);
 	snd_pcm_unlock(pcm);
 	return state;
 }
@@ -1050,6 +1183,7 @@ int snd_pcm_hwsync(snd_pcm_t *pcm)
 	}
 	snd_pcm_lock(pcm);
 	err = __snd_pcm_hwsync(pcm);
+	pcm_snapshot_publish(pcm, err, SNAPSHOT_KEEP_STATE);
 	snd_pcm_unlock(pcm);
 	return err;
 }
@@ -1098,6 +1232,7 @@ int snd_pcm_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 	}
 	snd_pcm_lock(pcm);
 	err = __snd_pcm_delay(pcm, delayp);
+	pcm_snapshot_publish(pcm, err, SNAPSHOT_KEEP_STATE);
 	snd_pcm_unlock(pcm);
 	return err;
 }
@@ -1118,13 +1253,19 @@ int snd_pcm_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
  */
 int snd_pcm_resume(snd_pcm_t *pcm)
 {
+	int err;
+
 	assert(pcm);
 	if (CHECK_SANITY(! pcm->setup)) {
 		SNDMSG("PCM not set up");
 		return -EIO;
 	}
 	/* lock handled in the callback */
-	return pcm->fast_ops->resume(pcm->fast_op_arg);
+	err = pcm->fast_ops->resume(pcm->fast_op_arg);
+	snd_pcm_lock(pcm);
+	pcm_snapshot_publish(pcm, 0, __snd_pcm_state(pcm));
+	snd_pcm_unlock(pcm);
+	return err;
 }
 
 /**
@@ -1175,6 +1316,7 @@ int snd_pcm_prepare(snd_pcm_t *pcm)
 		return err;
 	snd_pcm_lock(pcm);
 	err = pcm->fast_ops->prepare(pcm->fast_op_arg);
+	pcm_snapshot_publish(pcm, err, SND_PCM_STATE_PREPARED);
 	snd_pcm_unlock(pcm);
 	return err;
 }
@@ -1199,6 +1341,7 @@ int snd_pcm_reset(snd_pcm_t *pcm)
 	}
 	snd_pcm_lock(pcm);
 	err = pcm->fast_ops->reset(pcm->fast_op_arg);
+	pcm_snapshot_publish(pcm, err, SNAPSHOT_KEEP_STATE);
 	snd_pcm_unlock(pcm);
 	return err;
 }
@@ -1224,6 +1367,7 @@ int snd_pcm_start(snd_pcm_t *pcm)
 		return err;
 	snd_pcm_lock(pcm);
 	err = __snd_pcm_start(pcm);
+	pcm_snapshot_publish(pcm, err, SND_PCM_STATE_RUNNING);
 	snd_pcm_unlock(pcm);
 	return err;
 }
@@ -1256,6 +1400,7 @@ int snd_pcm_drop(snd_pcm_t *pcm)
 		return err;
 	snd_pcm_lock(pcm);
 	err = pcm->fast_ops->drop(pcm->fast_op_arg);
+	pcm_snapshot_publish(pcm, err, SND_PCM_STATE_SETUP);
 	snd_pcm_unlock(pcm);
 	return err;
 }
@@ -1288,7 +1433,11 @@ int snd_pcm_drain(snd_pcm_t *pcm)
 	if (err < 0)
 		return err;
 	/* lock handled in the callback */
-	return pcm->fast_ops->drain(pcm->fast_op_arg);
+	err = pcm->fast_ops->drain(pcm->fast_op_arg);
+	snd_pcm_lock(pcm);
+	pcm_snapshot_publish(pcm, 0, __snd_pcm_state(pcm));
+	snd_pcm_unlock(pcm);
+	return err;
 }
 
 /**
@@ -1317,6 +1466,8 @@ int snd_pcm_pause(snd_pcm_t *pcm, int enable)
 		return err;
 	snd_pcm_lock(pcm);
 	err = pcm->fast_ops->pause(pcm->fast_op_arg, enable);
+	pcm_snapshot_publish(pcm, err, enable ? SND_PCM_STATE_PAUSED :
+					    SND_PCM_STATE_RUNNING);
 	snd_pcm_unlock(pcm);
 	return err;
 }
@@ -1377,6 +1528,7 @@ snd_pcm_sframes_t snd_pcm_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 		return err;
 	snd_pcm_lock(pcm);
 	result = pcm->fast_ops->rewind(pcm->fast_op_arg, frames);
+	pcm_snapshot_publish(pcm, result < 0 ? result : 0, SNAPSHOT_KEEP_STATE);
 	snd_pcm_unlock(pcm);
 	return result;
 }
@@ -1441,6 +1593,7 @@ snd_pcm_sframes_t snd_pcm_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 		return err;
 	snd_pcm_lock(pcm);
 	result = pcm->fast_ops->forward(pcm->fast_op_arg, frames);
+	pcm_snapshot_publish(pcm, result < 0 ? result : 0, SNAPSHOT_KEEP_STATE);
 	snd_pcm_unlock(pcm);
 	return result;
 }
@@ -1482,6 +1635,7 @@ snd_pcm_sframes_t snd_pcm_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_ufr
 	err = bad_pcm_state(pcm, P_STATE_RUNNABLE);
 	if (err < 0)
 		return err;
+	snd_pcm_stats_xfer(pcm);
 	return _snd_pcm_writei(pcm, buffer, size);
 }
 
@@ -1521,6 +1675,7 @@ snd_pcm_sframes_t snd_pcm_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t
 	err = bad_pcm_state(pcm, P_STATE_RUNNABLE);
 	if (err < 0)
 		return err;
+	snd_pcm_stats_xfer(pcm);
 	return _snd_pcm_writen(pcm, bufs, size);
 }
 
@@ -1560,6 +1715,7 @@ snd_pcm_sframes_t snd_pcm_readi(snd_pcm_t *pcm, void *buffer, snd_pcm_uframes_t
 	err = bad_pcm_state(pcm, P_STATE_RUNNABLE);
 	if (err < 0)
 		return err;
+	snd_pcm_stats_xfer(pcm);
 	return _snd_pcm_readi(pcm, buffer, size);
 }
 
@@ -1599,6 +1755,7 @@ snd_pcm_sframes_t snd_pcm_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t s
 	err = bad_pcm_state(pcm, P_STATE_RUNNABLE);
 	if (err < 0)
 		return err;
+	snd_pcm_stats_xfer(pcm);
 	return _snd_pcm_readn(pcm, bufs, size);
 }
 
@@ -1754,13 +1911,19 @@ int snd_pcm_poll_descriptors_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsign
 static int __snd_pcm_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds,
 				  unsigned int nfds, unsigned short *revents)
 {
-	if (pcm->fast_ops->poll_revents)
-		return pcm->fast_ops->poll_revents(pcm->fast_op_arg, pfds, nfds, revents);
-	if (nfds == 1) {
+	int err;
+
+	if (pcm->fast_ops->poll_revents) {
+		err = pcm->fast_ops->poll_revents(pcm->fast_op_arg, pfds, nfds, revents);
+	} else if (nfds == 1) {
 		*revents = pfds->revents;
-		return 0;
+		err = 0;
+	} else {
+		return -EINVAL;
 	}
-	return -EINVAL;
+	if (err >= 0)
+		snd_pcm_stats_wakeup(pcm, *revents);
+	return err;
 }
 
 #ifndef DOC_HIDDEN
@@ -2279,9 +2442,174 @@ int snd_pcm_dump(snd_pcm_t *pcm, snd_output_t *out)
 	assert(pcm);
 	assert(out);
 	pcm->ops->dump(pcm->op_arg, out);
+	if (pcm->buffer_memory)
+		snd_output_printf(out, "Buffer memory of %s: %zu bytes\n",
+				  pcm->name ? pcm->name : "PCM",
+				  pcm->buffer_memory);
+#ifdef BUILD_PCM_STATS
+	snd_pcm_stats_dump(pcm, out);
+#endif
 	return 0;
 }
 
+#ifndef DOC_HIDDEN
+#define STAT(v, n) [SND_PCM_STAT_##v] = n
+static const char *const snd_pcm_stat_names[] = {
+	STAT(AVAIL_UPDATE, "avail_update"),
+	STAT(FRAMES, "frames"),
+	STAT(IOCTL_SYNC_PTR, "ioctl_sync_ptr"),
+	STAT(IOCTL_HWSYNC, "ioctl_hwsync"),
+	STAT(IOCTL_XFER, "ioctl_xfer"),
+	STAT(IOCTL_CONTROL, "ioctl_control"),
+	STAT(XRUN, "xrun"),
+	STAT(RECOVER, "recover"),
+	STAT(WAKEUP, "wakeup"),
+	STAT(SPURIOUS_WAKEUP, "spurious_wakeup"),
+};
+#undef STAT
+#endif
+
+/**
+ * \brief get name of a PCM runtime counter
+ * \param stat counter
+ * \return ascii name of the counter
+ */
+const char *snd_pcm_stat_name(snd_pcm_stat_t stat)
+{
+	if ((unsigned int)stat > SND_PCM_STAT_LAST)
+		return NULL;
+	return snd_pcm_stat_names[stat];
+}
+
+/**
+ * \brief Read a runtime counter of a PCM handle
+ * \param pcm PCM handle
+ * \param stat counter to read
+ * \param value returned counter value
+ * \return 0 on success otherwise a negative error code
+ * \retval -ENOSYS the library was built without the statistics
+ *
+ * The counters belong to this handle only; the plugins of the chain
+ * keep their own ones, #snd_pcm_dump() prints all of them.
+ */
+int snd_pcm_stats_get(snd_pcm_t *pcm, snd_pcm_stat_t stat,
+		      unsigned long long *value)
+{
+	assert(pcm && value);
+	if ((unsigned int)stat > SND_PCM_STAT_LAST)
+		return -EINVAL;
+#ifdef BUILD_PCM_STATS
+	*value = pcm->stats.count[stat];
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
+/**
+ * \brief Read the wake-to-transfer latency histogram of a PCM handle
+ * \param pcm PCM handle
+ * \param bucket histogram bucket, 0 .. #SND_PCM_STATS_LATENCY_BUCKETS - 1
+ * \param count returned number of samples in the bucket
+ * \return 0 on success otherwise a negative error code
+ * \retval -ENOSYS the library was built without the statistics
+ *
+ * The latency is measured from a poll wakeup reporting an event to the next
+ * read, write or mmap commit call.  Bucket 0 counts latencies below 1us,
+ * bucket n (n > 0) those from 2^(n-1) to 2^n - 1 us, the last bucket also
+ * counts all longer ones.
+ */
+int snd_pcm_stats_latency(snd_pcm_t *pcm, unsigned int bucket,
+			  unsigned long long *count)
+{
+	assert(pcm && count);
+	if (bucket >= SND_PCM_STATS_LATENCY_BUCKETS)
+		return -EINVAL;
+#ifdef BUILD_PCM_STATS
+	*count = pcm->stats.latency[bucket];
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
+/**
+ * \brief Clear the runtime counters of a PCM handle
+ * \param pcm PCM handle
+ * \return 0 on success otherwise a negative error code
+ * \retval -ENOSYS the library was built without the statistics
+ */
+int snd_pcm_stats_reset(snd_pcm_t *pcm)
+{
+	assert(pcm);
+#ifdef BUILD_PCM_STATS
+	memset(&pcm->stats, 0, sizeof(pcm->stats));
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
+/**
+ * \brief Dump the runtime counters of a PCM handle
+ * \param pcm PCM handle
+ * \param out Output handle
+ * \return 0 on success otherwise a negative error code
+ * \retval -ENOSYS the library was built without the statistics
+ */
+int snd_pcm_stats_dump(snd_pcm_t *pcm, snd_output_t *out)
+{
+#ifdef BUILD_PCM_STATS
+	unsigned int i;
+
+	assert(pcm && out);
+	snd_output_printf(out, "Statistics of %s:\n", pcm->name ? pcm->name : "PCM");
+	for (i = 0; i <= SND_PCM_STAT_LAST; i++)
+		snd_output_printf(out, "  %-16s: %llu\n", snd_pcm_stat_names[i],
+				  pcm->stats.count[i]);
+	for (i = 0; i < SND_PCM_STATS_LATENCY_BUCKETS; i++) {
+		if (!pcm->stats.latency[i])
+			continue;
+		snd_output_printf(out, "  latency < %7luus: %llu\n",
+				  1UL << i, pcm->stats.latency[i]);
+	}
+	return 0;
+#else
+	assert(pcm && out);
+	return -ENOSYS;
+#endif
+}
+
+#if defined(BUILD_PCM_STATS) && !defined(DOC_HIDDEN)
+void snd_pcm_stats_wakeup(snd_pcm_t *pcm, unsigned short revents)
+{
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_WAKEUP);
+	if (!(revents & (POLLIN | POLLOUT))) {
+		snd_pcm_stats_inc(pcm, SND_PCM_STAT_SPURIOUS_WAKEUP);
+		return;
+	}
+	gettimestamp(&pcm->stats.wake, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+}
+
+void snd_pcm_stats_xfer(snd_pcm_t *pcm)
+{
+	snd_htimestamp_t now;
+	unsigned long long usec;
+	unsigned int bucket;
+
+	if (!pcm->stats.wake.tv_sec && !pcm->stats.wake.tv_nsec)
+		return;
+	gettimestamp(&now, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	usec = (now.tv_sec - pcm->stats.wake.tv_sec) * 1000000ULL +
+		(now.tv_nsec - pcm->stats.wake.tv_nsec) / 1000;
+	for (bucket = 0; usec && bucket < SND_PCM_STATS_LATENCY_BUCKETS - 1; bucket++)
+		usec >>= 1;
+	pcm->stats.latency[bucket]++;
+	pcm->stats.wake.tv_sec = 0;
+	pcm->stats.wake.tv_nsec = 0;
+}
+#endif
+
 /**
  * \brief Convert bytes in frames for a PCM
  * \param pcm PCM handle
@@ -2402,52 +2730,182 @@ static const char *const build_in_pcms[] = {
 	NULL
 };
 
-static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
-			     snd_config_t *pcm_root, snd_config_t *pcm_conf,
-			     snd_pcm_stream_t stream, int mode)
-{
-	const char *str;
-	char *buf = NULL, *buf1 = NULL;
-	int err;
-	snd_config_t *conf, *type_conf = NULL, *tmp;
-	snd_config_iterator_t i, next;
-	const char *id;
-	const char *lib = NULL, *open_name = NULL;
-	int (*open_func)(snd_pcm_t **, const char *, 
-			 snd_config_t *, snd_config_t *, 
-			 snd_pcm_stream_t, int) = NULL;
-#ifndef PIC
-	extern void *snd_pcm_open_symbols(void);
+/*
+ * PCM definition cache
+ *
+ * Expanding a PCM definition (arguments, @func nodes, pcm_type lookups) of
+ * the global configuration is repeated on every open.  With
+ * $LIBASOUND_OPEN_CACHE=1, the expanded definitions and the library and
+ * symbol names resolved for the PCM types are remembered, keyed by the name
+ * as passed to the open call, including its arguments.  Each entry holds the
+ * generation of the global configuration it was expanded from, and is
+ * ignored after the configuration has been reloaded.  Local configurations
+ * (snd_pcm_open_lconf()) are never cached.
+ */
+
+#define OPEN_CACHE_SIZE		32
+
+struct open_cache_entry {
+	char *key;		/* "pcm.NAME" or "pcm_type.TYPE" */
+	unsigned int generation;
+	unsigned long stamp;
+	snd_config_t *conf;	/* expanded definition */
+	char *lib;		/* NULL for a built-in type */
+	char *open_name;
+};
+
+static struct open_cache_entry *open_cache;
+static unsigned long open_cache_stamp;
+static unsigned long open_cache_hits;
+static unsigned long open_cache_misses;
+static int open_cache_enabled = -1;
+
+#ifdef THREAD_SAFE_API
+static pthread_mutex_t open_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define open_cache_lock()	pthread_mutex_lock(&open_cache_mutex)
+#define open_cache_unlock()	pthread_mutex_unlock(&open_cache_mutex)
+#else
+#define open_cache_lock()	do { } while (0)
+#define open_cache_unlock()	do { } while (0)
 #endif
-	if (snd_config_get_type(pcm_conf) != SND_CONFIG_TYPE_COMPOUND) {
-		char *val;
-		id = NULL;
-		snd_config_get_id(pcm_conf, &id);
-		val = NULL;
-		snd_config_get_ascii(pcm_conf, &val);
-		SNDERR("Invalid type for PCM %s%sdefinition (id: %s, value: %s)", name ? name : "", name ? " " : "", id, val);
-		free(val);
-		return -EINVAL;
+
+static void open_cache_clear(struct open_cache_entry *e)
+{
+	free(e->key);
+	e->key = NULL;
+	if (e->conf)
+		snd_config_delete(e->conf);
+	e->conf = NULL;
+	free(e->lib);
+	e->lib = NULL;
+	free(e->open_name);
+	e->open_name = NULL;
+}
+
+/*
+ * Return the generation of the global configuration if root is the global
+ * configuration and the cache is enabled, otherwise zero
+ */
+static unsigned int open_cache_generation(snd_config_t *root)
+{
+	unsigned int generation;
+
+	if (open_cache_enabled < 0) {
+		const char *env = getenv("LIBASOUND_OPEN_CACHE");
+		open_cache_enabled = env && atoi(env) > 0;
 	}
-	err = snd_config_search(pcm_conf, "type", &conf);
-	if (err < 0) {
-		SNDERR("type is not defined");
-		return err;
+	if (!open_cache_enabled)
+		return 0;
+	/* read the generation first, a reload in between changes snd_config */
+	generation = snd_config_generation() + 1;
+	if (root != snd_config)
+		return 0;
+	return generation;
+}
+
+static struct open_cache_entry *open_cache_find(const char *key,
+						unsigned int generation)
+{
+	unsigned int k;
+
+	for (k = 0; open_cache && k < OPEN_CACHE_SIZE; k++) {
+		struct open_cache_entry *e = &open_cache[k];
+		if (e->key && e->generation == generation &&
+		    !strcmp(e->key, key)) {
+			e->stamp = ++open_cache_stamp;
+			open_cache_hits++;
+			return e;
+		}
 	}
-	err = snd_config_get_id(conf, &id);
-	if (err < 0) {
-		SNDERR("unable to get id");
-		return err;
+	open_cache_misses++;
+	return NULL;
+}
+
+static struct open_cache_entry *open_cache_new(const char *key,
+					       unsigned int generation)
+{
+	struct open_cache_entry *e;
+	unsigned int k;
+
+	if (!open_cache) {
+		open_cache = calloc(OPEN_CACHE_SIZE, sizeof(*open_cache));
+		if (!open_cache)
+			return NULL;
 	}
-	err = snd_config_get_string(conf, &str);
-	if (err < 0) {
-		SNDERR("Invalid type for %s", id);
+	/* replace a stale or the least recently used entry */
+	e = &open_cache[0];
+	for (k = 1; k < OPEN_CACHE_SIZE && e->key && e->generation == generation; k++) {
+		if (!open_cache[k].key || open_cache[k].generation != generation ||
+		    open_cache[k].stamp < e->stamp)
+			e = &open_cache[k];
+	}
+	open_cache_clear(e);
+	e->key = strdup(key);
+	if (!e->key)
+		return NULL;
+	e->generation = generation;
+	e->stamp = ++open_cache_stamp;
+	return e;
+}
+
+static char *open_cache_key(const char *base, const char *name)
+{
+	char *key = malloc(strlen(base) + strlen(name) + 2);
+
+	if (key)
+		sprintf(key, "%s.%s", base, name);
+	return key;
+}
+
+/* snd_config_search_definition(root, "pcm", name, ...) through the cache */
+static int snd_pcm_search_definition(snd_config_t *root, const char *name,
+				     snd_config_t **pcm_conf)
+{
+	unsigned int generation = open_cache_generation(root);
+	struct open_cache_entry *e;
+	char *key;
+	int err;
+
+	if (!generation)
+		return snd_config_search_definition(root, "pcm", name, pcm_conf);
+	key = open_cache_key("pcm", name);
+	if (!key)
+		return -ENOMEM;
+	open_cache_lock();
+	e = open_cache_find(key, generation);
+	if (e && e->conf) {
+		err = snd_config_copy(pcm_conf, e->conf);
+		open_cache_unlock();
+		free(key);
 		return err;
 	}
-	err = snd_config_search_definition(pcm_root, "pcm_type", str, &type_conf);
+	open_cache_unlock();
+	err = snd_config_search_definition(root, "pcm", name, pcm_conf);
+	if (err >= 0) {
+		open_cache_lock();
+		e = open_cache_new(key, generation);
+		if (e && snd_config_copy(&e->conf, *pcm_conf) < 0)
+			open_cache_clear(e);
+		open_cache_unlock();
+	}
+	free(key);
+	return err;
+}
+
+/* find the library and the open function name of a PCM type */
+static int snd_pcm_open_resolve(snd_config_t *pcm_root, const char *type,
+				char **libp, char **open_namep)
+{
+	snd_config_t *type_conf = NULL;
+	snd_config_iterator_t i, next;
+	const char *lib = NULL, *open_name = NULL;
+	char *buf = NULL, *buf1 = NULL;
+	int err;
+
+	err = snd_config_search_definition(pcm_root, "pcm_type", type, &type_conf);
 	if (err >= 0) {
 		if (snd_config_get_type(type_conf) != SND_CONFIG_TYPE_COMPOUND) {
-			SNDERR("Invalid type for PCM type %s definition", str);
+			SNDERR("Invalid type for PCM type %s definition", type);
 			err = -EINVAL;
 			goto _err;
 		}
@@ -2479,32 +2937,177 @@ static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 			goto _err;
 		}
 	}
-	if (!open_name) {
-		buf = malloc(strlen(str) + 32);
-		if (buf == NULL) {
+	if (open_name) {
+		buf = strdup(open_name);
+	} else {
+		buf = malloc(strlen(type) + 32);
+		if (buf)
+			sprintf(buf, "_snd_pcm_%s_open", type);
+	}
+	if (buf == NULL) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	if (lib) {
+		buf1 = strdup(lib);
+		if (buf1 == NULL) {
 			err = -ENOMEM;
 			goto _err;
 		}
-		open_name = buf;
-		sprintf(buf, "_snd_pcm_%s_open", str);
-	}
-	if (!lib) {
+	} else {
 		const char *const *build_in = build_in_pcms;
 		while (*build_in) {
-			if (!strcmp(*build_in, str))
+			if (!strcmp(*build_in, type))
 				break;
 			build_in++;
 		}
 		if (*build_in == NULL) {
-			buf1 = malloc(strlen(str) + sizeof(ALSA_PLUGIN_DIR) + 32);
+			buf1 = malloc(strlen(type) + sizeof(ALSA_PLUGIN_DIR) + 32);
 			if (buf1 == NULL) {
 				err = -ENOMEM;
 				goto _err;
 			}
-			lib = buf1;
-			sprintf(buf1, "%s/libasound_module_pcm_%s.so", ALSA_PLUGIN_DIR, str);
+			sprintf(buf1, "%s/libasound_module_pcm_%s.so", ALSA_PLUGIN_DIR, type);
+		}
+	}
+	*open_namep = buf;
+	*libp = buf1;
+	buf = buf1 = NULL;
+	err = 0;
+       _err:
+	if (type_conf)
+		snd_config_delete(type_conf);
+	free(buf);
+	free(buf1);
+	return err;
+}
+
+/* snd_pcm_open_resolve() through the cache */
+static int snd_pcm_open_resolve_cached(snd_config_t *pcm_root, const char *type,
+				       char **libp, char **open_namep)
+{
+	unsigned int generation = open_cache_generation(pcm_root);
+	struct open_cache_entry *e;
+	char *key;
+	int err;
+
+	if (!generation)
+		return snd_pcm_open_resolve(pcm_root, type, libp, open_namep);
+	key = open_cache_key("pcm_type", type);
+	if (!key)
+		return -ENOMEM;
+	open_cache_lock();
+	e = open_cache_find(key, generation);
+	if (e && e->open_name) {
+		*open_namep = strdup(e->open_name);
+		*libp = e->lib ? strdup(e->lib) : NULL;
+		open_cache_unlock();
+		free(key);
+		if (!*open_namep || (e->lib && !*libp)) {
+			free(*open_namep);
+			free(*libp);
+			return -ENOMEM;
+		}
+		return 0;
+	}
+	open_cache_unlock();
+	err = snd_pcm_open_resolve(pcm_root, type, libp, open_namep);
+	if (err >= 0) {
+		open_cache_lock();
+		e = open_cache_new(key, generation);
+		if (e) {
+			e->open_name = strdup(*open_namep);
+			e->lib = *libp ? strdup(*libp) : NULL;
+			if (!e->open_name || (*libp && !e->lib))
+				open_cache_clear(e);
+		}
+		open_cache_unlock();
+	}
+	free(key);
+	return err;
+}
+
+/**
+ * \brief Drop all entries of the PCM definition cache
+ * \return the number of dropped entries
+ *
+ * The cache is enabled by setting $LIBASOUND_OPEN_CACHE to 1.  It is
+ * invalidated automatically when the global configuration is reloaded;
+ * flush it when a definition depends on something else which has changed,
+ * e.g. the cards present in the system.
+ */
+int snd_pcm_open_cache_flush(void)
+{
+	unsigned int k;
+	int count = 0;
+
+	open_cache_lock();
+	for (k = 0; open_cache && k < OPEN_CACHE_SIZE; k++) {
+		if (open_cache[k].key) {
+			open_cache_clear(&open_cache[k]);
+			count++;
 		}
 	}
+	open_cache_unlock();
+	return count;
+}
+
+/**
+ * \brief Get the PCM definition cache counters
+ * \param hits Returned number of lookups answered from the cache
+ * \param misses Returned number of lookups which expanded the configuration
+ */
+void snd_pcm_open_cache_stats(unsigned long *hits, unsigned long *misses)
+{
+	open_cache_lock();
+	*hits = open_cache_hits;
+	*misses = open_cache_misses;
+	open_cache_unlock();
+}
+
+static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
+			     snd_config_t *pcm_root, snd_config_t *pcm_conf,
+			     snd_pcm_stream_t stream, int mode)
+{
+	const char *str;
+	char *lib = NULL, *open_name = NULL;
+	int err;
+	snd_config_t *conf, *tmp;
+	const char *id;
+	int (*open_func)(snd_pcm_t **, const char *, 
+			 snd_config_t *, snd_config_t *, 
+			 snd_pcm_stream_t, int) = NULL;
+#ifndef PIC
+	extern void *snd_pcm_open_symbols(void);
+#endif
+	if (snd_config_get_type(pcm_conf) != SND_CONFIG_TYPE_COMPOUND) {
+		char *val;
+		id = NULL;
+		snd_config_get_id(pcm_conf, &id);
+		val = NULL;
+		snd_config_get_ascii(pcm_conf, &val);
+		SNDERR("Invalid type for PCM %s%sdefinition (id: %s, value: %s)", name ? name : "", name ? " " : "", id, val);
+		free(val);
+		return -EINVAL;
+	}
+	err = snd_config_search(pcm_conf, "type", &conf);
+	if (err < 0) {
+		SNDERR("type is not defined");
+		return err;
+	}
+	err = snd_config_get_id(conf, &id);
+	if (err < 0) {
+		SNDERR("unable to get id");
+		return err;
+	}
+	err = snd_config_get_string(conf, &str);
+	if (err < 0) {
+		SNDERR("Invalid type for %s", id);
+		return err;
+	}
+	err = snd_pcm_open_resolve_cached(pcm_root, str, &lib, &open_name);
+	if (err < 0)
+		return err;
 #ifndef PIC
 	snd_pcm_open_symbols();	/* this call is for static linking only */
 #endif
@@ -2544,11 +3147,8 @@ static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 			snd_config_get_integer(tmp, &(*pcmp)->minperiodtime);
 		err = 0;
 	}
-       _err:
-	if (type_conf)
-		snd_config_delete(type_conf);
-	free(buf);
-	free(buf1);
+	free(lib);
+	free(open_name);
 	return err;
 }
 
@@ -2560,7 +3160,7 @@ static int snd_pcm_open_noupdate(snd_pcm_t **pcmp, snd_config_t *root,
 	snd_config_t *pcm_conf;
 	const char *str;
 
-	err = snd_config_search_definition(root, "pcm", name, &pcm_conf);
+	err = snd_pcm_search_definition(root, name, &pcm_conf);
 	if (err < 0) {
 		SNDERR("Unknown PCM %s", name);
 		return err;
@@ -2695,6 +3295,7 @@ int snd_pcm_free(snd_pcm_t *pcm)
 {
 	assert(pcm);
 	free(pcm->name);
+	free(pcm->refine_id);
 	free(pcm->hw.link_dst);
 	free(pcm->appl.link_dst);
 	snd_dlobj_cache_put(pcm->open_func);
@@ -2851,6 +3452,7 @@ snd_pcm_sframes_t snd_pcm_avail_update(snd_pcm_t *pcm)
 
 	snd_pcm_lock(pcm);
 	result = __snd_pcm_avail_update(pcm);
+	pcm_snapshot_publish(pcm, result < 0 ? result : 0, SNAPSHOT_KEEP_STATE);
 	snd_pcm_unlock(pcm);
 	return result;
 }
@@ -2885,6 +3487,7 @@ snd_pcm_sframes_t snd_pcm_avail(snd_pcm_t *pcm)
 		result = err;
 	else
 		result = __snd_pcm_avail_update(pcm);
+	pcm_snapshot_publish(pcm, result < 0 ? result : 0, SNAPSHOT_KEEP_STATE);
 	snd_pcm_unlock(pcm);
 	return result;
 }
@@ -2927,10 +3530,95 @@ int snd_pcm_avail_delay(snd_pcm_t *pcm,
 	*availp = sf;
 	err = 0;
  unlock:
+	pcm_snapshot_publish(pcm, err, SNAPSHOT_KEEP_STATE);
 	snd_pcm_unlock(pcm);
 	return err;
 }
 
+#ifndef DOC_HIDDEN
+/* readers give up when they keep racing with the writer */
+#define SNAPSHOT_RETRIES	64
+#endif
+
+/**
+ * \brief Read the last published PCM state and position without locking
+ * \param pcm PCM handle
+ * \param state Returned PCM state (may be NULL)
+ * \param availp Returned number of frames ready to be read / written (may be NULL)
+ * \param delayp Returned number of frames queued in the ring buffer (may be NULL)
+ * \param tstamp Returned time of the publication (may be NULL)
+ * \return 0 on success otherwise a negative error code
+ * \retval -EAGAIN the snapshot was continuously updated while reading it
+ *
+ * The functions transferring data and changing the stream state
+ * (#snd_pcm_writei(), #snd_pcm_avail(), #snd_pcm_mmap_commit(),
+ * #snd_pcm_start(), ...) publish the stream position and state into a
+ * per-handle snapshot protected by a sequence counter.  This function
+ * reads the snapshot without taking the PCM lock and without calling
+ * into the plugin chain or the driver, so it never blocks the thread
+ * doing the I/O.  It is meant for watchdog and metering threads.
+ *
+ * The values are those seen by the last such call, \a tstamp tells how
+ * old they are (it uses the timestamp type set in the sw params).
+ * \a delayp is the fill level of the ring buffer; unlike
+ * #snd_pcm_delay() it does not include additional device latencies.
+ *
+ * The function is thread-safe and lock-free.
+ */
+int snd_pcm_snapshot(snd_pcm_t *pcm, snd_pcm_state_t *state,
+		     snd_pcm_uframes_t *availp, snd_pcm_sframes_t *delayp,
+		     snd_htimestamp_t *tstamp)
+{
+	const snd_pcm_pos_snapshot_t *snap;
+	snd_pcm_state_t st;
+	snd_pcm_uframes_t hw_ptr, appl_ptr, buffer_size, boundary;
+	snd_pcm_sframes_t avail;
+	snd_htimestamp_t ts;
+	unsigned int seq, retries;
+
+	assert(pcm);
+	snap = &pcm->snapshot;
+	for (retries = 0; ; retries++) {
+		if (retries >= SNAPSHOT_RETRIES)
+			return -EAGAIN;
+		seq = __atomic_load_n(&snap->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		st = __atomic_load_n(&snap->state, __ATOMIC_RELAXED);
+		hw_ptr = __atomic_load_n(&snap->hw_ptr, __ATOMIC_RELAXED);
+		appl_ptr = __atomic_load_n(&snap->appl_ptr, __ATOMIC_RELAXED);
+		buffer_size = __atomic_load_n(&snap->buffer_size, __ATOMIC_RELAXED);
+		boundary = __atomic_load_n(&snap->boundary, __ATOMIC_RELAXED);
+		ts.tv_sec = __atomic_load_n(&snap->tstamp.tv_sec, __ATOMIC_RELAXED);
+		ts.tv_nsec = __atomic_load_n(&snap->tstamp.tv_nsec, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&snap->seq, __ATOMIC_RELAXED) == seq)
+			break;
+	}
+
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		avail = hw_ptr + buffer_size - appl_ptr;
+		if (avail < 0)
+			avail += boundary;
+		else if ((snd_pcm_uframes_t) avail >= boundary)
+			avail -= boundary;
+	} else {
+		avail = hw_ptr - appl_ptr;
+		if (avail < 0)
+			avail += boundary;
+	}
+	if (state)
+		*state = st;
+	if (availp)
+		*availp = avail;
+	if (delayp)
+		*delayp = pcm->stream == SND_PCM_STREAM_PLAYBACK ?
+			(snd_pcm_sframes_t) buffer_size - avail : avail;
+	if (tstamp)
+		*tstamp = ts;
+	return 0;
+}
+
 /**
  * \brief Silence an area
  * \param dst_area area specification
@@ -2952,22 +3640,13 @@ int snd_pcm_area_silence(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes
 	dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
 	width = snd_pcm_format_physical_width(format);
 	silence = snd_pcm_format_silence_64(format);
-        /*
-         * Iterate copying silent sample for sample data aligned to 64 bit.
-         * This is a fast path.
-         */
-        if (dst_area->step == (unsigned int) width &&
-            width != 24 &&
-            ((intptr_t)dst & 7) == 0) {
-		unsigned int dwords = samples * width / 64;
-		uint64_t *dstp = (uint64_t *)dst;
-		samples -= dwords * 64 / width;
-		while (dwords-- > 0)
-			*dstp++ = silence;
-		if (samples == 0)
-			return 0;
-		dst = (char *)dstp;
-	}
+	/*
+	 * Contiguous samples are filled with wide stores.
+	 * This is a fast path.
+	 */
+	if (dst_area->step == (unsigned int) width && width >= 8 &&
+	    dst_area->first % 8 == 0)
+		return snd_pcm_format_set_silence(format, dst, samples);
 	dst_step = dst_area->step / 8;
 	switch (width) {
 	case 4: {
@@ -3116,6 +3795,10 @@ int snd_pcm_area_copy(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes_t
 	int src_step, dst_step;
 	if (dst_area == src_area && dst_offset == src_offset)
 		return 0;
+	/* a plugin converting on the place */
+	if (dst_area->addr == src_area->addr && dst_area->first == src_area->first &&
+	    dst_area->step == src_area->step && dst_offset == src_offset)
+		return 0;
 	if (!src_area->addr)
 		return snd_pcm_area_silence(dst_area, dst_offset, samples, format);
 	src = snd_pcm_channel_area_addr(src_area, src_offset);
@@ -3215,6 +3898,100 @@ int snd_pcm_area_copy(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes_t
 	return 0;
 }
 
+/* return the frame size in bytes if areas share one interleaved buffer */
+static unsigned int areas_interleaved_bytes(const snd_pcm_channel_area_t *areas,
+					    unsigned int channels, int width)
+{
+	unsigned int c;
+
+	if (!areas->addr || areas->first % 8 || areas->step % 8 ||
+	    areas->step < channels * width)
+		return 0;
+	for (c = 1; c < channels; c++) {
+		if (areas[c].addr != areas->addr ||
+		    areas[c].step != areas->step ||
+		    areas[c].first != areas->first + c * width)
+			return 0;
+	}
+	return areas->step / 8;
+}
+
+/* check whether each channel is stored contiguously */
+static int areas_planar(const snd_pcm_channel_area_t *areas,
+			unsigned int channels, int width)
+{
+	unsigned int c;
+
+	for (c = 0; c < channels; c++) {
+		if (!areas[c].addr || areas[c].first % 8 ||
+		    areas[c].step != (unsigned int) width)
+			return 0;
+	}
+	return 1;
+}
+
+#define TRANSPOSE_CHANNELS	64
+
+/*
+ * Copy between an interleaved and a non-interleaved layout in one
+ * cache-blocked pass instead of one strided pass per channel.
+ * Returns 0 if the layout was handled, -EINVAL otherwise.
+ */
+static int areas_copy_transpose(const snd_pcm_channel_area_t *dst_areas,
+				snd_pcm_uframes_t dst_offset,
+				const snd_pcm_channel_area_t *src_areas,
+				snd_pcm_uframes_t src_offset,
+				unsigned int channels, snd_pcm_uframes_t frames,
+				int width)
+{
+	const snd_pcm_channel_area_t *planar_areas, *inter_areas;
+	snd_pcm_uframes_t planar_offset, inter_offset;
+	char *planar[TRANSPOSE_CHANNELS];
+	unsigned int frame_bytes, c, chns;
+	int to_planar;
+
+	if (channels < 2)
+		return -EINVAL;
+	switch (width) {
+	case 8: case 16: case 24: case 32: case 64:
+		break;
+	default:
+		return -EINVAL;
+	}
+	frame_bytes = areas_interleaved_bytes(src_areas, channels, width);
+	if (frame_bytes && areas_planar(dst_areas, channels, width)) {
+		to_planar = 1;
+		inter_areas = src_areas;
+		inter_offset = src_offset;
+		planar_areas = dst_areas;
+		planar_offset = dst_offset;
+	} else {
+		frame_bytes = areas_interleaved_bytes(dst_areas, channels, width);
+		if (!frame_bytes || !areas_planar(src_areas, channels, width))
+			return -EINVAL;
+		to_planar = 0;
+		inter_areas = dst_areas;
+		inter_offset = dst_offset;
+		planar_areas = src_areas;
+		planar_offset = src_offset;
+	}
+	for (c = 0; c < channels; c += chns) {
+		unsigned int i;
+		chns = channels - c;
+		if (chns > TRANSPOSE_CHANNELS)
+			chns = TRANSPOSE_CHANNELS;
+		for (i = 0; i < chns; i++)
+			planar[i] = snd_pcm_channel_area_addr(&planar_areas[c + i],
+							      planar_offset);
+		snd_pcm_simd_transpose(planar,
+				       (char *)snd_pcm_channel_area_addr(&inter_areas[c],
+									 inter_offset),
+				       frame_bytes, chns, frames, width / 8,
+				       to_planar);
+	}
+	return 0;
+}
+
 /**
  * \brief Copy one or more areas
  * \param dst_areas destination areas specification (one for each channel)
@@ -3241,6 +4018,9 @@ int snd_pcm_areas_copy(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_
 		SNDMSG("invalid frames %ld", frames);
 		return -EINVAL;
 	}
+	if (areas_copy_transpose(dst_areas, dst_offset, src_areas, src_offset,
+				 channels, frames, width) == 0)
+		return 0;
 	while (channels > 0) {
 		unsigned int step = src_areas->step;
 		void *src_addr = src_areas->addr;
@@ -3340,6 +4120,135 @@ int snd_pcm_areas_copy_wrap(const snd_pcm_channel_area_t *dst_channels,
 	return 0;
 }
 
+static int areas_convert(const snd_pcm_channel_area_t *dst_areas,
+			 snd_pcm_uframes_t dst_offset,
+			 snd_pcm_format_t dst_format,
+			 const snd_pcm_channel_area_t *src_areas,
+			 snd_pcm_uframes_t src_offset,
+			 snd_pcm_format_t src_format,
+			 unsigned int channels, snd_pcm_uframes_t frames)
+{
+	snd_pcm_simd_convert_t kernel;
+
+	assert(dst_areas);
+	assert(src_areas);
+	kernel = snd_pcm_simd_g711_kernel(src_format, dst_format);
+	if (!kernel) {
+		SNDMSG("unsupported conversion %s -> %s",
+		       snd_pcm_format_name(src_format),
+		       snd_pcm_format_name(dst_format));
+		return -EINVAL;
+	}
+	snd_pcm_simd_convert_areas(kernel, dst_areas, dst_offset,
+				   snd_pcm_format_physical_width(dst_format),
+				   src_areas, src_offset,
+				   snd_pcm_format_physical_width(src_format),
+				   channels, frames);
+	return 0;
+}
+
+/**
+ * \brief Decode one or more areas of mu-law samples to a linear format
+ * \param dst_areas destination areas specification (one for each channel)
+ * \param dst_offset offset in frames inside destination area
+ * \param src_areas source areas specification (one for each channel)
+ * \param src_offset offset in frames inside source area
+ * \param channels channels count
+ * \param frames frames to convert
+ * \param format linear format of the destination
+ * \return 0 on success otherwise a negative error code
+ *
+ * The 8, 16, 24 and 32-bit linear formats are supported, the 18-bit and
+ * 20-bit formats are not.  The result is the same as with the mulaw PCM
+ * plugin.
+ */
+int snd_pcm_areas_mulaw_decode(const snd_pcm_channel_area_t *dst_areas,
+			       snd_pcm_uframes_t dst_offset,
+			       const snd_pcm_channel_area_t *src_areas,
+			       snd_pcm_uframes_t src_offset,
+			       unsigned int channels, snd_pcm_uframes_t frames,
+			       snd_pcm_format_t format)
+{
+	return areas_convert(dst_areas, dst_offset, format,
+			     src_areas, src_offset, SND_PCM_FORMAT_MU_LAW,
+			     channels, frames);
+}
+
+/**
+ * \brief Encode one or more areas of linear samples to mu-law
+ * \param dst_areas destination areas specification (one for each channel)
+ * \param dst_offset offset in frames inside destination area
+ * \param src_areas source areas specification (one for each channel)
+ * \param src_offset offset in frames inside source area
+ * \param channels channels count
+ * \param frames frames to convert
+ * \param format linear format of the source
+ * \return 0 on success otherwise a negative error code
+ *
+ * See #snd_pcm_areas_mulaw_decode() for the supported formats.
+ */
+int snd_pcm_areas_mulaw_encode(const snd_pcm_channel_area_t *dst_areas,
+			       snd_pcm_uframes_t dst_offset,
+			       const snd_pcm_channel_area_t *src_areas,
+			       snd_pcm_uframes_t src_offset,
+			       unsigned int channels, snd_pcm_uframes_t frames,
+			       snd_pcm_format_t format)
+{
+	return areas_convert(dst_areas, dst_offset, SND_PCM_FORMAT_MU_LAW,
+			     src_areas, src_offset, format,
+			     channels, frames);
+}
+
+/**
+ * \brief Decode one or more areas of A-law samples to a linear format
+ * \param dst_areas destination areas specification (one for each channel)
+ * \param dst_offset offset in frames inside destination area
+ * \param src_areas source areas specification (one for each channel)
+ * \param src_offset offset in frames inside source area
+ * \param channels channels count
+ * \param frames frames to convert
+ * \param format linear format of the destination
+ * \return 0 on success otherwise a negative error code
+ *
+ * See #snd_pcm_areas_mulaw_decode() for the supported formats.
+ */
+int snd_pcm_areas_alaw_decode(const snd_pcm_channel_area_t *dst_areas,
+			      snd_pcm_uframes_t dst_offset,
+			      const snd_pcm_channel_area_t *src_areas,
+			      snd_pcm_uframes_t src_offset,
+			      unsigned int channels, snd_pcm_uframes_t frames,
+			      snd_pcm_format_t format)
+{
+	return areas_convert(dst_areas, dst_offset, format,
+			     src_areas, src_offset, SND_PCM_FORMAT_A_LAW,
+			     channels, frames);
+}
+
+/**
+ * \brief Encode one or more areas of linear samples to A-law
+ * \param dst_areas destination areas specification (one for each channel)
+ * \param dst_offset offset in frames inside destination area
+ * \param src_areas source areas specification (one for each channel)
+ * \param src_offset offset in frames inside source area
+ * \param channels channels count
+ * \param frames frames to convert
+ * \param format linear format of the source
+ * \return 0 on success otherwise a negative error code
+ *
+ * See #snd_pcm_areas_mulaw_decode() for the supported formats.
+ */
+int snd_pcm_areas_alaw_encode(const snd_pcm_channel_area_t *dst_areas,
+			      snd_pcm_uframes_t dst_offset,
+			      const snd_pcm_channel_area_t *src_areas,
+			      snd_pcm_uframes_t src_offset,
+			      unsigned int channels, snd_pcm_uframes_t frames,
+			      snd_pcm_format_t format)
+{
+	return areas_convert(dst_areas, dst_offset, SND_PCM_FORMAT_A_LAW,
+			     src_areas, src_offset, format,
+			     channels, frames);
+}
+
 static void dump_one_param(snd_pcm_hw_params_t *params, unsigned int k, snd_output_t *out)
 {
 	snd_output_printf(out, "%s: ", snd_pcm_hw_param_name(k));
@@ -7100,6 +8009,10 @@ void snd_pcm_info_set_stream(snd_pcm_info_t *obj, snd_pcm_stream_t val)
  * The resulting size parameter is always less or equal to the input count of frames
  * and can be zero, if no frames can be processed (the ring buffer is full).
  *
+ * With a mirrored ring buffer (see \ref pcm_mmap_mirror) the returned area
+ * is not split at the end of the buffer: offset + frames may exceed the
+ * buffer size.
+ *
  * See the snd_pcm_mmap_commit() function to finish the frame processing in
  * the direct areas.
  *
@@ -7143,7 +8056,8 @@ int __snd_pcm_mmap_begin(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas,
 	f = *frames;
 	if (f > avail)
 		f = avail;
-	if (f > cont)
+	/* a mirrored buffer continues past its end */
+	if (f > cont && !pcm->mmap_mirror)
 		f = cont;
 	*frames = f;
 	return 0;
@@ -7214,9 +8128,13 @@ snd_pcm_sframes_t snd_pcm_mmap_commit(snd_pcm_t *pcm,
 	err = bad_pcm_state(pcm, P_STATE_RUNNABLE);
 	if (err < 0)
 		return err;
+	snd_pcm_stats_xfer(pcm);
 	snd_pcm_lock(pcm);
 	result = __snd_pcm_mmap_commit(pcm, offset, frames);
+	pcm_snapshot_publish(pcm, result < 0 ? result : 0, SNAPSHOT_KEEP_STATE);
 	snd_pcm_unlock(pcm);
+	if (result > 0)
+		snd_pcm_stats_add(pcm, SND_PCM_STAT_FRAMES, result);
 	return result;
 }
 
@@ -7300,6 +8218,7 @@ snd_pcm_sframes_t snd_pcm_read_areas(snd_pcm_t *pcm, const snd_pcm_channel_area_
 			err = __snd_pcm_start(pcm);
 			if (err < 0)
 				goto _end;
+			state = SND_PCM_STATE_RUNNING;
 			break;
 		case SND_PCM_STATE_RUNNING:
 			err = __snd_pcm_hwsync(pcm);
@@ -7348,7 +8267,9 @@ snd_pcm_sframes_t snd_pcm_read_areas(snd_pcm_t *pcm, const snd_pcm_channel_area_
 		xfer += frames;
 	}
  _end:
+	pcm_snapshot_publish(pcm, err < 0 ? err : 0, state);
 	__snd_pcm_unlock(pcm);
+	snd_pcm_stats_add(pcm, SND_PCM_STAT_FRAMES, xfer);
 	return xfer > 0 ? (snd_pcm_sframes_t) xfer : snd_pcm_check_error(pcm, err);
 }
 
@@ -7421,6 +8342,7 @@ snd_pcm_sframes_t snd_pcm_write_areas(snd_pcm_t *pcm, const snd_pcm_channel_area
 				err = __snd_pcm_start(pcm);
 				if (err < 0)
 					goto _end;
+				state = SND_PCM_STATE_RUNNING;
 			}
 		}
 		offset += frames;
@@ -7428,7 +8350,9 @@ snd_pcm_sframes_t snd_pcm_write_areas(snd_pcm_t *pcm, const snd_pcm_channel_area
 		xfer += frames;
 	}
  _end:
+	pcm_snapshot_publish(pcm, err < 0 ? err : 0, state);
 	__snd_pcm_unlock(pcm);
+	snd_pcm_stats_add(pcm, SND_PCM_STAT_FRAMES, xfer);
 	return xfer > 0 ? (snd_pcm_sframes_t) xfer : snd_pcm_check_error(pcm, err);
 }
 
@@ -8422,11 +9346,14 @@ int snd_pcm_recover(snd_pcm_t *pcm, int err, int silent)
                         s = "overrun";
                 if (!silent)
                         SNDERR("%s occurred", s);
+                /* the error may come from snd_pcm_wait() or a poll */
+                pcm_stats_xrun(pcm, err, SNAPSHOT_KEEP_STATE);
                 err = snd_pcm_prepare(pcm);
                 if (err < 0) {
                         SNDERR("cannot recovery from %s, prepare failed: %s", s, snd_strerror(err));
                         return err;
                 }
+                snd_pcm_stats_inc(pcm, SND_PCM_STAT_RECOVER);
                 return 0;
         }
         if (err == -ESTRPIPE) {
@@ -8440,6 +9367,7 @@ int snd_pcm_recover(snd_pcm_t *pcm, int err, int silent)
                                 return err;
                         }
                 }
+                snd_pcm_stats_inc(pcm, SND_PCM_STAT_RECOVER);
                 return 0;
         }
         return err;
@@ -59,6 +59,10 @@ IMA compatibility project proceedings, Vol 2, Issue 2, May 1992.
 #include "bswap.h"
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#include "pcm_simd.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #include "plugin_ops.h"
 
@@ -77,6 +81,32 @@ typedef void (*adpcm_f)(const snd_pcm_channel_area_t *dst_areas,
 			unsigned int getputidx,
 			snd_pcm_adpcm_state_t *states);
 
+/* channels coded side by side, one per vector lane */
+#define ADPCM_LANES	8
+/* frames per pass through the lane buffers */
+#define ADPCM_CHUNK	256
+
+typedef void (*adpcm_encode_lanes_f)(unsigned char *codes,
+				     const int16_t *samples,
+				     unsigned int frames,
+				     unsigned int lanes,
+				     snd_pcm_adpcm_state_t *states);
+typedef void (*adpcm_decode_lanes_f)(int16_t *samples,
+				     const unsigned char *codes,
+				     unsigned int frames,
+				     unsigned int lanes,
+				     snd_pcm_adpcm_state_t *states);
+
+typedef struct {
+	const snd_pcm_channel_area_t *dst_areas;
+	snd_pcm_uframes_t dst_offset;
+	const snd_pcm_channel_area_t *src_areas;
+	snd_pcm_uframes_t src_offset;
+	snd_pcm_uframes_t frames;
+} adpcm_job_t;
+
+typedef struct adpcm_pool adpcm_pool_t;
+
 typedef struct {
 	/* This field need to be the first */
 	snd_pcm_plugin_t plug;
@@ -84,6 +114,13 @@ typedef struct {
 	adpcm_f func;
 	snd_pcm_format_t sformat;
 	snd_pcm_adpcm_state_t *states;
+	/* lane coder, used when 'kernel' is set */
+	snd_pcm_simd_convert_t kernel;	/* linear <-> S16 */
+	int encode;
+	adpcm_encode_lanes_f encode_lanes;
+	adpcm_decode_lanes_f decode_lanes;
+	unsigned int channels;
+	adpcm_pool_t *pool;
 } snd_pcm_adpcm_t;
 
 #endif
@@ -91,8 +128,10 @@ typedef struct {
 /* First table lookup for Ima-ADPCM quantizer */
 static const char IndexAdjust[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
 
-/* Second table lookup for Ima-ADPCM quantizer */
-static const short StepSize[89] = {
+/* Second table lookup for Ima-ADPCM quantizer, with one entry of padding
+ * for the 32-bit gathers of the vector coder
+ */
+static const short StepSize[89 + 1] = {
 	7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
 	19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
 	50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
@@ -321,6 +360,442 @@ void snd_pcm_adpcm_encode(const snd_pcm_channel_area_t *dst_areas,
 
 #endif
 
+#ifndef DOC_HIDDEN
+
+/*
+ * The per-sample state machine is serial within a channel only, so the
+ * lane coder runs up to ADPCM_LANES channels side by side: the samples of
+ * a chunk of frames are gathered into a frame-major block of S16 values
+ * (or of codes), coded there and scattered back.  The results are the
+ * same as those of the per-channel loops above.  The plain C coders only
+ * touch the first 'lanes' lanes, the vector ones code all of them.
+ */
+
+static void adpcm_encode_lanes(unsigned char *codes, const int16_t *samples,
+			       unsigned int frames,
+			       unsigned int lanes,
+			       snd_pcm_adpcm_state_t *states)
+{
+	unsigned int lane;
+
+	while (frames-- > 0) {
+		for (lane = 0; lane < lanes; lane++)
+			codes[lane] = adpcm_encoder(samples[lane], &states[lane]);
+		codes += ADPCM_LANES;
+		samples += ADPCM_LANES;
+	}
+}
+
+static void adpcm_decode_lanes(int16_t *samples, const unsigned char *codes,
+			       unsigned int frames,
+			       unsigned int lanes,
+			       snd_pcm_adpcm_state_t *states)
+{
+	unsigned int lane;
+
+	while (frames-- > 0) {
+		for (lane = 0; lane < lanes; lane++)
+			samples[lane] = adpcm_decoder(codes[lane], &states[lane]);
+		codes += ADPCM_LANES;
+		samples += ADPCM_LANES;
+	}
+}
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * The same arithmetic with one channel per 32-bit lane.  The 16-bit
+ * wrap-arounds of the short variables in adpcm_encoder() and
+ * adpcm_decoder() are reproduced with adpcm_sx16().
+ */
+
+static inline SND_PCM_SIMD_TARGET("avx2") __m256i adpcm_sx16(__m256i x)
+{
+	return _mm256_srai_epi32(_mm256_slli_epi32(x, 16), 16);
+}
+
+static inline SND_PCM_SIMD_TARGET("avx2")
+__m256i adpcm_step_avx2(__m256i step_idx)
+{
+	return _mm256_and_si256(_mm256_i32gather_epi32((const int *)StepSize,
+						       step_idx, 2),
+				_mm256_set1_epi32(0xffff));
+}
+
+/* apply the predicted difference and move the step index */
+static inline SND_PCM_SIMD_TARGET("avx2")
+void adpcm_update_avx2(__m256i *pred_val, __m256i *step_idx,
+		       __m256i pred_diff, __m256i sign, __m256i adjust_idx)
+{
+	const __m256i index_adjust = _mm256_setr_epi32(-1, -1, -1, -1,
+						       2, 4, 6, 8);
+
+	pred_diff = _mm256_sub_epi32(_mm256_xor_si256(adpcm_sx16(pred_diff), sign),
+				     sign);
+	*pred_val = _mm256_add_epi32(*pred_val, pred_diff);
+	*pred_val = _mm256_min_epi32(*pred_val, _mm256_set1_epi32(32767));
+	*pred_val = _mm256_max_epi32(*pred_val, _mm256_set1_epi32(-32768));
+	*step_idx = _mm256_add_epi32(*step_idx,
+				     _mm256_permutevar8x32_epi32(index_adjust,
+								 adjust_idx));
+	*step_idx = _mm256_min_epi32(*step_idx, _mm256_set1_epi32(88));
+	*step_idx = _mm256_max_epi32(*step_idx, _mm256_setzero_si256());
+}
+
+static SND_PCM_SIMD_TARGET("avx2")
+void adpcm_encode_lanes_avx2(unsigned char *codes, const int16_t *samples,
+			     unsigned int frames,
+			     unsigned int lanes ATTRIBUTE_UNUSED,
+			     snd_pcm_adpcm_state_t *states)
+{
+	int32_t val[ADPCM_LANES], idx[ADPCM_LANES];
+	__m256i pred_val, step_idx;
+	unsigned int lane;
+
+	for (lane = 0; lane < ADPCM_LANES; lane++) {
+		val[lane] = states[lane].pred_val;
+		idx[lane] = states[lane].step_idx;
+	}
+	pred_val = _mm256_loadu_si256((const __m256i *)val);
+	step_idx = _mm256_loadu_si256((const __m256i *)idx);
+	while (frames-- > 0) {
+		__m256i sl = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)samples));
+		__m256i diff = adpcm_sx16(_mm256_sub_epi32(sl, pred_val));
+		__m256i sign = _mm256_srai_epi32(diff, 31);
+		__m256i step = adpcm_step_avx2(step_idx);
+		__m256i pred_diff = _mm256_srli_epi32(step, 3);
+		__m256i adjust_idx = _mm256_setzero_si256();
+		__m256i code;
+		int bit;
+
+		diff = adpcm_sx16(_mm256_sub_epi32(_mm256_xor_si256(diff, sign), sign));
+		for (bit = 4; bit; bit >>= 1) {
+			__m256i ge = _mm256_cmpgt_epi32(step, diff);
+			__m256i m = _mm256_andnot_si256(ge, step);
+			adjust_idx = _mm256_or_si256(adjust_idx,
+						     _mm256_andnot_si256(ge, _mm256_set1_epi32(bit)));
+			diff = _mm256_sub_epi32(diff, m);
+			pred_diff = _mm256_add_epi32(pred_diff, m);
+			step = _mm256_srli_epi32(step, 1);
+		}
+		adpcm_update_avx2(&pred_val, &step_idx, pred_diff, sign, adjust_idx);
+		code = _mm256_or_si256(adjust_idx,
+				       _mm256_and_si256(sign, _mm256_set1_epi32(0x8)));
+		code = _mm256_packs_epi32(code, code);
+		code = _mm256_packus_epi16(code, code);
+		code = _mm256_unpacklo_epi32(code, _mm256_permute4x64_epi64(code, 0x02));
+		_mm_storel_epi64((__m128i *)codes, _mm256_castsi256_si128(code));
+		codes += ADPCM_LANES;
+		samples += ADPCM_LANES;
+	}
+	_mm256_storeu_si256((__m256i *)val, pred_val);
+	_mm256_storeu_si256((__m256i *)idx, step_idx);
+	for (lane = 0; lane < ADPCM_LANES; lane++) {
+		states[lane].pred_val = val[lane];
+		states[lane].step_idx = idx[lane];
+	}
+}
+
+static SND_PCM_SIMD_TARGET("avx2")
+void adpcm_decode_lanes_avx2(int16_t *samples, const unsigned char *codes,
+			     unsigned int frames,
+			     unsigned int lanes ATTRIBUTE_UNUSED,
+			     snd_pcm_adpcm_state_t *states)
+{
+	int32_t val[ADPCM_LANES], idx[ADPCM_LANES];
+	__m256i pred_val, step_idx;
+	unsigned int lane;
+
+	for (lane = 0; lane < ADPCM_LANES; lane++) {
+		val[lane] = states[lane].pred_val;
+		idx[lane] = states[lane].step_idx;
+	}
+	pred_val = _mm256_loadu_si256((const __m256i *)val);
+	step_idx = _mm256_loadu_si256((const __m256i *)idx);
+	while (frames-- > 0) {
+		__m256i code = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)codes));
+		__m256i sign = _mm256_cmpeq_epi32(_mm256_and_si256(code, _mm256_set1_epi32(0x8)),
+						  _mm256_set1_epi32(0x8));
+		__m256i step = adpcm_step_avx2(step_idx);
+		__m256i pred_diff = _mm256_srli_epi32(step, 3);
+		__m256i out;
+		int bit;
+
+		code = _mm256_and_si256(code, _mm256_set1_epi32(0x7));
+		for (bit = 4; bit; bit >>= 1) {
+			__m256i b = _mm256_set1_epi32(bit);
+			__m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(code, b), b);
+			pred_diff = _mm256_add_epi32(pred_diff, _mm256_and_si256(m, step));
+			step = _mm256_srli_epi32(step, 1);
+		}
+		adpcm_update_avx2(&pred_val, &step_idx, pred_diff, sign, code);
+		out = _mm256_permute4x64_epi64(_mm256_packs_epi32(pred_val, pred_val), 0x08);
+		_mm_storeu_si128((__m128i *)samples, _mm256_castsi256_si128(out));
+		codes += ADPCM_LANES;
+		samples += ADPCM_LANES;
+	}
+	_mm256_storeu_si256((__m256i *)val, pred_val);
+	_mm256_storeu_si256((__m256i *)idx, step_idx);
+	for (lane = 0; lane < ADPCM_LANES; lane++) {
+		states[lane].pred_val = val[lane];
+		states[lane].step_idx = idx[lane];
+	}
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* the 4-bit codes of one channel <-> every ADPCM_LANES-th byte */
+static void adpcm_get_codes(unsigned char *codes,
+			    const snd_pcm_channel_area_t *area,
+			    snd_pcm_uframes_t offset, unsigned int frames)
+{
+	unsigned int bit = area->first + area->step * offset;
+	const unsigned char *src = (const unsigned char *)area->addr + bit / 8;
+	int src_step = area->step / 8, bit_step = area->step % 8;
+
+	bit %= 8;
+	while (frames-- > 0) {
+		*codes = bit ? *src & 0x0f : (*src >> 4) & 0x0f;
+		codes += ADPCM_LANES;
+		src += src_step;
+		bit += bit_step;
+		if (bit == 8) {
+			src++;
+			bit = 0;
+		}
+	}
+}
+
+static void adpcm_put_codes(const snd_pcm_channel_area_t *area,
+			    snd_pcm_uframes_t offset,
+			    const unsigned char *codes, unsigned int frames)
+{
+	unsigned int bit = area->first + area->step * offset;
+	unsigned char *dst = (unsigned char *)area->addr + bit / 8;
+	int dst_step = area->step / 8, bit_step = area->step % 8;
+
+	bit %= 8;
+	while (frames-- > 0) {
+		if (bit)
+			*dst = (*dst & 0xf0) | *codes;
+		else
+			*dst = (*dst & 0x0f) | (*codes << 4);
+		codes += ADPCM_LANES;
+		dst += dst_step;
+		bit += bit_step;
+		if (bit == 8) {
+			dst++;
+			bit = 0;
+		}
+	}
+}
+
+/* code the channels first .. first + lanes - 1 */
+static void adpcm_code_lanes(snd_pcm_adpcm_t *adpcm, const adpcm_job_t *job,
+			     unsigned int first, unsigned int lanes)
+{
+	int16_t samples[ADPCM_CHUNK * ADPCM_LANES];
+	unsigned char codes[ADPCM_CHUNK * ADPCM_LANES];
+	snd_pcm_adpcm_state_t states[ADPCM_LANES];
+	snd_pcm_uframes_t done;
+	unsigned int lane, n;
+
+	memcpy(states, adpcm->states + first, lanes * sizeof(*states));
+	if (lanes < ADPCM_LANES) {
+		/* the spare lanes code silence */
+		memset(states + lanes, 0, (ADPCM_LANES - lanes) * sizeof(*states));
+		memset(samples, 0, sizeof(samples));
+		memset(codes, 0, sizeof(codes));
+	}
+	for (done = 0; done < job->frames; done += n) {
+		n = job->frames - done;
+		if (n > ADPCM_CHUNK)
+			n = ADPCM_CHUNK;
+		for (lane = 0; lane < lanes; lane++) {
+			const snd_pcm_channel_area_t *src = &job->src_areas[first + lane];
+			if (adpcm->encode)
+				adpcm->kernel((char *)(samples + lane),
+					      ADPCM_LANES * sizeof(*samples),
+					      snd_pcm_channel_area_addr(src, job->src_offset + done),
+					      snd_pcm_channel_area_step(src), n);
+			else
+				adpcm_get_codes(codes + lane, src,
+						job->src_offset + done, n);
+		}
+		if (adpcm->encode)
+			adpcm->encode_lanes(codes, samples, n, lanes, states);
+		else
+			adpcm->decode_lanes(samples, codes, n, lanes, states);
+		for (lane = 0; lane < lanes; lane++) {
+			const snd_pcm_channel_area_t *dst = &job->dst_areas[first + lane];
+			if (adpcm->encode)
+				adpcm_put_codes(dst, job->dst_offset + done,
+						codes + lane, n);
+			else
+				adpcm->kernel(snd_pcm_channel_area_addr(dst, job->dst_offset + done),
+					      snd_pcm_channel_area_step(dst),
+					      (const char *)(samples + lane),
+					      ADPCM_LANES * sizeof(*samples), n);
+		}
+	}
+	memcpy(adpcm->states + first, states, lanes * sizeof(*states));
+}
+
+/* share 'part' of 'parts' of the lane groups */
+static void adpcm_code_part(snd_pcm_adpcm_t *adpcm, const adpcm_job_t *job,
+			    unsigned int part, unsigned int parts)
+{
+	unsigned int groups = (adpcm->channels + ADPCM_LANES - 1) / ADPCM_LANES;
+	unsigned int group = groups * part / parts;
+	unsigned int last = groups * (part + 1) / parts;
+
+	for (; group < last; group++) {
+		unsigned int first = group * ADPCM_LANES;
+		unsigned int lanes = adpcm->channels - first;
+		if (lanes > ADPCM_LANES)
+			lanes = ADPCM_LANES;
+		adpcm_code_lanes(adpcm, job, first, lanes);
+	}
+}
+
+#ifdef HAVE_LIBPTHREAD
+
+/*
+ * With many channels the lane groups are split between the calling thread
+ * and a few workers that live from hw_params to hw_free.
+ */
+struct adpcm_pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t start_cond;
+	pthread_cond_t done_cond;
+	unsigned int generation;
+	unsigned int pending;
+	int quit;
+	adpcm_job_t job;
+	snd_pcm_adpcm_t *adpcm;
+	unsigned int nworkers;
+	struct adpcm_worker {
+		pthread_t thread;
+		adpcm_pool_t *pool;
+		unsigned int part;
+	} workers[0];
+};
+
+static void *adpcm_worker(void *arg)
+{
+	struct adpcm_worker *worker = arg;
+	adpcm_pool_t *pool = worker->pool;
+	unsigned int generation = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		while (pool->generation == generation && !pool->quit)
+			pthread_cond_wait(&pool->start_cond, &pool->mutex);
+		if (pool->quit)
+			break;
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+		adpcm_code_part(pool->adpcm, &pool->job, worker->part,
+				pool->nworkers + 1);
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->pending == 0)
+			pthread_cond_signal(&pool->done_cond);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+static void adpcm_pool_free(snd_pcm_adpcm_t *adpcm)
+{
+	adpcm_pool_t *pool = adpcm->pool;
+	unsigned int k;
+
+	if (!pool)
+		return;
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->mutex);
+	for (k = 0; k < pool->nworkers; k++)
+		pthread_join(pool->workers[k].thread, NULL);
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->start_cond);
+	pthread_cond_destroy(&pool->done_cond);
+	free(pool);
+	adpcm->pool = NULL;
+}
+
+/* $LIBASOUND_ADPCM_THREADS threads in all, one lane group at least each */
+static void adpcm_pool_new(snd_pcm_adpcm_t *adpcm)
+{
+	const char *env = getenv("LIBASOUND_ADPCM_THREADS");
+	unsigned int groups = (adpcm->channels + ADPCM_LANES - 1) / ADPCM_LANES;
+	unsigned int threads = env ? atoi(env) : 0;
+	adpcm_pool_t *pool;
+
+	if (threads > groups)
+		threads = groups;
+	if (threads < 2)
+		return;
+	pool = calloc(1, sizeof(*pool) + (threads - 1) * sizeof(pool->workers[0]));
+	if (!pool)
+		return;
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+	pool->adpcm = adpcm;
+	adpcm->pool = pool;
+	for (; pool->nworkers < threads - 1; pool->nworkers++) {
+		struct adpcm_worker *worker = &pool->workers[pool->nworkers];
+		worker->pool = pool;
+		worker->part = pool->nworkers + 1;
+		if (pthread_create(&worker->thread, NULL, adpcm_worker, worker))
+			break;
+	}
+	if (!pool->nworkers)
+		adpcm_pool_free(adpcm);
+}
+
+static void adpcm_code(snd_pcm_adpcm_t *adpcm, const adpcm_job_t *job)
+{
+	adpcm_pool_t *pool = adpcm->pool;
+
+	if (!pool) {
+		adpcm_code_part(adpcm, job, 0, 1);
+		return;
+	}
+	pthread_mutex_lock(&pool->mutex);
+	pool->job = *job;
+	pool->pending = pool->nworkers;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->mutex);
+	adpcm_code_part(adpcm, job, 0, pool->nworkers + 1);
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->pending)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+#else /* HAVE_LIBPTHREAD */
+
+static void adpcm_pool_new(snd_pcm_adpcm_t *adpcm ATTRIBUTE_UNUSED)
+{
+}
+
+static void adpcm_pool_free(snd_pcm_adpcm_t *adpcm ATTRIBUTE_UNUSED)
+{
+}
+
+static void adpcm_code(snd_pcm_adpcm_t *adpcm, const adpcm_job_t *job)
+{
+	adpcm_code_part(adpcm, job, 0, 1);
+}
+
+#endif /* HAVE_LIBPTHREAD */
+
+#endif /* DOC_HIDDEN */
+
 static int snd_pcm_adpcm_hw_refine_cprepare(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
 	snd_pcm_adpcm_t *adpcm = pcm->private_data;
@@ -439,16 +914,38 @@ static int snd_pcm_adpcm_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 			adpcm->func = snd_pcm_adpcm_encode;
 		}
 	}
+	adpcm->encode = adpcm->func == snd_pcm_adpcm_encode;
+	if (adpcm->sformat != SND_PCM_FORMAT_IMA_ADPCM)
+		format = adpcm->sformat;
+	if (adpcm->encode)
+		adpcm->kernel = snd_pcm_simd_linear_kernel(format, SND_PCM_FORMAT_S16);
+	else
+		adpcm->kernel = snd_pcm_simd_linear_kernel(SND_PCM_FORMAT_S16, format);
+	adpcm->encode_lanes = adpcm_encode_lanes;
+	adpcm->decode_lanes = adpcm_decode_lanes;
+#ifdef HAVE_X86_SIMD
+	if (snd_pcm_simd_caps() & SND_PCM_SIMD_AVX2) {
+		adpcm->encode_lanes = adpcm_encode_lanes_avx2;
+		adpcm->decode_lanes = adpcm_decode_lanes_avx2;
+	}
+#endif
 	assert(!adpcm->states);
 	adpcm->states = malloc(adpcm->plug.gen.slave->channels * sizeof(*adpcm->states));
 	if (adpcm->states == NULL)
 		return -ENOMEM;
+	adpcm->channels = adpcm->plug.gen.slave->channels;
+	if (adpcm->kernel)
+		adpcm_pool_new(adpcm);
+	/* the plain C lanes only pay off when shared between threads */
+	if (adpcm->encode_lanes == adpcm_encode_lanes && !adpcm->pool)
+		adpcm->kernel = NULL;
 	return 0;
 }
 
 static int snd_pcm_adpcm_hw_free(snd_pcm_t *pcm)
 {
 	snd_pcm_adpcm_t *adpcm = pcm->private_data;
+	adpcm_pool_free(adpcm);
 	free(adpcm->states);
 	adpcm->states = NULL;
 	return snd_pcm_hw_free(adpcm->plug.gen.slave);
@@ -477,10 +974,15 @@ snd_pcm_adpcm_write_areas(snd_pcm_t *pcm,
 	snd_pcm_adpcm_t *adpcm = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	adpcm->func(slave_areas, slave_offset,
-		    areas, offset, 
-		    pcm->channels, size,
-		    adpcm->getput_idx, adpcm->states);
+	if (adpcm->kernel) {
+		adpcm_job_t job = { slave_areas, slave_offset,
+				    areas, offset, size };
+		adpcm_code(adpcm, &job);
+	} else
+		adpcm->func(slave_areas, slave_offset,
+			    areas, offset, 
+			    pcm->channels, size,
+			    adpcm->getput_idx, adpcm->states);
 	*slave_sizep = size;
 	return size;
 }
@@ -497,10 +999,15 @@ snd_pcm_adpcm_read_areas(snd_pcm_t *pcm,
 	snd_pcm_adpcm_t *adpcm = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	adpcm->func(areas, offset, 
-		    slave_areas, slave_offset,
-		    pcm->channels, size,
-		    adpcm->getput_idx, adpcm->states);
+	if (adpcm->kernel) {
+		adpcm_job_t job = { areas, offset,
+				    slave_areas, slave_offset, size };
+		adpcm_code(adpcm, &job);
+	} else
+		adpcm->func(areas, offset, 
+			    slave_areas, slave_offset,
+			    pcm->channels, size,
+			    adpcm->getput_idx, adpcm->states);
 	*slave_sizep = size;
 	return size;
 }
@@ -609,6 +1116,12 @@ pcm.name {
 }
 \endcode
 
+When the CPU has AVX2, eight channels are coded at once, one per vector
+lane.  With many channels the work can also be shared between threads:
+$LIBASOUND_ADPCM_THREADS gives the number of threads to use (the caller
+included, one per eight channels at most); the default is one.  The
+output does not depend on either.
+
 \subsection pcm_plugins_adpcm_funcref Function reference
 
 <UL>
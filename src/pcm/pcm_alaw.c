@@ -29,6 +29,7 @@
 #include "bswap.h"
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#include "pcm_simd.h"
 
 #include "plugin_ops.h"
 
@@ -52,6 +53,8 @@ typedef struct {
 	unsigned int getput_idx;
 	alaw_f func;
 	snd_pcm_format_t sformat;
+	snd_pcm_simd_convert_t kernel;	/* client -> slave for playback */
+	unsigned int src_width, dst_width;	/* in bits, for the kernel */
 } snd_pcm_alaw_t;
 
 #endif
@@ -335,6 +338,15 @@ static int snd_pcm_alaw_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 			alaw->func = snd_pcm_alaw_encode;
 		}
 	}
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		alaw->kernel = snd_pcm_simd_g711_kernel(format, alaw->sformat);
+		alaw->src_width = snd_pcm_format_physical_width(format);
+		alaw->dst_width = snd_pcm_format_physical_width(alaw->sformat);
+	} else {
+		alaw->kernel = snd_pcm_simd_g711_kernel(alaw->sformat, format);
+		alaw->src_width = snd_pcm_format_physical_width(alaw->sformat);
+		alaw->dst_width = snd_pcm_format_physical_width(format);
+	}
 	return 0;
 }
 
@@ -350,10 +362,17 @@ snd_pcm_alaw_write_areas(snd_pcm_t *pcm,
 	snd_pcm_alaw_t *alaw = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	alaw->func(slave_areas, slave_offset,
-		   areas, offset, 
-		   pcm->channels, size,
-		   alaw->getput_idx);
+	if (alaw->kernel)
+		snd_pcm_simd_convert_areas(alaw->kernel,
+					   slave_areas, slave_offset,
+					   alaw->dst_width,
+					   areas, offset, alaw->src_width,
+					   pcm->channels, size);
+	else
+		alaw->func(slave_areas, slave_offset,
+			   areas, offset, 
+			   pcm->channels, size,
+			   alaw->getput_idx);
 	*slave_sizep = size;
 	return size;
 }
@@ -370,10 +389,17 @@ snd_pcm_alaw_read_areas(snd_pcm_t *pcm,
 	snd_pcm_alaw_t *alaw = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	alaw->func(areas, offset, 
-		   slave_areas, slave_offset,
-		   pcm->channels, size,
-		   alaw->getput_idx);
+	if (alaw->kernel)
+		snd_pcm_simd_convert_areas(alaw->kernel,
+					   areas, offset, alaw->dst_width,
+					   slave_areas, slave_offset,
+					   alaw->src_width,
+					   pcm->channels, size);
+	else
+		alaw->func(areas, offset, 
+			   slave_areas, slave_offset,
+			   pcm->channels, size,
+			   alaw->getput_idx);
 	*slave_sizep = size;
 	return size;
 }
@@ -483,6 +509,10 @@ pcm.name {
 }
 \endcode
 
+Decoding goes through a table, encoding of 16-bit samples is vectorized
+when the CPU supports it. The same conversion is available to applications
+as #snd_pcm_areas_alaw_decode() and #snd_pcm_areas_alaw_encode().
+
 \subsection pcm_plugins_alaw_funcref Function reference
 
 <UL>
@@ -307,6 +307,7 @@ int snd_pcm_generic_mmap(snd_pcm_t *pcm)
 		pcm->mmap_channels = generic->slave->mmap_channels;
 		pcm->running_areas = generic->slave->running_areas;
 		pcm->stopped_areas = generic->slave->stopped_areas;
+		pcm->mmap_mirror = generic->slave->mmap_mirror;
 	}
 	return 0;
 }
@@ -318,6 +319,7 @@ int snd_pcm_generic_munmap(snd_pcm_t *pcm)
 		pcm->mmap_channels = NULL;
 		pcm->running_areas = NULL;
 		pcm->stopped_areas = NULL;
+		pcm->mmap_mirror = 0;
 	}
 	return 0;
 }
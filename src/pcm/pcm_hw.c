@@ -38,6 +38,9 @@
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include "pcm_local.h"
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
 #include "../control/control_local.h"
 #include "../timer/timer_local.h"
 
@@ -82,6 +85,7 @@ static int use_old_hw_params_ioctl(int fd, unsigned int cmd, snd_pcm_hw_params_t
 static snd_pcm_sframes_t snd_pcm_hw_avail_update(snd_pcm_t *pcm);
 static const snd_pcm_fast_ops_t snd_pcm_hw_fast_ops;
 static const snd_pcm_fast_ops_t snd_pcm_hw_fast_ops_timer;
+static int snd_pcm_hw_change_timer(snd_pcm_t *pcm, int enable);
 
 /*
  *
@@ -97,11 +101,25 @@ typedef struct {
 	bool mmap_status_fallbacked;
 	bool mmap_control_fallbacked;
 	struct snd_pcm_sync_ptr *sync_ptr;
+	snd_pcm_t *pcm;			/* owner, for the stats counters */
+
+	/* rate-limited SYNC_PTR, see reuse_hw_ptr() */
+	snd_pcm_uframes_t sync_ptr_max_error;	/* 0 = always ask the kernel */
+	snd_pcm_uframes_t sync_hw_ptr;		/* hw_ptr of the last SYNC_PTR */
+	struct timespec sync_tstamp;		/* time of the last SYNC_PTR */
+	unsigned long sync_ptr_issued;
+	unsigned long sync_ptr_avoided;
 
 	int period_event;
 	snd_timer_t *period_timer;
 	struct pollfd period_timer_pfd;
 	int period_timer_need_poll;
+	/* timer-scheduled wakeups, see snd_pcm_hw_sched_arm() */
+	int timer_sched;			/* requested by the configuration */
+	int sched_fd;				/* timerfd, -1 when not active */
+	unsigned int sched_rate;		/* measured hw_ptr rate */
+	snd_pcm_uframes_t sched_hw_ptr;		/* start of the rate measurement */
+	struct timespec sched_tstamp;
 	/* restricted parameters */
 	snd_pcm_format_t format;
 	int rate;
@@ -136,14 +154,52 @@ static int sync_ptr1(snd_pcm_hw_t *hw, unsigned int flags)
 {
 	int err;
 	hw->sync_ptr->flags = flags;
+	snd_pcm_stats_inc(hw->pcm, SND_PCM_STAT_IOCTL_SYNC_PTR);
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_SYNC_PTR, hw->sync_ptr) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_SYNC_PTR failed (%i)", err);
 		return err;
 	}
+	hw->sync_ptr_issued++;
+	hw->sync_hw_ptr = hw->sync_ptr->s.status.hw_ptr;
+	clock_gettime(CLOCK_MONOTONIC, &hw->sync_tstamp);
 	return 0;
 }
 
+/*
+ * When sync_ptr_max_error is set and the status is not mmapped, the
+ * SYNC_PTR ioctl is skipped while the stream is running and the position
+ * of the last call is kept.  It lags behind the real one, so avail is
+ * under-estimated and never covers frames the hardware has not reached.
+ * The kernel is asked again as soon as the stream has moved (by the time
+ * elapsed) more than sync_ptr_max_error frames from the last read position
+ * or reached the next period boundary, where the driver updates the
+ * position itself.  Returns true if the last position was kept.
+ */
+static bool reuse_hw_ptr(snd_pcm_t *pcm)
+{
+	snd_pcm_hw_t *hw = pcm->private_data;
+	struct timespec now;
+	snd_pcm_uframes_t frames;
+	long long nsec;
+
+	if (!hw->sync_ptr_max_error || !pcm->setup)
+		return false;
+	if (hw->sync_ptr->s.status.state != SNDRV_PCM_STATE_RUNNING)
+		return false;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	nsec = (now.tv_sec - hw->sync_tstamp.tv_sec) * 1000000000LL +
+		now.tv_nsec - hw->sync_tstamp.tv_nsec;
+	if (nsec < 0 || nsec >= 1000000000LL)
+		return false;
+	frames = nsec * pcm->rate / 1000000000LL;
+	if (frames > hw->sync_ptr_max_error ||
+	    hw->sync_hw_ptr % pcm->period_size + frames >= pcm->period_size)
+		return false;
+	hw->sync_ptr_avoided++;
+	return true;
+}
+
 static int issue_avail_min(snd_pcm_hw_t *hw)
 {
 	if (!hw->mmap_control_fallbacked)
@@ -205,8 +261,145 @@ static int query_status_data(snd_pcm_hw_t *hw)
 			 SNDRV_PCM_SYNC_PTR_AVAIL_MIN);
 }
 
+/* query_status_data() and request_hwsync() for the streaming paths */
+static int query_status_ratelimited(snd_pcm_t *pcm, bool hwsync)
+{
+	snd_pcm_hw_t *hw = pcm->private_data;
+
+	if (!hw->mmap_status_fallbacked)
+		return 0;
+	if (reuse_hw_ptr(pcm))
+		return 0;
+	return hwsync ? request_hwsync(hw) : query_status_data(hw);
+}
+
+/* shortest interval used for measuring the hw_ptr rate */
+#define SCHED_RATE_WINDOW_NSEC	50000000LL
+
+/*
+ * In the timer-scheduled mode the second poll descriptor is a timerfd
+ * instead of the period timer.  It is armed for the time the stream needs
+ * to reach avail_min, estimated from the hw_ptr rate measured so far, and
+ * period interrupts are disabled if the driver allows it.
+ */
+static void snd_pcm_hw_sched_arm(snd_pcm_t *pcm)
+{
+#ifdef HAVE_SYS_TIMERFD_H
+	snd_pcm_hw_t *hw = pcm->private_data;
+	struct itimerspec its;
+	struct timespec now;
+	snd_pcm_uframes_t avail, hw_ptr;
+	snd_pcm_sframes_t frames;
+	long long nsec;
+
+	if (hw->sched_fd < 0)
+		return;
+	memset(&its, 0, sizeof(its));
+	switch (FAST_PCM_STATE(hw)) {
+	case SND_PCM_STATE_RUNNING:
+	case SND_PCM_STATE_DRAINING:
+		break;
+	default:
+		/* the position doesn't move, the PCM fd reports the rest */
+		hw->sched_tstamp.tv_sec = 0;
+		hw->sched_tstamp.tv_nsec = 0;
+		timerfd_settime(hw->sched_fd, 0, &its, NULL);
+		return;
+	}
+	if (!hw->sched_rate)
+		hw->sched_rate = pcm->rate;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	hw_ptr = *pcm->hw.ptr;
+	if (hw->sched_tstamp.tv_sec || hw->sched_tstamp.tv_nsec) {
+		nsec = (now.tv_sec - hw->sched_tstamp.tv_sec) * 1000000000LL +
+			now.tv_nsec - hw->sched_tstamp.tv_nsec;
+		if (nsec >= SCHED_RATE_WINDOW_NSEC) {
+			frames = hw_ptr - hw->sched_hw_ptr;
+			if (frames < 0)
+				frames += pcm->boundary;
+			frames = frames * 1000000000LL / nsec;
+			/* ignore stalls and bursts */
+			if (frames > pcm->rate / 2 && frames < pcm->rate * 2)
+				hw->sched_rate = (3 * hw->sched_rate + frames) / 4;
+			hw->sched_hw_ptr = hw_ptr;
+			hw->sched_tstamp = now;
+		}
+	} else {
+		hw->sched_hw_ptr = hw_ptr;
+		hw->sched_tstamp = now;
+	}
+	avail = snd_pcm_mmap_avail(pcm);
+	if (avail >= pcm->avail_min)
+		nsec = 1;
+	else
+		nsec = (pcm->avail_min - avail) * 1000000000LL / hw->sched_rate;
+	its.it_value.tv_sec = nsec / 1000000000LL;
+	its.it_value.tv_nsec = nsec % 1000000000LL;
+	timerfd_settime(hw->sched_fd, 0, &its, NULL);
+#endif
+}
+
+/* check a timer wakeup; re-arm the timer if it was too early */
+static int snd_pcm_hw_sched_ready(snd_pcm_t *pcm)
+{
+	snd_pcm_hw_t *hw = pcm->private_data;
+
+	if (hw->mmap_status_fallbacked)
+		request_hwsync(hw);
+	else if (ioctl(hw->fd, SNDRV_PCM_IOCTL_HWSYNC) < 0)
+		return 1;
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_HWSYNC);
+	switch (FAST_PCM_STATE(hw)) {
+	case SND_PCM_STATE_RUNNING:
+	case SND_PCM_STATE_DRAINING:
+		break;
+	default:
+		return 1;	/* let the application see the new state */
+	}
+	if (snd_pcm_mmap_avail(pcm) >= pcm->avail_min)
+		return 1;
+	snd_pcm_hw_sched_arm(pcm);
+	return 0;
+}
+
+static int snd_pcm_hw_change_sched(snd_pcm_t *pcm, int enable)
+{
+	snd_pcm_hw_t *hw = pcm->private_data;
+
+	if (enable) {
+#ifdef HAVE_SYS_TIMERFD_H
+		int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if (fd < 0) {
+			SYSMSG("timerfd_create failed (%i)", -errno);
+			return -errno;
+		}
+		hw->sched_fd = fd;
+		hw->sched_rate = 0;	/* nominal rate, set when first armed */
+		hw->sched_tstamp.tv_sec = 0;
+		hw->sched_tstamp.tv_nsec = 0;
+		hw->period_timer_pfd.fd = fd;
+		hw->period_timer_pfd.events = POLLIN;
+		hw->period_timer_pfd.revents = 0;
+		pcm->fast_ops = &snd_pcm_hw_fast_ops_timer;
+#else
+		return -ENOSYS;
+#endif
+	} else if (hw->sched_fd >= 0) {
+		close(hw->sched_fd);
+		hw->sched_fd = -1;
+		pcm->fast_ops = &snd_pcm_hw_fast_ops;
+	}
+	return 0;
+}
+
 static int snd_pcm_hw_clear_timer_queue(snd_pcm_hw_t *hw)
 {
+	if (hw->sched_fd >= 0) {
+		uint64_t expirations;
+		if (read(hw->sched_fd, &expirations, sizeof(expirations)) < 0)
+			return -errno;
+		return 0;
+	}
 	if (hw->period_timer_need_poll) {
 		while (poll(&hw->period_timer_pfd, 1, 0) > 0) {
 			snd_timer_tread_t rbuf[4];
@@ -230,6 +423,7 @@ static int snd_pcm_hw_poll_descriptors(snd_pcm_t *pcm, struct pollfd *pfds, unsi
 
 	if (space < 2)
 		return -ENOMEM;
+	snd_pcm_hw_sched_arm(pcm);
 	pfds[0].fd = hw->fd;
 	pfds[0].events = pcm->poll_events | POLLERR | POLLNVAL;
 	pfds[1].fd = hw->period_timer_pfd.fd;
@@ -247,7 +441,8 @@ static int snd_pcm_hw_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsigned
 	events = pfds[0].revents;
 	if (pfds[1].revents & POLLIN) {
 		snd_pcm_hw_clear_timer_queue(hw);
-		events |= pcm->poll_events & ~(POLLERR|POLLNVAL);
+		if (hw->sched_fd < 0 || snd_pcm_hw_sched_ready(pcm))
+			events |= pcm->poll_events & ~(POLLERR|POLLNVAL);
 	}
 	*revents = events;
 	return 0;
@@ -381,6 +576,8 @@ static int snd_pcm_hw_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	if (hw->timer_sched && (params->info & SND_PCM_INFO_NO_PERIOD_WAKEUP))
+		params->flags |= SND_PCM_HW_PARAMS_NO_PERIOD_WAKEUP;
 	if (hw_params_call(hw, params) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_HW_PARAMS failed (%i)", err);
@@ -389,6 +586,12 @@ static int snd_pcm_hw_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	params->info &= ~0xf0000000;
 	if (pcm->tstamp_type != SND_PCM_TSTAMP_TYPE_GETTIMEOFDAY)
 		params->info |= SND_PCM_INFO_MONOTONIC;
+	if (hw->timer_sched && hw->sched_fd < 0) {
+		snd_pcm_hw_change_timer(pcm, 0);
+		err = snd_pcm_hw_change_sched(pcm, 1);
+		if (err < 0)
+			return err;
+	}
 	return query_status_data(hw);
 }
 
@@ -407,6 +610,10 @@ static int snd_pcm_hw_change_timer(snd_pcm_t *pcm, int enable)
 	unsigned int suspend, resume;
 	int err;
 	
+	if (hw->sched_fd >= 0) {
+		/* the timer-scheduled mode provides the wakeups */
+		return 0;
+	}
 	if (enable) {
 		err = snd_timer_hw_open(&hw->period_timer,
 				"hw-pcm-period-event",
@@ -484,6 +691,7 @@ static int snd_pcm_hw_hw_free(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	snd_pcm_hw_change_sched(pcm, 0);
 	snd_pcm_hw_change_timer(pcm, 0);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_HW_FREE) < 0) {
 		err = -errno;
@@ -508,7 +716,9 @@ static int snd_pcm_hw_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t * params)
 	    params->silence_size == pcm->silence_size &&
 	    old_period_event == hw->period_event) {
 		hw->mmap_control->avail_min = params->avail_min;
-		return issue_avail_min(hw);
+		err = issue_avail_min(hw);
+		snd_pcm_hw_sched_arm(pcm);
+		return err;
 	}
 	if (params->tstamp_type == SND_PCM_TSTAMP_TYPE_MONOTONIC_RAW &&
 	    hw->version < SNDRV_PROTOCOL_VERSION(2, 0, 12)) {
@@ -574,12 +784,14 @@ static int snd_pcm_hw_status(snd_pcm_t *pcm, snd_pcm_status_t * status)
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
 	if (SNDRV_PROTOCOL_VERSION(2, 0, 13) > hw->version) {
+		snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_CONTROL);
 		if (ioctl(fd, SNDRV_PCM_IOCTL_STATUS, status) < 0) {
 			err = -errno;
 			SYSMSG("SNDRV_PCM_IOCTL_STATUS failed (%i)", err);
 			return err;
 		}
 	} else {
+		snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_CONTROL);
 		if (ioctl(fd, SNDRV_PCM_IOCTL_STATUS_EXT, status) < 0) {
 			err = -errno;
 			SYSMSG("SNDRV_PCM_IOCTL_STATUS_EXT failed (%i)", err);
@@ -596,7 +808,7 @@ static int snd_pcm_hw_status(snd_pcm_t *pcm, snd_pcm_status_t * status)
 static snd_pcm_state_t snd_pcm_hw_state(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
-	int err = query_status_data(hw);
+	int err = query_status_ratelimited(pcm, false);
 	if (err < 0)
 		return err;
 	return (snd_pcm_state_t) hw->mmap_status->state;
@@ -606,6 +818,7 @@ static int snd_pcm_hw_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_HWSYNC);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_DELAY, delayp) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_DELAY failed (%i)", err);
@@ -620,10 +833,11 @@ static int snd_pcm_hw_hwsync(snd_pcm_t *pcm)
 	int fd = hw->fd, err;
 	if (SNDRV_PROTOCOL_VERSION(2, 0, 3) <= hw->version) {
 		if (hw->mmap_status_fallbacked) {
-			err = request_hwsync(hw);
+			err = query_status_ratelimited(pcm, true);
 			if (err < 0)
 				return err;
 		} else {
+			snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_HWSYNC);
 			if (ioctl(fd, SNDRV_PCM_IOCTL_HWSYNC) < 0) {
 				err = -errno;
 				SYSMSG("SNDRV_PCM_IOCTL_HWSYNC failed (%i)", err);
@@ -650,6 +864,7 @@ static int snd_pcm_hw_prepare(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_CONTROL);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_PREPARE) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_PREPARE failed (%i)", err);
@@ -662,6 +877,7 @@ static int snd_pcm_hw_reset(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_CONTROL);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_RESET) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_RESET failed (%i)", err);
@@ -679,6 +895,7 @@ static int snd_pcm_hw_start(snd_pcm_t *pcm)
 	       snd_pcm_mmap_playback_hw_avail(pcm) > 0);
 #endif
 	issue_applptr(hw);
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_CONTROL);
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_START) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_START failed (%i)", err);
@@ -688,6 +905,10 @@ static int snd_pcm_hw_start(snd_pcm_t *pcm)
 #endif
 		return err;
 	}
+	if (hw->sched_fd >= 0) {
+		query_status_data(hw);
+		snd_pcm_hw_sched_arm(pcm);
+	}
 	return 0;
 }
 
@@ -695,6 +916,7 @@ static int snd_pcm_hw_drop(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_CONTROL);
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_DROP) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_DROP failed (%i)", err);
@@ -704,10 +926,82 @@ static int snd_pcm_hw_drop(snd_pcm_t *pcm)
 	return 0;
 }
 
+/*
+ * Without period interrupts the kernel notices the end of the data only
+ * at its drain timeout, so a blocking playback drain in the timer-scheduled
+ * mode waits in user space: the timer is armed for the time the queued
+ * frames need, hw_ptr is synced on each wakeup until it reaches appl_ptr,
+ * and the stream is dropped then.
+ */
+static int snd_pcm_hw_sched_drain(snd_pcm_t *pcm)
+{
+#ifdef HAVE_SYS_TIMERFD_H
+	snd_pcm_hw_t *hw = pcm->private_data;
+	struct itimerspec its;
+	struct pollfd pfd;
+	snd_pcm_sframes_t frames;
+	uint64_t expirations;
+	long long nsec;
+	int err;
+
+	if (FAST_PCM_STATE(hw) == SND_PCM_STATE_PREPARED) {
+		if (snd_pcm_mmap_playback_hw_avail(pcm) <= 0)
+			return snd_pcm_hw_drop(pcm);
+		err = snd_pcm_hw_start(pcm);
+		if (err < 0)
+			return err;
+	}
+	memset(&its, 0, sizeof(its));
+	pfd.fd = hw->sched_fd;
+	pfd.events = POLLIN;
+	for (;;) {
+		if (hw->mmap_status_fallbacked) {
+			err = request_hwsync(hw);
+			if (err < 0)
+				return err;
+		} else if (ioctl(hw->fd, SNDRV_PCM_IOCTL_HWSYNC) < 0) {
+			/* stopped meanwhile, e.g. by the stop threshold */
+			if (errno != EPIPE && errno != EBADFD)
+				return -errno;
+		}
+		snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_HWSYNC);
+		if (FAST_PCM_STATE(hw) != SND_PCM_STATE_RUNNING)
+			break;
+		frames = snd_pcm_mmap_playback_hw_avail(pcm);
+		if (frames <= 0)
+			break;
+		nsec = frames * 1000000000LL /
+			(hw->sched_rate ? hw->sched_rate : pcm->rate) + 1;
+		its.it_value.tv_sec = nsec / 1000000000LL;
+		its.it_value.tv_nsec = nsec % 1000000000LL;
+		timerfd_settime(hw->sched_fd, 0, &its, NULL);
+		if (poll(&pfd, 1, -1) < 0)
+			return -errno;
+		if (read(hw->sched_fd, &expirations, sizeof(expirations)) < 0 &&
+		    errno != EAGAIN)
+			return -errno;
+	}
+	return snd_pcm_hw_drop(pcm);
+#else
+	return -ENOSYS;
+#endif
+}
+
 static int snd_pcm_hw_drain(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	if (hw->sched_fd >= 0 && pcm->stream == SND_PCM_STREAM_PLAYBACK &&
+	    !(pcm->mode & SND_PCM_NONBLOCK)) {
+		switch (FAST_PCM_STATE(hw)) {
+		case SND_PCM_STATE_PREPARED:
+		case SND_PCM_STATE_RUNNING:
+			return snd_pcm_hw_sched_drain(pcm);
+		default:
+			break;
+		}
+	}
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_CONTROL);
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_DRAIN) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_DRAIN failed (%i)", err);
@@ -720,6 +1014,7 @@ static int snd_pcm_hw_pause(snd_pcm_t *pcm, int enable)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_CONTROL);
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_PAUSE, enable) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_PAUSE failed (%i)", err);
@@ -737,6 +1032,7 @@ static snd_pcm_sframes_t snd_pcm_hw_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t fra
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_CONTROL);
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_REWIND, &frames) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_REWIND failed (%i)", err);
@@ -758,6 +1054,7 @@ static snd_pcm_sframes_t snd_pcm_hw_forward(snd_pcm_t *pcm, snd_pcm_uframes_t fr
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
 	if (SNDRV_PROTOCOL_VERSION(2, 0, 4) <= hw->version) {
+		snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_CONTROL);
 		if (ioctl(hw->fd, SNDRV_PCM_IOCTL_FORWARD, &frames) < 0) {
 			err = -errno;
 			SYSMSG("SNDRV_PCM_IOCTL_FORWARD failed (%i)", err);
@@ -795,6 +1092,7 @@ static int snd_pcm_hw_resume(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_CONTROL);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_RESUME) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_RESUME failed (%i)", err);
@@ -853,6 +1151,7 @@ static snd_pcm_sframes_t snd_pcm_hw_writei(snd_pcm_t *pcm, const void *buffer, s
 	xferi.buf = (char*) buffer;
 	xferi.frames = size;
 	xferi.result = 0; /* make valgrind happy */
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_XFER);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_WRITEI_FRAMES, &xferi) < 0)
 		err = -errno;
 	else
@@ -862,6 +1161,8 @@ static snd_pcm_sframes_t snd_pcm_hw_writei(snd_pcm_t *pcm, const void *buffer, s
 #endif
 	if (err < 0)
 		return snd_pcm_check_error(pcm, err);
+	snd_pcm_stats_add(pcm, SND_PCM_STAT_FRAMES, xferi.result);
+	snd_pcm_hw_sched_arm(pcm);
 	return xferi.result;
 }
 
@@ -874,6 +1175,7 @@ static snd_pcm_sframes_t snd_pcm_hw_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_
 	memset(&xfern, 0, sizeof(xfern)); /* make valgrind happy */
 	xfern.bufs = bufs;
 	xfern.frames = size;
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_XFER);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_WRITEN_FRAMES, &xfern) < 0)
 		err = -errno;
 	else
@@ -883,6 +1185,8 @@ static snd_pcm_sframes_t snd_pcm_hw_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_
 #endif
 	if (err < 0)
 		return snd_pcm_check_error(pcm, err);
+	snd_pcm_stats_add(pcm, SND_PCM_STAT_FRAMES, xfern.result);
+	snd_pcm_hw_sched_arm(pcm);
 	return xfern.result;
 }
 
@@ -895,6 +1199,7 @@ static snd_pcm_sframes_t snd_pcm_hw_readi(snd_pcm_t *pcm, void *buffer, snd_pcm_
 	xferi.buf = buffer;
 	xferi.frames = size;
 	xferi.result = 0; /* make valgrind happy */
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_XFER);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_READI_FRAMES, &xferi) < 0)
 		err = -errno;
 	else
@@ -904,6 +1209,8 @@ static snd_pcm_sframes_t snd_pcm_hw_readi(snd_pcm_t *pcm, void *buffer, snd_pcm_
 #endif
 	if (err < 0)
 		return snd_pcm_check_error(pcm, err);
+	snd_pcm_stats_add(pcm, SND_PCM_STAT_FRAMES, xferi.result);
+	snd_pcm_hw_sched_arm(pcm);
 	return xferi.result;
 }
 
@@ -916,6 +1223,7 @@ static snd_pcm_sframes_t snd_pcm_hw_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_u
 	memset(&xfern, 0, sizeof(xfern)); /* make valgrind happy */
 	xfern.bufs = bufs;
 	xfern.frames = size;
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_XFER);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_READN_FRAMES, &xfern) < 0)
 		err = -errno;
 	else
@@ -925,6 +1233,8 @@ static snd_pcm_sframes_t snd_pcm_hw_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_u
 #endif
 	if (err < 0)
 		return snd_pcm_check_error(pcm, err);
+	snd_pcm_stats_add(pcm, SND_PCM_STAT_FRAMES, xfern.result);
+	snd_pcm_hw_sched_arm(pcm);
 	return xfern.result;
 }
 
@@ -1099,6 +1409,7 @@ static snd_pcm_sframes_t snd_pcm_hw_mmap_commit(snd_pcm_t *pcm,
 
 	snd_pcm_mmap_appl_forward(pcm, size);
 	issue_applptr(hw);
+	snd_pcm_hw_sched_arm(pcm);
 #ifdef DEBUG_MMAP
 	fprintf(stderr, "appl_forward: hw_ptr = %li, appl_ptr = %li, size = %li\n", *pcm->hw.ptr, *pcm->appl.ptr, size);
 #endif
@@ -1110,13 +1421,14 @@ static snd_pcm_sframes_t snd_pcm_hw_avail_update(snd_pcm_t *pcm)
 	snd_pcm_hw_t *hw = pcm->private_data;
 	snd_pcm_uframes_t avail;
 
-	query_status_data(hw);
+	query_status_ratelimited(pcm, false);
 	avail = snd_pcm_mmap_avail(pcm);
 	switch (FAST_PCM_STATE(hw)) {
 	case SNDRV_PCM_STATE_RUNNING:
 		if (avail >= pcm->stop_threshold) {
 			/* SNDRV_PCM_IOCTL_XRUN ioctl has been implemented since PCM kernel API 2.0.1 */
 			if (SNDRV_PROTOCOL_VERSION(2, 0, 1) <= hw->version) {
+				snd_pcm_stats_inc(pcm, SND_PCM_STAT_IOCTL_CONTROL);
 				if (ioctl(hw->fd, SNDRV_PCM_IOCTL_XRUN) < 0)
 					return -errno;
 			}
@@ -1135,21 +1447,26 @@ static snd_pcm_sframes_t snd_pcm_hw_avail_update(snd_pcm_t *pcm)
 static int snd_pcm_hw_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail,
 				 snd_htimestamp_t *tstamp)
 {
+	snd_pcm_hw_t *hw = pcm->private_data;
+	snd_pcm_uframes_t max_error = hw->sync_ptr_max_error;
 	snd_pcm_sframes_t avail1;
 	int ok = 0;
 
+	/* the timestamp belongs to the position read from the kernel */
+	hw->sync_ptr_max_error = 0;
 	/* unfortunately, loop is necessary to ensure valid timestamp */
 	while (1) {
 		avail1 = snd_pcm_hw_avail_update(pcm);
 		if (avail1 < 0)
-			return avail1;
+			break;
 		if (ok && (snd_pcm_uframes_t)avail1 == *avail)
 			break;
 		*avail = avail1;
 		*tstamp = snd_pcm_hw_fast_tstamp(pcm);
 		ok = 1;
 	}
-	return 0;
+	hw->sync_ptr_max_error = max_error;
+	return avail1 < 0 ? avail1 : 0;
 }
 
 static void __fill_chmap_ctl_id(snd_ctl_elem_id_t *id, int dev, int subdev,
@@ -1428,6 +1745,11 @@ static void snd_pcm_hw_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "  appl_ptr     : %li\n", hw->mmap_control->appl_ptr);
 		snd_output_printf(out, "  hw_ptr       : %li\n", hw->mmap_status->hw_ptr);
 	}
+	if (hw->sync_ptr_max_error) {
+		snd_output_printf(out, "  sync_ptr     : max_error %lu, issued %lu, avoided %lu\n",
+				  hw->sync_ptr_max_error, hw->sync_ptr_issued,
+				  hw->sync_ptr_avoided);
+	}
 }
 
 static const snd_pcm_ops_t snd_pcm_hw_ops = {
@@ -1530,6 +1852,7 @@ int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
 	snd_pcm_t *pcm = NULL;
 	snd_pcm_hw_t *hw = NULL;
 	snd_pcm_info_t info;
+	const char *env;
 	int ret;
 
 	assert(pcmp);
@@ -1613,6 +1936,13 @@ int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
 	hw->format = SND_PCM_FORMAT_UNKNOWN;
 	hw->rate = 0;
 	hw->channels = 0;
+	env = getenv("LIBASOUND_SYNC_PTR_MAX_ERROR");
+	if (env && atol(env) > 0)
+		hw->sync_ptr_max_error = atol(env);
+	hw->sched_fd = -1;
+	env = getenv("LIBASOUND_TIMER_SCHED");
+	if (env && *env)
+		hw->timer_sched = !!atoi(env);
 
 	ret = snd_pcm_new(&pcm, SND_PCM_TYPE_HW, name, info.stream, mode);
 	if (ret < 0) {
@@ -1624,6 +1954,7 @@ int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
 	pcm->ops = &snd_pcm_hw_ops;
 	pcm->fast_ops = &snd_pcm_hw_fast_ops;
 	pcm->private_data = hw;
+	hw->pcm = pcm;
 	pcm->poll_fd = fd;
 	pcm->poll_events = info.stream == SND_PCM_STREAM_PLAYBACK ? POLLOUT : POLLIN;
 	pcm->tstamp_type = tstamp_type;
@@ -1751,6 +2082,8 @@ pcm.name {
 	[device INT]		# Device number (default 0)
 	[subdevice INT]		# Subdevice number (default -1: first available)
 	[sync_ptr_ioctl BOOL]	# Use SYNC_PTR ioctl rather than the direct mmap access for control structures
+	[sync_ptr_max_error INT] # Max. hw_ptr lag in frames between SYNC_PTR ioctls
+	[timer_sched BOOL]	# Wake up from a timer instead of period interrupts
 	[nonblock BOOL]		# Force non-blocking open mode
 	[format STR]		# Restrict only to the given format
 	[channels INT]		# Restrict only to the given channels
@@ -1759,11 +2092,32 @@ pcm.name {
 }
 \endcode
 
+When the status and control structures can't be mmapped (or sync_ptr_ioctl
+is set), every position query costs a SYNC_PTR ioctl.  A non-zero
+sync_ptr_max_error limits them: while the stream is running, the position
+read by the last ioctl is kept until the stream has moved more than the
+given number of frames since, or reached the next period boundary.  The
+reported avail lags behind by up to that many frames and never exceeds the
+real one.  The state (e.g. an xrun) is noticed with the same delay.
+The default is taken from the environment variable
+LIBASOUND_SYNC_PTR_MAX_ERROR, 0 (always issue the ioctl) if not set.
+#snd_pcm_hw_sync_ptr_stats() returns the number of issued and avoided ioctls.
+
+With timer_sched enabled, poll() wakeups come from a timer armed for the
+moment the stream is expected to reach avail_min, rather than from period
+interrupts.  The expected moment is derived from the hw_ptr rate measured
+while running, and an early wakeup re-arms the timer instead of being
+reported.  Period interrupts are turned off when the driver supports
+#SND_PCM_HW_PARAMS_NO_PERIOD_WAKEUP, so large buffers can be driven with
+few wakeups.  The period_event software parameter is ignored in this mode.
+The default is taken from the environment variable LIBASOUND_TIMER_SCHED.
+
 \subsection pcm_plugins_hw_funcref Function reference
 
 <UL>
   <LI>snd_pcm_hw_open()
   <LI>_snd_pcm_hw_open()
+  <LI>snd_pcm_hw_sync_ptr_stats()
 </UL>
 
 */
@@ -1787,7 +2141,8 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 	snd_config_iterator_t i, next;
 	long card = -1, device = 0, subdevice = -1;
 	const char *str;
-	int err, sync_ptr_ioctl = 0;
+	int err, sync_ptr_ioctl = 0, timer_sched = -1;
+	long sync_ptr_max_error = -1;
 	int rate = 0, channels = 0;
 	snd_pcm_format_t format = SND_PCM_FORMAT_UNKNOWN;
 	snd_config_t *n;
@@ -1849,6 +2204,22 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 			sync_ptr_ioctl = err;
 			continue;
 		}
+		if (strcmp(id, "sync_ptr_max_error") == 0) {
+			err = snd_config_get_integer(n, &sync_ptr_max_error);
+			if (err < 0 || sync_ptr_max_error < 0) {
+				SNDERR("Invalid value for %s", id);
+				err = -EINVAL;
+				goto fail;
+			}
+			continue;
+		}
+		if (strcmp(id, "timer_sched") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				continue;
+			timer_sched = err;
+			continue;
+		}
 		if (strcmp(id, "nonblock") == 0) {
 			err = snd_config_get_bool(n);
 			if (err < 0)
@@ -1930,6 +2301,10 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 		hw->rate = rate;
 	if (chmap)
 		hw->chmap_override = chmap;
+	if (sync_ptr_max_error >= 0)
+		hw->sync_ptr_max_error = sync_ptr_max_error;
+	if (timer_sched >= 0)
+		hw->timer_sched = timer_sched;
 
 	return 0;
 
@@ -1942,6 +2317,33 @@ fail:
 SND_DLSYM_BUILD_VERSION(_snd_pcm_hw_open, SND_PCM_DLSYM_VERSION);
 #endif
 
+/**
+ * \brief Get the SYNC_PTR ioctl counters of a hw PCM
+ * \param pcm hw PCM handle
+ * \param issued Returns the number of issued SYNC_PTR ioctls (may be NULL)
+ * \param avoided Returns the number of position queries answered by
+ *                the last read position instead of an ioctl (may be NULL)
+ * \retval zero on success otherwise a negative error code
+ *
+ * The ioctls are used only when the status and control structures
+ * can't be mmapped, see the sync_ptr_max_error option of the hw plugin.
+ */
+int snd_pcm_hw_sync_ptr_stats(snd_pcm_t *pcm, unsigned long *issued,
+			      unsigned long *avoided)
+{
+	snd_pcm_hw_t *hw;
+
+	assert(pcm);
+	if (pcm->type != SND_PCM_TYPE_HW)
+		return -EINVAL;
+	hw = pcm->private_data;
+	if (issued)
+		*issued = hw->sync_ptr_issued;
+	if (avoided)
+		*avoided = hw->sync_ptr_avoided;
+	return 0;
+}
+
 /*
  *  To be removed helpers, but keep binary compatibility at the time
  */
@@ -29,6 +29,7 @@
 #include "bswap.h"
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#include "pcm_simd.h"
 
 #include "plugin_ops.h"
 
@@ -63,8 +64,17 @@ struct snd_pcm_iec958 {
 	unsigned int byteswap;
 	unsigned char preamble[3];	/* B/M/W or Z/X/Y */
 	snd_pcm_fast_ops_t fops;
+	/* block coder, used when 'kernel' is set */
+	snd_pcm_simd_convert_t kernel;	/* linear <-> S32 */
+	unsigned int width;		/* of the linear side, in bits */
+	uint32_t *status_bits;		/* 192 frames of preamble + status */
+	int32_t *buf;			/* IEC958_CHUNK decoded samples */
+	snd_pcm_channel_area_t *buf_areas;
 };
 
+/* samples per pass of the block decoder */
+#define IEC958_CHUNK	1024
+
 enum { PREAMBLE_Z, PREAMBLE_X, PREAMBLE_Y };
 
 #endif /* DOC_HIDDEN */
@@ -74,19 +84,9 @@ enum { PREAMBLE_Z, PREAMBLE_X, PREAMBLE_Y };
  * to be sure that bit 4 upt 31 will carry
  * an even number of ones and zeros.
  */
-static unsigned int iec958_parity(unsigned int data)
+static inline unsigned int iec958_parity(unsigned int data)
 {
-	unsigned int parity;
-	int bit;
-
-	data >>= 4;     /* start from bit 4 */
-	parity = 0;
-	for (bit = 4; bit <= 30; bit++) {
-		if (data & 1)
-			parity++;
-		data >>= 1;
-	}
-	return (parity & 1);
+	return __builtin_parity(data & 0x7ffffff0);
 }
 
 /*
@@ -141,7 +141,105 @@ static inline int32_t iec958_to_s32(snd_pcm_iec958_t *iec, uint32_t data)
 	return (int32_t)data;
 }
 
+/* the same as iec958_subframe() with precomputed preamble and status */
+static inline uint32_t iec958_block_subframe(snd_pcm_iec958_t *iec, uint32_t data,
+					     uint32_t status)
+{
+	data = ((data >> 4) & ~0xf) | status;
+	if (iec958_parity(data))
+		data |= 0x80000000;
+	if (iec->byteswap)
+		data = bswap_32(data);
+	return data;
+}
+
 #ifndef DOC_HIDDEN
+
+/*
+ * Block coder: the samples are converted to or from S32 by the linear
+ * conversion kernels, the subframe bits are added or stripped by a vector
+ * loop over whole frames.  The preamble and channel status bits of a block
+ * of 192 frames are computed once at hw_params.
+ */
+static void snd_pcm_iec958_encode_block(snd_pcm_iec958_t *iec,
+					const snd_pcm_channel_area_t *dst_areas,
+					snd_pcm_uframes_t dst_offset,
+					const snd_pcm_channel_area_t *src_areas,
+					snd_pcm_uframes_t src_offset,
+					unsigned int channels,
+					snd_pcm_uframes_t frames)
+{
+	int packed = snd_pcm_simd_areas_packed(dst_areas, channels, 32);
+
+	while (frames > 0) {
+		const uint32_t *status = iec->status_bits + iec->counter * channels;
+		snd_pcm_uframes_t n = 192 - iec->counter;
+		unsigned int channel;
+		if (n > frames)
+			n = frames;
+		snd_pcm_simd_convert_areas(iec->kernel, dst_areas, dst_offset, 32,
+					   src_areas, src_offset, iec->width,
+					   channels, n);
+		if (packed) {
+			snd_pcm_simd_iec958_encode(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+						   status, n * channels, iec->byteswap);
+		} else {
+			for (channel = 0; channel < channels; ++channel) {
+				const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+				char *dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+				int dst_step = snd_pcm_channel_area_step(dst_area);
+				snd_pcm_uframes_t k;
+				for (k = 0; k < n; ++k, dst += dst_step)
+					*(uint32_t *)dst = iec958_block_subframe(iec, *(uint32_t *)dst,
+										 status[k * channels + channel]);
+			}
+		}
+		iec->counter = (iec->counter + n) % 192;
+		dst_offset += n;
+		src_offset += n;
+		frames -= n;
+	}
+}
+
+static void snd_pcm_iec958_decode_block(snd_pcm_iec958_t *iec,
+					const snd_pcm_channel_area_t *dst_areas,
+					snd_pcm_uframes_t dst_offset,
+					const snd_pcm_channel_area_t *src_areas,
+					snd_pcm_uframes_t src_offset,
+					unsigned int channels,
+					snd_pcm_uframes_t frames)
+{
+	int packed = snd_pcm_simd_areas_packed(src_areas, channels, 32);
+
+	while (frames > 0) {
+		snd_pcm_uframes_t n = IEC958_CHUNK / channels;
+		unsigned int channel;
+		if (n > frames)
+			n = frames;
+		if (packed) {
+			snd_pcm_simd_iec958_decode(iec->buf,
+						   snd_pcm_channel_area_addr(src_areas, src_offset),
+						   n * channels, iec->byteswap);
+		} else {
+			for (channel = 0; channel < channels; ++channel) {
+				const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+				const char *src = snd_pcm_channel_area_addr(src_area, src_offset);
+				int src_step = snd_pcm_channel_area_step(src_area);
+				snd_pcm_uframes_t k;
+				for (k = 0; k < n; ++k, src += src_step)
+					iec->buf[k * channels + channel] =
+						iec958_to_s32(iec, *(const uint32_t *)src);
+			}
+		}
+		snd_pcm_simd_convert_areas(iec->kernel, dst_areas, dst_offset,
+					   iec->width, iec->buf_areas, 0, 32,
+					   channels, n);
+		dst_offset += n;
+		src_offset += n;
+		frames -= n;
+	}
+}
+
 static void snd_pcm_iec958_decode(snd_pcm_iec958_t *iec,
 				  const snd_pcm_channel_area_t *dst_areas,
 				  snd_pcm_uframes_t dst_offset,
@@ -313,6 +411,70 @@ static int snd_pcm_iec958_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 				       snd_pcm_generic_hw_refine);
 }
 
+static void snd_pcm_iec958_block_free(snd_pcm_iec958_t *iec)
+{
+	free(iec->status_bits);
+	iec->status_bits = NULL;
+	free(iec->buf);
+	iec->buf = NULL;
+	free(iec->buf_areas);
+	iec->buf_areas = NULL;
+	iec->kernel = NULL;
+}
+
+/* prepare the block coder; the preamble values must not reach the data */
+static int snd_pcm_iec958_block_setup(snd_pcm_iec958_t *iec,
+				      snd_pcm_format_t format,
+				      unsigned int channels)
+{
+	snd_pcm_format_t linear;
+	unsigned int frame, channel;
+	uint32_t *status;
+
+	snd_pcm_iec958_block_free(iec);
+	if (((iec->preamble[PREAMBLE_Z] | iec->preamble[PREAMBLE_X] |
+	      iec->preamble[PREAMBLE_Y]) & ~0xf) || channels > IEC958_CHUNK)
+		return 0;
+	if (iec->sformat == SND_PCM_FORMAT_IEC958_SUBFRAME_LE ||
+	    iec->sformat == SND_PCM_FORMAT_IEC958_SUBFRAME_BE)
+		linear = format;
+	else
+		linear = iec->sformat;
+	if (iec->func == snd_pcm_iec958_encode)
+		iec->kernel = snd_pcm_simd_linear_kernel(linear, SND_PCM_FORMAT_S32);
+	else
+		iec->kernel = snd_pcm_simd_linear_kernel(SND_PCM_FORMAT_S32, linear);
+	if (!iec->kernel)
+		return 0;
+	iec->width = snd_pcm_format_physical_width(linear);
+	iec->status_bits = malloc(192 * channels * sizeof(*iec->status_bits));
+	iec->buf = malloc(IEC958_CHUNK * sizeof(*iec->buf));
+	iec->buf_areas = malloc(channels * sizeof(*iec->buf_areas));
+	if (!iec->status_bits || !iec->buf || !iec->buf_areas) {
+		snd_pcm_iec958_block_free(iec);
+		return -ENOMEM;
+	}
+	status = iec->status_bits;
+	for (frame = 0; frame < 192; ++frame) {
+		for (channel = 0; channel < channels; ++channel, ++status) {
+			*status = (iec->status[frame >> 3] & (1 << (frame & 7))) ?
+				0x40000000 : 0;
+			if (channel)
+				*status |= iec->preamble[PREAMBLE_Y];
+			else if (!frame)
+				*status |= iec->preamble[PREAMBLE_Z];
+			else
+				*status |= iec->preamble[PREAMBLE_X];
+		}
+	}
+	for (channel = 0; channel < channels; ++channel) {
+		iec->buf_areas[channel].addr = iec->buf;
+		iec->buf_areas[channel].first = channel * 32;
+		iec->buf_areas[channel].step = channels * 32;
+	}
+	return 0;
+}
+
 static int snd_pcm_iec958_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_iec958_t *iec = pcm->private_data;
@@ -356,7 +518,14 @@ static int snd_pcm_iec958_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params
 	/* FIXME: needs to adjust status_bits according to the format
 	 *        and sample rate
 	 */
-	return 0;
+	return snd_pcm_iec958_block_setup(iec, format, iec->plug.gen.slave->channels);
+}
+
+static int snd_pcm_iec958_hw_free(snd_pcm_t *pcm)
+{
+	snd_pcm_iec958_t *iec = pcm->private_data;
+	snd_pcm_iec958_block_free(iec);
+	return snd_pcm_hw_free(iec->plug.gen.slave);
 }
 
 static snd_pcm_uframes_t
@@ -371,9 +540,16 @@ snd_pcm_iec958_write_areas(snd_pcm_t *pcm,
 	snd_pcm_iec958_t *iec = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	iec->func(iec, slave_areas, slave_offset,
-		  areas, offset, 
-		  pcm->channels, size);
+	if (iec->kernel && iec->func == snd_pcm_iec958_encode)
+		snd_pcm_iec958_encode_block(iec, slave_areas, slave_offset,
+					    areas, offset, pcm->channels, size);
+	else if (iec->kernel)
+		snd_pcm_iec958_decode_block(iec, slave_areas, slave_offset,
+					    areas, offset, pcm->channels, size);
+	else
+		iec->func(iec, slave_areas, slave_offset,
+			  areas, offset, 
+			  pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -390,9 +566,18 @@ snd_pcm_iec958_read_areas(snd_pcm_t *pcm,
 	snd_pcm_iec958_t *iec = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	iec->func(iec, areas, offset, 
-		  slave_areas, slave_offset,
-		  pcm->channels, size);
+	if (iec->kernel && iec->func == snd_pcm_iec958_encode)
+		snd_pcm_iec958_encode_block(iec, areas, offset,
+					    slave_areas, slave_offset,
+					    pcm->channels, size);
+	else if (iec->kernel)
+		snd_pcm_iec958_decode_block(iec, areas, offset,
+					    slave_areas, slave_offset,
+					    pcm->channels, size);
+	else
+		iec->func(iec, areas, offset, 
+			  slave_areas, slave_offset,
+			  pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -451,7 +636,7 @@ static const snd_pcm_ops_t snd_pcm_iec958_ops = {
 	.info = snd_pcm_generic_info,
 	.hw_refine = snd_pcm_iec958_hw_refine,
 	.hw_params = snd_pcm_iec958_hw_params,
-	.hw_free = snd_pcm_generic_hw_free,
+	.hw_free = snd_pcm_iec958_hw_free,
 	.sw_params = snd_pcm_generic_sw_params,
 	.channel_info = snd_pcm_generic_channel_info,
 	.dump = snd_pcm_iec958_dump,
@@ -569,6 +754,11 @@ pcm.name {
 }
 \endcode
 
+The preamble and channel status bits of a whole block of 192 frames are
+computed when the hardware parameters are set, and the subframes are then
+built or taken apart with vector code.  Preamble values wider than four
+bits, and the 18 and 20 bit formats, use the slower per-sample path.
+
 \subsection pcm_plugins_iec958_funcref Function reference
 
 <UL>
@@ -199,7 +199,7 @@ static void snd_pcm_ladspa_free(snd_pcm_ladspa_t *ladspa)
 	snd_pcm_ladspa_free_plugins(&ladspa->pplugins);
 	snd_pcm_ladspa_free_plugins(&ladspa->cplugins);
 	for (idx = 0; idx < 2; idx++) {
-		free(ladspa->zero[idx]);
+		snd_pcm_buffer_free(ladspa->zero[idx]);
                 ladspa->zero[idx] = NULL;
         }
         ladspa->allocated = 0;
@@ -333,12 +333,12 @@ static void snd_pcm_ladspa_free_instances(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
 					plugin->desc->cleanup(instance->handle);
 				if (instance->input.m_data) {
 				        for (idx = 0; idx < instance->input.channels.size; idx++)
-						free(instance->input.m_data[idx]);
+						snd_pcm_buffer_free(instance->input.m_data[idx]);
 					free(instance->input.m_data);
                                 }
 				if (instance->output.m_data) {
 				        for (idx = 0; idx < instance->output.channels.size; idx++)
-						free(instance->output.m_data[idx]);
+						snd_pcm_buffer_free(instance->output.m_data[idx]);
 					free(instance->output.m_data);
                                 }
                                 free(instance->input.data);
@@ -676,10 +676,10 @@ static int snd_pcm_ladspa_allocate_instances(snd_pcm_t *pcm, snd_pcm_ladspa_t *l
 	return 0;
 }
 
-static LADSPA_Data *snd_pcm_ladspa_allocate_zero(snd_pcm_ladspa_t *ladspa, unsigned int idx)
+static LADSPA_Data *snd_pcm_ladspa_allocate_zero(snd_pcm_t *pcm, snd_pcm_ladspa_t *ladspa, unsigned int idx)
 {
         if (ladspa->zero[idx] == NULL)
-                ladspa->zero[idx] = calloc(ladspa->allocated, sizeof(LADSPA_Data));
+                ladspa->zero[idx] = snd_pcm_buffer_alloc(pcm, ladspa->allocated * sizeof(LADSPA_Data));
         return ladspa->zero[idx];
 }
 
@@ -756,7 +756,7 @@ static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
                                 }
 			        instance->input.data[idx] = pchannels[chn];
 			        if (instance->input.data[idx] == NULL) {
-                                        instance->input.data[idx] = snd_pcm_ladspa_allocate_zero(ladspa, 0);
+                                        instance->input.data[idx] = snd_pcm_ladspa_allocate_zero(pcm, ladspa, 0);
                                         if (instance->input.data[idx] == NULL) {
                                                 free(pchannels);
                                                 return -ENOMEM;
@@ -767,7 +767,7 @@ static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
 			        chn = instance->output.channels.array[idx];
                                 /* FIXME/OPTIMIZE: check if we can remove double alloc */
                                 /* if LADSPA plugin has no broken inplace */
-                                instance->output.data[idx] = malloc(sizeof(LADSPA_Data) * ladspa->allocated);
+                                instance->output.data[idx] = snd_pcm_buffer_alloc(pcm, sizeof(LADSPA_Data) * ladspa->allocated);
                                 if (instance->output.data[idx] == NULL) {
                                         free(pchannels);
                                         return -ENOMEM;
@@ -787,12 +787,12 @@ static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
                         for (idx = 0; idx < instance->output.channels.size; idx++) {
         			chn = instance->output.channels.array[idx];
                                 if (instance->output.data[idx] == pchannels[chn]) {
-					free(instance->output.m_data[idx]);
+					snd_pcm_buffer_free(instance->output.m_data[idx]);
 					instance->output.m_data[idx] = NULL;
                                         if (chn < ochannels) {
                                                 instance->output.data[idx] = NULL;
                                         } else {
-                                                instance->output.data[idx] = snd_pcm_ladspa_allocate_zero(ladspa, 1);
+                                                instance->output.data[idx] = snd_pcm_ladspa_allocate_zero(pcm, ladspa, 1);
                                                 if (instance->output.data[idx] == NULL) {
                                                         free(pchannels);
                                                         return -ENOMEM;
@@ -29,6 +29,7 @@
 #include "bswap.h"
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#include "pcm_simd.h"
 
 #include "plugin_ops.h"
 
@@ -56,6 +57,8 @@ typedef struct {
 		     const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
 		     unsigned int channels, snd_pcm_uframes_t frames,
 		     unsigned int get32idx, unsigned int put32floatidx);
+	snd_pcm_simd_convert_t kernel;	/* client -> slave for playback */
+	unsigned int src_width, dst_width;	/* in bits, for the kernel */
 } snd_pcm_lfloat_t;
 
 int snd_pcm_lfloat_get_s32_index(snd_pcm_format_t format)
@@ -294,6 +297,9 @@ static int snd_pcm_lfloat_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		lfloat->float32_idx = snd_pcm_lfloat_get_s32_index(src_format);
 		lfloat->func = snd_pcm_lfloat_convert_float_integer;
 	}
+	lfloat->kernel = snd_pcm_simd_float_kernel(src_format, dst_format);
+	lfloat->src_width = snd_pcm_format_physical_width(src_format);
+	lfloat->dst_width = snd_pcm_format_physical_width(dst_format);
 	return 0;
 }
 
@@ -309,10 +315,17 @@ snd_pcm_lfloat_write_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(slave_areas, slave_offset,
-		     areas, offset, 
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	if (lfloat->kernel)
+		snd_pcm_simd_convert_areas(lfloat->kernel,
+					   slave_areas, slave_offset,
+					   lfloat->dst_width,
+					   areas, offset, lfloat->src_width,
+					   pcm->channels, size);
+	else
+		lfloat->func(slave_areas, slave_offset,
+			     areas, offset, 
+			     pcm->channels, size,
+			     lfloat->int32_idx, lfloat->float32_idx);
 	*slave_sizep = size;
 	return size;
 }
@@ -329,10 +342,17 @@ snd_pcm_lfloat_read_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(areas, offset, 
-		     slave_areas, slave_offset,
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	if (lfloat->kernel)
+		snd_pcm_simd_convert_areas(lfloat->kernel,
+					   areas, offset, lfloat->dst_width,
+					   slave_areas, slave_offset,
+					   lfloat->src_width,
+					   pcm->channels, size);
+	else
+		lfloat->func(areas, offset, 
+			     slave_areas, slave_offset,
+			     pcm->channels, size,
+			     lfloat->int32_idx, lfloat->float32_idx);
 	*slave_sizep = size;
 	return size;
 }
@@ -442,6 +462,13 @@ pcm.name {
 }
 \endcode
 
+Integer samples are scaled to the range [-1.0, 1.0). Float samples are
+rounded to the nearest integer of the slave (or client) width and clipped,
+so values at or above 1.0 give the largest positive sample; NaN gives
+silence. The 16, 24 and 32-bit formats are vectorized for native endian
+FLOAT and FLOAT64 when the CPU supports it; the result does not depend on
+the code path taken.
+
 \subsection pcm_plugins_lfloat_funcref Function reference
 
 <UL>
@@ -29,6 +29,7 @@
 #include "bswap.h"
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#include "pcm_simd.h"
 
 #include "plugin_ops.h"
 
@@ -45,6 +46,8 @@ typedef struct {
 	unsigned int conv_idx;
 	unsigned int get_idx, put_idx;
 	snd_pcm_format_t sformat;
+	snd_pcm_simd_convert_t kernel;	/* client -> slave for playback */
+	unsigned int src_width, dst_width;	/* in bits, for the kernel */
 } snd_pcm_linear_t;
 #endif
 
@@ -328,6 +331,19 @@ static int snd_pcm_linear_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 			linear->conv_idx = snd_pcm_linear_convert_index(linear->sformat,
 									format);
 	}
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		linear->kernel = snd_pcm_simd_linear_kernel(format, linear->sformat);
+		linear->src_width = snd_pcm_format_physical_width(format);
+		linear->dst_width = snd_pcm_format_physical_width(linear->sformat);
+	} else {
+		linear->kernel = snd_pcm_simd_linear_kernel(linear->sformat, format);
+		linear->src_width = snd_pcm_format_physical_width(linear->sformat);
+		linear->dst_width = snd_pcm_format_physical_width(format);
+	}
+	/* sign and endianness conversions keep every sample on its place */
+	snd_pcm_plugin_set_in_place(pcm, params,
+				    snd_pcm_format_physical_width(format) ==
+				    snd_pcm_format_physical_width(linear->sformat));
 	return 0;
 }
 
@@ -343,7 +359,13 @@ snd_pcm_linear_write_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
+	if (linear->kernel)
+		snd_pcm_simd_convert_areas(linear->kernel,
+					   slave_areas, slave_offset,
+					   linear->dst_width,
+					   areas, offset, linear->src_width,
+					   pcm->channels, size);
+	else if (linear->use_getput)
 		snd_pcm_linear_getput(slave_areas, slave_offset,
 				      areas, offset, 
 				      pcm->channels, size,
@@ -368,7 +390,13 @@ snd_pcm_linear_read_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
+	if (linear->kernel)
+		snd_pcm_simd_convert_areas(linear->kernel,
+					   areas, offset, linear->dst_width,
+					   slave_areas, slave_offset,
+					   linear->src_width,
+					   pcm->channels, size);
+	else if (linear->use_getput)
 		snd_pcm_linear_getput(areas, offset, 
 				      slave_areas, slave_offset,
 				      pcm->channels, size,
@@ -485,6 +513,11 @@ pcm.name {
 }
 \endcode
 
+The conversion routine for the pair of formats is chosen once in
+#snd_pcm_hw_params(); for the common 8, 16, 24 and 32-bit formats (packed
+24-bit and byte-swapped included) it is a dedicated loop, vectorized for the
+most used pairs. The 18-bit and 20-bit formats use the generic code.
+
 \subsection pcm_plugins_linear_funcref Function reference
 
 <UL>
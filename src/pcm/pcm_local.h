@@ -117,6 +117,30 @@ typedef struct _snd_pcm_rbptr {
 	void (*changed)(snd_pcm_t *pcm, snd_pcm_t *src);
 } snd_pcm_rbptr_t;
 
+/* copy of the stream position readable without the PCM lock;
+ * seq is odd while a writer updates the fields (seqlock)
+ */
+typedef struct _snd_pcm_pos_snapshot {
+	unsigned int seq;
+	int busy;			/* a writer owns the snapshot */
+	snd_pcm_state_t state;
+	snd_pcm_uframes_t hw_ptr;
+	snd_pcm_uframes_t appl_ptr;
+	snd_pcm_uframes_t buffer_size;
+	snd_pcm_uframes_t boundary;
+	snd_htimestamp_t tstamp;	/* time of the last update */
+} snd_pcm_pos_snapshot_t;
+
+#ifdef BUILD_PCM_STATS
+/* runtime counters, see snd_pcm_stats_get(); updated without atomics */
+typedef struct _snd_pcm_stats_data {
+	unsigned long long count[SND_PCM_STAT_LAST + 1];
+	unsigned long long latency[SND_PCM_STATS_LATENCY_BUCKETS];
+	snd_htimestamp_t wake;		/* last wakeup, zero once consumed */
+	int xrun;			/* the current xrun is counted */
+} snd_pcm_stats_data_t;
+#endif
+
 typedef struct _snd_pcm_channel_info {
 	unsigned int channel;
 	void *addr;			/* base address of channel samples */
@@ -234,8 +258,18 @@ struct _snd_pcm {
 	unsigned int mmap_shadow: 1;	/* don't call actual mmap,
 					 * use the mmaped buffer of the slave
 					 */
+	unsigned int mmap_mirror: 1;	/* library buffer is mapped twice
+					 * back to back
+					 */
 	unsigned int donot_close: 1;	/* don't close this PCM */
 	unsigned int own_state_check:1; /* plugin has own PCM state check */
+	unsigned int refine_id_checked:1; /* refine_id was evaluated */
+	char *refine_id;		/* identity for the hw_refine cache */
+	size_t buffer_memory;		/* bytes of snd_pcm_buffer_alloc() */
+	snd_pcm_pos_snapshot_t snapshot; /* see snd_pcm_snapshot() */
+#ifdef BUILD_PCM_STATS
+	snd_pcm_stats_data_t stats;
+#endif
 	snd_pcm_channel_info_t *mmap_channels;
 	snd_pcm_channel_area_t *running_areas;
 	snd_pcm_channel_area_t *stopped_areas;
@@ -315,6 +349,10 @@ struct _snd_pcm {
 	snd1_pcm_write_mmap
 #define snd_pcm_channel_info_shm \
 	snd1_pcm_channel_info_shm
+#define snd_pcm_buffer_alloc \
+	snd1_pcm_buffer_alloc
+#define snd_pcm_buffer_free \
+	snd1_pcm_buffer_free
 #define snd_pcm_hw_refine_soft \
 	snd1_pcm_hw_refine_soft
 #define snd_pcm_hw_refine_slave \
@@ -363,6 +401,8 @@ struct _snd_pcm {
 	snd1_pcm_hw_param_get_max
 #define snd_pcm_hw_param_name		\
 	snd1_pcm_hw_param_name
+#define snd_pcm_refine_cache_enabled \
+	snd1_pcm_refine_cache_enabled
 
 int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 		snd_pcm_stream_t stream, int mode);
@@ -412,6 +452,13 @@ static inline int snd_pcm_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t *i
 	return pcm->ops->channel_info(pcm, info);
 }
 int snd_pcm_channel_info_shm(snd_pcm_t *pcm, snd_pcm_channel_info_t *info, int shmid);
+
+/* alignment of the buffers of snd_pcm_buffer_alloc() */
+#define SND_PCM_BUFFER_ALIGN	64
+#define snd_pcm_buffer_align(size) \
+	(((size) + SND_PCM_BUFFER_ALIGN - 1) & ~(size_t)(SND_PCM_BUFFER_ALIGN - 1))
+void *snd_pcm_buffer_alloc(snd_pcm_t *pcm, size_t size);
+void snd_pcm_buffer_free(void *ptr);
 int _snd_pcm_poll_descriptor(snd_pcm_t *pcm);
 #define _snd_pcm_link_descriptor _snd_pcm_poll_descriptor /* FIXME */
 #define _snd_pcm_async_descriptor _snd_pcm_poll_descriptor /* FIXME */
@@ -424,8 +471,24 @@ snd_pcm_sframes_t __snd_pcm_mmap_commit(snd_pcm_t *pcm,
 					snd_pcm_uframes_t frames);
 int __snd_pcm_wait_in_lock(snd_pcm_t *pcm, int timeout);
 
+#ifdef BUILD_PCM_STATS
+#define snd_pcm_stats_add(pcm, stat, n)	((pcm)->stats.count[stat] += (n))
+#define snd_pcm_stats_wakeup \
+	snd1_pcm_stats_wakeup
+#define snd_pcm_stats_xfer \
+	snd1_pcm_stats_xfer
+void snd_pcm_stats_wakeup(snd_pcm_t *pcm, unsigned short revents);
+void snd_pcm_stats_xfer(snd_pcm_t *pcm);
+#else
+#define snd_pcm_stats_add(pcm, stat, n)	do { } while (0)
+#define snd_pcm_stats_wakeup(pcm, revents)	do { } while (0)
+#define snd_pcm_stats_xfer(pcm)		do { } while (0)
+#endif
+#define snd_pcm_stats_inc(pcm, stat)	snd_pcm_stats_add(pcm, stat, 1)
+
 static inline snd_pcm_sframes_t __snd_pcm_avail_update(snd_pcm_t *pcm)
 {
+	snd_pcm_stats_inc(pcm, SND_PCM_STAT_AVAIL_UPDATE);
 	return pcm->fast_ops->avail_update(pcm->fast_op_arg);
 }
 
@@ -662,6 +725,7 @@ static inline int muldiv_near(int a, int b, int c)
 }
 
 int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
+int snd_pcm_refine_cache_enabled(void);
 int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 #undef _snd_pcm_hw_params
 int snd_pcm_hw_refine_soft(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
@@ -25,6 +25,7 @@
 #include <string.h>
 #include "bswap.h"
 #include "pcm_local.h"
+#include "pcm_simd.h"
 
 
 /**
@@ -606,80 +607,60 @@ uint8_t snd_pcm_format_silence(snd_pcm_format_t format)
  */
 int snd_pcm_format_set_silence(snd_pcm_format_t format, void *data, unsigned int samples)
 {
+	uint64_t silence;
+	unsigned char pattern[8];
+	unsigned int width;
+
 	if (samples == 0)
 		return 0;
-	switch (snd_pcm_format_physical_width(format)) {
-	case 4: {
-		uint8_t silence = snd_pcm_format_silence_64(format);
-		unsigned int samples1;
+	silence = snd_pcm_format_silence_64(format);
+	width = snd_pcm_format_physical_width(format);
+	switch (width) {
+	case 4:
 		if (samples % 2 != 0)
 			return -EINVAL;
-		samples1 = samples / 2;
-		memset(data, silence, samples1);
-		break;
-	}
-	case 8: {
-		uint8_t silence = snd_pcm_format_silence_64(format);
-		memset(data, silence, samples);
-		break;
-	}
+		samples /= 2;
+		width = 8;
+		/* fall through */
+	case 8:
+		memset(data, (uint8_t)silence, samples);
+		return 0;
 	case 16: {
-		uint16_t silence = snd_pcm_format_silence_64(format);
-		uint16_t *pdata = (uint16_t *)data;
-		if (! silence)
-			memset(data, 0, samples * 2);
-		else {
-			while (samples-- > 0)
-				*pdata++ = silence;
-		}
+		uint16_t sil = silence;
+		memcpy(pattern, &sil, 2);
 		break;
 	}
-	case 24: {
-		uint32_t silence = snd_pcm_format_silence_64(format);
-		uint8_t *pdata = (uint8_t *)data;
-		if (! silence)
-			memset(data, 0, samples * 3);
-		else {
-			while (samples-- > 0) {
+	case 24:
 #ifdef SNDRV_LITTLE_ENDIAN
-				*pdata++ = silence >> 0;
-				*pdata++ = silence >> 8;
-				*pdata++ = silence >> 16;
+		pattern[0] = silence >> 0;
+		pattern[1] = silence >> 8;
+		pattern[2] = silence >> 16;
 #else
-				*pdata++ = silence >> 16;
-				*pdata++ = silence >> 8;
-				*pdata++ = silence >> 0;
+		pattern[0] = silence >> 16;
+		pattern[1] = silence >> 8;
+		pattern[2] = silence >> 0;
 #endif
-			}
-		}
 		break;
-	}
 	case 32: {
-		uint32_t silence = snd_pcm_format_silence_64(format);
-		uint32_t *pdata = (uint32_t *)data;
-		if (! silence)
-			memset(data, 0, samples * 4);
-		else {
-			while (samples-- > 0)
-				*pdata++ = silence;
-		}
+		uint32_t sil = silence;
+		memcpy(pattern, &sil, 4);
 		break;
 	}
-	case 64: {
-		uint64_t silence = snd_pcm_format_silence_64(format);
-		uint64_t *pdata = (uint64_t *)data;
-		if (! silence)
-			memset(data, 0, samples * 8);
-		else {
-			while (samples-- > 0)
-				*pdata++ = silence;
-		}
+	case 64:
+		memcpy(pattern, &silence, 8);
 		break;
-	}
 	default:
 		assert(0);
 		return -EINVAL;
 	}
+	/* plain memset() is the best choice unless the buffer is huge, then
+	 * the non-temporal stores of the pattern fill win
+	 */
+	if (!silence && (size_t)samples * (width / 8) < SND_PCM_SILENCE_NT_BYTES)
+		memset(data, 0, (size_t)samples * (width / 8));
+	else
+		snd_pcm_simd_fill(data, (size_t)samples * (width / 8),
+				  pattern, width / 8);
 	return 0;
 }
 
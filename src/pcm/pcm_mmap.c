@@ -23,11 +23,13 @@
 #include <malloc.h>
 #include <string.h>
 #include <poll.h>
+#include <unistd.h>
 #include <sys/mman.h>
 #ifdef HAVE_SYS_SHM_H
 #include <sys/shm.h>
 #endif
 #include "pcm_local.h"
+#include "pcm_plugin.h"
 
 void snd_pcm_mmap_appl_backward(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 {
@@ -256,6 +258,205 @@ int snd_pcm_channel_info_shm(snd_pcm_t *pcm, snd_pcm_channel_info_t *info, int s
 	return 0;
 }	
 
+/*
+ * Buffers of snd_pcm_buffer_alloc() start with this header, padded to
+ * SND_PCM_BUFFER_ALIGN bytes, so that the data keeps the alignment.
+ */
+typedef struct {
+	snd_pcm_t *pcm;
+	size_t size;		/* allocated bytes, header included */
+	int type;
+} snd_pcm_buffer_hdr_t;
+
+enum {
+	SND_PCM_BUFFER_HEAP,
+	SND_PCM_BUFFER_THP,
+	SND_PCM_BUFFER_HUGETLB,
+};
+
+/* huge pages are used only for buffers of at least this size */
+#define SND_PCM_HUGEPAGE_SIZE	(2 * 1024 * 1024)
+
+static size_t snd_pcm_buffer_memory_all;
+
+static int snd_pcm_buffer_hugepages(void)
+{
+	static int hugepages = -1;
+
+	if (hugepages < 0) {
+		const char *env = getenv("LIBASOUND_HUGEPAGES");
+		hugepages = env ? atoi(env) : 0;
+		if (hugepages < 0)
+			hugepages = 0;
+	}
+	return hugepages;
+}
+
+static void snd_pcm_buffer_account(snd_pcm_t *pcm, ssize_t size)
+{
+	pcm->buffer_memory += size;
+	__atomic_fetch_add(&snd_pcm_buffer_memory_all, size, __ATOMIC_RELAXED);
+}
+
+/* anonymous mapping backed by huge pages, NULL if not possible */
+static void *snd_pcm_buffer_map(size_t *size, int *type)
+{
+	int hugepages = snd_pcm_buffer_hugepages();
+	size_t bytes;
+	void *ptr;
+
+	if (!hugepages || *size < SND_PCM_HUGEPAGE_SIZE)
+		return NULL;
+	bytes = (*size + SND_PCM_HUGEPAGE_SIZE - 1) &
+		~(size_t)(SND_PCM_HUGEPAGE_SIZE - 1);
+#ifdef MAP_HUGETLB
+	if (hugepages > 1) {
+		ptr = mmap(NULL, bytes, PROT_READ|PROT_WRITE,
+			   MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+		if (ptr != MAP_FAILED) {
+			*size = bytes;
+			*type = SND_PCM_BUFFER_HUGETLB;
+			return ptr;
+		}
+	}
+#endif
+#ifdef MADV_HUGEPAGE
+	ptr = mmap(NULL, bytes, PROT_READ|PROT_WRITE,
+		   MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+	madvise(ptr, bytes, MADV_HUGEPAGE);
+	*size = bytes;
+	*type = SND_PCM_BUFFER_THP;
+	return ptr;
+#else
+	return NULL;
+#endif
+}
+
+/*
+ * Allocate a zero filled intermediate buffer of 'size' bytes for 'pcm'.
+ * The data is aligned to SND_PCM_BUFFER_ALIGN bytes; large buffers use
+ * huge pages when $LIBASOUND_HUGEPAGES asks for it (1 = transparent,
+ * 2 = explicit with a transparent fallback).  The memory is accounted
+ * to 'pcm' until snd_pcm_buffer_free().
+ */
+void *snd_pcm_buffer_alloc(snd_pcm_t *pcm, size_t size)
+{
+	snd_pcm_buffer_hdr_t *hdr;
+	size_t bytes = size + SND_PCM_BUFFER_ALIGN;
+	int type = SND_PCM_BUFFER_HEAP;
+	void *ptr;
+
+	ptr = snd_pcm_buffer_map(&bytes, &type);
+	if (ptr == NULL) {
+		if (posix_memalign(&ptr, SND_PCM_BUFFER_ALIGN, bytes))
+			return NULL;
+		memset(ptr, 0, bytes);
+	}
+	hdr = ptr;
+	hdr->pcm = pcm;
+	hdr->size = bytes;
+	hdr->type = type;
+	snd_pcm_buffer_account(pcm, bytes);
+	return (char *)ptr + SND_PCM_BUFFER_ALIGN;
+}
+
+/* release a buffer of snd_pcm_buffer_alloc(), NULL is ignored */
+void snd_pcm_buffer_free(void *ptr)
+{
+	snd_pcm_buffer_hdr_t *hdr;
+
+	if (ptr == NULL)
+		return;
+	hdr = (snd_pcm_buffer_hdr_t *)((char *)ptr - SND_PCM_BUFFER_ALIGN);
+	snd_pcm_buffer_account(hdr->pcm, -(ssize_t)hdr->size);
+	if (hdr->type == SND_PCM_BUFFER_HEAP)
+		free(hdr);
+	else
+		munmap(hdr, hdr->size);
+}
+
+/**
+ * \brief Get the memory of the intermediate buffers of a PCM handle
+ * \param pcm PCM handle, or NULL for all handles of the process
+ * \return allocated bytes
+ *
+ * Only the buffers allocated by the library itself are counted (ring
+ * buffers of the plugins and of the emulated mmap access, conversion
+ * buffers), not the buffers of the devices.  The value of one handle does
+ * not include its slaves; #snd_pcm_dump() prints the value of each handle
+ * of the chain.
+ */
+size_t snd_pcm_buffer_memory(snd_pcm_t *pcm)
+{
+	if (pcm == NULL)
+		return __atomic_load_n(&snd_pcm_buffer_memory_all,
+				       __ATOMIC_RELAXED);
+	return pcm->buffer_memory;
+}
+
+#ifdef HAVE_MEMFD_CREATE
+/*
+ * Map 'size' bytes of one memfd twice back to back, so that an access
+ * running past the end of the ring buffer continues at its start.
+ */
+static void *snd_pcm_mmap_mirror_alloc(size_t size)
+{
+	char *ptr;
+	int fd;
+
+	fd = memfd_create("alsa-pcm", MFD_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	if (ftruncate(fd, size) < 0)
+		goto _close;
+	/* reserve the address range first, then map the file over it */
+	ptr = mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		goto _close;
+	if (mmap(ptr, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED,
+		 fd, 0) == MAP_FAILED ||
+	    mmap(ptr + size, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED,
+		 fd, 0) == MAP_FAILED) {
+		munmap(ptr, size * 2);
+		goto _close;
+	}
+	close(fd);
+	return ptr;
+
+ _close:
+	close(fd);
+	return NULL;
+}
+#endif
+
+/*
+ * Can the library allocated buffer of 'size' bytes be mirrored?
+ * Only an interleaved buffer whose end falls on a page boundary can,
+ * and only when the generic plugin code, which knows about the mirror,
+ * commits the frames to the slave.
+ */
+static int snd_pcm_mmap_mirror_ok(snd_pcm_t *pcm, size_t size)
+{
+#ifdef HAVE_MEMFD_CREATE
+	const char *env;
+
+	if (pcm->fast_ops->mmap_commit != snd_pcm_plugin_fast_ops.mmap_commit)
+		return 0;
+	if (pcm->access != SND_PCM_ACCESS_MMAP_INTERLEAVED &&
+	    pcm->access != SND_PCM_ACCESS_RW_INTERLEAVED)
+		return 0;
+	env = getenv("LIBASOUND_MMAP_MIRROR");
+	if (!env || atoi(env) <= 0)
+		return 0;
+	return size == (size_t)pcm->buffer_size * pcm->frame_bits / 8 &&
+	       size % page_size() == 0;
+#else
+	return 0;
+#endif
+}
+
 int snd_pcm_mmap(snd_pcm_t *pcm)
 {
 	int err;
@@ -301,6 +502,7 @@ int snd_pcm_mmap(snd_pcm_t *pcm)
 		char *ptr;
 		size_t size;
 		unsigned int c1;
+		int mirror;
 		if (i->addr) {
         		a->addr = i->addr;
         		a->first = i->first;
@@ -333,6 +535,8 @@ int snd_pcm_mmap(snd_pcm_t *pcm)
 				size = s;
 		}
 		size = (size + 7) / 8;
+		mirror = i->type == SND_PCM_AREA_LOCAL &&
+			 snd_pcm_mmap_mirror_ok(pcm, size);
 		size = page_align(size);
 		switch (i->type) {
 		case SND_PCM_AREA_MMAP:
@@ -394,10 +598,21 @@ int snd_pcm_mmap(snd_pcm_t *pcm)
 			return -ENOSYS;
 #endif
 		case SND_PCM_AREA_LOCAL:
-			ptr = malloc(size);
+#ifdef HAVE_MEMFD_CREATE
+			if (mirror) {
+				ptr = snd_pcm_mmap_mirror_alloc(size);
+				if (ptr) {
+					pcm->mmap_mirror = 1;
+					snd_pcm_buffer_account(pcm, size);
+					i->addr = ptr;
+					break;
+				}
+			}
+#endif
+			ptr = snd_pcm_buffer_alloc(pcm, size);
 			if (ptr == NULL) {
-				SYSERR("malloc failed");
-				return -errno;
+				SYSERR("buffer allocation failed");
+				return -ENOMEM;
 			}
 			i->addr = ptr;
 			break;
@@ -496,13 +711,18 @@ int snd_pcm_munmap(snd_pcm_t *pcm)
 			return -ENOSYS;
 #endif
 		case SND_PCM_AREA_LOCAL:
-			free(i->addr);
+			if (pcm->mmap_mirror) {
+				munmap(i->addr, size * 2);
+				snd_pcm_buffer_account(pcm, -(ssize_t)size);
+			} else
+				snd_pcm_buffer_free(i->addr);
 			break;
 		default:
 			assert(0);
 		}
 		i->addr = NULL;
 	}
+	pcm->mmap_mirror = 0;
 	err = pcm->ops->munmap(pcm);
 	if (err < 0)
 		return err;
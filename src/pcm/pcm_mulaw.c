@@ -29,6 +29,7 @@
 #include "bswap.h"
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#include "pcm_simd.h"
 
 #include "plugin_ops.h"
 
@@ -52,6 +53,8 @@ typedef struct {
 	unsigned int getput_idx;
 	mulaw_f func;
 	snd_pcm_format_t sformat;
+	snd_pcm_simd_convert_t kernel;	/* client -> slave for playback */
+	unsigned int src_width, dst_width;	/* in bits, for the kernel */
 } snd_pcm_mulaw_t;
 
 #endif
@@ -350,6 +353,15 @@ static int snd_pcm_mulaw_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 			mulaw->func = snd_pcm_mulaw_encode;
 		}
 	}
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		mulaw->kernel = snd_pcm_simd_g711_kernel(format, mulaw->sformat);
+		mulaw->src_width = snd_pcm_format_physical_width(format);
+		mulaw->dst_width = snd_pcm_format_physical_width(mulaw->sformat);
+	} else {
+		mulaw->kernel = snd_pcm_simd_g711_kernel(mulaw->sformat, format);
+		mulaw->src_width = snd_pcm_format_physical_width(mulaw->sformat);
+		mulaw->dst_width = snd_pcm_format_physical_width(format);
+	}
 	return 0;
 }
 
@@ -365,10 +377,17 @@ snd_pcm_mulaw_write_areas(snd_pcm_t *pcm,
 	snd_pcm_mulaw_t *mulaw = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	mulaw->func(slave_areas, slave_offset,
-		    areas, offset, 
-		    pcm->channels, size,
-		    mulaw->getput_idx);
+	if (mulaw->kernel)
+		snd_pcm_simd_convert_areas(mulaw->kernel,
+					   slave_areas, slave_offset,
+					   mulaw->dst_width,
+					   areas, offset, mulaw->src_width,
+					   pcm->channels, size);
+	else
+		mulaw->func(slave_areas, slave_offset,
+			    areas, offset, 
+			    pcm->channels, size,
+			    mulaw->getput_idx);
 	*slave_sizep = size;
 	return size;
 }
@@ -385,10 +404,17 @@ snd_pcm_mulaw_read_areas(snd_pcm_t *pcm,
 	snd_pcm_mulaw_t *mulaw = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	mulaw->func(areas, offset, 
-		    slave_areas, slave_offset,
-		    pcm->channels, size,
-		    mulaw->getput_idx);
+	if (mulaw->kernel)
+		snd_pcm_simd_convert_areas(mulaw->kernel,
+					   areas, offset, mulaw->dst_width,
+					   slave_areas, slave_offset,
+					   mulaw->src_width,
+					   pcm->channels, size);
+	else
+		mulaw->func(areas, offset, 
+			    slave_areas, slave_offset,
+			    pcm->channels, size,
+			    mulaw->getput_idx);
 	*slave_sizep = size;
 	return size;
 }
@@ -497,6 +523,10 @@ pcm.name {
 }
 \endcode
 
+Decoding goes through a table, encoding of 16-bit samples is vectorized
+when the CPU supports it. The same conversion is available to applications
+as #snd_pcm_areas_mulaw_decode() and #snd_pcm_areas_mulaw_encode().
+
 \subsection pcm_plugins_mulaw_funcref Function reference
 
 <UL>
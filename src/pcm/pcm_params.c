@@ -2340,13 +2340,202 @@ static int snd_pcm_sw_params_default(snd_pcm_t *pcm, snd_pcm_sw_params_t *params
 	return 0;
 }
 
+/*
+ * hw_refine cache
+ *
+ * The result of a refine only depends on the input parameters and on the
+ * PCM chain, so it is remembered across handles and looked up by the
+ * identity of the chain: the PCM name and type, the stream and open mode,
+ * the device at the end of the chain and the generation of the global
+ * configuration.  PCMs without a name (created internally by plug) and
+ * external plugins, whose constraints are computed by foreign code, are
+ * never cached.  A stale entry can be detected only when hw_params rejects
+ * the result of a hit, then that entry is dropped and the refine is
+ * retried.
+ *
+ * The cache is enabled by $LIBASOUND_REFINE_CACHE=1.
+ */
+
+#define REFINE_CACHE_SIZE	32
+
+struct refine_cache_entry {
+	char *id;
+	unsigned long stamp;
+	int result;
+	snd_pcm_hw_params_t in;
+	snd_pcm_hw_params_t out;
+};
+
+static struct refine_cache_entry *refine_cache;
+static unsigned long refine_cache_stamp;
+static unsigned long refine_cache_hits;
+static unsigned long refine_cache_misses;
+static int refine_cache_enabled = -1;
+
+#ifdef THREAD_SAFE_API
+static pthread_mutex_t refine_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define refine_cache_lock()	pthread_mutex_lock(&refine_cache_mutex)
+#define refine_cache_unlock()	pthread_mutex_unlock(&refine_cache_mutex)
+#else
+#define refine_cache_lock()	do { } while (0)
+#define refine_cache_unlock()	do { } while (0)
+#endif
+
+int snd_pcm_refine_cache_enabled(void)
+{
+	if (refine_cache_enabled < 0) {
+		const char *env = getenv("LIBASOUND_REFINE_CACHE");
+		refine_cache_enabled = env && atoi(env) > 0;
+	}
+	return refine_cache_enabled;
+}
+
+/* build the chain identity once per handle; NULL if not cacheable */
+static const char *refine_cache_id(snd_pcm_t *pcm)
+{
+	snd_pcm_info_t info;
+	char buf[256];
+	int card = -1, device = -1, subdevice = -1;
+
+	if (pcm->refine_id_checked)
+		return pcm->refine_id;
+	pcm->refine_id_checked = 1;
+	if (!pcm->name || pcm->type == SND_PCM_TYPE_IOPLUG ||
+	    pcm->type == SND_PCM_TYPE_EXTPLUG)
+		return NULL;
+	memset(&info, 0, sizeof(info));
+	if (snd_pcm_info(pcm, &info) >= 0) {
+		card = info.card;
+		device = info.device;
+		subdevice = info.subdevice;
+	}
+	snprintf(buf, sizeof(buf), "%s:%d:%d:%d:%d:%d:%d:%u", pcm->name,
+		 pcm->type, pcm->stream, pcm->mode, card, device, subdevice,
+		 snd_config_generation());
+	pcm->refine_id = strdup(buf);
+	return pcm->refine_id;
+}
+
+static int refine_cache_lookup(const char *id, snd_pcm_hw_params_t *params,
+			       int *result)
+{
+	unsigned int k;
+	int found = 0;
+
+	refine_cache_lock();
+	for (k = 0; refine_cache && k < REFINE_CACHE_SIZE; k++) {
+		struct refine_cache_entry *e = &refine_cache[k];
+		if (!e->id || strcmp(e->id, id) ||
+		    memcmp(&e->in, params, sizeof(*params)))
+			continue;
+		*params = e->out;
+		*result = e->result;
+		e->stamp = ++refine_cache_stamp;
+		found = 1;
+		break;
+	}
+	if (found)
+		refine_cache_hits++;
+	else
+		refine_cache_misses++;
+	refine_cache_unlock();
+	return found;
+}
+
+static void refine_cache_store(const char *id, const snd_pcm_hw_params_t *in,
+			       const snd_pcm_hw_params_t *out, int result)
+{
+	struct refine_cache_entry *e;
+	unsigned int k;
+
+	refine_cache_lock();
+	if (!refine_cache) {
+		refine_cache = calloc(REFINE_CACHE_SIZE, sizeof(*refine_cache));
+		if (!refine_cache)
+			goto unlock;
+	}
+	/* replace the least recently used entry */
+	e = &refine_cache[0];
+	for (k = 1; k < REFINE_CACHE_SIZE && e->id; k++) {
+		if (!refine_cache[k].id || refine_cache[k].stamp < e->stamp)
+			e = &refine_cache[k];
+	}
+	free(e->id);
+	e->id = strdup(id);
+	e->stamp = ++refine_cache_stamp;
+	e->in = *in;
+	e->out = *out;
+	e->result = result;
+ unlock:
+	refine_cache_unlock();
+}
+
+/* drop the entry of a refine of 'in' */
+static void refine_cache_drop(const char *id, const snd_pcm_hw_params_t *in)
+{
+	unsigned int k;
+
+	refine_cache_lock();
+	for (k = 0; refine_cache && k < REFINE_CACHE_SIZE; k++) {
+		struct refine_cache_entry *e = &refine_cache[k];
+		if (!e->id || strcmp(e->id, id) ||
+		    memcmp(&e->in, in, sizeof(*in)))
+			continue;
+		free(e->id);
+		e->id = NULL;
+		break;
+	}
+	refine_cache_unlock();
+}
+
+/**
+ * \brief Drop all entries of the hw_params refine cache
+ * \return the number of dropped entries
+ *
+ * The cache is enabled by setting $LIBASOUND_REFINE_CACHE to 1. Flush it
+ * after the capabilities of a device changed without a configuration
+ * update, e.g. when another stream locked the sample rate.
+ */
+int snd_pcm_refine_cache_flush(void)
+{
+	unsigned int k;
+	int count = 0;
+
+	refine_cache_lock();
+	for (k = 0; refine_cache && k < REFINE_CACHE_SIZE; k++) {
+		if (refine_cache[k].id) {
+			free(refine_cache[k].id);
+			refine_cache[k].id = NULL;
+			count++;
+		}
+	}
+	refine_cache_unlock();
+	return count;
+}
+
+/**
+ * \brief Get the hw_params refine cache counters
+ * \param hits Returned number of refines answered from the cache
+ * \param misses Returned number of refines passed to the PCM chain
+ */
+void snd_pcm_refine_cache_stats(unsigned long *hits, unsigned long *misses)
+{
+	refine_cache_lock();
+	*hits = refine_cache_hits;
+	*misses = refine_cache_misses;
+	refine_cache_unlock();
+}
+
 #if 0
 #define REFINE_DEBUG
 #endif
 
-int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+/* snd_pcm_hw_refine(), '*hit' is set when the cache answered it */
+static int hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params, int *hit)
 {
 	int res;
+	const char *id = NULL;
+	snd_pcm_hw_params_t in;
 #ifdef REFINE_DEBUG
 	snd_output_t *log;
 	snd_output_stdio_attach(&log, stderr, 0);
@@ -2356,7 +2545,19 @@ int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	snd_output_printf(log, "REFINE called:\n");
 	snd_pcm_hw_params_dump(params, log);
 #endif
+	if (snd_pcm_refine_cache_enabled()) {
+		id = refine_cache_id(pcm);
+		if (id) {
+			*hit = refine_cache_lookup(id, params, &res);
+			if (*hit)
+				goto _end;
+			in = *params;
+		}
+	}
 	res = pcm->ops->hw_refine(pcm->op_arg, params);
+	if (id)
+		refine_cache_store(id, &in, params, res);
+ _end:
 #ifdef REFINE_DEBUG
 	snd_output_printf(log, "refine done - result = %i\n", res);
 	snd_pcm_hw_params_dump(params, log);
@@ -2365,6 +2566,13 @@ int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	return res;
 }
 
+int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+	int hit = 0;
+
+	return hw_refine(pcm, params, &hit);
+}
+
 /* Install one of the configurations present in configuration
    space defined by PARAMS.
    The configuration chosen is that obtained fixing in this order:
@@ -2382,7 +2590,13 @@ int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	int err;
 	snd_pcm_sw_params_t sw;
 	int fb, min_align;
-	err = snd_pcm_hw_refine(pcm, params);
+	int hit = 0;
+	snd_pcm_hw_params_t saved;
+
+	if (snd_pcm_refine_cache_enabled())
+		saved = *params;
+ __retry:
+	err = hw_refine(pcm, params, &hit);
 	if (err < 0)
 		return err;
 	snd_pcm_hw_params_choose(pcm, params);
@@ -2392,8 +2606,18 @@ int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 			return err;
 	}
 	err = pcm->ops->hw_params(pcm->op_arg, params);
-	if (err < 0)
+	if (err < 0) {
+		/*
+		 * the refine answered by the cache might be out of date,
+		 * drop its entry and refine again; the retry misses
+		 */
+		if (hit && err == -EINVAL) {
+			refine_cache_drop(refine_cache_id(pcm), &saved);
+			*params = saved;
+			goto __retry;
+		}
 		return err;
+	}
 
 	pcm->setup = 1;
 	INTERNAL(snd_pcm_hw_params_get_access)(params, &pcm->access);
@@ -55,6 +55,8 @@ typedef struct {
 	snd_pcm_route_ttable_entry_t *ttable;
 	int ttable_ok;
 	unsigned int tt_ssize, tt_cused, tt_sused;
+	int internal_float;	/* float samples between the conversion stages */
+	int use_float;		/* float pipeline for the current setup */
 } snd_pcm_plug_t;
 
 #endif
@@ -367,6 +369,31 @@ typedef struct {
 } snd_pcm_plug_params_t;
 #endif
 
+/*
+ * With internal_float, a rate or channel conversion runs on FLOAT samples:
+ * the slave format is converted once to float, route and rate work on
+ * float, and the client format is converted once at the top.
+ */
+static int snd_pcm_plug_float_stage(snd_pcm_plug_t *plug,
+				    const snd_pcm_plug_params_t *clt,
+				    const snd_pcm_plug_params_t *slv)
+{
+#if defined(BUILD_PCM_PLUGIN_LFLOAT) && SND_PCM_PLUGIN_ROUTE_FLOAT
+	if (!plug->use_float)
+		return 0;
+	if (clt->rate == slv->rate &&
+	    clt->channels == slv->channels &&
+	    (!plug->ttable || plug->ttable_ok))
+		return 0;
+	return (snd_pcm_format_linear(clt->format) ||
+		clt->format == SND_PCM_FORMAT_FLOAT) &&
+	       (snd_pcm_format_linear(slv->format) ||
+		slv->format == SND_PCM_FORMAT_FLOAT);
+#else
+	return 0;
+#endif
+}
+
 #ifdef BUILD_PCM_PLUGIN_RATE
 static int snd_pcm_plug_change_rate(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plug_params_t *clt, snd_pcm_plug_params_t *slv)
 {
@@ -374,14 +401,16 @@ static int snd_pcm_plug_change_rate(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plu
 	int err;
 	if (clt->rate == slv->rate)
 		return 0;
-	assert(snd_pcm_format_linear(slv->format));
+	assert(snd_pcm_format_linear(slv->format) ||
+	       slv->format == SND_PCM_FORMAT_FLOAT);
 	err = snd_pcm_rate_open(new, NULL, slv->format, slv->rate, plug->rate_converter,
 				plug->gen.slave, plug->gen.slave != plug->req_slave);
 	if (err < 0)
 		return err;
 	slv->access = clt->access;
 	slv->rate = clt->rate;
-	if (snd_pcm_format_linear(clt->format))
+	if (snd_pcm_format_linear(clt->format) &&
+	    slv->format != SND_PCM_FORMAT_FLOAT)
 		slv->format = clt->format;
 	return 1;
 }
@@ -400,7 +429,8 @@ static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm
 	if (clt->rate != slv->rate &&
 	    clt->channels > slv->channels)
 		return 0;
-	assert(snd_pcm_format_linear(slv->format));
+	assert(snd_pcm_format_linear(slv->format) ||
+	       slv->format == SND_PCM_FORMAT_FLOAT);
 	tt_ssize = slv->channels;
 	tt_cused = clt->channels;
 	tt_sused = slv->channels;
@@ -484,7 +514,8 @@ static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm
 		return err;
 	slv->channels = clt->channels;
 	slv->access = clt->access;
-	if (snd_pcm_format_linear(clt->format))
+	if (snd_pcm_format_linear(clt->format) &&
+	    slv->format != SND_PCM_FORMAT_FLOAT)
 		slv->format = clt->format;
 	return 1;
 }
@@ -504,6 +535,21 @@ static int snd_pcm_plug_change_format(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_p
 	    (!plug->ttable || plug->ttable_ok))
 		return 0;
 
+#ifdef BUILD_PCM_PLUGIN_LFLOAT
+	if (snd_pcm_plug_float_stage(plug, clt, slv)) {
+		/* Conversion is done in float by another plugin */
+		if (slv->format == SND_PCM_FORMAT_FLOAT)
+			return 0;
+		err = snd_pcm_lfloat_open(new, NULL, slv->format, plug->gen.slave,
+					  plug->gen.slave != plug->req_slave);
+		if (err < 0)
+			return err;
+		slv->format = SND_PCM_FORMAT_FLOAT;
+		slv->access = clt->access;
+		return 1;
+	}
+#endif
+
 	if (snd_pcm_format_linear(slv->format)) {
 		/* Conversion is done in another plugin */
 		if (clt->rate != slv->rate ||
@@ -1028,6 +1074,8 @@ static int snd_pcm_plug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	INTERNAL(snd_pcm_hw_params_get_format)(&sparams, &slv_params.format);
 	INTERNAL(snd_pcm_hw_params_get_channels)(&sparams, &slv_params.channels);
 	INTERNAL(snd_pcm_hw_params_get_rate)(&sparams, &slv_params.rate, 0);
+	plug->use_float = plug->internal_float;
+ retry:
 	snd_pcm_plug_clear(pcm);
 	if (!(clt_params.format == slv_params.format &&
 	      clt_params.channels == slv_params.channels &&
@@ -1037,13 +1085,24 @@ static int snd_pcm_plug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 					    clt_params.access) >= 0)) {
 		INTERNAL(snd_pcm_hw_params_set_access_first)(slave, &sparams, &slv_params.access);
 		err = snd_pcm_plug_insert_plugins(pcm, &clt_params, &slv_params);
-		if (err < 0)
+		if (err < 0) {
+			if (plug->use_float) {
+				/* fall back to the integer chain */
+				plug->use_float = 0;
+				goto retry;
+			}
 			return err;
+		}
 	}
 	slave = plug->gen.slave;
 	err = _snd_pcm_hw_params_internal(slave, params);
 	if (err < 0) {
 		snd_pcm_plug_clear(pcm);
+		if (plug->use_float) {
+			plug->use_float = 0;
+			slave = plug->req_slave;
+			goto retry;
+		}
 		return err;
 	}
 	snd_pcm_unlink_hw_ptr(pcm, plug->req_slave);
@@ -1195,9 +1254,18 @@ pcm.name {
 	rate_converter [ STR1 STR2 ... ]
 				# type of rate converter
 				# default value is taken from defaults.pcm.rate_converter
+	internal_float BOOL	# keep FLOAT samples between the conversion
+				# stages (default no)
 }
 \endcode
 
+With internal_float, a conversion that needs the route or rate plugin runs
+on native FLOAT samples: the slave format is converted to float once, the
+route and rate stages work on float without clipping or requantizing, and
+the client format is converted once at the top of the chain.  When a stage
+cannot work on float (e.g. a rate converter without float support), the
+usual integer chain is built instead.
+
 \subsection pcm_plugins_plug_funcref Function reference
 
 <UL>
@@ -1236,6 +1304,7 @@ int _snd_pcm_plug_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_format_t sformat = SND_PCM_FORMAT_UNKNOWN;
 	int schannels = -1, srate = -1;
 	const snd_config_t *rate_converter = NULL;
+	int internal_float = 0;
 
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1283,6 +1352,13 @@ int _snd_pcm_plug_open(snd_pcm_t **pcmp, const char *name,
 			continue;
 		}
 #endif
+		if (strcmp(id, "internal_float") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			internal_float = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1327,9 +1403,12 @@ int _snd_pcm_plug_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	err = snd_pcm_plug_open(pcmp, name, sformat, schannels, srate, rate_converter,
 				route_policy, ttable, ssize, cused, sused, spcm, 1);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	((snd_pcm_plug_t *)(*pcmp)->private_data)->internal_float = internal_float;
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_plug_open, SND_PCM_DLSYM_VERSION);
@@ -80,6 +80,16 @@ pcm.rate44100Hz {
 }
 \endcode
 
+\section pcm_plugins_in_place In-place conversion
+
+Playback plugins whose conversion keeps every sample at its position
+(softvol, linear between formats of the same width, route with a diagonal
+ttable) share the ring buffer of their slave instead of allocating their
+own. The data is then copied only once from the application buffer and
+converted in the final buffer by each plugin of such a chain. Setting the
+environment variable LIBASOUND_PLUGIN_IN_PLACE to 0 disables it for linear
+and route.
+
 */
   
 #include <limits.h>
@@ -135,6 +145,66 @@ void snd_pcm_plugin_init(snd_pcm_plugin_t *plugin)
 	plugin->undo_write = snd_pcm_plugin_undo_write;
 }
 
+/*
+ * Called from the hw_params callback of a plugin, after the slave has been
+ * set up.  can_in_place tells whether the conversion negotiated in params
+ * may be done on the place, i.e. it neither changes the sample width nor
+ * reads other samples than the one it writes.  If the frame layout of the
+ * slave matches too, the plugin uses the mmap buffer of the slave as its own
+ * (see snd_pcm_generic_mmap()), so the data committed to it is converted
+ * directly in the slave buffer.  A chain of such plugins then costs a single
+ * copy from the application buffer per period.
+ *
+ * Only playback is done on the place: on capture, the slave would be free to
+ * overwrite the data which has not been read from the plugin yet.
+ * $LIBASOUND_PLUGIN_IN_PLACE=0 disables it.
+ */
+int snd_pcm_plugin_set_in_place(snd_pcm_t *pcm, const snd_pcm_hw_params_t *params,
+				int can_in_place)
+{
+	static int enabled = -1;
+	snd_pcm_plugin_t *plugin = pcm->private_data;
+	snd_pcm_t *slave = plugin->gen.slave;
+	snd_pcm_access_t access;
+	snd_pcm_uframes_t buffer_size;
+	unsigned int channels;
+
+	if (enabled < 0) {
+		const char *env = getenv("LIBASOUND_PLUGIN_IN_PLACE");
+		enabled = !env || *env != '0';
+	}
+	pcm->mmap_shadow = 0;
+	if (!enabled || !can_in_place || pcm->stream != SND_PCM_STREAM_PLAYBACK)
+		return 0;
+	if (!slave->mmap_channels || !slave->running_areas)
+		return 0;
+	if (INTERNAL(snd_pcm_hw_params_get_access)(params, &access) < 0 ||
+	    INTERNAL(snd_pcm_hw_params_get_channels)(params, &channels) < 0 ||
+	    INTERNAL(snd_pcm_hw_params_get_buffer_size)(params, &buffer_size) < 0)
+		return 0;
+	if (channels != slave->channels || buffer_size != slave->buffer_size)
+		return 0;
+	/* the application sees the slave areas, keep the layout it asked for */
+	switch (access) {
+	case SND_PCM_ACCESS_MMAP_INTERLEAVED:
+	case SND_PCM_ACCESS_RW_INTERLEAVED:
+		if (slave->access != SND_PCM_ACCESS_MMAP_INTERLEAVED)
+			return 0;
+		break;
+	case SND_PCM_ACCESS_MMAP_NONINTERLEAVED:
+	case SND_PCM_ACCESS_RW_NONINTERLEAVED:
+		if (slave->access != SND_PCM_ACCESS_MMAP_NONINTERLEAVED)
+			return 0;
+		break;
+	default:
+		if (slave->access != SND_PCM_ACCESS_MMAP_COMPLEX)
+			return 0;
+		break;
+	}
+	pcm->mmap_shadow = 1;
+	return 1;
+}
+
 static int snd_pcm_plugin_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 {
 	snd_pcm_plugin_t *plugin = pcm->private_data;
@@ -422,7 +492,7 @@ snd_pcm_plugin_mmap_commit(snd_pcm_t *pcm,
 			err = result;
 			goto error;
 		}
-		if (frames > cont)
+		if (frames > cont && !pcm->mmap_mirror)
 			frames = cont;
 		frames = plugin->write(pcm, areas, appl_offset, frames,
 				       slave_areas, slave_offset, &slave_frames);
@@ -442,8 +512,8 @@ snd_pcm_plugin_mmap_commit(snd_pcm_t *pcm,
 			goto error;
 		}
 		snd_pcm_mmap_appl_forward(pcm, frames);
-		if (frames == cont)
-			appl_offset = 0;
+		if (frames >= cont)
+			appl_offset = frames - cont;
 		else
 			appl_offset += result;
 		size -= frames;
@@ -503,7 +573,7 @@ static snd_pcm_sframes_t snd_pcm_plugin_avail_update(snd_pcm_t *pcm)
 				err = result;
 				goto error;
 			}
-			if (frames > cont)
+			if (frames > cont && !pcm->mmap_mirror)
 				frames = cont;
 			frames = (plugin->read)(pcm, areas, hw_offset, frames,
 					      slave_areas, slave_offset, &slave_frames);
@@ -523,8 +593,8 @@ static snd_pcm_sframes_t snd_pcm_plugin_avail_update(snd_pcm_t *pcm)
 				goto error;
 			}
 			snd_pcm_mmap_hw_forward(pcm, frames);
-			if (frames == cont)
-				hw_offset = 0;
+			if (frames >= cont)
+				hw_offset = frames - cont;
 			else
 				hw_offset += frames;
 			size -= frames;
@@ -62,11 +62,15 @@ typedef struct {
 	snd1_pcm_plugin_rewind
 #define snd_pcm_plugin_forward \
 	snd1_pcm_plugin_forward
+#define snd_pcm_plugin_set_in_place \
+	snd1_pcm_plugin_set_in_place
 
 void snd_pcm_plugin_init(snd_pcm_plugin_t *plugin);
 snd_pcm_sframes_t snd_pcm_plugin_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames);
 snd_pcm_sframes_t snd_pcm_plugin_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frames);
 int snd_pcm_plugin_may_wait_for_avail_min(snd_pcm_t *pcm, snd_pcm_uframes_t avail);
+int snd_pcm_plugin_set_in_place(snd_pcm_t *pcm, const snd_pcm_hw_params_t *params,
+				int can_in_place);
 
 extern const snd_pcm_fast_ops_t snd_pcm_plugin_fast_ops;
 
@@ -28,10 +28,12 @@
  *
  */
 #include <inttypes.h>
+#include <math.h>
 #include "bswap.h"
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 #include "pcm_rate.h"
+#include "pcm_simd.h"
 
 #include "plugin_ops.h"
 
@@ -70,6 +72,18 @@ struct _snd_pcm_rate {
 	snd_htimestamp_t trigger_tstamp;
 	unsigned int plugin_version;
 	unsigned int rate_min, rate_max;
+	int float_ok;		/* converter accepts the native FLOAT format */
+	uint64_t in_formats;	/* of get_supported_formats, 0 = any */
+	uint64_t out_formats;
+	unsigned int format_flags;
+	snd_pcm_format_t in_format;	/* of the streams, info has the converter's */
+	snd_pcm_format_t out_format;
+	snd_pcm_channel_area_t *in_areas;	/* a period in the converter formats, */
+	snd_pcm_channel_area_t *out_areas;	/* NULL if never needed */
+	snd_pcm_simd_convert_t in_kernel;
+	snd_pcm_simd_convert_t out_kernel;
+	unsigned int in_conv_idx;
+	unsigned int out_conv_idx;
 };
 
 #define SND_PCM_RATE_PLUGIN_VERSION_OLD	0x010001	/* old rate plugin */
@@ -82,6 +96,14 @@ static int snd_pcm_rate_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_
 	int err;
 	snd_pcm_access_mask_t access_mask = { SND_PCM_ACCBIT_SHM };
 	snd_pcm_format_mask_t format_mask = { SND_PCM_FMTBIT_LINEAR };
+	if (rate->float_ok) {
+		/* float is converted only to float */
+		if (rate->sformat == SND_PCM_FORMAT_FLOAT)
+			snd_pcm_format_mask_none(&format_mask);
+		if (rate->sformat == SND_PCM_FORMAT_FLOAT ||
+		    rate->sformat == SND_PCM_FORMAT_UNKNOWN)
+			snd_pcm_format_mask_set(&format_mask, SND_PCM_FORMAT_FLOAT);
+	}
 	err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_ACCESS,
 					 &access_mask);
 	if (err < 0)
@@ -235,12 +257,132 @@ static int snd_pcm_rate_hw_refine(snd_pcm_t *pcm,
 				       snd_pcm_generic_hw_refine);
 }
 
+/* the format a converter supporting 'formats' works in for 'format' */
+static snd_pcm_format_t snd_pcm_rate_pick_format(uint64_t formats,
+						 snd_pcm_format_t format)
+{
+	if (formats & (1ULL << format))
+		return format;
+	if (format == SND_PCM_FORMAT_FLOAT)
+		return SND_PCM_FORMAT_UNKNOWN;
+	if (snd_pcm_format_width(format) > 16 &&
+	    (formats & (1ULL << SND_PCM_FORMAT_S32)))
+		return SND_PCM_FORMAT_S32;
+	if (formats & (1ULL << SND_PCM_FORMAT_S16))
+		return SND_PCM_FORMAT_S16;
+	if (formats & (1ULL << SND_PCM_FORMAT_S32))
+		return SND_PCM_FORMAT_S32;
+	return SND_PCM_FORMAT_UNKNOWN;
+}
+
+/*
+ * Set the formats of info to those the converter works in.  A stream in
+ * another format is converted to S32 when it has more than 16 bits and
+ * the converter takes S32, to S16 otherwise, so that S32 and FLOAT
+ * streams go through the converters supporting them without the S16
+ * round trip.
+ */
+static int snd_pcm_rate_set_formats(snd_pcm_rate_t *rate)
+{
+	snd_pcm_rate_side_info_t *in = &rate->info.in, *out = &rate->info.out;
+	uint64_t in_formats = rate->in_formats, out_formats = rate->out_formats;
+
+	rate->in_format = in->format;
+	rate->out_format = out->format;
+	if (!in_formats || !out_formats)
+		return 0;
+	if (rate->format_flags & SND_PCM_RATE_FLAG_SYNC_FORMATS) {
+		in_formats &= out_formats;
+		out_formats = in_formats;
+	}
+	in->format = snd_pcm_rate_pick_format(in_formats, in->format);
+	if (rate->format_flags & SND_PCM_RATE_FLAG_SYNC_FORMATS)
+		out->format = in->format;
+	else
+		out->format = snd_pcm_rate_pick_format(out_formats, out->format);
+	if (in->format == SND_PCM_FORMAT_UNKNOWN ||
+	    out->format == SND_PCM_FORMAT_UNKNOWN) {
+		SNDERR("Rate converter does not support %s -> %s",
+		       snd_pcm_format_name(rate->in_format),
+		       snd_pcm_format_name(rate->out_format));
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static void snd_pcm_rate_free_stage(snd_pcm_rate_t *rate)
+{
+	if (rate->in_areas)
+		snd_pcm_buffer_free(rate->in_areas[0].addr);
+	if (rate->out_areas)
+		snd_pcm_buffer_free(rate->out_areas[0].addr);
+	free(rate->in_areas);
+	free(rate->out_areas);
+	rate->in_areas = rate->out_areas = NULL;
+}
+
+/*
+ * An interleaved period buffer in 'format' for a side whose stream format
+ * differs; converters go faster over whole frames.
+ */
+static snd_pcm_channel_area_t *snd_pcm_rate_alloc_stage(snd_pcm_t *pcm,
+							unsigned int channels,
+							snd_pcm_format_t format,
+							snd_pcm_uframes_t frames)
+{
+	unsigned int width, chn;
+	snd_pcm_channel_area_t *areas;
+	void *buf;
+
+	areas = malloc(channels * sizeof(*areas));
+	if (!areas)
+		return NULL;
+	width = snd_pcm_format_physical_width(format);
+	buf = snd_pcm_buffer_alloc(pcm, width * channels * frames / 8);
+	if (!buf) {
+		free(areas);
+		return NULL;
+	}
+	for (chn = 0; chn < channels; chn++) {
+		areas[chn].addr = buf;
+		areas[chn].first = chn * width;
+		areas[chn].step = channels * width;
+	}
+	return areas;
+}
+
+/* the areas of a period split at the end of a buffer of 'access' */
+static void snd_pcm_rate_setup_split(snd_pcm_channel_area_t *areas, void *buf,
+				     unsigned int channels, unsigned int width,
+				     size_t bytes, snd_pcm_access_t access)
+{
+	int interleaved = access == SND_PCM_ACCESS_MMAP_INTERLEAVED ||
+			  access == SND_PCM_ACCESS_RW_INTERLEAVED;
+	unsigned int chn;
+
+	for (chn = 0; chn < channels; chn++) {
+		if (interleaved) {
+			areas[chn].addr = buf;
+			areas[chn].first = chn * width;
+			areas[chn].step = channels * width;
+		} else {
+			areas[chn].addr = (char *)buf + bytes * chn;
+			assert(((uintptr_t)areas[chn].addr & (SND_PCM_BUFFER_ALIGN - 1)) == 0);
+			areas[chn].first = 0;
+			areas[chn].step = width;
+		}
+	}
+}
+
 static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 	snd_pcm_t *slave = rate->gen.slave;
 	snd_pcm_rate_side_info_t *sinfo, *cinfo;
-	unsigned int channels, cwidth, swidth, chn;
+	unsigned int channels, cwidth, swidth;
+	snd_pcm_access_t access;
+	size_t cbytes, sbytes;
+	void *buf;
 	int err = snd_pcm_hw_params_slave(pcm, params,
 					  snd_pcm_rate_hw_refine_cchange,
 					  snd_pcm_rate_hw_refine_sprepare,
@@ -269,6 +411,9 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	if (err < 0)
 		return err;
 	err = INTERNAL(snd_pcm_hw_params_get_channels)(params, &channels);
+	if (err < 0)
+		return err;
+	err = INTERNAL(snd_pcm_hw_params_get_access)(params, &access);
 	if (err < 0)
 		return err;
 
@@ -282,6 +427,11 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 		SNDMSG("rate plugin already in use");
 		return -EBUSY;
 	}
+	cwidth = snd_pcm_format_physical_width(cinfo->format);
+	swidth = snd_pcm_format_physical_width(sinfo->format);
+	err = snd_pcm_rate_set_formats(rate);
+	if (err < 0)
+		return err;
 	err = rate->ops.init(rate->obj, &rate->info);
 	if (err < 0)
 		return err;
@@ -290,40 +440,68 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	if (rate->pareas == NULL)
 		goto error;
 
-	cwidth = snd_pcm_format_physical_width(cinfo->format);
-	swidth = snd_pcm_format_physical_width(sinfo->format);
-	rate->pareas[0].addr = malloc(((cwidth * channels * cinfo->period_size) / 8) +
-				      ((swidth * channels * sinfo->period_size) / 8));
-	if (rate->pareas[0].addr == NULL)
+	/* keep every channel of the period buffers aligned */
+	cbytes = snd_pcm_buffer_align((cwidth * cinfo->period_size) / 8);
+	sbytes = snd_pcm_buffer_align((swidth * sinfo->period_size) / 8);
+	buf = snd_pcm_buffer_alloc(pcm, (cbytes + sbytes) * channels);
+	rate->pareas[0].addr = buf;
+	if (buf == NULL)
 		goto error;
 
+	/*
+	 * laid out like the buffers of each side, so that a period split at
+	 * the end of a buffer is converted like the others
+	 */
 	rate->sareas = rate->pareas + channels;
-	rate->sareas[0].addr = (char *)rate->pareas[0].addr + ((cwidth * channels * cinfo->period_size) / 8);
-	for (chn = 0; chn < channels; chn++) {
-		rate->pareas[chn].addr = rate->pareas[0].addr + (cwidth * chn * cinfo->period_size) / 8;
-		rate->pareas[chn].first = 0;
-		rate->pareas[chn].step = cwidth;
-		rate->sareas[chn].addr = rate->sareas[0].addr + (swidth * chn * sinfo->period_size) / 8;
-		rate->sareas[chn].first = 0;
-		rate->sareas[chn].step = swidth;
-	}
+	snd_pcm_rate_setup_split(rate->pareas, buf, channels, cwidth, cbytes,
+				 access);
+	snd_pcm_rate_setup_split(rate->sareas, (char *)buf + cbytes * channels,
+				 channels, swidth, sbytes, slave->access);
 
 	if (rate->ops.convert_s16) {
-		rate->get_idx = snd_pcm_linear_get_index(rate->info.in.format, SND_PCM_FORMAT_S16);
-		rate->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S16, rate->info.out.format);
-		free(rate->src_buf);
-		rate->src_buf = malloc(channels * rate->info.in.period_size * 2);
-		free(rate->dst_buf);
-		rate->dst_buf = malloc(channels * rate->info.out.period_size * 2);
+		if (rate->info.in.format != SND_PCM_FORMAT_FLOAT) {
+			rate->get_idx = snd_pcm_linear_get_index(rate->info.in.format, SND_PCM_FORMAT_S16);
+			rate->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S16, rate->info.out.format);
+		}
+		snd_pcm_buffer_free(rate->src_buf);
+		rate->src_buf = snd_pcm_buffer_alloc(pcm, channels * rate->info.in.period_size * 2);
+		snd_pcm_buffer_free(rate->dst_buf);
+		rate->dst_buf = snd_pcm_buffer_alloc(pcm, channels * rate->info.out.period_size * 2);
 		if (! rate->src_buf || ! rate->dst_buf)
 			goto error;
 	}
 
+	if (rate->info.in.format != rate->in_format ||
+	    (rate->format_flags & SND_PCM_RATE_FLAG_INTERLEAVED)) {
+		rate->in_areas = snd_pcm_rate_alloc_stage(pcm, channels,
+							  rate->info.in.format,
+							  rate->info.in.period_size);
+		if (!rate->in_areas)
+			goto error;
+		rate->in_kernel = snd_pcm_simd_linear_kernel(rate->in_format,
+							     rate->info.in.format);
+		rate->in_conv_idx = snd_pcm_linear_convert_index(rate->in_format,
+								 rate->info.in.format);
+	}
+	if (rate->info.out.format != rate->out_format ||
+	    (rate->format_flags & SND_PCM_RATE_FLAG_INTERLEAVED)) {
+		rate->out_areas = snd_pcm_rate_alloc_stage(pcm, channels,
+							   rate->info.out.format,
+							   rate->info.out.period_size);
+		if (!rate->out_areas)
+			goto error;
+		rate->out_kernel = snd_pcm_simd_linear_kernel(rate->info.out.format,
+							      rate->out_format);
+		rate->out_conv_idx = snd_pcm_linear_convert_index(rate->info.out.format,
+								  rate->out_format);
+	}
+
 	return 0;
 
  error:
+	snd_pcm_rate_free_stage(rate);
 	if (rate->pareas) {
-		free(rate->pareas[0].addr);
+		snd_pcm_buffer_free(rate->pareas[0].addr);
 		free(rate->pareas);
 		rate->pareas = NULL;
 	}
@@ -336,15 +514,16 @@ static int snd_pcm_rate_hw_free(snd_pcm_t *pcm)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 	if (rate->pareas) {
-		free(rate->pareas[0].addr);
+		snd_pcm_buffer_free(rate->pareas[0].addr);
 		free(rate->pareas);
 		rate->pareas = NULL;
 		rate->sareas = NULL;
 	}
+	snd_pcm_rate_free_stage(rate);
 	if (rate->ops.free)
 		rate->ops.free(rate->obj);
-	free(rate->src_buf);
-	free(rate->dst_buf);
+	snd_pcm_buffer_free(rate->src_buf);
+	snd_pcm_buffer_free(rate->dst_buf);
 	rate->src_buf = rate->dst_buf = NULL;
 	return snd_pcm_hw_free(rate->gen.slave);
 }
@@ -448,6 +627,21 @@ static void convert_to_s16(snd_pcm_rate_t *rate, int16_t *buf,
 		src_step[c] = snd_pcm_channel_area_step(areas + c);
 	}
 
+	if (rate->info.in.format == SND_PCM_FORMAT_FLOAT) {
+		while (frames--) {
+			for (c = 0; c < channels; c++) {
+				float val = rint(*(const float *)srcs[c] * 32768.0);
+				if (val > 32767)
+					val = 32767;
+				else if (val < -32768)
+					val = -32768;
+				*buf++ = val;
+				srcs[c] += src_step[c];
+			}
+		}
+		return;
+	}
+
 	while (frames--) {
 		for (c = 0; c < channels; c++) {
 			src = srcs[c];
@@ -486,6 +680,16 @@ static void convert_from_s16(snd_pcm_rate_t *rate, const int16_t *buf,
 		dst_step[c] = snd_pcm_channel_area_step(areas + c);
 	}
 
+	if (rate->info.out.format == SND_PCM_FORMAT_FLOAT) {
+		while (frames--) {
+			for (c = 0; c < channels; c++) {
+				*(float *)dsts[c] = *buf++ * (1.0 / 32768.0);
+				dsts[c] += dst_step[c];
+			}
+		}
+		return;
+	}
+
 	while (frames--) {
 		for (c = 0; c < channels; c++) {
 			dst = dsts[c];
@@ -502,6 +706,44 @@ static void convert_from_s16(snd_pcm_rate_t *rate, const int16_t *buf,
 	}
 }
 
+/* convert between a stream format and the converter format of a side */
+static void stage_convert(snd_pcm_simd_convert_t kernel, unsigned int conv_idx,
+			  const snd_pcm_channel_area_t *dst_areas,
+			  snd_pcm_uframes_t dst_offset, snd_pcm_format_t dst_format,
+			  const snd_pcm_channel_area_t *src_areas,
+			  snd_pcm_uframes_t src_offset, snd_pcm_format_t src_format,
+			  unsigned int channels, snd_pcm_uframes_t frames)
+{
+	if (dst_format == src_format)
+		snd_pcm_areas_copy(dst_areas, dst_offset, src_areas, src_offset,
+				   channels, frames, src_format);
+	else if (kernel)
+		snd_pcm_simd_convert_areas(kernel, dst_areas, dst_offset,
+					   snd_pcm_format_physical_width(dst_format),
+					   src_areas, src_offset,
+					   snd_pcm_format_physical_width(src_format),
+					   channels, frames);
+	else
+		snd_pcm_linear_convert(dst_areas, dst_offset, src_areas, src_offset,
+				       channels, frames, conv_idx);
+}
+
+/*
+ * Does a side go through its staging buffer: when the converter works in
+ * another format or wants interleaved areas and these are not.
+ */
+static int stage_needed(snd_pcm_rate_t *rate,
+			const snd_pcm_channel_area_t *areas,
+			snd_pcm_format_t format, snd_pcm_format_t conv_format)
+{
+	if (format != conv_format)
+		return 1;
+	if (!(rate->format_flags & SND_PCM_RATE_FLAG_INTERLEAVED))
+		return 0;
+	return !snd_pcm_simd_areas_packed(areas, rate->info.channels,
+					  snd_pcm_format_physical_width(format));
+}
+
 static void do_convert(const snd_pcm_channel_area_t *dst_areas,
 		       snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
 		       const snd_pcm_channel_area_t *src_areas,
@@ -528,8 +770,33 @@ static void do_convert(const snd_pcm_channel_area_t *dst_areas,
 			convert_from_s16(rate, rate->dst_buf, dst_areas, dst_offset,
 					 dst_frames, channels);
 	} else {
-		rate->ops.convert(rate->obj, dst_areas, dst_offset, dst_frames,
-				   src_areas, src_offset, src_frames);
+		const snd_pcm_channel_area_t *in = src_areas, *out = dst_areas;
+		snd_pcm_uframes_t in_offset = src_offset, out_offset = dst_offset;
+		int in_stage = rate->in_areas &&
+			stage_needed(rate, src_areas, rate->in_format,
+				     rate->info.in.format);
+		int out_stage = rate->out_areas &&
+			stage_needed(rate, dst_areas, rate->out_format,
+				     rate->info.out.format);
+		if (in_stage) {
+			stage_convert(rate->in_kernel, rate->in_conv_idx,
+				      rate->in_areas, 0, rate->info.in.format,
+				      src_areas, src_offset, rate->in_format,
+				      channels, src_frames);
+			in = rate->in_areas;
+			in_offset = 0;
+		}
+		if (out_stage) {
+			out = rate->out_areas;
+			out_offset = 0;
+		}
+		rate->ops.convert(rate->obj, out, out_offset, dst_frames,
+				   in, in_offset, src_frames);
+		if (out_stage)
+			stage_convert(rate->out_kernel, rate->out_conv_idx,
+				      dst_areas, dst_offset, rate->out_format,
+				      rate->out_areas, 0, rate->info.out.format,
+				      channels, dst_frames);
 	}
 }
 
@@ -1171,6 +1438,11 @@ static void snd_pcm_rate_dump(snd_pcm_t *pcm, snd_output_t *out)
 	if (rate->ops.dump)
 		rate->ops.dump(rate->obj, out);
 	snd_output_printf(out, "Protocol version: %x\n", rate->plugin_version);
+	if (rate->info.in.format != rate->in_format ||
+	    rate->info.out.format != rate->out_format)
+		snd_output_printf(out, "Converter formats: %s -> %s\n",
+				  snd_pcm_format_name(rate->info.in.format),
+				  snd_pcm_format_name(rate->info.out.format));
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -1252,9 +1524,18 @@ const snd_config_t *snd_pcm_rate_get_default_converter(snd_config_t *root)
 }
 
 #ifdef PIC
+static const char *const builtin_rate_plugins[] = {
+	"linear", "sinc_fast", "sinc", "sinc_best", NULL
+};
+
 static int is_builtin_plugin(const char *type)
 {
-	return strcmp(type, "linear") == 0;
+	const char *const *types;
+
+	for (types = builtin_rate_plugins; *types; types++)
+		if (strcmp(type, *types) == 0)
+			return 1;
+	return 0;
 }
 
 static const char *const default_rate_plugins[] = {
@@ -1381,7 +1662,8 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 
 	assert(pcmp && slave);
 	if (sformat != SND_PCM_FORMAT_UNKNOWN &&
-	    snd_pcm_format_linear(sformat) != 1)
+	    snd_pcm_format_linear(sformat) != 1 &&
+	    sformat != SND_PCM_FORMAT_FLOAT)
 		return -EINVAL;
 	rate = calloc(1, sizeof(snd_pcm_rate_t));
 	if (!rate) {
@@ -1461,6 +1743,7 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 		free(rate);
 		return err;
 	}
+	rate->plugin_version = rate->ops.version;
 #endif
 
 	if (! rate->ops.init || ! (rate->ops.convert || rate->ops.convert_s16) ||
@@ -1470,6 +1753,24 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 		free(rate);
 		return err;
 	}
+	if (rate->plugin_version >= 0x010003 && rate->ops.get_supported_formats)
+		rate->ops.get_supported_formats(rate->obj, &rate->in_formats,
+						&rate->out_formats,
+						&rate->format_flags);
+	/* S16 converters get float converted, the others have to take it */
+	rate->float_ok = rate->ops.convert_s16 ||
+		(rate->in_formats & rate->out_formats &
+		 (1ULL << SND_PCM_FORMAT_FLOAT));
+	if (sformat == SND_PCM_FORMAT_FLOAT && !rate->float_ok) {
+		SNDERR("Rate converter %s does not support FLOAT", type);
+		if (rate->ops.close)
+			rate->ops.close(rate->obj);
+		if (rate->open_func)
+			snd_dlobj_cache_put(rate->open_func);
+		snd_pcm_free(pcm);
+		free(rate);
+		return -EINVAL;
+	}
 
 	pcm->ops = &snd_pcm_rate_ops;
 	pcm->fast_ops = &snd_pcm_rate_fast_ops;
@@ -1489,7 +1790,25 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 
 \section pcm_plugins_rate Plugin: Rate
 
-This plugin converts a stream rate. The input and output formats must be linear.
+This plugin converts a stream rate. The input and output formats must be linear,
+or both the native FLOAT format.  Converters tell the formats they work
+in; a stream in another format is converted to S32 when it is wider than
+16 bits and the converter takes S32, to S16 otherwise.  Converters
+flagged SND_PCM_RATE_FLAG_INTERLEAVED get non-interleaved streams copied
+to interleaved buffers.  The built-in
+converters resample S32 and float samples directly; converters working
+on S16 get them converted.
+
+Besides the linear interpolation, a polyphase windowed-sinc converter is
+built in, in three qualities: sinc_fast, sinc and sinc_best (32, 64 and
+128 taps, more when the rate goes down).  The filter bank is computed at
+hw_params for the ratio of the period sizes; it has a filter for every
+phase of the common ratios like 44.1k to 48k or 48k to 96k.  The sinc
+converters are used only when asked for, e.g. with
+defaults.pcm.rate_converter "sinc"; they cost more CPU time than the
+linear one and delay the stream by half of their taps, which is not
+reported by snd_pcm_delay().  When no converter is given, speexrate is
+preferred if installed, then linear.
 
 \code
 pcm.name {
@@ -1579,7 +1898,8 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 	if (err < 0)
 		return err;
 	if (sformat != SND_PCM_FORMAT_UNKNOWN &&
-	    snd_pcm_format_linear(sformat) != 1) {
+	    snd_pcm_format_linear(sformat) != 1 &&
+	    sformat != SND_PCM_FORMAT_FLOAT) {
 	    	snd_config_delete(sconf);
 		SNDERR("slave format is not linear");
 		return -EINVAL;
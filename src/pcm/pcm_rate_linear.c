@@ -25,6 +25,7 @@
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 #include "pcm_rate.h"
+#include "pcm_simd.h"
 
 #include "plugin_ops.h"
 
@@ -33,6 +34,9 @@
 #define LINEAR_DIV_SHIFT 19
 #define LINEAR_DIV (1<<LINEAR_DIV_SHIFT)
 
+/* fewer channels are faster one by one */
+#define LINEAR_FRAME_CHANNELS 4
+
 struct rate_linear {
 	unsigned int get_idx;
 	unsigned int put_idx;
@@ -40,6 +44,12 @@ struct rate_linear {
 	unsigned int pitch_shift;	/* for expand interpolation */
 	unsigned int channels;
 	int16_t *old_sample;
+	int32_t *old_s32;		/* S32 format */
+	float *old_float;		/* FLOAT format */
+	int expand;
+	snd_pcm_format_t format;	/* of both sides for the frame path */
+	snd_pcm_simd_lerp_step_t *steps;	/* of the frame path */
+	unsigned int steps_size;
 	void (*func)(struct rate_linear *rate,
 		     const snd_pcm_channel_area_t *dst_areas,
 		     snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
@@ -308,6 +318,329 @@ static void linear_shrink_s16(struct rate_linear *rate,
 	}
 }
 
+/* native float version, no conversion from and to S16 */
+static void linear_expand_s32(struct rate_linear *rate,
+			      const snd_pcm_channel_area_t *dst_areas,
+			      snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			      const snd_pcm_channel_area_t *src_areas,
+			      snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	unsigned int channel;
+	unsigned int src_frames1;
+	unsigned int dst_frames1;
+	unsigned int get_threshold = rate->pitch;
+	unsigned int pos;
+
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const int32_t *src;
+		int32_t *dst;
+		int src_step, dst_step;
+		int32_t old_sample = 0;
+		int32_t new_sample;
+		int old_weight, new_weight;
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area) >> 2;
+		dst_step = snd_pcm_channel_area_step(dst_area) >> 2;
+		src_frames1 = 0;
+		dst_frames1 = 0;
+		new_sample = rate->old_s32[channel];
+		pos = get_threshold;
+		while (dst_frames1 < dst_frames) {
+			if (pos >= get_threshold) {
+				pos -= get_threshold;
+				old_sample = new_sample;
+				if (src_frames1 < src_frames)
+					new_sample = *src;
+			}
+			new_weight = (pos << (16 - rate->pitch_shift)) / (get_threshold >> rate->pitch_shift);
+			old_weight = 0x10000 - new_weight;
+			*dst = ((int64_t)old_sample * old_weight +
+				(int64_t)new_sample * new_weight) >> 16;
+			dst += dst_step;
+			dst_frames1++;
+			pos += LINEAR_DIV;
+			if (pos >= get_threshold) {
+				src += src_step;
+				src_frames1++;
+			}
+		}
+		rate->old_s32[channel] = new_sample;
+	}
+}
+
+static void linear_shrink_s32(struct rate_linear *rate,
+			      const snd_pcm_channel_area_t *dst_areas,
+			      snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			      const snd_pcm_channel_area_t *src_areas,
+			      snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	unsigned int get_increment = rate->pitch;
+	unsigned int channel;
+	unsigned int src_frames1;
+	unsigned int dst_frames1;
+	unsigned int pos = 0;
+
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const int32_t *src;
+		int32_t *dst;
+		int src_step, dst_step;
+		int32_t old_sample = 0;
+		int32_t new_sample = 0;
+		int old_weight, new_weight;
+		pos = LINEAR_DIV - get_increment; /* Force first sample to be copied */
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area) >> 2;
+		dst_step = snd_pcm_channel_area_step(dst_area) >> 2;
+		src_frames1 = 0;
+		dst_frames1 = 0;
+		while (src_frames1 < src_frames) {
+			new_sample = *src;
+			src += src_step;
+			src_frames1++;
+			pos += get_increment;
+			if (pos >= LINEAR_DIV) {
+				pos -= LINEAR_DIV;
+				old_weight = (pos << (32 - LINEAR_DIV_SHIFT)) / (get_increment >> (LINEAR_DIV_SHIFT - 16));
+				new_weight = 0x10000 - old_weight;
+				*dst = ((int64_t)old_sample * old_weight +
+					(int64_t)new_sample * new_weight) >> 16;
+				dst += dst_step;
+				dst_frames1++;
+				if (CHECK_SANITY(dst_frames1 > dst_frames)) {
+					SNDERR("dst_frames overflow");
+					break;
+				}
+			}
+			old_sample = new_sample;
+		}
+	}
+}
+
+static void linear_expand_float(struct rate_linear *rate,
+				const snd_pcm_channel_area_t *dst_areas,
+				snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+				const snd_pcm_channel_area_t *src_areas,
+				snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	unsigned int channel;
+	unsigned int src_frames1;
+	unsigned int dst_frames1;
+	unsigned int get_threshold = rate->pitch;
+	float scale = 1.0 / get_threshold;
+	unsigned int pos;
+
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const float *src;
+		float *dst;
+		int src_step, dst_step;
+		float old_sample = 0.0;
+		float new_sample;
+		float new_weight;
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area) / sizeof(float);
+		dst_step = snd_pcm_channel_area_step(dst_area) / sizeof(float);
+		src_frames1 = 0;
+		dst_frames1 = 0;
+		new_sample = rate->old_float[channel];
+		pos = get_threshold;
+		while (dst_frames1 < dst_frames) {
+			if (pos >= get_threshold) {
+				pos -= get_threshold;
+				old_sample = new_sample;
+				if (src_frames1 < src_frames)
+					new_sample = *src;
+			}
+			new_weight = pos * scale;
+			*dst = old_sample + (new_sample - old_sample) * new_weight;
+			dst += dst_step;
+			dst_frames1++;
+			pos += LINEAR_DIV;
+			if (pos >= get_threshold) {
+				src += src_step;
+				src_frames1++;
+			}
+		}
+		rate->old_float[channel] = new_sample;
+	}
+}
+
+/* native float version, no conversion from and to S16 */
+static void linear_shrink_float(struct rate_linear *rate,
+				const snd_pcm_channel_area_t *dst_areas,
+				snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+				const snd_pcm_channel_area_t *src_areas,
+				snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	unsigned int get_increment = rate->pitch;
+	float scale = 1.0 / get_increment;
+	unsigned int channel;
+	unsigned int src_frames1;
+	unsigned int dst_frames1;
+	unsigned int pos = 0;
+
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const float *src;
+		float *dst;
+		int src_step, dst_step;
+		float old_sample = 0.0;
+		float new_sample = 0.0;
+		float old_weight;
+		pos = LINEAR_DIV - get_increment; /* Force first sample to be copied */
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area) / sizeof(float);
+		dst_step = snd_pcm_channel_area_step(dst_area) / sizeof(float);
+		src_frames1 = 0;
+		dst_frames1 = 0;
+		while (src_frames1 < src_frames) {
+			new_sample = *src;
+			src += src_step;
+			src_frames1++;
+			pos += get_increment;
+			if (pos >= LINEAR_DIV) {
+				pos -= LINEAR_DIV;
+				old_weight = pos * scale;
+				*dst = new_sample + (old_sample - new_sample) * old_weight;
+				dst += dst_step;
+				dst_frames1++;
+				if (CHECK_SANITY(dst_frames1 > dst_frames)) {
+					SNDERR("dst_frames overflow");
+					break;
+				}
+			}
+			old_sample = new_sample;
+		}
+	}
+}
+
+/*
+ * With both sides interleaved, the weights are worked out once per frame
+ * and the SIMD kernels blend all channels of a frame at once.  The steps
+ * take the positions and the weights of the per channel versions above,
+ * so that the output does not depend on the path.
+ */
+static unsigned int linear_expand_steps(struct rate_linear *rate,
+					unsigned int dst_frames,
+					unsigned int src_frames, int *last)
+{
+	snd_pcm_simd_lerp_step_t *steps = rate->steps;
+	unsigned int get_threshold = rate->pitch;
+	float scale = 1.0 / get_threshold;
+	unsigned int src_frames1 = 0;
+	unsigned int dst_frames1;
+	unsigned int pos = get_threshold;
+	int old = -1, new = -1;
+
+	for (dst_frames1 = 0; dst_frames1 < dst_frames; dst_frames1++) {
+		if (pos >= get_threshold) {
+			pos -= get_threshold;
+			old = new;
+			if (src_frames1 < src_frames)
+				new = src_frames1;
+		}
+		steps[dst_frames1].a = old;
+		steps[dst_frames1].b = new;
+		if (rate->format == SND_PCM_FORMAT_FLOAT)
+			steps[dst_frames1].frac = pos * scale;
+		else
+			steps[dst_frames1].weight =
+				(pos << (16 - rate->pitch_shift)) /
+				(get_threshold >> rate->pitch_shift);
+		pos += LINEAR_DIV;
+		if (pos >= get_threshold)
+			src_frames1++;
+	}
+	*last = new;
+	return dst_frames1;
+}
+
+static unsigned int linear_shrink_steps(struct rate_linear *rate,
+					unsigned int dst_frames,
+					unsigned int src_frames)
+{
+	snd_pcm_simd_lerp_step_t *steps = rate->steps;
+	unsigned int get_increment = rate->pitch;
+	float scale = 1.0 / get_increment;
+	unsigned int src_frames1;
+	unsigned int dst_frames1 = 0;
+	unsigned int pos = LINEAR_DIV - get_increment; /* Force first sample to be copied */
+
+	for (src_frames1 = 0; src_frames1 < src_frames; src_frames1++) {
+		pos += get_increment;
+		if (pos < LINEAR_DIV)
+			continue;
+		pos -= LINEAR_DIV;
+		if (CHECK_SANITY(dst_frames1 >= dst_frames)) {
+			SNDERR("dst_frames overflow");
+			break;
+		}
+		/* the new sample, blended with the old one by its weight */
+		steps[dst_frames1].a = src_frames1;
+		steps[dst_frames1].b = src_frames1 ? src_frames1 - 1 : 0;
+		if (rate->format == SND_PCM_FORMAT_FLOAT)
+			steps[dst_frames1].frac = pos * scale;
+		else
+			steps[dst_frames1].weight =
+				(pos << (32 - LINEAR_DIV_SHIFT)) /
+				(get_increment >> (LINEAR_DIV_SHIFT - 16));
+		dst_frames1++;
+	}
+	return dst_frames1;
+}
+
+static void linear_frames(struct rate_linear *rate,
+			  const snd_pcm_channel_area_t *dst_areas,
+			  snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			  const snd_pcm_channel_area_t *src_areas,
+			  snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	unsigned int channels = rate->channels;
+	void *dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+	const void *src = snd_pcm_channel_area_addr(src_areas, src_offset);
+	unsigned int frames;
+	int last = -1;
+
+	if (rate->expand)
+		frames = linear_expand_steps(rate, dst_frames, src_frames, &last);
+	else
+		frames = linear_shrink_steps(rate, dst_frames, src_frames);
+
+	switch (rate->format) {
+	case SND_PCM_FORMAT_S16:
+		snd_pcm_simd_lerp_s16(dst, src, rate->old_sample, rate->steps,
+				      frames, channels);
+		if (last >= 0)
+			memcpy(rate->old_sample, (const int16_t *)src + last * channels,
+			       channels * sizeof(*rate->old_sample));
+		break;
+	case SND_PCM_FORMAT_S32:
+		snd_pcm_simd_lerp_s32(dst, src, rate->old_s32, rate->steps,
+				      frames, channels);
+		if (last >= 0)
+			memcpy(rate->old_s32, (const int32_t *)src + last * channels,
+			       channels * sizeof(*rate->old_s32));
+		break;
+	default:
+		snd_pcm_simd_lerp_float(dst, src, rate->old_float, rate->steps,
+					frames, channels);
+		if (last >= 0)
+			memcpy(rate->old_float, (const float *)src + last * channels,
+			       channels * sizeof(*rate->old_float));
+		break;
+	}
+}
+
 static void linear_convert(void *obj, 
 			   const snd_pcm_channel_area_t *dst_areas,
 			   snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
@@ -315,6 +648,18 @@ static void linear_convert(void *obj,
 			   snd_pcm_uframes_t src_offset, unsigned int src_frames)
 {
 	struct rate_linear *rate = obj;
+	unsigned int width;
+
+	if (rate->steps && dst_frames <= rate->steps_size &&
+	    rate->channels >= LINEAR_FRAME_CHANNELS) {
+		width = snd_pcm_format_physical_width(rate->format);
+		if (snd_pcm_simd_areas_packed(dst_areas, rate->channels, width) &&
+		    snd_pcm_simd_areas_packed(src_areas, rate->channels, width)) {
+			linear_frames(rate, dst_areas, dst_offset, dst_frames,
+				      src_areas, src_offset, src_frames);
+			return;
+		}
+	}
 	rate->func(rate, dst_areas, dst_offset, dst_frames,
 		   src_areas, src_offset, src_frames);
 }
@@ -325,22 +670,42 @@ static void linear_free(void *obj)
 
 	free(rate->old_sample);
 	rate->old_sample = NULL;
+	free(rate->old_s32);
+	rate->old_s32 = NULL;
+	free(rate->old_float);
+	rate->old_float = NULL;
+	free(rate->steps);
+	rate->steps = NULL;
 }
 
 static int linear_init(void *obj, snd_pcm_rate_info_t *info)
 {
 	struct rate_linear *rate = obj;
+	int is_float = info->in.format == SND_PCM_FORMAT_FLOAT;
+	int is_s32 = info->in.format == SND_PCM_FORMAT_S32 &&
+		     info->out.format == SND_PCM_FORMAT_S32;
 
+	if (is_float != (info->out.format == SND_PCM_FORMAT_FLOAT))
+		return -EINVAL;
 	rate->get_idx = snd_pcm_linear_get_index(info->in.format, SND_PCM_FORMAT_S16);
 	rate->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S16, info->out.format);
-	if (info->in.rate < info->out.rate) {
-		if (info->in.format == info->out.format && info->in.format == SND_PCM_FORMAT_S16)
+	rate->expand = info->in.rate < info->out.rate;
+	if (rate->expand) {
+		if (is_float)
+			rate->func = linear_expand_float;
+		else if (is_s32)
+			rate->func = linear_expand_s32;
+		else if (info->in.format == info->out.format && info->in.format == SND_PCM_FORMAT_S16)
 			rate->func = linear_expand_s16;
 		else
 			rate->func = linear_expand;
 		/* pitch is get_threshold */
 	} else {
-		if (info->in.format == info->out.format && info->in.format == SND_PCM_FORMAT_S16)
+		if (is_float)
+			rate->func = linear_shrink_float;
+		else if (is_s32)
+			rate->func = linear_shrink_s32;
+		else if (info->in.format == info->out.format && info->in.format == SND_PCM_FORMAT_S16)
 			rate->func = linear_shrink_s16;
 		else
 			rate->func = linear_shrink;
@@ -354,6 +719,34 @@ static int linear_init(void *obj, snd_pcm_rate_info_t *info)
 	rate->old_sample = malloc(sizeof(*rate->old_sample) * rate->channels);
 	if (! rate->old_sample)
 		return -ENOMEM;
+	free(rate->old_s32);
+	rate->old_s32 = NULL;
+	if (is_s32) {
+		rate->old_s32 = calloc(rate->channels, sizeof(*rate->old_s32));
+		if (! rate->old_s32)
+			return -ENOMEM;
+	}
+	free(rate->old_float);
+	rate->old_float = NULL;
+	if (is_float) {
+		rate->old_float = calloc(rate->channels, sizeof(*rate->old_float));
+		if (! rate->old_float)
+			return -ENOMEM;
+	}
+
+	/* the frame path, for S16, S32 and FLOAT on both sides */
+	free(rate->steps);
+	rate->steps = NULL;
+	rate->steps_size = 0;
+	rate->format = SND_PCM_FORMAT_UNKNOWN;
+	if (info->in.format == info->out.format &&
+	    (is_float || is_s32 || info->in.format == SND_PCM_FORMAT_S16)) {
+		rate->format = info->in.format;
+		rate->steps = malloc(info->out.period_size * sizeof(*rate->steps));
+		if (! rate->steps)
+			return -ENOMEM;
+		rate->steps_size = info->out.period_size;
+	}
 
 	return 0;
 }
@@ -398,6 +791,10 @@ static void linear_reset(void *obj)
 	/* for expand */
 	if (rate->old_sample)
 		memset(rate->old_sample, 0, sizeof(*rate->old_sample) * rate->channels);
+	if (rate->old_s32)
+		memset(rate->old_s32, 0, sizeof(*rate->old_s32) * rate->channels);
+	if (rate->old_float)
+		memset(rate->old_float, 0, sizeof(*rate->old_float) * rate->channels);
 }
 
 static void linear_close(void *obj)
@@ -413,6 +810,18 @@ static int get_supported_rates(ATTRIBUTE_UNUSED void *rate,
 	return 0;
 }
 
+static int linear_get_supported_formats(ATTRIBUTE_UNUSED void *rate,
+					uint64_t *in_formats,
+					uint64_t *out_formats,
+					unsigned int *flags)
+{
+	*in_formats = *out_formats = (1ULL << SND_PCM_FORMAT_S16) |
+				     (1ULL << SND_PCM_FORMAT_S32) |
+				     (1ULL << SND_PCM_FORMAT_FLOAT);
+	*flags = SND_PCM_RATE_FLAG_SYNC_FORMATS;
+	return 0;
+}
+
 static void linear_dump(ATTRIBUTE_UNUSED void *rate, snd_output_t *out)
 {
 	snd_output_printf(out, "Converter: linear-interpolation\n");
@@ -430,6 +839,7 @@ static const snd_pcm_rate_ops_t linear_ops = {
 	.version = SND_PCM_RATE_PLUGIN_VERSION,
 	.get_supported_rates = get_supported_rates,
 	.dump = linear_dump,
+	.get_supported_formats = linear_get_supported_formats,
 };
 
 int SND_PCM_RATE_PLUGIN_ENTRY(linear) (ATTRIBUTE_UNUSED unsigned int version,
@@ -0,0 +1,478 @@
+/*
+ *  Polyphase windowed-sinc rate converter plugin
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include "bswap.h"
+#include "pcm_local.h"
+#include "pcm_plugin.h"
+#include "pcm_rate.h"
+#include "pcm_simd.h"
+
+#include "plugin_ops.h"
+
+/*
+ * Output sample m of a period is taken at input time m * in / out, where
+ * in and out are the period sizes; reduced, out is the number of distinct
+ * phases.  Up to SINC_MAX_PHASES the bank holds a filter for each of them
+ * (160 for 44.1k -> 48k, 2 for 48k -> 96k), otherwise it samples the
+ * phases more coarsely and the two filters around each one are blended.
+ *
+ * The filters are Kaiser windowed sincs, longer and with a lower cutoff
+ * when the rate goes down, normalized to unity gain at DC.  The output is
+ * delayed by half the filter length so that each period only needs the
+ * samples seen so far.
+ *
+ * The samples are filtered as floats: float streams at their own scale,
+ * integer ones at their S32 value.
+ */
+
+#define SINC_MAX_PHASES	512
+#define SINC_MAX_TAPS	1024
+
+struct sinc_quality {
+	const char *name;
+	unsigned int taps;	/* filter length without downsampling */
+	unsigned int phases;	/* bank size when the phases are blended */
+	double cutoff;		/* relative to the lower Nyquist frequency */
+	double beta;		/* Kaiser window parameter */
+};
+
+enum { SINC_FAST, SINC_MEDIUM, SINC_BEST };
+
+static const struct sinc_quality sinc_qualities[] = {
+	[SINC_FAST] = { "fast", 32, 64, 0.88, 6.0 },
+	[SINC_MEDIUM] = { "medium", 64, 128, 0.91, 8.6 },
+	[SINC_BEST] = { "best", 128, 256, 0.945, 11.0 },
+};
+
+struct rate_sinc {
+	const struct sinc_quality *quality;
+	unsigned int channels;
+	unsigned int in_frames;		/* period sizes */
+	unsigned int out_frames;
+	unsigned int taps;
+	unsigned int phases;
+	int exact;			/* a filter for every phase */
+	snd_pcm_format_t in_format;
+	snd_pcm_format_t out_format;
+	snd_pcm_simd_convert_t get;	/* to S32, NULL for the get32 code */
+	snd_pcm_simd_convert_t put;	/* from S32, NULL for the put32 code */
+	unsigned int get_idx;
+	unsigned int put_idx;
+	float *bank;			/* phases + 1 filters */
+	float *hist;			/* per channel: taps - 1 old samples, then a period */
+	unsigned int hist_stride;
+	float *out;
+	int32_t *s32;
+	snd_pcm_simd_fir_step_t *steps;
+	unsigned int steps_src;		/* frames the steps were computed for */
+	unsigned int steps_dst;
+	int interp;
+};
+
+static snd_pcm_uframes_t input_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_sinc *rate = obj;
+	if (frames == 0 || rate->out_frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->in_frames, rate->out_frames);
+}
+
+static snd_pcm_uframes_t output_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_sinc *rate = obj;
+	if (frames == 0 || rate->in_frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->out_frames, rate->in_frames);
+}
+
+static unsigned int sinc_gcd(unsigned int a, unsigned int b)
+{
+	while (b) {
+		unsigned int r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+/* modified Bessel function of the first kind, order 0 */
+static double sinc_bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	unsigned int k;
+
+	for (k = 1; term > sum * 1e-12; k++) {
+		term *= (x * x) / (4.0 * k * k);
+		sum += term;
+	}
+	return sum;
+}
+
+/* filter p of the bank is for the input time phase p / phases */
+static void sinc_make_bank(float *bank, unsigned int phases, unsigned int taps,
+			   double cutoff, double beta)
+{
+	double half = taps / 2.0;
+	double i0_beta = sinc_bessel_i0(beta);
+	unsigned int p, k;
+
+	for (p = 0; p <= phases; p++) {
+		float *h = bank + p * taps;
+		double v[taps];
+		double sum = 0;
+
+		for (k = 0; k < taps; k++) {
+			double d = (double)p / phases + half - 1 - k;
+			double x = d / half;
+			double s;
+
+			if (fabs(x) > 1.0) {
+				v[k] = 0;
+				continue;
+			}
+			s = d == 0 ? cutoff : sin(M_PI * cutoff * d) / (M_PI * d);
+			v[k] = s * sinc_bessel_i0(beta * sqrt(1.0 - x * x)) / i0_beta;
+			sum += v[k];
+		}
+		for (k = 0; k < taps; k++)
+			h[k] = v[k] / sum;
+	}
+}
+
+/* where each output sample of a src_frames -> dst_frames call is taken */
+static void sinc_steps(struct rate_sinc *rate, unsigned int src_frames,
+		       unsigned int dst_frames)
+{
+	unsigned int i;
+
+	if (src_frames == rate->steps_src && dst_frames == rate->steps_dst)
+		return;
+	rate->interp = 0;
+	for (i = 0; i < dst_frames; i++) {
+		uint64_t pos = (uint64_t)i * src_frames;
+		uint64_t sub = (pos % dst_frames) * rate->phases;
+		unsigned int r = sub % dst_frames;
+
+		rate->steps[i].src = pos / dst_frames;
+		rate->steps[i].coef = (sub / dst_frames) * rate->taps;
+		rate->steps[i].frac = (float)r / dst_frames;
+		if (r)
+			rate->interp = 1;
+	}
+	rate->steps_src = src_frames;
+	rate->steps_dst = dst_frames;
+}
+
+static void sinc_get32(struct rate_sinc *rate, const char *src, int src_step,
+		       unsigned int frames)
+{
+#define GET32_LABELS
+#include "plugin_ops.h"
+#undef GET32_LABELS
+	void *get = get32_labels[rate->get_idx];
+	int32_t *dst = rate->s32;
+	int32_t sample = 0;
+
+	while (frames--) {
+		goto *get;
+#define GET32_END after_get
+#include "plugin_ops.h"
+#undef GET32_END
+	after_get:
+		*dst++ = sample;
+		src += src_step;
+	}
+}
+
+static void sinc_put32(struct rate_sinc *rate, char *dst, int dst_step,
+		       unsigned int frames)
+{
+#define PUT32_LABELS
+#include "plugin_ops.h"
+#undef PUT32_LABELS
+	void *put = put32_labels[rate->put_idx];
+	const int32_t *src = rate->s32;
+	int32_t sample;
+
+	while (frames--) {
+		sample = *src++;
+		goto *put;
+#define PUT32_END after_put
+#include "plugin_ops.h"
+#undef PUT32_END
+	after_put:
+		dst += dst_step;
+	}
+}
+
+/* one channel of the source into the history */
+static void sinc_load(struct rate_sinc *rate, float *dst,
+		      const snd_pcm_channel_area_t *area,
+		      snd_pcm_uframes_t offset, unsigned int frames)
+{
+	const char *src = snd_pcm_channel_area_addr(area, offset);
+	int step = snd_pcm_channel_area_step(area);
+	unsigned int i;
+
+	if (rate->in_format == SND_PCM_FORMAT_FLOAT) {
+		for (i = 0; i < frames; i++, src += step)
+			dst[i] = *(const float *)src;
+		return;
+	}
+	if (rate->in_format == SND_PCM_FORMAT_S32 && step == 4) {
+		snd_pcm_simd_s32_to_float(dst, (const int32_t *)src, frames);
+		return;
+	}
+	if (rate->get)
+		rate->get((char *)rate->s32, 4, src, step, frames);
+	else
+		sinc_get32(rate, src, step, frames);
+	snd_pcm_simd_s32_to_float(dst, rate->s32, frames);
+}
+
+/* the filtered samples of one channel into the destination */
+static void sinc_store(struct rate_sinc *rate,
+		       const snd_pcm_channel_area_t *area,
+		       snd_pcm_uframes_t offset, unsigned int frames)
+{
+	char *dst = snd_pcm_channel_area_addr(area, offset);
+	int step = snd_pcm_channel_area_step(area);
+	unsigned int i;
+
+	if (rate->out_format == SND_PCM_FORMAT_FLOAT) {
+		for (i = 0; i < frames; i++, dst += step)
+			*(float *)dst = rate->out[i];
+		return;
+	}
+	if (rate->out_format == SND_PCM_FORMAT_S32 && step == 4) {
+		snd_pcm_simd_float_to_s32((int32_t *)dst, rate->out, frames);
+		return;
+	}
+	snd_pcm_simd_float_to_s32(rate->s32, rate->out, frames);
+	if (rate->put)
+		rate->put(dst, step, (const char *)rate->s32, 4, frames);
+	else
+		sinc_put32(rate, dst, step, frames);
+}
+
+static void sinc_convert(void *obj,
+			 const snd_pcm_channel_area_t *dst_areas,
+			 snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			 const snd_pcm_channel_area_t *src_areas,
+			 snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	struct rate_sinc *rate = obj;
+	unsigned int keep = rate->taps - 1;
+	unsigned int channel;
+
+	if (src_frames > rate->in_frames || dst_frames > rate->out_frames) {
+		SNDERR("period overflow %u -> %u", src_frames, dst_frames);
+		return;
+	}
+	sinc_steps(rate, src_frames, dst_frames);
+	for (channel = 0; channel < rate->channels; ++channel) {
+		float *hist = rate->hist + channel * rate->hist_stride;
+
+		sinc_load(rate, hist + keep, &src_areas[channel], src_offset,
+			  src_frames);
+		snd_pcm_simd_fir(rate->out, hist, rate->bank, rate->taps,
+				 rate->steps, dst_frames, rate->interp);
+		sinc_store(rate, &dst_areas[channel], dst_offset, dst_frames);
+		memmove(hist, hist + src_frames, keep * sizeof(*hist));
+	}
+}
+
+static void sinc_free(void *obj)
+{
+	struct rate_sinc *rate = obj;
+
+	free(rate->bank);
+	rate->bank = NULL;
+	free(rate->hist);
+	rate->hist = NULL;
+	free(rate->out);
+	rate->out = NULL;
+	free(rate->s32);
+	rate->s32 = NULL;
+	free(rate->steps);
+	rate->steps = NULL;
+	rate->steps_src = rate->steps_dst = 0;
+}
+
+static int sinc_init(void *obj, snd_pcm_rate_info_t *info)
+{
+	struct rate_sinc *rate = obj;
+	const struct sinc_quality *q = rate->quality;
+	int is_float = info->in.format == SND_PCM_FORMAT_FLOAT;
+	unsigned int in, out, g, taps, phases, s32_frames;
+	double cutoff = q->cutoff;
+	void *bank;
+
+	if (is_float != (info->out.format == SND_PCM_FORMAT_FLOAT))
+		return -EINVAL;
+	if (!info->in.period_size || !info->out.period_size)
+		return -EINVAL;
+	sinc_free(rate);
+
+	g = sinc_gcd(info->in.period_size, info->out.period_size);
+	in = info->in.period_size / g;
+	out = info->out.period_size / g;
+	taps = q->taps;
+	if (in > out) {
+		cutoff = cutoff * out / in;
+		taps = ((uint64_t)taps * in + out - 1) / out;
+		if (taps > SINC_MAX_TAPS)
+			taps = SINC_MAX_TAPS;
+	}
+	taps = (taps + 7) & ~7U;
+	phases = out <= SINC_MAX_PHASES ? out : q->phases;
+
+	rate->channels = info->channels;
+	rate->in_frames = info->in.period_size;
+	rate->out_frames = info->out.period_size;
+	rate->taps = taps;
+	rate->phases = phases;
+	rate->exact = phases == out;
+	rate->in_format = info->in.format;
+	rate->out_format = info->out.format;
+	if (!is_float) {
+		rate->get = snd_pcm_simd_linear_kernel(info->in.format, SND_PCM_FORMAT_S32);
+		rate->put = snd_pcm_simd_linear_kernel(SND_PCM_FORMAT_S32, info->out.format);
+		rate->get_idx = snd_pcm_linear_get_index(info->in.format, SND_PCM_FORMAT_S32);
+		rate->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, info->out.format);
+	}
+
+	if (posix_memalign(&bank, 64, (phases + 1) * taps * sizeof(float)))
+		return -ENOMEM;
+	rate->bank = bank;
+	sinc_make_bank(rate->bank, phases, taps, cutoff, q->beta);
+
+	rate->hist_stride = (taps - 1 + rate->in_frames + 15) & ~15U;
+	rate->hist = calloc((size_t)rate->channels * rate->hist_stride,
+			    sizeof(*rate->hist));
+	rate->out = malloc(rate->out_frames * sizeof(*rate->out));
+	s32_frames = rate->in_frames > rate->out_frames ?
+		rate->in_frames : rate->out_frames;
+	rate->s32 = malloc(s32_frames * sizeof(*rate->s32));
+	rate->steps = malloc(rate->out_frames * sizeof(*rate->steps));
+	if (!rate->hist || !rate->out || !rate->s32 || !rate->steps) {
+		sinc_free(rate);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void sinc_reset(void *obj)
+{
+	struct rate_sinc *rate = obj;
+
+	if (rate->hist)
+		memset(rate->hist, 0, (size_t)rate->channels *
+		       rate->hist_stride * sizeof(*rate->hist));
+}
+
+static void sinc_close(void *obj)
+{
+	sinc_free(obj);
+	free(obj);
+}
+
+static int get_supported_rates(ATTRIBUTE_UNUSED void *rate,
+			       unsigned int *rate_min, unsigned int *rate_max)
+{
+	*rate_min = SND_PCM_PLUGIN_RATE_MIN;
+	*rate_max = SND_PCM_PLUGIN_RATE_MAX;
+	return 0;
+}
+
+/* the filter loads and stores every linear format itself */
+static int sinc_get_supported_formats(ATTRIBUTE_UNUSED void *rate,
+				      uint64_t *in_formats,
+				      uint64_t *out_formats,
+				      unsigned int *flags)
+{
+	uint64_t formats = 1ULL << SND_PCM_FORMAT_FLOAT;
+	int format;
+
+	for (format = 0; format < 64; format++)
+		if (snd_pcm_format_linear(format) == 1)
+			formats |= 1ULL << format;
+	*in_formats = *out_formats = formats;
+	*flags = 0;
+	return 0;
+}
+
+static void sinc_dump(void *obj, snd_output_t *out)
+{
+	struct rate_sinc *rate = obj;
+
+	snd_output_printf(out, "Converter: polyphase windowed-sinc (%s)\n",
+			  rate->quality->name);
+	if (rate->bank)
+		snd_output_printf(out, "  %u taps, %u phases (%s)\n",
+				  rate->taps, rate->phases,
+				  rate->exact ? "exact" : "interpolated");
+}
+
+static const snd_pcm_rate_ops_t sinc_ops = {
+	.close = sinc_close,
+	.init = sinc_init,
+	.free = sinc_free,
+	.reset = sinc_reset,
+	.convert = sinc_convert,
+	.input_frames = input_frames,
+	.output_frames = output_frames,
+	.version = SND_PCM_RATE_PLUGIN_VERSION,
+	.get_supported_rates = get_supported_rates,
+	.dump = sinc_dump,
+	.get_supported_formats = sinc_get_supported_formats,
+};
+
+static int sinc_open(void **objp, snd_pcm_rate_ops_t *ops, int quality)
+{
+	struct rate_sinc *rate;
+
+	rate = calloc(1, sizeof(*rate));
+	if (! rate)
+		return -ENOMEM;
+	rate->quality = &sinc_qualities[quality];
+
+	*objp = rate;
+	*ops = sinc_ops;
+	return 0;
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(sinc_fast) (ATTRIBUTE_UNUSED unsigned int version,
+					  void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return sinc_open(objp, ops, SINC_FAST);
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(sinc) (ATTRIBUTE_UNUSED unsigned int version,
+				     void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return sinc_open(objp, ops, SINC_MEDIUM);
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(sinc_best) (ATTRIBUTE_UNUSED unsigned int version,
+					  void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return sinc_open(objp, ops, SINC_BEST);
+}
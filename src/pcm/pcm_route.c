@@ -30,6 +30,7 @@
 #include <math.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#include "pcm_simd.h"
 
 #include "plugin_ops.h"
 
@@ -55,6 +56,7 @@ typedef struct {
 #if SND_PCM_PLUGIN_ROUTE_FLOAT
 	float as_float;
 #endif
+	unsigned int mix_block;		/* see snd_pcm_route_convert_mix() */
 } snd_pcm_route_ttable_src_t;
 
 typedef struct snd_pcm_route_ttable_dst snd_pcm_route_ttable_dst_t;
@@ -70,8 +72,30 @@ typedef struct {
 	unsigned int nsrcs;
 	unsigned int ndsts;
 	snd_pcm_route_ttable_dst_t *dsts;
+	int fused;			/* see snd_pcm_route_convert_fused() */
+	unsigned int fused_src_bytes;
+	unsigned int fused_dst_bytes;
+	int src_float;			/* see snd_pcm_route_convert1_float() */
+	int dst_float;
+	int mix;			/* see snd_pcm_route_convert_mix() */
+	snd_pcm_simd_convert_t mix_get;	/* source format -> S32 */
+	snd_pcm_simd_convert_t mix_put;	/* S32 -> destination format */
+	snd_pcm_simd_convert_t mix_copy; /* source -> destination format */
+	unsigned int mix_src_bytes;
+	unsigned int mix_dst_bytes;
+	int mix_src_s32;		/* formats needing no get/put */
+	int mix_dst_s32;
+	unsigned int mix_nsrcs;		/* source channels read by sums */
+	unsigned int *mix_srcs;
+	float *mix_buf;			/* a block per source, then the sum */
+	int32_t *mix_s32;
+	char **mix_src_planar;		/* blocks of interleaved buffers */
+	char **mix_dst_planar;
 } snd_pcm_route_params_t;
 
+/* frames per pass of snd_pcm_route_convert_mix() */
+#define ROUTE_MIX_FRAMES	256
+
 
 typedef void (*route_f)(const snd_pcm_channel_area_t *dst_area,
 			snd_pcm_uframes_t dst_offset,
@@ -374,7 +398,8 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 #if SND_PCM_PLUGIN_ROUTE_FLOAT
 	norm_float:
 		sum.as_float = rint(sum.as_float);
-		if (sum.as_float > (int64_t)0x7fffffff)
+		/* 0x7fffffff is 2^31 as a float */
+		if (sum.as_float >= 2147483648.0)
 			sample = 0x7fffffff;	/* maximum positive value */
 		else if (sum.as_float < -(int64_t)0x80000000)
 			sample = 0x80000000;	/* maximum negative value */
@@ -395,6 +420,331 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 	}
 }
 
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+/*
+ * Conversion with a float format on either side: the samples are summed
+ * as floats in the -1.0 .. 1.0 range and clipped only when they are stored
+ * in an integer format, so float chains keep their headroom.
+ */
+static void snd_pcm_route_convert1_float(const snd_pcm_channel_area_t *dst_area,
+					 snd_pcm_uframes_t dst_offset,
+					 const snd_pcm_channel_area_t *src_areas,
+					 snd_pcm_uframes_t src_offset,
+					 unsigned int src_channels,
+					 snd_pcm_uframes_t frames,
+					 const snd_pcm_route_ttable_dst_t* ttable,
+					 const snd_pcm_route_params_t *params)
+{
+#define GET32_LABELS
+#define PUT32_LABELS
+#include "plugin_ops.h"
+#undef GET32_LABELS
+#undef PUT32_LABELS
+	void *get32 = get32_labels[params->get_idx];
+	void *put32 = put32_labels[params->put_idx];
+	int nsrcs = ttable->nsrcs;
+	char *dst;
+	int dst_step;
+	const char *srcs[nsrcs];
+	int src_steps[nsrcs];
+	float gains[nsrcs];
+	int32_t sample = 0;
+	int srcidx, srcidx1 = 0;
+
+	for (srcidx = 0; srcidx < nsrcs && (unsigned)srcidx < src_channels; ++srcidx) {
+		const snd_pcm_route_ttable_src_t *tt = &ttable->srcs[srcidx];
+		if ((unsigned int)tt->channel >= src_channels)
+			continue;
+		srcs[srcidx1] = snd_pcm_channel_area_addr(&src_areas[tt->channel], src_offset);
+		src_steps[srcidx1] = snd_pcm_channel_area_step(&src_areas[tt->channel]);
+		if (ttable->att)
+			gains[srcidx1] = tt->as_float;
+		else
+			gains[srcidx1] = tt->as_int ? 1.0 : 0.0;
+		srcidx1++;
+	}
+	nsrcs = srcidx1;
+	if (nsrcs == 0) {
+		snd_pcm_route_convert1_zero(dst_area, dst_offset,
+					    src_areas, src_offset,
+					    src_channels,
+					    frames, ttable, params);
+		return;
+	}
+
+	dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+	dst_step = snd_pcm_channel_area_step(dst_area);
+	while (frames-- > 0) {
+		float sum = 0.0;
+
+		for (srcidx = 0; srcidx < nsrcs; ++srcidx) {
+			const char *src = srcs[srcidx];
+			float val;
+
+			if (params->src_float) {
+				val = *(const float *)src;
+			} else {
+				goto *get32;
+#define GET32_END after_get
+#include "plugin_ops.h"
+#undef GET32_END
+			after_get:
+				val = sample * (1.0 / 2147483648.0);
+			}
+			sum += val * gains[srcidx];
+			srcs[srcidx] += src_steps[srcidx];
+		}
+
+		if (params->dst_float) {
+			*(float *)dst = sum;
+		} else {
+			double val = rint(sum * 2147483648.0);
+			if (val > (int64_t)0x7fffffff)
+				sample = 0x7fffffff;	/* maximum positive value */
+			else if (val < -(int64_t)0x80000000)
+				sample = 0x80000000;	/* maximum negative value */
+			else
+				sample = val;
+			goto *put32;
+#define PUT32_END after_put
+#include "plugin_ops.h"
+#undef PUT32_END
+		after_put:
+			;
+		}
+		dst += dst_step;
+	}
+}
+#endif /* SND_PCM_PLUGIN_ROUTE_FLOAT */
+
+/*
+ * Fused conversion for the common plug case, e.g. an S16 stereo client on
+ * an S32 multi-channel device: with interleaved native S16 or S32 samples on
+ * both sides, every source frame is read once and all destination samples
+ * are computed from it, instead of one pass over the source buffer per
+ * destination channel.  The arithmetic is the same as in
+ * snd_pcm_route_convert1_many().
+ */
+static void snd_pcm_route_convert_fused(const snd_pcm_channel_area_t *dst_areas,
+					snd_pcm_uframes_t dst_offset,
+					const snd_pcm_channel_area_t *src_areas,
+					snd_pcm_uframes_t src_offset,
+					unsigned int src_channels,
+					unsigned int dst_channels,
+					snd_pcm_uframes_t frames,
+					const snd_pcm_route_params_t *params)
+{
+	const char *src = snd_pcm_channel_area_addr(src_areas, src_offset);
+	char *dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+	unsigned int src_frame = src_channels * params->fused_src_bytes;
+	unsigned int dst_frame = dst_channels * params->fused_dst_bytes;
+	int32_t in[src_channels];
+	unsigned int c, d;
+
+	while (frames-- > 0) {
+		/* read the source frame once, as 32 bit samples */
+		if (params->fused_src_bytes == 2) {
+			for (c = 0; c < src_channels; c++)
+				in[c] = (int32_t)((uint32_t)((const uint16_t *)src)[c] << 16);
+		} else {
+			memcpy(in, src, src_frame);
+		}
+		for (d = 0; d < dst_channels; d++) {
+			const snd_pcm_route_ttable_dst_t *t =
+				d < params->ndsts ? &params->dsts[d] : NULL;
+			int32_t sample;
+
+			if (!t || t->nsrcs == 0) {
+				sample = 0;
+			} else if (t->nsrcs == 1 &&
+				   t->srcs[0].as_int == SND_PCM_PLUGIN_ROUTE_RESOLUTION) {
+				sample = in[t->srcs[0].channel];
+			} else {
+				unsigned int k;
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+				float sum = 0.0;
+				for (k = 0; k < t->nsrcs; k++) {
+					if (t->att)
+						sum += in[t->srcs[k].channel] * t->srcs[k].as_float;
+					else if (t->srcs[k].as_int)
+						sum += in[t->srcs[k].channel];
+				}
+				sum = rint(sum);
+				if (sum > (int64_t)0x7fffffff)
+					sample = 0x7fffffff;
+				else if (sum < -(int64_t)0x80000000)
+					sample = 0x80000000;
+				else
+					sample = sum;
+#else
+				int64_t sum = 0;
+				for (k = 0; k < t->nsrcs; k++) {
+					if (t->att)
+						sum += (int64_t)in[t->srcs[k].channel] * t->srcs[k].as_int;
+					else if (t->srcs[k].as_int)
+						sum += in[t->srcs[k].channel];
+				}
+				if (t->att)
+					div(sum);
+				if (sum > (int64_t)0x7fffffff)
+					sample = 0x7fffffff;
+				else if (sum < -(int64_t)0x80000000)
+					sample = 0x80000000;
+				else
+					sample = sum;
+#endif
+			}
+			if (params->fused_dst_bytes == 2)
+				((int16_t *)dst)[d] = sample >> 16;
+			else
+				((int32_t *)dst)[d] = sample;
+		}
+		src += src_frame;
+		dst += dst_frame;
+	}
+}
+
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+/* a single source at full volume? */
+static inline int snd_pcm_route_dst_is_copy(const snd_pcm_route_ttable_dst_t *t)
+{
+	return t->nsrcs == 1 && t->srcs[0].as_int == SND_PCM_PLUGIN_ROUTE_RESOLUTION;
+}
+
+/*
+ * Block mixing engine for integer formats.  The ttable is compiled at
+ * hw_params into the list of source channels read by sums; the samples
+ * are then processed in blocks:
+ * - an interleaved source block is transposed into one contiguous row per
+ *   channel, so that the conversion kernels run on contiguous data, and
+ *   every source read by a sum is converted to float once, whatever the
+ *   number of destinations reading it;
+ * - a silent destination is filled, a copied one (a single source at full
+ *   volume) goes through one conversion kernel, the others are
+ *   accumulated in ttable order with vector multiply-adds, plain adds for
+ *   unity gains;
+ * - an interleaved destination block is transposed back at the end.
+ * The sums are done in the same order and precision as in
+ * snd_pcm_route_convert1_many(), so are the results.
+ */
+static void snd_pcm_route_convert_mix(const snd_pcm_channel_area_t *dst_areas,
+				      snd_pcm_uframes_t dst_offset,
+				      const snd_pcm_channel_area_t *src_areas,
+				      snd_pcm_uframes_t src_offset,
+				      unsigned int src_channels,
+				      unsigned int dst_channels,
+				      snd_pcm_uframes_t frames,
+				      const snd_pcm_route_params_t *params)
+{
+	unsigned int src_bytes = params->mix_src_bytes;
+	unsigned int dst_bytes = params->mix_dst_bytes;
+	int src_packed = snd_pcm_simd_areas_packed(src_areas, src_channels,
+						   src_bytes * 8);
+	int dst_packed = snd_pcm_simd_areas_packed(dst_areas, dst_channels,
+						   dst_bytes * 8);
+	float *sum = params->mix_buf + params->mix_nsrcs * ROUTE_MIX_FRAMES;
+	const char *srcs[src_channels];
+	int src_steps[src_channels];
+	snd_pcm_uframes_t n;
+	unsigned int c, d, k;
+
+	while (frames > 0) {
+		n = frames;
+		if (n > ROUTE_MIX_FRAMES)
+			n = ROUTE_MIX_FRAMES;
+		for (c = 0; c < src_channels; c++) {
+			if (src_packed) {
+				srcs[c] = params->mix_src_planar[c];
+				src_steps[c] = src_bytes;
+			} else {
+				srcs[c] = src_areas[c].addr ?
+					snd_pcm_channel_area_addr(&src_areas[c], src_offset) : NULL;
+				src_steps[c] = snd_pcm_channel_area_step(&src_areas[c]);
+			}
+		}
+		if (src_packed)
+			snd_pcm_simd_transpose(params->mix_src_planar,
+					       snd_pcm_channel_area_addr(src_areas, src_offset),
+					       src_channels * src_bytes, src_channels,
+					       n, src_bytes, 1);
+		for (k = 0; k < params->mix_nsrcs; k++) {
+			const int32_t *s32 = params->mix_s32;
+			c = params->mix_srcs[k];
+			if (params->mix_src_s32 && src_steps[c] == sizeof(int32_t))
+				s32 = (const int32_t *)srcs[c];
+			else
+				params->mix_get((char *)params->mix_s32, sizeof(int32_t),
+						srcs[c], src_steps[c], n);
+			snd_pcm_simd_s32_to_float(params->mix_buf + k * ROUTE_MIX_FRAMES,
+						  s32, n);
+		}
+
+		for (d = 0; d < dst_channels; d++) {
+			const snd_pcm_route_ttable_dst_t *t =
+				d < params->ndsts ? &params->dsts[d] : NULL;
+			char *dst;
+			int dst_step;
+			if (dst_packed) {
+				dst = params->mix_dst_planar[d];
+				dst_step = dst_bytes;
+			} else {
+				dst = snd_pcm_channel_area_addr(&dst_areas[d], dst_offset);
+				dst_step = snd_pcm_channel_area_step(&dst_areas[d]);
+			}
+			if (!t || t->nsrcs == 0 ||
+			    (snd_pcm_route_dst_is_copy(t) && !srcs[t->srcs[0].channel])) {
+				snd_pcm_channel_area_t area = { dst, 0, dst_step * 8 };
+				snd_pcm_area_silence(&area, 0, n, params->dst_sfmt);
+			} else if (snd_pcm_route_dst_is_copy(t)) {
+				c = t->srcs[0].channel;
+				params->mix_copy(dst, dst_step, srcs[c], src_steps[c], n);
+			} else {
+				memset(sum, 0, n * sizeof(*sum));
+				for (k = 0; k < t->nsrcs; k++)
+					snd_pcm_simd_mac_float(sum, params->mix_buf +
+							       t->srcs[k].mix_block * ROUTE_MIX_FRAMES,
+							       t->att ? t->srcs[k].as_float : 1.0f,
+							       n);
+				if (params->mix_dst_s32 && dst_step == sizeof(int32_t)) {
+					snd_pcm_simd_float_to_s32((int32_t *)dst, sum, n);
+				} else {
+					snd_pcm_simd_float_to_s32(params->mix_s32, sum, n);
+					params->mix_put(dst, dst_step,
+							(const char *)params->mix_s32,
+							sizeof(int32_t), n);
+				}
+			}
+		}
+		if (dst_packed)
+			snd_pcm_simd_transpose(params->mix_dst_planar,
+					       snd_pcm_channel_area_addr(dst_areas, dst_offset),
+					       dst_channels * dst_bytes, dst_channels,
+					       n, dst_bytes, 0);
+		src_offset += n;
+		dst_offset += n;
+		frames -= n;
+	}
+}
+#endif /* SND_PCM_PLUGIN_ROUTE_FLOAT */
+
+/* are the areas one interleaved buffer of 'bytes' wide samples? */
+static int snd_pcm_route_areas_interleaved(const snd_pcm_channel_area_t *areas,
+					   unsigned int channels,
+					   unsigned int bytes)
+{
+	unsigned int c;
+
+	if (areas[0].first % 8)
+		return 0;
+	for (c = 0; c < channels; c++) {
+		if (areas[c].addr != areas[0].addr ||
+		    areas[c].first != areas[0].first + c * bytes * 8 ||
+		    areas[c].step != channels * bytes * 8)
+			return 0;
+	}
+	return 1;
+}
+
 #endif /* DOC_HIDDEN */
 
 static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
@@ -410,6 +760,27 @@ static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
 	snd_pcm_route_ttable_dst_t *dstp;
 	const snd_pcm_channel_area_t *dst_area;
 
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	/* the fused loop is better for plain copies of interleaved frames */
+	if (params->mix && (params->mix_nsrcs || !params->fused)) {
+		snd_pcm_route_convert_mix(dst_areas, dst_offset,
+					  src_areas, src_offset,
+					  src_channels, dst_channels,
+					  frames, params);
+		return;
+	}
+#endif
+	if (params->fused &&
+	    snd_pcm_route_areas_interleaved(src_areas, src_channels,
+					    params->fused_src_bytes) &&
+	    snd_pcm_route_areas_interleaved(dst_areas, dst_channels,
+					    params->fused_dst_bytes)) {
+		snd_pcm_route_convert_fused(dst_areas, dst_offset,
+					    src_areas, src_offset,
+					    src_channels, dst_channels,
+					    frames, params);
+		return;
+	}
 	dstp = params->dsts;
 	dst_area = dst_areas;
 	for (dst_channel = 0; dst_channel < dst_channels; ++dst_channel) {
@@ -418,6 +789,13 @@ static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
 						    src_areas, src_offset,
 						    src_channels,
 						    frames, dstp, params);
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+		else if (params->src_float || params->dst_float)
+			snd_pcm_route_convert1_float(dst_area, dst_offset,
+						     src_areas, src_offset,
+						     src_channels,
+						     frames, dstp, params);
+#endif
 		else
 			dstp->func(dst_area, dst_offset,
 				   src_areas, src_offset,
@@ -428,6 +806,22 @@ static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
 	}
 }
 
+static void snd_pcm_route_mix_free(snd_pcm_route_params_t *params)
+{
+	free(params->mix_srcs);
+	params->mix_srcs = NULL;
+	free(params->mix_buf);
+	params->mix_buf = NULL;
+	free(params->mix_s32);
+	params->mix_s32 = NULL;
+	free(params->mix_src_planar);
+	params->mix_src_planar = NULL;
+	free(params->mix_dst_planar);
+	params->mix_dst_planar = NULL;
+	params->mix_nsrcs = 0;
+	params->mix = 0;
+}
+
 static int snd_pcm_route_close(snd_pcm_t *pcm)
 {
 	snd_pcm_route_t *route = pcm->private_data;
@@ -440,6 +834,7 @@ static int snd_pcm_route_close(snd_pcm_t *pcm)
 		}
 		free(params->dsts);
 	}
+	snd_pcm_route_mix_free(params);
 	free(route->chmap);
 	return snd_pcm_generic_close(pcm);
 }
@@ -449,6 +844,9 @@ static int snd_pcm_route_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd
 	int err;
 	snd_pcm_access_mask_t access_mask = { SND_PCM_ACCBIT_SHM };
 	snd_pcm_format_mask_t format_mask = { SND_PCM_FMTBIT_LINEAR };
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	snd_pcm_format_mask_set(&format_mask, SND_PCM_FORMAT_FLOAT);
+#endif
 	err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_ACCESS,
 					 &access_mask);
 	if (err < 0)
@@ -543,11 +941,119 @@ static int snd_pcm_route_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 				       snd_pcm_generic_hw_refine);
 }
 
+/* does every destination channel read only its own source channel? */
+static int snd_pcm_route_is_diagonal(snd_pcm_route_t *route)
+{
+	unsigned int dst;
+
+	for (dst = 0; dst < route->params.ndsts; dst++) {
+		const snd_pcm_route_ttable_dst_t *d = &route->params.dsts[dst];
+		if (d->nsrcs > 1 ||
+		    (d->nsrcs == 1 && d->srcs[0].channel != (int)dst))
+			return 0;
+	}
+	return 1;
+}
+
+/* are all ttable sources within the source channels? */
+static int snd_pcm_route_sources_valid(snd_pcm_route_t *route,
+				       unsigned int src_channels)
+{
+	unsigned int dst, k;
+
+	for (dst = 0; dst < route->params.ndsts; dst++) {
+		const snd_pcm_route_ttable_dst_t *d = &route->params.dsts[dst];
+		for (k = 0; k < d->nsrcs; k++)
+			if ((unsigned int)d->srcs[k].channel >= src_channels)
+				return 0;
+	}
+	return 1;
+}
+
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+/* a row of ROUTE_MIX_FRAMES samples per channel, after the row pointers */
+static char **snd_pcm_route_mix_planar(unsigned int channels,
+				       unsigned int bytes)
+{
+	char **rows = malloc(channels * (sizeof(*rows) + ROUTE_MIX_FRAMES * bytes));
+	unsigned int c;
+
+	if (rows) {
+		for (c = 0; c < channels; c++)
+			rows[c] = (char *)(rows + channels) + c * ROUTE_MIX_FRAMES * bytes;
+	}
+	return rows;
+}
+
+/*
+ * Compile the ttable for snd_pcm_route_convert_mix(): number the source
+ * channels read by sums and give each ttable source its block.
+ */
+static int snd_pcm_route_mix_setup(snd_pcm_route_params_t *params,
+				   snd_pcm_format_t src_format,
+				   snd_pcm_format_t dst_format,
+				   unsigned int src_channels,
+				   unsigned int dst_channels)
+{
+	int block[src_channels];
+	unsigned int d, k, c;
+
+	snd_pcm_route_mix_free(params);
+	/* the scalar float code is no match for the integer loops */
+	if (!snd_pcm_simd_caps())
+		return 0;
+	params->mix_get = snd_pcm_simd_linear_kernel(src_format, SND_PCM_FORMAT_S32);
+	params->mix_put = snd_pcm_simd_linear_kernel(SND_PCM_FORMAT_S32, dst_format);
+	params->mix_copy = snd_pcm_simd_linear_kernel(src_format, dst_format);
+	if (!params->mix_get || !params->mix_put || !params->mix_copy)
+		return 0;
+	for (c = 0; c < src_channels; c++)
+		block[c] = -1;
+	for (d = 0; d < params->ndsts; d++) {
+		snd_pcm_route_ttable_dst_t *t = &params->dsts[d];
+		if (t->nsrcs == 0 || snd_pcm_route_dst_is_copy(t))
+			continue;
+		for (k = 0; k < t->nsrcs; k++) {
+			c = t->srcs[k].channel;
+			if (block[c] < 0)
+				block[c] = params->mix_nsrcs++;
+			t->srcs[k].mix_block = block[c];
+		}
+	}
+	params->mix_src_s32 = src_format == SND_PCM_FORMAT_S32;
+	params->mix_dst_s32 = dst_format == SND_PCM_FORMAT_S32;
+	params->mix_src_bytes = snd_pcm_format_physical_width(src_format) / 8;
+	params->mix_dst_bytes = snd_pcm_format_physical_width(dst_format) / 8;
+	params->mix_srcs = malloc((params->mix_nsrcs + 1) * sizeof(*params->mix_srcs));
+	params->mix_buf = malloc((params->mix_nsrcs + 1) * ROUTE_MIX_FRAMES *
+				 sizeof(*params->mix_buf));
+	params->mix_s32 = malloc(ROUTE_MIX_FRAMES * sizeof(*params->mix_s32));
+	params->mix_src_planar = snd_pcm_route_mix_planar(src_channels,
+							  params->mix_src_bytes);
+	params->mix_dst_planar = snd_pcm_route_mix_planar(dst_channels,
+							  params->mix_dst_bytes);
+	if (!params->mix_srcs || !params->mix_buf || !params->mix_s32 ||
+	    !params->mix_src_planar || !params->mix_dst_planar) {
+		snd_pcm_route_mix_free(params);
+		return -ENOMEM;
+	}
+	for (c = 0; c < src_channels; c++)
+		if (block[c] >= 0)
+			params->mix_srcs[block[c]] = c;
+	params->mix = 1;
+	return 0;
+}
+#endif
+
 static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_route_t *route = pcm->private_data;
 	snd_pcm_t *slave = route->plug.gen.slave;
 	snd_pcm_format_t src_format, dst_format;
+	unsigned int channels;
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	unsigned int src_channels, dst_channels;
+#endif
 	int err = snd_pcm_hw_params_slave(pcm, params,
 					  snd_pcm_route_hw_refine_cchange,
 					  snd_pcm_route_hw_refine_sprepare,
@@ -565,6 +1071,26 @@ static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	}
 	if (err < 0)
 		return err;
+	route->params.src_float = src_format == SND_PCM_FORMAT_FLOAT;
+	route->params.dst_float = dst_format == SND_PCM_FORMAT_FLOAT;
+	snd_pcm_route_mix_free(&route->params);
+	if (route->params.src_float || route->params.dst_float) {
+		/* only the integer side goes through get32/put32 */
+		route->params.get_idx = snd_pcm_linear_get_index(route->params.src_float ?
+								 SND_PCM_FORMAT_S32 : src_format,
+								 SND_PCM_FORMAT_S32);
+		route->params.put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32,
+								 route->params.dst_float ?
+								 SND_PCM_FORMAT_S32 : dst_format);
+		route->params.dst_sfmt = dst_format;
+		route->params.use_getput = 0;
+		route->params.fused = 0;
+		snd_pcm_plugin_set_in_place(pcm, params,
+					    snd_pcm_format_physical_width(src_format) ==
+					    snd_pcm_format_physical_width(dst_format) &&
+					    snd_pcm_route_is_diagonal(route));
+		return 0;
+	}
 	/* 3 bytes or 20-bit formats? */
 	route->params.use_getput =
 		(snd_pcm_format_physical_width(src_format) + 7) / 8 == 3 ||
@@ -581,6 +1107,37 @@ static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 #else
 	route->params.sum_idx = UINT64;
 #endif
+	err = INTERNAL(snd_pcm_hw_params_get_channels)(params, &channels);
+	if (err < 0)
+		return err;
+	route->params.fused =
+		(src_format == SND_PCM_FORMAT_S16 || src_format == SND_PCM_FORMAT_S32) &&
+		(dst_format == SND_PCM_FORMAT_S16 || dst_format == SND_PCM_FORMAT_S32) &&
+		snd_pcm_route_sources_valid(route,
+					    pcm->stream == SND_PCM_STREAM_PLAYBACK ?
+					    channels : slave->channels);
+	route->params.fused_src_bytes = snd_pcm_format_physical_width(src_format) / 8;
+	route->params.fused_dst_bytes = snd_pcm_format_physical_width(dst_format) / 8;
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		src_channels = channels;
+		dst_channels = slave->channels;
+	} else {
+		src_channels = slave->channels;
+		dst_channels = channels;
+	}
+	if (snd_pcm_route_sources_valid(route, src_channels)) {
+		err = snd_pcm_route_mix_setup(&route->params, src_format,
+					      dst_format, src_channels,
+					      dst_channels);
+		if (err < 0)
+			return err;
+	}
+#endif
+	snd_pcm_plugin_set_in_place(pcm, params,
+				    snd_pcm_format_physical_width(src_format) ==
+				    snd_pcm_format_physical_width(dst_format) &&
+				    snd_pcm_route_is_diagonal(route));
 	return 0;
 }
 
@@ -705,6 +1262,8 @@ static void snd_pcm_route_dump(snd_pcm_t *pcm, snd_output_t *out)
 		}
 		snd_output_putc(out, '\n');
 	}
+	if (pcm->setup && route->params.fused)
+		snd_output_puts(out, "  Fused interleaved conversion\n");
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -1017,7 +1576,8 @@ int snd_pcm_route_open(snd_pcm_t **pcmp, const char *name,
 	int err;
 	assert(pcmp && slave && ttable);
 	if (sformat != SND_PCM_FORMAT_UNKNOWN && 
-	    snd_pcm_format_linear(sformat) != 1)
+	    snd_pcm_format_linear(sformat) != 1 &&
+	    !(SND_PCM_PLUGIN_ROUTE_FLOAT && sformat == SND_PCM_FORMAT_FLOAT))
 		return -EINVAL;
 	route = calloc(1, sizeof(snd_pcm_route_t));
 	if (!route) {
@@ -1235,6 +1795,14 @@ The format and rate must match for both of them.
 SCHANNEL can be a channel name instead of a number (e g FL, LFE).
 If so, a matching channel map will be selected for the slave.
 
+Besides the linear formats, the native FLOAT format is accepted on either
+side.  When it is used, the mix is done in floating point and the samples
+are clipped only when they are stored in an integer format.
+
+Between linear formats on a CPU with SSE2 or AVX2, the samples are mixed
+in blocks of frames, each source channel being converted once however
+many destinations read it.
+
 \code
 pcm.name {
         type route              # Route & Volume conversion PCM
@@ -1328,7 +1896,8 @@ int _snd_pcm_route_open(snd_pcm_t **pcmp, const char *name,
 	if (err < 0)
 		return err;
 	if (sformat != SND_PCM_FORMAT_UNKNOWN &&
-	    snd_pcm_format_linear(sformat) != 1) {
+	    snd_pcm_format_linear(sformat) != 1 &&
+	    !(SND_PCM_PLUGIN_ROUTE_FLOAT && sformat == SND_PCM_FORMAT_FLOAT)) {
 	    	snd_config_delete(sconf);
 		SNDERR("slave format is not linear");
 		return -EINVAL;
@@ -0,0 +1,3095 @@
+/*
+ *  PCM Interface - SIMD helpers
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "bswap.h"
+#include "pcm_local.h"
+#include "pcm_simd.h"
+
+/*
+ * CPU feature detection
+ *
+ * The optimized routines can be restricted via $LIBASOUND_SIMD:
+ *   none (or 0) - use only the generic C code
+ *   sse2        - do not use anything above SSE2
+ *   sse4.1      - do not use AVX2
+ */
+
+static unsigned int simd_caps_detect(void)
+{
+	unsigned int caps = 0;
+#ifdef HAVE_X86_SIMD
+	const char *env;
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		caps |= SND_PCM_SIMD_SSE2;
+	if (__builtin_cpu_supports("ssse3"))
+		caps |= SND_PCM_SIMD_SSSE3;
+	if (__builtin_cpu_supports("sse4.1"))
+		caps |= SND_PCM_SIMD_SSE41;
+	if (__builtin_cpu_supports("avx2"))
+		caps |= SND_PCM_SIMD_AVX2;
+	env = getenv("LIBASOUND_SIMD");
+	if (env) {
+		if (!strcmp(env, "none") || !strcmp(env, "0"))
+			caps = 0;
+		else if (!strcmp(env, "sse2"))
+			caps &= SND_PCM_SIMD_SSE2;
+		else if (!strcmp(env, "sse4.1"))
+			caps &= SND_PCM_SIMD_SSE2 | SND_PCM_SIMD_SSSE3 |
+				SND_PCM_SIMD_SSE41;
+	}
+#endif
+	return caps;
+}
+
+unsigned int snd_pcm_simd_caps(void)
+{
+	static int caps = -1;
+
+	if (caps < 0)
+		caps = simd_caps_detect();
+	return caps;
+}
+
+/*
+ * interleaved <-> planar transposition
+ *
+ * The interleaved buffer is walked in blocks which fit into L1 cache,
+ * and each block is visited once per group of channels.  Inside a block
+ * the vector kernels transpose square tiles of samples, the rest is
+ * moved by the generic loop.
+ */
+
+#define TRANSPOSE_BLOCK_BYTES	8192
+#define TRANSPOSE_MAX_TILE	8
+
+typedef void (*transpose_group_t)(char *const *planar, size_t poff,
+				  char *inter, unsigned int frame_bytes,
+				  snd_pcm_uframes_t frames, int to_planar);
+
+static void transpose_generic(char *const *planar, size_t poff,
+			      char *inter, unsigned int frame_bytes,
+			      unsigned int channels, snd_pcm_uframes_t frames,
+			      unsigned int width, int to_planar)
+{
+	unsigned int c;
+
+	for (c = 0; c < channels; c++) {
+		char *p = planar[c] + poff;
+		char *i = inter + c * width;
+		char *src = to_planar ? i : p;
+		char *dst = to_planar ? p : i;
+		unsigned int src_step = to_planar ? frame_bytes : width;
+		unsigned int dst_step = to_planar ? width : frame_bytes;
+		snd_pcm_uframes_t f = frames;
+
+		switch (width) {
+		case 1:
+			while (f-- > 0) {
+				*dst = *src;
+				src += src_step;
+				dst += dst_step;
+			}
+			break;
+		case 2:
+			while (f-- > 0) {
+				*(uint16_t *)dst = *(const uint16_t *)src;
+				src += src_step;
+				dst += dst_step;
+			}
+			break;
+		case 3:
+			while (f-- > 0) {
+				dst[0] = src[0];
+				dst[1] = src[1];
+				dst[2] = src[2];
+				src += src_step;
+				dst += dst_step;
+			}
+			break;
+		case 4:
+			while (f-- > 0) {
+				*(uint32_t *)dst = *(const uint32_t *)src;
+				src += src_step;
+				dst += dst_step;
+			}
+			break;
+		case 8:
+			while (f-- > 0) {
+				*(uint64_t *)dst = *(const uint64_t *)src;
+				src += src_step;
+				dst += dst_step;
+			}
+			break;
+		}
+	}
+}
+
+#ifdef HAVE_X86_SIMD
+
+static inline SND_PCM_SIMD_TARGET("sse2")
+void transpose_4x4_32(__m128i *r)
+{
+	__m128i t0 = _mm_unpacklo_epi32(r[0], r[1]);
+	__m128i t1 = _mm_unpacklo_epi32(r[2], r[3]);
+	__m128i t2 = _mm_unpackhi_epi32(r[0], r[1]);
+	__m128i t3 = _mm_unpackhi_epi32(r[2], r[3]);
+
+	r[0] = _mm_unpacklo_epi64(t0, t1);
+	r[1] = _mm_unpackhi_epi64(t0, t1);
+	r[2] = _mm_unpacklo_epi64(t2, t3);
+	r[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+static inline SND_PCM_SIMD_TARGET("sse2")
+void transpose_8x8_16(__m128i *r)
+{
+	__m128i a[8], b[8];
+	int k;
+
+	for (k = 0; k < 4; k++) {
+		a[k] = _mm_unpacklo_epi16(r[2 * k], r[2 * k + 1]);
+		a[k + 4] = _mm_unpackhi_epi16(r[2 * k], r[2 * k + 1]);
+	}
+	for (k = 0; k < 2; k++) {
+		b[4 * k + 0] = _mm_unpacklo_epi32(a[4 * k + 0], a[4 * k + 1]);
+		b[4 * k + 1] = _mm_unpacklo_epi32(a[4 * k + 2], a[4 * k + 3]);
+		b[4 * k + 2] = _mm_unpackhi_epi32(a[4 * k + 0], a[4 * k + 1]);
+		b[4 * k + 3] = _mm_unpackhi_epi32(a[4 * k + 2], a[4 * k + 3]);
+	}
+	for (k = 0; k < 4; k++) {
+		r[2 * k] = _mm_unpacklo_epi64(b[2 * k], b[2 * k + 1]);
+		r[2 * k + 1] = _mm_unpackhi_epi64(b[2 * k], b[2 * k + 1]);
+	}
+}
+
+static inline SND_PCM_SIMD_TARGET("avx2")
+void transpose_8x8_32(__m256i *r)
+{
+	__m256i t[8], u[8];
+	int k;
+
+	for (k = 0; k < 4; k++) {
+		t[2 * k] = _mm256_unpacklo_epi32(r[2 * k], r[2 * k + 1]);
+		t[2 * k + 1] = _mm256_unpackhi_epi32(r[2 * k], r[2 * k + 1]);
+	}
+	for (k = 0; k < 2; k++) {
+		u[4 * k + 0] = _mm256_unpacklo_epi64(t[4 * k + 0], t[4 * k + 2]);
+		u[4 * k + 1] = _mm256_unpackhi_epi64(t[4 * k + 0], t[4 * k + 2]);
+		u[4 * k + 2] = _mm256_unpacklo_epi64(t[4 * k + 1], t[4 * k + 3]);
+		u[4 * k + 3] = _mm256_unpackhi_epi64(t[4 * k + 1], t[4 * k + 3]);
+	}
+	for (k = 0; k < 4; k++) {
+		r[k] = _mm256_permute2x128_si256(u[k], u[k + 4], 0x20);
+		r[k + 4] = _mm256_permute2x128_si256(u[k], u[k + 4], 0x31);
+	}
+}
+
+/*
+ * square tile kernels: 'frames' must be a multiple of the tile size,
+ * the group size equals the tile size
+ */
+#define DEFINE_TILE_KERNEL(name, isa, vtype, n, bytes, load, store, transpose) \
+static SND_PCM_SIMD_TARGET(isa) \
+void name(char *const *planar, size_t poff, char *inter, \
+	  unsigned int frame_bytes, snd_pcm_uframes_t frames, int to_planar) \
+{ \
+	vtype r[n]; \
+	snd_pcm_uframes_t f; \
+	int k; \
+	for (f = 0; f < frames; f += n) { \
+		char *i = inter + f * frame_bytes; \
+		size_t o = poff + f * (bytes); \
+		if (to_planar) { \
+			for (k = 0; k < n; k++) \
+				r[k] = load((const vtype *)(i + k * frame_bytes)); \
+			transpose(r); \
+			for (k = 0; k < n; k++) \
+				store((vtype *)(planar[k] + o), r[k]); \
+		} else { \
+			for (k = 0; k < n; k++) \
+				r[k] = load((const vtype *)(planar[k] + o)); \
+			transpose(r); \
+			for (k = 0; k < n; k++) \
+				store((vtype *)(i + k * frame_bytes), r[k]); \
+		} \
+	} \
+}
+
+static inline SND_PCM_SIMD_TARGET("sse2")
+void transpose_2x2_64(__m128i *r)
+{
+	__m128i t = _mm_unpacklo_epi64(r[0], r[1]);
+
+	r[1] = _mm_unpackhi_epi64(r[0], r[1]);
+	r[0] = t;
+}
+
+DEFINE_TILE_KERNEL(transpose_tile_32x4_sse2, "sse2", __m128i, 4, 4,
+		   _mm_loadu_si128, _mm_storeu_si128, transpose_4x4_32)
+DEFINE_TILE_KERNEL(transpose_tile_16x8_sse2, "sse2", __m128i, 8, 2,
+		   _mm_loadu_si128, _mm_storeu_si128, transpose_8x8_16)
+DEFINE_TILE_KERNEL(transpose_tile_64x2_sse2, "sse2", __m128i, 2, 8,
+		   _mm_loadu_si128, _mm_storeu_si128, transpose_2x2_64)
+DEFINE_TILE_KERNEL(transpose_tile_32x8_avx2, "avx2", __m256i, 8, 4,
+		   _mm256_loadu_si256, _mm256_storeu_si256, transpose_8x8_32)
+
+/*
+ * packed stereo kernels: the interleaved buffer holds exactly two channels
+ */
+static SND_PCM_SIMD_TARGET("sse2")
+void transpose_stereo_16_sse2(char *const *planar, size_t poff, char *inter,
+			      unsigned int frame_bytes ATTRIBUTE_UNUSED,
+			      snd_pcm_uframes_t frames, int to_planar)
+{
+	char *l = planar[0] + poff, *r = planar[1] + poff;
+	snd_pcm_uframes_t f;
+
+	for (f = 0; f < frames; f += 8, inter += 32, l += 16, r += 16) {
+		__m128i v0, v1;
+		if (to_planar) {
+			v0 = _mm_loadu_si128((const __m128i *)inter);
+			v1 = _mm_loadu_si128((const __m128i *)(inter + 16));
+			/* sign extended halves survive the saturation intact */
+			_mm_storeu_si128((__m128i *)l,
+				_mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(v0, 16), 16),
+						_mm_srai_epi32(_mm_slli_epi32(v1, 16), 16)));
+			_mm_storeu_si128((__m128i *)r,
+				_mm_packs_epi32(_mm_srai_epi32(v0, 16),
+						_mm_srai_epi32(v1, 16)));
+		} else {
+			v0 = _mm_loadu_si128((const __m128i *)l);
+			v1 = _mm_loadu_si128((const __m128i *)r);
+			_mm_storeu_si128((__m128i *)inter, _mm_unpacklo_epi16(v0, v1));
+			_mm_storeu_si128((__m128i *)(inter + 16), _mm_unpackhi_epi16(v0, v1));
+		}
+	}
+}
+
+static SND_PCM_SIMD_TARGET("sse2")
+void transpose_stereo_32_sse2(char *const *planar, size_t poff, char *inter,
+			      unsigned int frame_bytes ATTRIBUTE_UNUSED,
+			      snd_pcm_uframes_t frames, int to_planar)
+{
+	char *l = planar[0] + poff, *r = planar[1] + poff;
+	snd_pcm_uframes_t f;
+
+	for (f = 0; f < frames; f += 4, inter += 32, l += 16, r += 16) {
+		__m128 v0, v1;
+		if (to_planar) {
+			v0 = _mm_loadu_ps((const float *)inter);
+			v1 = _mm_loadu_ps((const float *)(inter + 16));
+			_mm_storeu_ps((float *)l, _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps((float *)r, _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+		} else {
+			__m128i i0 = _mm_loadu_si128((const __m128i *)l);
+			__m128i i1 = _mm_loadu_si128((const __m128i *)r);
+			_mm_storeu_si128((__m128i *)inter, _mm_unpacklo_epi32(i0, i1));
+			_mm_storeu_si128((__m128i *)(inter + 16), _mm_unpackhi_epi32(i0, i1));
+		}
+	}
+}
+
+struct transpose_kernel {
+	unsigned int width;	/* sample width in bytes */
+	unsigned int channels;	/* channels moved at once */
+	unsigned int frames;	/* frames moved at once */
+	unsigned int packed;	/* requires frame_bytes == channels * width */
+	unsigned int caps;	/* required CPU features */
+	transpose_group_t func;
+};
+
+/* ordered by preference */
+static const struct transpose_kernel transpose_kernels[] = {
+	{ 4, 8, 8, 0, SND_PCM_SIMD_AVX2, transpose_tile_32x8_avx2 },
+	{ 4, 4, 4, 0, SND_PCM_SIMD_SSE2, transpose_tile_32x4_sse2 },
+	{ 4, 2, 4, 1, SND_PCM_SIMD_SSE2, transpose_stereo_32_sse2 },
+	{ 2, 8, 8, 0, SND_PCM_SIMD_SSE2, transpose_tile_16x8_sse2 },
+	{ 2, 2, 8, 1, SND_PCM_SIMD_SSE2, transpose_stereo_16_sse2 },
+	{ 8, 2, 2, 0, SND_PCM_SIMD_SSE2, transpose_tile_64x2_sse2 },
+};
+
+static const struct transpose_kernel *
+transpose_find_kernel(unsigned int width, unsigned int channels,
+		      unsigned int frame_bytes)
+{
+	unsigned int caps = snd_pcm_simd_caps();
+	unsigned int k;
+
+	for (k = 0; k < sizeof(transpose_kernels) / sizeof(transpose_kernels[0]); k++) {
+		const struct transpose_kernel *t = &transpose_kernels[k];
+		if (t->width != width || t->channels > channels ||
+		    (t->caps & caps) != t->caps)
+			continue;
+		if (t->packed && (channels != t->channels ||
+				  frame_bytes != t->channels * width))
+			continue;
+		return t;
+	}
+	return NULL;
+}
+
+#endif /* HAVE_X86_SIMD */
+
+void snd_pcm_simd_transpose(char **planar, char *interleaved,
+			    unsigned int frame_bytes, unsigned int channels,
+			    snd_pcm_uframes_t frames, unsigned int width,
+			    int to_planar)
+{
+	snd_pcm_uframes_t block, offset;
+
+	block = TRANSPOSE_BLOCK_BYTES / frame_bytes;
+	block -= block % TRANSPOSE_MAX_TILE;
+	if (block < TRANSPOSE_MAX_TILE)
+		block = TRANSPOSE_MAX_TILE;
+	for (offset = 0; offset < frames; offset += block) {
+		snd_pcm_uframes_t size = frames - offset;
+		char *inter = interleaved + offset * frame_bytes;
+		size_t poff = offset * width;
+		unsigned int c = 0;
+
+		if (size > block)
+			size = block;
+#ifdef HAVE_X86_SIMD
+		while (c < channels) {
+			const struct transpose_kernel *t;
+			snd_pcm_uframes_t tiled;
+
+			t = transpose_find_kernel(width, channels - c, frame_bytes);
+			if (!t)
+				break;
+			tiled = size - size % t->frames;
+			t->func(planar + c, poff, inter + c * width, frame_bytes,
+				tiled, to_planar);
+			if (tiled < size)
+				transpose_generic(planar + c, poff + tiled * width,
+						  inter + c * width + tiled * frame_bytes,
+						  frame_bytes, t->channels,
+						  size - tiled, width, to_planar);
+			c += t->channels;
+		}
+#endif
+		transpose_generic(planar + c, poff, inter + c * width,
+				  frame_bytes, channels - c, size, width,
+				  to_planar);
+	}
+}
+
+/*
+ * pattern fill
+ *
+ * The pattern is expanded to a multiple of 48 bytes (the common multiple
+ * of the vector sizes and of a packed 24-bit sample) so that the store
+ * loops never have to care about the sample boundaries.
+ */
+
+#define FILL_PERIOD		48
+#define FILL_CHUNK		(FILL_PERIOD * 64)
+
+#ifdef HAVE_X86_SIMD
+
+static SND_PCM_SIMD_TARGET("sse2")
+void fill_sse2(char *dst, size_t bytes, const unsigned char *pat, int nt)
+{
+	size_t head = (-(uintptr_t)dst) & 15;
+	unsigned int phase;
+	__m128i v0, v1, v2;
+
+	if (head > bytes)
+		head = bytes;
+	memcpy(dst, pat, head);
+	dst += head;
+	bytes -= head;
+	phase = head % FILL_PERIOD;
+	v0 = _mm_loadu_si128((const __m128i *)(pat + phase));
+	v1 = _mm_loadu_si128((const __m128i *)(pat + phase + 16));
+	v2 = _mm_loadu_si128((const __m128i *)(pat + phase + 32));
+	if (nt) {
+		for (; bytes >= 48; bytes -= 48, dst += 48) {
+			_mm_stream_si128((__m128i *)dst, v0);
+			_mm_stream_si128((__m128i *)(dst + 16), v1);
+			_mm_stream_si128((__m128i *)(dst + 32), v2);
+		}
+		_mm_sfence();
+	} else {
+		for (; bytes >= 48; bytes -= 48, dst += 48) {
+			_mm_store_si128((__m128i *)dst, v0);
+			_mm_store_si128((__m128i *)(dst + 16), v1);
+			_mm_store_si128((__m128i *)(dst + 32), v2);
+		}
+	}
+	memcpy(dst, pat + phase, bytes);
+}
+
+static SND_PCM_SIMD_TARGET("avx2")
+void fill_avx2(char *dst, size_t bytes, const unsigned char *pat, int nt)
+{
+	size_t head = (-(uintptr_t)dst) & 31;
+	unsigned int phase;
+	__m256i v0, v1, v2;
+
+	if (head > bytes)
+		head = bytes;
+	memcpy(dst, pat, head);
+	dst += head;
+	bytes -= head;
+	phase = head % FILL_PERIOD;
+	v0 = _mm256_loadu_si256((const __m256i *)(pat + phase));
+	v1 = _mm256_loadu_si256((const __m256i *)(pat + phase + 32));
+	v2 = _mm256_loadu_si256((const __m256i *)(pat + phase + 64));
+	if (nt) {
+		for (; bytes >= 96; bytes -= 96, dst += 96) {
+			_mm256_stream_si256((__m256i *)dst, v0);
+			_mm256_stream_si256((__m256i *)(dst + 32), v1);
+			_mm256_stream_si256((__m256i *)(dst + 64), v2);
+		}
+		_mm_sfence();
+	} else {
+		for (; bytes >= 96; bytes -= 96, dst += 96) {
+			_mm256_store_si256((__m256i *)dst, v0);
+			_mm256_store_si256((__m256i *)(dst + 32), v1);
+			_mm256_store_si256((__m256i *)(dst + 64), v2);
+		}
+	}
+	memcpy(dst, pat + phase, bytes);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* write one period and keep doubling it with memcpy() */
+static void fill_generic(char *dst, size_t bytes, const unsigned char *pat)
+{
+	size_t done = bytes < FILL_PERIOD ? bytes : FILL_PERIOD;
+
+	memcpy(dst, pat, done);
+	while (done < bytes) {
+		size_t size = bytes - done;
+		if (size > done)
+			size = done;
+		if (size > FILL_CHUNK)
+			size = FILL_CHUNK;
+		memcpy(dst + done, dst, size);
+		done += size;
+	}
+}
+
+void snd_pcm_simd_fill(void *data, size_t bytes, const void *pattern,
+		       unsigned int size)
+{
+	/* any alignment phase plus the largest store loop, the size must be
+	 * a multiple of all the supported pattern sizes
+	 */
+	unsigned char pat[FILL_PERIOD * 4];
+	unsigned int i;
+#ifdef HAVE_X86_SIMD
+	unsigned int caps = snd_pcm_simd_caps();
+	int nt = bytes >= SND_PCM_SILENCE_NT_BYTES;
+#endif
+
+	for (i = 0; i < sizeof(pat); i += size)
+		memcpy(pat + i, pattern, size);
+#ifdef HAVE_X86_SIMD
+	if (caps & SND_PCM_SIMD_AVX2) {
+		fill_avx2(data, bytes, pat, nt);
+		return;
+	}
+	if (caps & SND_PCM_SIMD_SSE2) {
+		fill_sse2(data, bytes, pat, nt);
+		return;
+	}
+#endif
+	fill_generic(data, bytes, pat);
+}
+
+/*
+ * linear format conversion
+ *
+ * Every (source, destination) pair of the common linear formats has its
+ * own loop, built from the load and store helpers below.  A sample is
+ * loaded as a signed 32-bit value aligned to the MSB, which is the same
+ * intermediate the get32/put32 code of plugin_ops.h uses, so the results
+ * are bit identical.  Vector kernels replace the loops of the most used
+ * pairs when the samples are contiguous.
+ */
+
+#ifdef SND_LITTLE_ENDIAN
+#define lin_le16(x)	(x)
+#define lin_be16(x)	bswap_16(x)
+#define lin_le32(x)	(x)
+#define lin_be32(x)	bswap_32(x)
+#define lin_le64(x)	(x)
+#define lin_be64(x)	bswap_64(x)
+#else
+#define lin_le16(x)	bswap_16(x)
+#define lin_be16(x)	(x)
+#define lin_le32(x)	bswap_32(x)
+#define lin_be32(x)	(x)
+#define lin_le64(x)	bswap_64(x)
+#define lin_be64(x)	(x)
+#endif
+
+static inline uint16_t lin_rd16(const unsigned char *p)
+{
+	uint16_t v;
+	memcpy(&v, p, 2);
+	return v;
+}
+
+static inline uint32_t lin_rd32(const unsigned char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline uint64_t lin_rd64(const unsigned char *p)
+{
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static inline void lin_wr16(unsigned char *p, uint16_t v)
+{
+	memcpy(p, &v, 2);
+}
+
+static inline void lin_wr32(unsigned char *p, uint32_t v)
+{
+	memcpy(p, &v, 4);
+}
+
+static inline void lin_wr64(unsigned char *p, uint64_t v)
+{
+	memcpy(p, &v, 8);
+}
+
+/* sign extension of a 24-bit value, as sx24() of plugin_ops.h */
+static inline uint32_t lin_sx24(uint32_t x)
+{
+	return x & 0x00800000 ? x | 0xff000000 : x & 0x00ffffff;
+}
+
+#define LIN_FORMAT(f, bytes, bits, load, store) \
+enum { LIN_BYTES_##f = bytes, LIN_BITS_##f = bits }; \
+static inline uint32_t lin_load_##f(const unsigned char *p) \
+{ \
+	return load; \
+} \
+static inline void lin_store_##f(unsigned char *p, uint32_t v) \
+{ \
+	store; \
+}
+
+LIN_FORMAT(S8, 1, 8, (uint32_t)p[0] << 24,
+	   p[0] = v >> 24)
+LIN_FORMAT(U8, 1, 8, ((uint32_t)p[0] << 24) ^ 0x80000000,
+	   p[0] = (v >> 24) ^ 0x80)
+LIN_FORMAT(S16_LE, 2, 16, (uint32_t)lin_le16(lin_rd16(p)) << 16,
+	   lin_wr16(p, lin_le16(v >> 16)))
+LIN_FORMAT(S16_BE, 2, 16, (uint32_t)lin_be16(lin_rd16(p)) << 16,
+	   lin_wr16(p, lin_be16(v >> 16)))
+LIN_FORMAT(U16_LE, 2, 16, ((uint32_t)lin_le16(lin_rd16(p)) << 16) ^ 0x80000000,
+	   lin_wr16(p, lin_le16((v >> 16) ^ 0x8000)))
+LIN_FORMAT(U16_BE, 2, 16, ((uint32_t)lin_be16(lin_rd16(p)) << 16) ^ 0x80000000,
+	   lin_wr16(p, lin_be16((v >> 16) ^ 0x8000)))
+LIN_FORMAT(S24_LE, 4, 24, lin_le32(lin_rd32(p)) << 8,
+	   lin_wr32(p, lin_le32(lin_sx24(v >> 8))))
+LIN_FORMAT(S24_BE, 4, 24, lin_be32(lin_rd32(p)) << 8,
+	   lin_wr32(p, lin_be32(lin_sx24(v >> 8))))
+LIN_FORMAT(U24_LE, 4, 24, (lin_le32(lin_rd32(p)) << 8) ^ 0x80000000,
+	   lin_wr32(p, lin_le32(lin_sx24((v ^ 0x80000000) >> 8))))
+LIN_FORMAT(U24_BE, 4, 24, (lin_be32(lin_rd32(p)) << 8) ^ 0x80000000,
+	   lin_wr32(p, lin_be32(lin_sx24((v ^ 0x80000000) >> 8))))
+LIN_FORMAT(S32_LE, 4, 32, lin_le32(lin_rd32(p)),
+	   lin_wr32(p, lin_le32(v)))
+LIN_FORMAT(S32_BE, 4, 32, lin_be32(lin_rd32(p)),
+	   lin_wr32(p, lin_be32(v)))
+LIN_FORMAT(U32_LE, 4, 32, lin_le32(lin_rd32(p)) ^ 0x80000000,
+	   lin_wr32(p, lin_le32(v ^ 0x80000000)))
+LIN_FORMAT(U32_BE, 4, 32, lin_be32(lin_rd32(p)) ^ 0x80000000,
+	   lin_wr32(p, lin_be32(v ^ 0x80000000)))
+LIN_FORMAT(S24_3LE, 3, 24,
+	   ((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24),
+	   p[0] = v >> 8; p[1] = v >> 16; p[2] = v >> 24)
+LIN_FORMAT(S24_3BE, 3, 24,
+	   ((uint32_t)p[2] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[0] << 24),
+	   p[2] = v >> 8; p[1] = v >> 16; p[0] = v >> 24)
+LIN_FORMAT(U24_3LE, 3, 24,
+	   ((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) ^ 0x80000000,
+	   p[0] = v >> 8; p[1] = v >> 16; p[2] = (v >> 24) ^ 0x80)
+LIN_FORMAT(U24_3BE, 3, 24,
+	   ((uint32_t)p[2] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[0] << 24) ^ 0x80000000,
+	   p[2] = v >> 8; p[1] = v >> 16; p[0] = (v >> 24) ^ 0x80)
+
+/* two copies of the list, the kernel table is built by nesting them */
+#define LIN_SRC_FORMATS(M) \
+	M(S8) M(U8) M(S16_LE) M(S16_BE) M(U16_LE) M(U16_BE) \
+	M(S24_LE) M(S24_BE) M(U24_LE) M(U24_BE) \
+	M(S32_LE) M(S32_BE) M(U32_LE) M(U32_BE) \
+	M(S24_3LE) M(S24_3BE) M(U24_3LE) M(U24_3BE)
+#define LIN_DST_FORMATS(M, s) \
+	M(s, S8) M(s, U8) M(s, S16_LE) M(s, S16_BE) M(s, U16_LE) M(s, U16_BE) \
+	M(s, S24_LE) M(s, S24_BE) M(s, U24_LE) M(s, U24_BE) \
+	M(s, S32_LE) M(s, S32_BE) M(s, U32_LE) M(s, U32_BE) \
+	M(s, S24_3LE) M(s, S24_3BE) M(s, U24_3LE) M(s, U24_3BE)
+
+#define LIN_KERNEL(s, d) \
+static void lin_##s##_##d(char *dst, int dst_step, const char *src, \
+			  int src_step, snd_pcm_uframes_t samples) \
+{ \
+	const unsigned char *sp = (const unsigned char *)src; \
+	unsigned char *dp = (unsigned char *)dst; \
+	while (samples-- > 0) { \
+		lin_store_##d(dp, lin_load_##s(sp)); \
+		sp += src_step; \
+		dp += dst_step; \
+	} \
+}
+#define LIN_KERNEL_ROW(s)	LIN_DST_FORMATS(LIN_KERNEL, s)
+LIN_SRC_FORMATS(LIN_KERNEL_ROW)
+
+#define LIN_FORMAT_ENTRY(f)	SND_PCM_FORMAT_##f,
+static const snd_pcm_format_t lin_formats[] = {
+	LIN_SRC_FORMATS(LIN_FORMAT_ENTRY)
+};
+#define LIN_NFORMATS	(sizeof(lin_formats) / sizeof(lin_formats[0]))
+
+#define LIN_KERNEL_ENTRY(s, d)	lin_##s##_##d,
+#define LIN_KERNEL_TABLE_ROW(s)	{ LIN_DST_FORMATS(LIN_KERNEL_ENTRY, s) },
+static const snd_pcm_simd_convert_t lin_kernels[][LIN_NFORMATS] = {
+	LIN_SRC_FORMATS(LIN_KERNEL_TABLE_ROW)
+};
+
+static int lin_format_index(snd_pcm_format_t format)
+{
+	unsigned int i;
+
+	for (i = 0; i < LIN_NFORMATS; i++)
+		if (lin_formats[i] == format)
+			return i;
+	return -1;
+}
+
+/*
+ * linear <-> float conversion
+ *
+ * Integer samples become floats scaled to [-1.0, 1.0) as plugin_ops.h
+ * does, so that direction is bit identical.  The way back rounds to the
+ * nearest value of the destination width and saturates, instead of
+ * truncating the 32-bit intermediate; NaN becomes silence.  The vector
+ * kernels give the same results as the loops.
+ */
+
+static inline double lin_float32(uint32_t i)
+{
+	float f;
+	memcpy(&f, &i, 4);
+	return f;
+}
+
+static inline uint32_t lin_float32_bits(float f)
+{
+	uint32_t i;
+	memcpy(&i, &f, 4);
+	return i;
+}
+
+static inline double lin_float64(uint64_t i)
+{
+	double f;
+	memcpy(&f, &i, 8);
+	return f;
+}
+
+static inline uint64_t lin_float64_bits(double f)
+{
+	uint64_t i;
+	memcpy(&i, &f, 8);
+	return i;
+}
+
+#define LIN_FLOAT_FORMAT(f, bytes, load, store) \
+enum { LIN_BYTES_##f = bytes }; \
+static inline double lin_loadf_##f(const unsigned char *p) \
+{ \
+	return load; \
+} \
+static inline void lin_storef_##f(unsigned char *p, double v) \
+{ \
+	store; \
+}
+
+LIN_FLOAT_FORMAT(FLOAT_LE, 4, lin_float32(lin_le32(lin_rd32(p))),
+		 lin_wr32(p, lin_le32(lin_float32_bits(v))))
+LIN_FLOAT_FORMAT(FLOAT_BE, 4, lin_float32(lin_be32(lin_rd32(p))),
+		 lin_wr32(p, lin_be32(lin_float32_bits(v))))
+LIN_FLOAT_FORMAT(FLOAT64_LE, 8, lin_float64(lin_le64(lin_rd64(p))),
+		 lin_wr64(p, lin_le64(lin_float64_bits(v))))
+LIN_FLOAT_FORMAT(FLOAT64_BE, 8, lin_float64(lin_be64(lin_rd64(p))),
+		 lin_wr64(p, lin_be64(lin_float64_bits(v))))
+
+#define LIN_FLOAT_FORMATS(M) \
+	M(FLOAT_LE) M(FLOAT_BE) M(FLOAT64_LE) M(FLOAT64_BE)
+
+/* float -> int32 rounded to 'bits' bits, then aligned to the MSB */
+static inline uint32_t lin_from_float(double v, unsigned int bits)
+{
+	double max = (double)(1U << (bits - 1));
+
+	if (v != v)
+		return 0;
+	v = rint(v * max);
+	if (v >= max)
+		v = max - 1;
+	else if (v < -max)
+		v = -max;
+	return (uint32_t)(int32_t)v << (32 - bits);
+}
+
+#define LIN_FLOAT_KERNELS(f, i) \
+static void lin_##f##_##i(char *dst, int dst_step, const char *src, \
+			  int src_step, snd_pcm_uframes_t samples) \
+{ \
+	const unsigned char *sp = (const unsigned char *)src; \
+	unsigned char *dp = (unsigned char *)dst; \
+	while (samples-- > 0) { \
+		lin_store_##i(dp, lin_from_float(lin_loadf_##f(sp), \
+						 LIN_BITS_##i)); \
+		sp += src_step; \
+		dp += dst_step; \
+	} \
+} \
+static void lin_##i##_##f(char *dst, int dst_step, const char *src, \
+			  int src_step, snd_pcm_uframes_t samples) \
+{ \
+	const unsigned char *sp = (const unsigned char *)src; \
+	unsigned char *dp = (unsigned char *)dst; \
+	while (samples-- > 0) { \
+		lin_storef_##f(dp, (int32_t)lin_load_##i(sp) * \
+				   (1.0 / 2147483648.0)); \
+		sp += src_step; \
+		dp += dst_step; \
+	} \
+}
+#define LIN_FLOAT_KERNEL_ROW(f)	LIN_DST_FORMATS(LIN_FLOAT_KERNELS, f)
+LIN_FLOAT_FORMATS(LIN_FLOAT_KERNEL_ROW)
+
+static const snd_pcm_format_t lin_float_formats[] = {
+	LIN_FLOAT_FORMATS(LIN_FORMAT_ENTRY)
+};
+#define LIN_NFLOAT_FORMATS \
+	(sizeof(lin_float_formats) / sizeof(lin_float_formats[0]))
+
+/* both tables are indexed by [float format][linear format] */
+#define LIN_FROM_ENTRY(f, i)	lin_##f##_##i,
+#define LIN_FROM_ROW(f)	{ LIN_DST_FORMATS(LIN_FROM_ENTRY, f) },
+static const snd_pcm_simd_convert_t lin_from_float_kernels[][LIN_NFORMATS] = {
+	LIN_FLOAT_FORMATS(LIN_FROM_ROW)
+};
+
+#define LIN_TO_ENTRY(f, i)	lin_##i##_##f,
+#define LIN_TO_ROW(f)	{ LIN_DST_FORMATS(LIN_TO_ENTRY, f) },
+static const snd_pcm_simd_convert_t lin_to_float_kernels[][LIN_NFORMATS] = {
+	LIN_FLOAT_FORMATS(LIN_TO_ROW)
+};
+
+static int lin_float_index(snd_pcm_format_t format)
+{
+	unsigned int i;
+
+	for (i = 0; i < LIN_NFLOAT_FORMATS; i++)
+		if (lin_float_formats[i] == format)
+			return i;
+	return -1;
+}
+
+/*
+ * mu-law and A-law
+ *
+ * Decoding is a lookup in a 256-entry table of the 16-bit values, encoding
+ * finds the segment and the mantissa of the magnitude as pcm_mulaw.c and
+ * pcm_alaw.c always did.  As there, 16 bits of the linear sample are used.
+ */
+
+static const int16_t lin_decode_MU_LAW[256 + 1] = {
+	-32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956,
+	-23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764,
+	-15996, -15484, -14972, -14460, -13948, -13436, -12924, -12412,
+	-11900, -11388, -10876, -10364, -9852, -9340, -8828, -8316,
+	-7932, -7676, -7420, -7164, -6908, -6652, -6396, -6140,
+	-5884, -5628, -5372, -5116, -4860, -4604, -4348, -4092,
+	-3900, -3772, -3644, -3516, -3388, -3260, -3132, -3004,
+	-2876, -2748, -2620, -2492, -2364, -2236, -2108, -1980,
+	-1884, -1820, -1756, -1692, -1628, -1564, -1500, -1436,
+	-1372, -1308, -1244, -1180, -1116, -1052, -988, -924,
+	-876, -844, -812, -780, -748, -716, -684, -652,
+	-620, -588, -556, -524, -492, -460, -428, -396,
+	-372, -356, -340, -324, -308, -292, -276, -260,
+	-244, -228, -212, -196, -180, -164, -148, -132,
+	-120, -112, -104, -96, -88, -80, -72, -64,
+	-56, -48, -40, -32, -24, -16, -8, 0,
+	32124, 31100, 30076, 29052, 28028, 27004, 25980, 24956,
+	23932, 22908, 21884, 20860, 19836, 18812, 17788, 16764,
+	15996, 15484, 14972, 14460, 13948, 13436, 12924, 12412,
+	11900, 11388, 10876, 10364, 9852, 9340, 8828, 8316,
+	7932, 7676, 7420, 7164, 6908, 6652, 6396, 6140,
+	5884, 5628, 5372, 5116, 4860, 4604, 4348, 4092,
+	3900, 3772, 3644, 3516, 3388, 3260, 3132, 3004,
+	2876, 2748, 2620, 2492, 2364, 2236, 2108, 1980,
+	1884, 1820, 1756, 1692, 1628, 1564, 1500, 1436,
+	1372, 1308, 1244, 1180, 1116, 1052, 988, 924,
+	876, 844, 812, 780, 748, 716, 684, 652,
+	620, 588, 556, 524, 492, 460, 428, 396,
+	372, 356, 340, 324, 308, 292, 276, 260,
+	244, 228, 212, 196, 180, 164, 148, 132,
+	120, 112, 104, 96, 88, 80, 72, 64,
+	56, 48, 40, 32, 24, 16, 8, 0,
+	0	/* padding for the 32-bit gather */
+};
+
+static const int16_t lin_decode_A_LAW[256 + 1] = {
+	-5504, -5248, -6016, -5760, -4480, -4224, -4992, -4736,
+	-7552, -7296, -8064, -7808, -6528, -6272, -7040, -6784,
+	-2752, -2624, -3008, -2880, -2240, -2112, -2496, -2368,
+	-3776, -3648, -4032, -3904, -3264, -3136, -3520, -3392,
+	-22016, -20992, -24064, -23040, -17920, -16896, -19968, -18944,
+	-30208, -29184, -32256, -31232, -26112, -25088, -28160, -27136,
+	-11008, -10496, -12032, -11520, -8960, -8448, -9984, -9472,
+	-15104, -14592, -16128, -15616, -13056, -12544, -14080, -13568,
+	-344, -328, -376, -360, -280, -264, -312, -296,
+	-472, -456, -504, -488, -408, -392, -440, -424,
+	-88, -72, -120, -104, -24, -8, -56, -40,
+	-216, -200, -248, -232, -152, -136, -184, -168,
+	-1376, -1312, -1504, -1440, -1120, -1056, -1248, -1184,
+	-1888, -1824, -2016, -1952, -1632, -1568, -1760, -1696,
+	-688, -656, -752, -720, -560, -528, -624, -592,
+	-944, -912, -1008, -976, -816, -784, -880, -848,
+	5504, 5248, 6016, 5760, 4480, 4224, 4992, 4736,
+	7552, 7296, 8064, 7808, 6528, 6272, 7040, 6784,
+	2752, 2624, 3008, 2880, 2240, 2112, 2496, 2368,
+	3776, 3648, 4032, 3904, 3264, 3136, 3520, 3392,
+	22016, 20992, 24064, 23040, 17920, 16896, 19968, 18944,
+	30208, 29184, 32256, 31232, 26112, 25088, 28160, 27136,
+	11008, 10496, 12032, 11520, 8960, 8448, 9984, 9472,
+	15104, 14592, 16128, 15616, 13056, 12544, 14080, 13568,
+	344, 328, 376, 360, 280, 264, 312, 296,
+	472, 456, 504, 488, 408, 392, 440, 424,
+	88, 72, 120, 104, 24, 8, 56, 40,
+	216, 200, 248, 232, 152, 136, 184, 168,
+	1376, 1312, 1504, 1440, 1120, 1056, 1248, 1184,
+	1888, 1824, 2016, 1952, 1632, 1568, 1760, 1696,
+	688, 656, 752, 720, 560, 528, 624, 592,
+	944, 912, 1008, 976, 816, 784, 880, 848,
+	0	/* padding for the 32-bit gather */
+};
+
+/* segment of a magnitude of 0x100 and more, by its bits above the 8th */
+#define LIN_SEG2(x)	x, x
+#define LIN_SEG4(x)	LIN_SEG2(x), LIN_SEG2(x)
+#define LIN_SEG8(x)	LIN_SEG4(x), LIN_SEG4(x)
+#define LIN_SEG16(x)	LIN_SEG8(x), LIN_SEG8(x)
+#define LIN_SEG32(x)	LIN_SEG16(x), LIN_SEG16(x)
+#define LIN_SEG64(x)	LIN_SEG32(x), LIN_SEG32(x)
+static const unsigned char lin_g711_seg[128] = {
+	0, 1, LIN_SEG2(2), LIN_SEG4(3), LIN_SEG8(4), LIN_SEG16(5),
+	LIN_SEG32(6), LIN_SEG64(7)
+};
+
+static inline unsigned char lin_encode_MU_LAW(int val)
+{
+	int mask, seg;
+
+	if (val < 0) {
+		val = 0x84 - val;
+		mask = 0x7f;
+	} else {
+		val += 0x84;
+		mask = 0xff;
+	}
+	if (val > 0x7fff)
+		val = 0x7fff;
+	seg = lin_g711_seg[val >> 8];
+	return ((seg << 4) | ((val >> (seg + 3)) & 0x0f)) ^ mask;
+}
+
+static inline unsigned char lin_encode_A_LAW(int val)
+{
+	int mask, seg;
+
+	if (val >= 0) {
+		mask = 0xd5;
+	} else {
+		mask = 0x55;
+		val = -val;
+		if (val > 0x7fff)
+			val = 0x7fff;
+	}
+	if (val < 0x100)
+		return (val >> 4) ^ mask;
+	seg = lin_g711_seg[val >> 8];
+	return ((seg << 4) | ((val >> (seg + 3)) & 0x0f)) ^ mask;
+}
+
+#define LIN_G711_FORMATS(M)	M(MU_LAW) M(A_LAW)
+
+#define LIN_G711_KERNELS(c, i) \
+static void lin_##c##_##i(char *dst, int dst_step, const char *src, \
+			  int src_step, snd_pcm_uframes_t samples) \
+{ \
+	const unsigned char *sp = (const unsigned char *)src; \
+	unsigned char *dp = (unsigned char *)dst; \
+	while (samples-- > 0) { \
+		lin_store_##i(dp, (uint32_t)lin_decode_##c[*sp] << 16); \
+		sp += src_step; \
+		dp += dst_step; \
+	} \
+} \
+static void lin_##i##_##c(char *dst, int dst_step, const char *src, \
+			  int src_step, snd_pcm_uframes_t samples) \
+{ \
+	const unsigned char *sp = (const unsigned char *)src; \
+	unsigned char *dp = (unsigned char *)dst; \
+	while (samples-- > 0) { \
+		*dp = lin_encode_##c((int32_t)lin_load_##i(sp) >> 16); \
+		sp += src_step; \
+		dp += dst_step; \
+	} \
+}
+#define LIN_G711_KERNEL_ROW(c)	LIN_DST_FORMATS(LIN_G711_KERNELS, c)
+LIN_G711_FORMATS(LIN_G711_KERNEL_ROW)
+
+enum { LIN_BYTES_MU_LAW = 1, LIN_BYTES_A_LAW = 1 };
+
+static const snd_pcm_format_t lin_g711_formats[] = {
+	LIN_G711_FORMATS(LIN_FORMAT_ENTRY)
+};
+#define LIN_NG711_FORMATS \
+	(sizeof(lin_g711_formats) / sizeof(lin_g711_formats[0]))
+
+/* indexed by [companded format][linear format] like the float tables */
+static const snd_pcm_simd_convert_t lin_from_g711_kernels[][LIN_NFORMATS] = {
+	LIN_G711_FORMATS(LIN_FROM_ROW)
+};
+
+static const snd_pcm_simd_convert_t lin_to_g711_kernels[][LIN_NFORMATS] = {
+	LIN_G711_FORMATS(LIN_TO_ROW)
+};
+
+static int lin_g711_index(snd_pcm_format_t format)
+{
+	unsigned int i;
+
+	for (i = 0; i < LIN_NG711_FORMATS; i++)
+		if (lin_g711_formats[i] == format)
+			return i;
+	return -1;
+}
+#ifdef HAVE_X86_SIMD
+
+/*
+ * The vector kernels convert the contiguous part and leave the rest and
+ * any strided call to the generic loop of the same pair.  The AVX2 ones
+ * clear the upper lanes first: gcc turns the call into a tail jump
+ * without its own vzeroupper and the SSE code behind it then pays the
+ * state transition on every call.
+ */
+#define LIN_VECTOR_LEAVE(name, isa, s, d, vsamples, leave, body) \
+static SND_PCM_SIMD_TARGET(isa) \
+void lin_##name(char *dst, int dst_step, const char *src, int src_step, \
+		snd_pcm_uframes_t samples) \
+{ \
+	snd_pcm_uframes_t n = 0; \
+	if (dst_step == LIN_BYTES_##d && src_step == LIN_BYTES_##s) { \
+		for (; n + (vsamples) <= samples; n += (vsamples)) { \
+			const char *sp = src + n * LIN_BYTES_##s; \
+			char *dp = dst + n * LIN_BYTES_##d; \
+			body \
+		} \
+	} \
+	leave \
+	lin_##s##_##d(dst + n * dst_step, dst_step, src + n * src_step, \
+		      src_step, samples - n); \
+}
+#define LIN_VECTOR(name, isa, s, d, vsamples, body) \
+	LIN_VECTOR_LEAVE(name, isa, s, d, vsamples, , body)
+#define LIN_AVX2(name, s, d, vsamples, body) \
+	LIN_VECTOR_LEAVE(name, "avx2", s, d, vsamples, _mm256_zeroupper();, body)
+
+#define LD128(p)	_mm_loadu_si128((const __m128i *)(p))
+#define ST128(p, v)	_mm_storeu_si128((__m128i *)(p), v)
+#define LD256(p)	_mm256_loadu_si256((const __m256i *)(p))
+#define ST256(p, v)	_mm256_storeu_si256((__m256i *)(p), v)
+
+static inline SND_PCM_SIMD_TARGET("sse2")
+__m128i lin_bswap16_sse2(__m128i x)
+{
+	return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+static inline SND_PCM_SIMD_TARGET("sse2")
+__m128i lin_bswap32_sse2(__m128i x)
+{
+	x = _mm_shufflelo_epi16(x, 0xb1);
+	x = _mm_shufflehi_epi16(x, 0xb1);
+	return lin_bswap16_sse2(x);
+}
+
+/* 16 bytes holding four packed 24-bit samples (12 used) <-> four int32
+ * aligned to the MSB
+ */
+static inline SND_PCM_SIMD_TARGET("ssse3")
+__m128i lin_load24x4(const char *p)
+{
+	int32_t last;
+	__m128i x;
+
+	memcpy(&last, p + 8, 4);
+	x = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)p),
+			       _mm_cvtsi32_si128(last));
+	return _mm_shuffle_epi8(x, _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+						 -1, 6, 7, 8, -1, 9, 10, 11));
+}
+
+static inline SND_PCM_SIMD_TARGET("ssse3")
+void lin_store24x4(char *p, __m128i x)
+{
+	int32_t last;
+
+	x = _mm_shuffle_epi8(x, _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10,
+					      11, 13, 14, 15, -1, -1, -1, -1));
+	_mm_storel_epi64((__m128i *)p, x);
+	last = _mm_cvtsi128_si32(_mm_srli_si128(x, 8));
+	memcpy(p + 8, &last, 4);
+}
+
+LIN_VECTOR(S16_LE_S32_LE_sse2, "sse2", S16_LE, S32_LE, 8,
+	__m128i x = LD128(sp);
+	ST128(dp, _mm_unpacklo_epi16(_mm_setzero_si128(), x));
+	ST128(dp + 16, _mm_unpackhi_epi16(_mm_setzero_si128(), x));
+)
+LIN_VECTOR(S32_LE_S16_LE_sse2, "sse2", S32_LE, S16_LE, 8,
+	ST128(dp, _mm_packs_epi32(_mm_srai_epi32(LD128(sp), 16),
+				  _mm_srai_epi32(LD128(sp + 16), 16)));
+)
+LIN_VECTOR(S16_LE_S24_LE_sse2, "sse2", S16_LE, S24_LE, 8,
+	__m128i x = LD128(sp);
+	ST128(dp, _mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), x), 8));
+	ST128(dp + 16, _mm_srai_epi32(_mm_unpackhi_epi16(_mm_setzero_si128(), x), 8));
+)
+LIN_VECTOR(S24_LE_S16_LE_sse2, "sse2", S24_LE, S16_LE, 8,
+	__m128i a = _mm_srai_epi32(_mm_slli_epi32(LD128(sp), 8), 16);
+	__m128i b = _mm_srai_epi32(_mm_slli_epi32(LD128(sp + 16), 8), 16);
+	ST128(dp, _mm_packs_epi32(a, b));
+)
+LIN_VECTOR(S24_LE_S32_LE_sse2, "sse2", S24_LE, S32_LE, 4,
+	ST128(dp, _mm_slli_epi32(LD128(sp), 8));
+)
+LIN_VECTOR(S32_LE_S24_LE_sse2, "sse2", S32_LE, S24_LE, 4,
+	ST128(dp, _mm_srai_epi32(LD128(sp), 8));
+)
+LIN_VECTOR(U8_S16_LE_sse2, "sse2", U8, S16_LE, 16,
+	__m128i x = _mm_xor_si128(LD128(sp), _mm_set1_epi8((char)0x80));
+	ST128(dp, _mm_unpacklo_epi8(_mm_setzero_si128(), x));
+	ST128(dp + 16, _mm_unpackhi_epi8(_mm_setzero_si128(), x));
+)
+LIN_VECTOR(S16_LE_U8_sse2, "sse2", S16_LE, U8, 16,
+	__m128i x = _mm_packs_epi16(_mm_srai_epi16(LD128(sp), 8),
+				    _mm_srai_epi16(LD128(sp + 16), 8));
+	ST128(dp, _mm_xor_si128(x, _mm_set1_epi8((char)0x80)));
+)
+LIN_VECTOR(S16_LE_U16_LE_sse2, "sse2", S16_LE, U16_LE, 8,
+	ST128(dp, _mm_xor_si128(LD128(sp), _mm_set1_epi16((short)0x8000)));
+)
+LIN_VECTOR(U16_LE_S16_LE_sse2, "sse2", U16_LE, S16_LE, 8,
+	ST128(dp, _mm_xor_si128(LD128(sp), _mm_set1_epi16((short)0x8000)));
+)
+LIN_VECTOR(S16_LE_S16_BE_sse2, "sse2", S16_LE, S16_BE, 8,
+	ST128(dp, lin_bswap16_sse2(LD128(sp)));
+)
+LIN_VECTOR(S16_BE_S16_LE_sse2, "sse2", S16_BE, S16_LE, 8,
+	ST128(dp, lin_bswap16_sse2(LD128(sp)));
+)
+LIN_VECTOR(S32_LE_S32_BE_sse2, "sse2", S32_LE, S32_BE, 4,
+	ST128(dp, lin_bswap32_sse2(LD128(sp)));
+)
+LIN_VECTOR(S32_BE_S32_LE_sse2, "sse2", S32_BE, S32_LE, 4,
+	ST128(dp, lin_bswap32_sse2(LD128(sp)));
+)
+LIN_VECTOR(S24_3LE_S32_LE_ssse3, "ssse3", S24_3LE, S32_LE, 4,
+	ST128(dp, lin_load24x4(sp));
+)
+LIN_VECTOR(S32_LE_S24_3LE_ssse3, "ssse3", S32_LE, S24_3LE, 4,
+	lin_store24x4(dp, LD128(sp));
+)
+LIN_VECTOR(S24_3LE_S16_LE_ssse3, "ssse3", S24_3LE, S16_LE, 8,
+	__m128i a = _mm_srai_epi32(lin_load24x4(sp), 16);
+	__m128i b = _mm_srai_epi32(lin_load24x4(sp + 12), 16);
+	ST128(dp, _mm_packs_epi32(a, b));
+)
+LIN_VECTOR(S16_LE_S24_3LE_ssse3, "ssse3", S16_LE, S24_3LE, 8,
+	__m128i x = LD128(sp);
+	lin_store24x4(dp, _mm_unpacklo_epi16(_mm_setzero_si128(), x));
+	lin_store24x4(dp + 12, _mm_unpackhi_epi16(_mm_setzero_si128(), x));
+)
+LIN_VECTOR(S24_3LE_S24_LE_ssse3, "ssse3", S24_3LE, S24_LE, 4,
+	ST128(dp, _mm_srai_epi32(lin_load24x4(sp), 8));
+)
+LIN_VECTOR(S24_LE_S24_3LE_ssse3, "ssse3", S24_LE, S24_3LE, 4,
+	lin_store24x4(dp, _mm_slli_epi32(LD128(sp), 8));
+)
+LIN_AVX2(S16_LE_S32_LE_avx2, S16_LE, S32_LE, 8,
+	ST256(dp, _mm256_slli_epi32(_mm256_cvtepi16_epi32(LD128(sp)), 16));
+)
+LIN_AVX2(S32_LE_S16_LE_avx2, S32_LE, S16_LE, 16,
+	__m256i x = _mm256_packs_epi32(_mm256_srai_epi32(LD256(sp), 16),
+				       _mm256_srai_epi32(LD256(sp + 32), 16));
+	ST256(dp, _mm256_permute4x64_epi64(x, 0xd8));
+)
+LIN_AVX2(S16_LE_S24_LE_avx2, S16_LE, S24_LE, 8,
+	ST256(dp, _mm256_slli_epi32(_mm256_cvtepi16_epi32(LD128(sp)), 8));
+)
+LIN_AVX2(S24_LE_S32_LE_avx2, S24_LE, S32_LE, 8,
+	ST256(dp, _mm256_slli_epi32(LD256(sp), 8));
+)
+LIN_AVX2(S32_LE_S24_LE_avx2, S32_LE, S24_LE, 8,
+	ST256(dp, _mm256_srai_epi32(LD256(sp), 8));
+)
+LIN_AVX2(S16_LE_U16_LE_avx2, S16_LE, U16_LE, 16,
+	ST256(dp, _mm256_xor_si256(LD256(sp), _mm256_set1_epi16((short)0x8000)));
+)
+LIN_AVX2(U16_LE_S16_LE_avx2, U16_LE, S16_LE, 16,
+	ST256(dp, _mm256_xor_si256(LD256(sp), _mm256_set1_epi16((short)0x8000)));
+)
+LIN_AVX2(S16_LE_S16_BE_avx2, S16_LE, S16_BE, 16,
+	__m256i x = LD256(sp);
+	ST256(dp, _mm256_or_si256(_mm256_slli_epi16(x, 8), _mm256_srli_epi16(x, 8)));
+)
+LIN_AVX2(S16_BE_S16_LE_avx2, S16_BE, S16_LE, 16,
+	__m256i x = LD256(sp);
+	ST256(dp, _mm256_or_si256(_mm256_slli_epi16(x, 8), _mm256_srli_epi16(x, 8)));
+)
+#define LIN_BSWAP32_AVX2 \
+	_mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, \
+			 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+LIN_AVX2(S32_LE_S32_BE_avx2, S32_LE, S32_BE, 8,
+	ST256(dp, _mm256_shuffle_epi8(LD256(sp), LIN_BSWAP32_AVX2));
+)
+LIN_AVX2(S32_BE_S32_LE_avx2, S32_BE, S32_LE, 8,
+	ST256(dp, _mm256_shuffle_epi8(LD256(sp), LIN_BSWAP32_AVX2));
+)
+
+/* floats -> int32 rounded to 'bits' bits and saturated, NaN -> 0; with
+ * 32 bits the only overflow left is +1.0 and up, which cvtps turns into
+ * 0x80000000 and the compare mask flips to 0x7fffffff
+ */
+static inline SND_PCM_SIMD_TARGET("sse2")
+__m128i lin_ps_to_int_sse2(__m128 x, unsigned int bits)
+{
+	const float max = (float)(1U << (bits - 1));
+
+	x = _mm_and_ps(x, _mm_cmpord_ps(x, x));
+	x = _mm_mul_ps(x, _mm_set1_ps(max));
+	if (bits == 32)
+		return _mm_xor_si128(_mm_cvtps_epi32(x),
+				     _mm_castps_si128(_mm_cmpge_ps(x, _mm_set1_ps(max))));
+	x = _mm_min_ps(x, _mm_set1_ps(max - 1));
+	x = _mm_max_ps(x, _mm_set1_ps(-max));
+	return _mm_cvtps_epi32(x);
+}
+
+/* two doubles -> two int32 in the low half */
+static inline SND_PCM_SIMD_TARGET("sse2")
+__m128i lin_pd_to_int_sse2(__m128d x, unsigned int bits)
+{
+	const double max = (double)(1U << (bits - 1));
+
+	x = _mm_and_pd(x, _mm_cmpord_pd(x, x));
+	x = _mm_mul_pd(x, _mm_set1_pd(max));
+	x = _mm_min_pd(x, _mm_set1_pd(max - 1));
+	x = _mm_max_pd(x, _mm_set1_pd(-max));
+	return _mm_cvtpd_epi32(x);
+}
+
+static inline SND_PCM_SIMD_TARGET("avx2")
+__m256i lin_ps_to_int_avx2(__m256 x, unsigned int bits)
+{
+	const float max = (float)(1U << (bits - 1));
+
+	x = _mm256_and_ps(x, _mm256_cmp_ps(x, x, _CMP_ORD_Q));
+	x = _mm256_mul_ps(x, _mm256_set1_ps(max));
+	if (bits == 32)
+		return _mm256_xor_si256(_mm256_cvtps_epi32(x),
+					_mm256_castps_si256(_mm256_cmp_ps(x, _mm256_set1_ps(max), _CMP_GE_OQ)));
+	x = _mm256_min_ps(x, _mm256_set1_ps(max - 1));
+	x = _mm256_max_ps(x, _mm256_set1_ps(-max));
+	return _mm256_cvtps_epi32(x);
+}
+
+static inline SND_PCM_SIMD_TARGET("avx2")
+__m128i lin_pd_to_int_avx2(__m256d x, unsigned int bits)
+{
+	const double max = (double)(1U << (bits - 1));
+
+	x = _mm256_and_pd(x, _mm256_cmp_pd(x, x, _CMP_ORD_Q));
+	x = _mm256_mul_pd(x, _mm256_set1_pd(max));
+	x = _mm256_min_pd(x, _mm256_set1_pd(max - 1));
+	x = _mm256_max_pd(x, _mm256_set1_pd(-max));
+	return _mm256_cvtpd_epi32(x);
+}
+
+/*
+ * The loads give int32 aligned to the MSB, the stores take values already
+ * rounded to the width of the format.  Four samples for SSE, eight for
+ * AVX2; both handle FLOAT_LE and FLOAT64_LE.
+ */
+#define LIN_FLOAT_SSE(i, isa, load, store) \
+static inline SND_PCM_SIMD_TARGET(isa) __m128i lin_load4_##i(const char *p) \
+{ \
+	return load; \
+} \
+static inline SND_PCM_SIMD_TARGET(isa) void lin_store4_##i(char *p, __m128i x) \
+{ \
+	store; \
+} \
+LIN_VECTOR(FLOAT_LE_##i##_sse, isa, FLOAT_LE, i, 4, \
+	lin_store4_##i(dp, lin_ps_to_int_sse2(_mm_loadu_ps((const float *)sp), \
+					      LIN_BITS_##i)); \
+) \
+LIN_VECTOR(i##_FLOAT_LE_sse, isa, i, FLOAT_LE, 4, \
+	_mm_storeu_ps((float *)dp, \
+		      _mm_mul_ps(_mm_cvtepi32_ps(lin_load4_##i(sp)), \
+				 _mm_set1_ps(1.0f / 2147483648.0f))); \
+) \
+LIN_VECTOR(FLOAT64_LE_##i##_sse, isa, FLOAT64_LE, i, 4, \
+	__m128i a = lin_pd_to_int_sse2(_mm_loadu_pd((const double *)sp), \
+				       LIN_BITS_##i); \
+	__m128i b = lin_pd_to_int_sse2(_mm_loadu_pd((const double *)(sp + 16)), \
+				       LIN_BITS_##i); \
+	lin_store4_##i(dp, _mm_unpacklo_epi64(a, b)); \
+) \
+LIN_VECTOR(i##_FLOAT64_LE_sse, isa, i, FLOAT64_LE, 4, \
+	__m128i x = lin_load4_##i(sp); \
+	__m128d k = _mm_set1_pd(1.0 / 2147483648.0); \
+	_mm_storeu_pd((double *)dp, _mm_mul_pd(_mm_cvtepi32_pd(x), k)); \
+	_mm_storeu_pd((double *)(dp + 16), \
+		      _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(x, 8)), k)); \
+)
+
+LIN_FLOAT_SSE(S16_LE, "sse2",
+	_mm_unpacklo_epi16(_mm_setzero_si128(), _mm_loadl_epi64((const __m128i *)p)),
+	_mm_storel_epi64((__m128i *)p, _mm_packs_epi32(x, x)))
+LIN_FLOAT_SSE(S16_BE, "sse2",
+	_mm_unpacklo_epi16(_mm_setzero_si128(),
+			   lin_bswap16_sse2(_mm_loadl_epi64((const __m128i *)p))),
+	_mm_storel_epi64((__m128i *)p, lin_bswap16_sse2(_mm_packs_epi32(x, x))))
+LIN_FLOAT_SSE(S24_LE, "sse2",
+	_mm_slli_epi32(LD128(p), 8),
+	ST128(p, x))
+LIN_FLOAT_SSE(S24_3LE, "ssse3",
+	lin_load24x4(p),
+	lin_store24x4(p, _mm_slli_epi32(x, 8)))
+LIN_FLOAT_SSE(S32_LE, "sse2",
+	LD128(p),
+	ST128(p, x))
+LIN_FLOAT_SSE(S32_BE, "sse2",
+	lin_bswap32_sse2(LD128(p)),
+	ST128(p, lin_bswap32_sse2(x)))
+
+#define LIN_FLOAT_AVX2(i, load, store) \
+static inline SND_PCM_SIMD_TARGET("avx2") __m256i lin_load8_##i(const char *p) \
+{ \
+	return load; \
+} \
+static inline SND_PCM_SIMD_TARGET("avx2") void lin_store8_##i(char *p, __m256i x) \
+{ \
+	store; \
+} \
+LIN_AVX2(FLOAT_LE_##i##_avx2, FLOAT_LE, i, 8, \
+	lin_store8_##i(dp, lin_ps_to_int_avx2(_mm256_loadu_ps((const float *)sp), \
+					      LIN_BITS_##i)); \
+) \
+LIN_AVX2(i##_FLOAT_LE_avx2, i, FLOAT_LE, 8, \
+	_mm256_storeu_ps((float *)dp, \
+			 _mm256_mul_ps(_mm256_cvtepi32_ps(lin_load8_##i(sp)), \
+				       _mm256_set1_ps(1.0f / 2147483648.0f))); \
+) \
+LIN_AVX2(FLOAT64_LE_##i##_avx2, FLOAT64_LE, i, 8, \
+	__m128i a = lin_pd_to_int_avx2(_mm256_loadu_pd((const double *)sp), \
+				       LIN_BITS_##i); \
+	__m128i b = lin_pd_to_int_avx2(_mm256_loadu_pd((const double *)(sp + 32)), \
+				       LIN_BITS_##i); \
+	lin_store8_##i(dp, _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1)); \
+) \
+LIN_AVX2(i##_FLOAT64_LE_avx2, i, FLOAT64_LE, 8, \
+	__m256i x = lin_load8_##i(sp); \
+	__m256d k = _mm256_set1_pd(1.0 / 2147483648.0); \
+	_mm256_storeu_pd((double *)dp, \
+			 _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(x)), k)); \
+	_mm256_storeu_pd((double *)(dp + 32), \
+			 _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1)), k)); \
+)
+
+LIN_FLOAT_AVX2(S16_LE,
+	_mm256_slli_epi32(_mm256_cvtepi16_epi32(LD128(p)), 16),
+	ST128(p, _mm256_castsi256_si128(
+		_mm256_permute4x64_epi64(_mm256_packs_epi32(x, x), 0x08))))
+LIN_FLOAT_AVX2(S16_BE,
+	_mm256_slli_epi32(_mm256_cvtepi16_epi32(lin_bswap16_sse2(LD128(p))), 16),
+	ST128(p, lin_bswap16_sse2(_mm256_castsi256_si128(
+		_mm256_permute4x64_epi64(_mm256_packs_epi32(x, x), 0x08)))))
+LIN_FLOAT_AVX2(S24_LE,
+	_mm256_slli_epi32(LD256(p), 8),
+	ST256(p, x))
+LIN_FLOAT_AVX2(S24_3LE,
+	_mm256_inserti128_si256(_mm256_castsi128_si256(lin_load24x4(p)),
+				lin_load24x4(p + 12), 1),
+	lin_store24x4(p, _mm_slli_epi32(_mm256_castsi256_si128(x), 8));
+	lin_store24x4(p + 12, _mm_slli_epi32(_mm256_extracti128_si256(x, 1), 8)))
+LIN_FLOAT_AVX2(S32_LE,
+	LD256(p),
+	ST256(p, x))
+LIN_FLOAT_AVX2(S32_BE,
+	_mm256_shuffle_epi8(LD256(p), LIN_BSWAP32_AVX2),
+	ST256(p, _mm256_shuffle_epi8(x, LIN_BSWAP32_AVX2)))
+
+/*
+ * The vector encoders get the segment from the exponent of the magnitude
+ * converted to float, which is exact below 2^24, and shift the mantissa
+ * down by multiplying with the matching power of two.
+ */
+static inline SND_PCM_SIMD_TARGET("sse2")
+__m128i lin_max_epi32_sse2(__m128i a, __m128i b)
+{
+	__m128i gt = _mm_cmpgt_epi32(a, b);
+	return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+/* four int16 in int32 lanes -> four codes in int32 lanes */
+static inline SND_PCM_SIMD_TARGET("sse2")
+__m128i lin_encode_MU_LAW_sse2(__m128i x)
+{
+	__m128i neg = _mm_srai_epi32(x, 31);
+	__m128i v, seg, scale;
+	__m128 f;
+
+	v = _mm_sub_epi32(_mm_xor_si128(x, neg), neg);
+	v = _mm_add_epi32(v, _mm_set1_epi32(0x84));
+	v = _mm_sub_epi32(_mm_set1_epi32(0x7fff),
+			  lin_max_epi32_sse2(_mm_sub_epi32(_mm_set1_epi32(0x7fff), v),
+					     _mm_setzero_si128()));
+	f = _mm_cvtepi32_ps(v);
+	seg = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(f), 23),
+			    _mm_set1_epi32(127 + 7));
+	scale = _mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127 - 3), seg), 23);
+	v = _mm_cvttps_epi32(_mm_mul_ps(f, _mm_castsi128_ps(scale)));
+	v = _mm_or_si128(_mm_slli_epi32(seg, 4),
+			 _mm_and_si128(v, _mm_set1_epi32(0x0f)));
+	return _mm_xor_si128(v, _mm_xor_si128(_mm_set1_epi32(0xff),
+					      _mm_and_si128(neg, _mm_set1_epi32(0x80))));
+}
+
+static inline SND_PCM_SIMD_TARGET("sse2")
+__m128i lin_encode_A_LAW_sse2(__m128i x)
+{
+	__m128i neg = _mm_srai_epi32(x, 31);
+	__m128i v, e, seg, scale;
+	__m128 f;
+
+	v = _mm_sub_epi32(_mm_xor_si128(x, neg), neg);
+	v = _mm_sub_epi32(v, _mm_srli_epi32(v, 15));	/* 0x8000 -> 0x7fff */
+	f = _mm_cvtepi32_ps(v);
+	e = _mm_srli_epi32(_mm_castps_si128(f), 23);
+	seg = lin_max_epi32_sse2(_mm_sub_epi32(e, _mm_set1_epi32(127 + 7)),
+				 _mm_setzero_si128());
+	/* the shift is seg + 3, but 4 for the first segment */
+	scale = lin_max_epi32_sse2(_mm_sub_epi32(e, _mm_set1_epi32(127 + 4)),
+				   _mm_set1_epi32(4));
+	scale = _mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127), scale), 23);
+	v = _mm_cvttps_epi32(_mm_mul_ps(f, _mm_castsi128_ps(scale)));
+	v = _mm_or_si128(_mm_slli_epi32(seg, 4),
+			 _mm_and_si128(v, _mm_set1_epi32(0x0f)));
+	return _mm_xor_si128(v, _mm_xor_si128(_mm_set1_epi32(0xd5),
+					      _mm_and_si128(neg, _mm_set1_epi32(0x80))));
+}
+
+static inline SND_PCM_SIMD_TARGET("avx2")
+__m256i lin_encode_MU_LAW_avx2(__m256i x)
+{
+	__m256i neg = _mm256_srai_epi32(x, 31);
+	__m256i v, seg, scale;
+	__m256 f;
+
+	v = _mm256_add_epi32(_mm256_abs_epi32(x), _mm256_set1_epi32(0x84));
+	v = _mm256_min_epi32(v, _mm256_set1_epi32(0x7fff));
+	f = _mm256_cvtepi32_ps(v);
+	seg = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(f), 23),
+			       _mm256_set1_epi32(127 + 7));
+	scale = _mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(127 - 3), seg), 23);
+	v = _mm256_cvttps_epi32(_mm256_mul_ps(f, _mm256_castsi256_ps(scale)));
+	v = _mm256_or_si256(_mm256_slli_epi32(seg, 4),
+			    _mm256_and_si256(v, _mm256_set1_epi32(0x0f)));
+	return _mm256_xor_si256(v, _mm256_xor_si256(_mm256_set1_epi32(0xff),
+						    _mm256_and_si256(neg, _mm256_set1_epi32(0x80))));
+}
+
+static inline SND_PCM_SIMD_TARGET("avx2")
+__m256i lin_encode_A_LAW_avx2(__m256i x)
+{
+	__m256i neg = _mm256_srai_epi32(x, 31);
+	__m256i v, e, seg, scale;
+	__m256 f;
+
+	v = _mm256_min_epi32(_mm256_abs_epi32(x), _mm256_set1_epi32(0x7fff));
+	f = _mm256_cvtepi32_ps(v);
+	e = _mm256_srli_epi32(_mm256_castps_si256(f), 23);
+	seg = _mm256_max_epi32(_mm256_sub_epi32(e, _mm256_set1_epi32(127 + 7)),
+			       _mm256_setzero_si256());
+	scale = _mm256_max_epi32(_mm256_sub_epi32(e, _mm256_set1_epi32(127 + 4)),
+				 _mm256_set1_epi32(4));
+	scale = _mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(127), scale), 23);
+	v = _mm256_cvttps_epi32(_mm256_mul_ps(f, _mm256_castsi256_ps(scale)));
+	v = _mm256_or_si256(_mm256_slli_epi32(seg, 4),
+			    _mm256_and_si256(v, _mm256_set1_epi32(0x0f)));
+	return _mm256_xor_si256(v, _mm256_xor_si256(_mm256_set1_epi32(0xd5),
+						    _mm256_and_si256(neg, _mm256_set1_epi32(0x80))));
+}
+
+/* eight codes -> eight sign extended values, the table has one entry of
+ * padding as the gather reads 32 bits
+ */
+static inline SND_PCM_SIMD_TARGET("avx2")
+__m256i lin_decode8_avx2(const int16_t *table, const char *p)
+{
+	__m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+	__m256i x = _mm256_i32gather_epi32((const int *)table, idx, 2);
+	return _mm256_srai_epi32(_mm256_slli_epi32(x, 16), 16);
+}
+
+#define LIN_G711_VECTOR(c) \
+LIN_VECTOR(S16_LE_##c##_sse2, "sse2", S16_LE, c, 8, \
+	__m128i x = LD128(sp); \
+	__m128i a = lin_encode_##c##_sse2(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)); \
+	__m128i b = lin_encode_##c##_sse2(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)); \
+	a = _mm_packs_epi32(a, b); \
+	_mm_storel_epi64((__m128i *)dp, _mm_packus_epi16(a, a)); \
+) \
+LIN_AVX2(S16_LE_##c##_avx2, S16_LE, c, 16, \
+	__m256i x = LD256(sp); \
+	__m256i a = lin_encode_##c##_avx2(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(x))); \
+	__m256i b = lin_encode_##c##_avx2(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1))); \
+	a = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8); \
+	a = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, a), 0x08); \
+	ST128(dp, _mm256_castsi256_si128(a)); \
+) \
+LIN_AVX2(c##_S16_LE_avx2, c, S16_LE, 16, \
+	__m256i a = lin_decode8_avx2(lin_decode_##c, sp); \
+	__m256i b = lin_decode8_avx2(lin_decode_##c, sp + 8); \
+	ST256(dp, _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8)); \
+)
+LIN_G711_VECTOR(MU_LAW)
+LIN_G711_VECTOR(A_LAW)
+
+/* in order of preference */
+static const struct lin_vector_kernel {
+	snd_pcm_format_t src, dst;
+	unsigned int caps;
+	snd_pcm_simd_convert_t func;
+} lin_vector_kernels[] = {
+#define LIN_ENTRY(s, d, isa, caps) \
+	{ SND_PCM_FORMAT_##s, SND_PCM_FORMAT_##d, caps, lin_##s##_##d##_##isa }
+	LIN_ENTRY(S16_LE, S32_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(S32_LE, S16_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(S16_LE, S24_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(S24_LE, S32_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(S32_LE, S24_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(S16_LE, U16_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(U16_LE, S16_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(S16_LE, S16_BE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(S16_BE, S16_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(S32_LE, S32_BE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(S32_BE, S32_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(S24_3LE, S32_LE, ssse3, SND_PCM_SIMD_SSSE3),
+	LIN_ENTRY(S32_LE, S24_3LE, ssse3, SND_PCM_SIMD_SSSE3),
+	LIN_ENTRY(S24_3LE, S16_LE, ssse3, SND_PCM_SIMD_SSSE3),
+	LIN_ENTRY(S16_LE, S24_3LE, ssse3, SND_PCM_SIMD_SSSE3),
+	LIN_ENTRY(S24_3LE, S24_LE, ssse3, SND_PCM_SIMD_SSSE3),
+	LIN_ENTRY(S24_LE, S24_3LE, ssse3, SND_PCM_SIMD_SSSE3),
+	LIN_ENTRY(S16_LE, S32_LE, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(S32_LE, S16_LE, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(S16_LE, S24_LE, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(S24_LE, S16_LE, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(S24_LE, S32_LE, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(S32_LE, S24_LE, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(U8, S16_LE, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(S16_LE, U8, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(S16_LE, U16_LE, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(U16_LE, S16_LE, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(S16_LE, S16_BE, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(S16_BE, S16_LE, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(S32_LE, S32_BE, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(S32_BE, S32_LE, sse2, SND_PCM_SIMD_SSE2),
+#define LIN_FLOAT_ENTRIES(i, isa, caps) \
+	LIN_ENTRY(FLOAT_LE, i, isa, caps), \
+	LIN_ENTRY(i, FLOAT_LE, isa, caps), \
+	LIN_ENTRY(FLOAT64_LE, i, isa, caps), \
+	LIN_ENTRY(i, FLOAT64_LE, isa, caps)
+	LIN_FLOAT_ENTRIES(S16_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_FLOAT_ENTRIES(S16_BE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_FLOAT_ENTRIES(S24_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_FLOAT_ENTRIES(S24_3LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_FLOAT_ENTRIES(S32_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_FLOAT_ENTRIES(S32_BE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_FLOAT_ENTRIES(S24_3LE, sse, SND_PCM_SIMD_SSSE3),
+	LIN_FLOAT_ENTRIES(S16_LE, sse, SND_PCM_SIMD_SSE2),
+	LIN_FLOAT_ENTRIES(S16_BE, sse, SND_PCM_SIMD_SSE2),
+	LIN_FLOAT_ENTRIES(S24_LE, sse, SND_PCM_SIMD_SSE2),
+	LIN_FLOAT_ENTRIES(S32_LE, sse, SND_PCM_SIMD_SSE2),
+	LIN_FLOAT_ENTRIES(S32_BE, sse, SND_PCM_SIMD_SSE2),
+#undef LIN_FLOAT_ENTRIES
+	LIN_ENTRY(MU_LAW, S16_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(A_LAW, S16_LE, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(S16_LE, MU_LAW, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(S16_LE, A_LAW, avx2, SND_PCM_SIMD_AVX2),
+	LIN_ENTRY(S16_LE, MU_LAW, sse2, SND_PCM_SIMD_SSE2),
+	LIN_ENTRY(S16_LE, A_LAW, sse2, SND_PCM_SIMD_SSE2),
+#undef LIN_ENTRY
+};
+
+#endif /* HAVE_X86_SIMD */
+
+static snd_pcm_simd_convert_t lin_vector_kernel(snd_pcm_format_t src_format,
+						snd_pcm_format_t dst_format)
+{
+#ifdef HAVE_X86_SIMD
+	unsigned int caps = snd_pcm_simd_caps();
+	unsigned int k;
+
+	for (k = 0; k < sizeof(lin_vector_kernels) / sizeof(lin_vector_kernels[0]); k++) {
+		const struct lin_vector_kernel *v = &lin_vector_kernels[k];
+		if (v->src == src_format && v->dst == dst_format &&
+		    (v->caps & caps) == v->caps)
+			return v->func;
+	}
+#endif
+	return NULL;
+}
+
+snd_pcm_simd_convert_t snd_pcm_simd_linear_kernel(snd_pcm_format_t src_format,
+						  snd_pcm_format_t dst_format)
+{
+	int s = lin_format_index(src_format);
+	int d = lin_format_index(dst_format);
+	snd_pcm_simd_convert_t func;
+
+	if (s < 0 || d < 0)
+		return NULL;
+	func = lin_vector_kernel(src_format, dst_format);
+	return func ? func : lin_kernels[s][d];
+}
+
+snd_pcm_simd_convert_t snd_pcm_simd_float_kernel(snd_pcm_format_t src_format,
+						 snd_pcm_format_t dst_format)
+{
+	snd_pcm_simd_convert_t func;
+	int f, i;
+
+	f = lin_float_index(src_format);
+	if (f >= 0) {
+		i = lin_format_index(dst_format);
+		if (i < 0)
+			return NULL;
+		func = lin_vector_kernel(src_format, dst_format);
+		return func ? func : lin_from_float_kernels[f][i];
+	}
+	f = lin_float_index(dst_format);
+	i = lin_format_index(src_format);
+	if (f < 0 || i < 0)
+		return NULL;
+	func = lin_vector_kernel(src_format, dst_format);
+	return func ? func : lin_to_float_kernels[f][i];
+}
+
+snd_pcm_simd_convert_t snd_pcm_simd_g711_kernel(snd_pcm_format_t src_format,
+						snd_pcm_format_t dst_format)
+{
+	snd_pcm_simd_convert_t func;
+	int c, i;
+
+	c = lin_g711_index(src_format);
+	if (c >= 0) {
+		i = lin_format_index(dst_format);
+		if (i < 0)
+			return NULL;
+		func = lin_vector_kernel(src_format, dst_format);
+		return func ? func : lin_from_g711_kernels[c][i];
+	}
+	c = lin_g711_index(dst_format);
+	i = lin_format_index(src_format);
+	if (c < 0 || i < 0)
+		return NULL;
+	func = lin_vector_kernel(src_format, dst_format);
+	return func ? func : lin_to_g711_kernels[c][i];
+}
+
+/* are all channels interleaved in one buffer in their natural order? */
+static int areas_packed(const snd_pcm_channel_area_t *areas,
+			unsigned int channels, unsigned int width)
+{
+	unsigned int channel;
+
+	for (channel = 0; channel < channels; ++channel) {
+		if (areas[channel].addr != areas[0].addr ||
+		    areas[channel].first != areas[0].first + channel * width ||
+		    areas[channel].step != channels * width)
+			return 0;
+	}
+	return areas[0].first % 8 == 0;
+}
+
+void snd_pcm_simd_convert_areas(snd_pcm_simd_convert_t kernel,
+				const snd_pcm_channel_area_t *dst_areas,
+				snd_pcm_uframes_t dst_offset,
+				unsigned int dst_width,
+				const snd_pcm_channel_area_t *src_areas,
+				snd_pcm_uframes_t src_offset,
+				unsigned int src_width,
+				unsigned int channels, snd_pcm_uframes_t frames)
+{
+	unsigned int channel;
+
+	if (areas_packed(src_areas, channels, src_width) &&
+	    areas_packed(dst_areas, channels, dst_width)) {
+		kernel(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+		       dst_width / 8,
+		       snd_pcm_channel_area_addr(src_areas, src_offset),
+		       src_width / 8, frames * channels);
+		return;
+	}
+	for (channel = 0; channel < channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		kernel(snd_pcm_channel_area_addr(dst_area, dst_offset),
+		       snd_pcm_channel_area_step(dst_area),
+		       snd_pcm_channel_area_addr(src_area, src_offset),
+		       snd_pcm_channel_area_step(src_area), frames);
+	}
+}
+
+int snd_pcm_simd_areas_packed(const snd_pcm_channel_area_t *areas,
+			      unsigned int channels, unsigned int width)
+{
+	return areas_packed(areas, channels, width);
+}
+
+/*
+ * IEC958 subframes
+ *
+ * The parity bit covers the time slots 4 to 30; it is folded down from
+ * the whole word, the vector code does it with shifts.
+ */
+
+#define IEC958_DATA_MASK	0x0ffffff0U
+#define IEC958_PARITY_MASK	0x7ffffff0U
+
+static inline uint32_t iec958_encode_one(uint32_t sample, uint32_t status,
+					 int byteswap)
+{
+	uint32_t data = ((sample >> 4) & IEC958_DATA_MASK) | status;
+
+	if (__builtin_parity(data & IEC958_PARITY_MASK))
+		data |= 0x80000000U;
+	return byteswap ? bswap_32(data) : data;
+}
+
+static inline int32_t iec958_decode_one(uint32_t data, int byteswap)
+{
+	if (byteswap)
+		data = bswap_32(data);
+	return (int32_t)((data & ~0xfU) << 4);
+}
+
+static void iec958_encode_generic(uint32_t *buf, const uint32_t *status,
+				  unsigned int samples, int byteswap)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++)
+		buf[i] = iec958_encode_one(buf[i], status[i], byteswap);
+}
+
+static void iec958_decode_generic(int32_t *dst, const uint32_t *src,
+				  unsigned int samples, int byteswap)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++)
+		dst[i] = iec958_decode_one(src[i], byteswap);
+}
+
+#ifdef HAVE_X86_SIMD
+
+static inline SND_PCM_SIMD_TARGET("sse2") __m128i iec958_bswap_sse2(__m128i x)
+{
+	x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1);
+	return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+static inline SND_PCM_SIMD_TARGET("sse2") __m128i iec958_parity_sse2(__m128i x)
+{
+	__m128i p = _mm_and_si128(x, _mm_set1_epi32(IEC958_PARITY_MASK));
+
+	p = _mm_xor_si128(p, _mm_srli_epi32(p, 16));
+	p = _mm_xor_si128(p, _mm_srli_epi32(p, 8));
+	p = _mm_xor_si128(p, _mm_srli_epi32(p, 4));
+	p = _mm_xor_si128(p, _mm_srli_epi32(p, 2));
+	p = _mm_xor_si128(p, _mm_srli_epi32(p, 1));
+	return _mm_or_si128(x, _mm_slli_epi32(p, 31));
+}
+
+static SND_PCM_SIMD_TARGET("sse2")
+void iec958_encode_sse2(uint32_t *buf, const uint32_t *status,
+			unsigned int samples, int byteswap)
+{
+	const __m128i data_mask = _mm_set1_epi32(IEC958_DATA_MASK);
+	unsigned int i;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(buf + i));
+		x = _mm_and_si128(_mm_srli_epi32(x, 4), data_mask);
+		x = _mm_or_si128(x, _mm_loadu_si128((const __m128i *)(status + i)));
+		x = iec958_parity_sse2(x);
+		if (byteswap)
+			x = iec958_bswap_sse2(x);
+		_mm_storeu_si128((__m128i *)(buf + i), x);
+	}
+	iec958_encode_generic(buf + i, status + i, samples - i, byteswap);
+}
+
+static SND_PCM_SIMD_TARGET("sse2")
+void iec958_decode_sse2(int32_t *dst, const uint32_t *src,
+			unsigned int samples, int byteswap)
+{
+	const __m128i mask = _mm_set1_epi32(~0xff);
+	unsigned int i;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		if (byteswap)
+			x = iec958_bswap_sse2(x);
+		x = _mm_and_si128(_mm_slli_epi32(x, 4), mask);
+		_mm_storeu_si128((__m128i *)(dst + i), x);
+	}
+	iec958_decode_generic(dst + i, src + i, samples - i, byteswap);
+}
+
+static inline SND_PCM_SIMD_TARGET("avx2") __m256i iec958_bswap_avx2(__m256i x)
+{
+	const __m256i shuf = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+					      11, 10, 9, 8, 15, 14, 13, 12,
+					      3, 2, 1, 0, 7, 6, 5, 4,
+					      11, 10, 9, 8, 15, 14, 13, 12);
+
+	return _mm256_shuffle_epi8(x, shuf);
+}
+
+static inline SND_PCM_SIMD_TARGET("avx2") __m256i iec958_parity_avx2(__m256i x)
+{
+	__m256i p = _mm256_and_si256(x, _mm256_set1_epi32(IEC958_PARITY_MASK));
+
+	p = _mm256_xor_si256(p, _mm256_srli_epi32(p, 16));
+	p = _mm256_xor_si256(p, _mm256_srli_epi32(p, 8));
+	p = _mm256_xor_si256(p, _mm256_srli_epi32(p, 4));
+	p = _mm256_xor_si256(p, _mm256_srli_epi32(p, 2));
+	p = _mm256_xor_si256(p, _mm256_srli_epi32(p, 1));
+	return _mm256_or_si256(x, _mm256_slli_epi32(p, 31));
+}
+
+static SND_PCM_SIMD_TARGET("avx2")
+void iec958_encode_avx2(uint32_t *buf, const uint32_t *status,
+			unsigned int samples, int byteswap)
+{
+	const __m256i data_mask = _mm256_set1_epi32(IEC958_DATA_MASK);
+	unsigned int i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(buf + i));
+		x = _mm256_and_si256(_mm256_srli_epi32(x, 4), data_mask);
+		x = _mm256_or_si256(x, _mm256_loadu_si256((const __m256i *)(status + i)));
+		x = iec958_parity_avx2(x);
+		if (byteswap)
+			x = iec958_bswap_avx2(x);
+		_mm256_storeu_si256((__m256i *)(buf + i), x);
+	}
+	_mm256_zeroupper();
+	iec958_encode_generic(buf + i, status + i, samples - i, byteswap);
+}
+
+static SND_PCM_SIMD_TARGET("avx2")
+void iec958_decode_avx2(int32_t *dst, const uint32_t *src,
+			unsigned int samples, int byteswap)
+{
+	const __m256i mask = _mm256_set1_epi32(~0xff);
+	unsigned int i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+		if (byteswap)
+			x = iec958_bswap_avx2(x);
+		x = _mm256_and_si256(_mm256_slli_epi32(x, 4), mask);
+		_mm256_storeu_si256((__m256i *)(dst + i), x);
+	}
+	_mm256_zeroupper();
+	iec958_decode_generic(dst + i, src + i, samples - i, byteswap);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+void snd_pcm_simd_iec958_encode(uint32_t *buf, const uint32_t *status,
+				unsigned int samples, int byteswap)
+{
+#ifdef HAVE_X86_SIMD
+	unsigned int caps = snd_pcm_simd_caps();
+
+	if (caps & SND_PCM_SIMD_AVX2) {
+		iec958_encode_avx2(buf, status, samples, byteswap);
+		return;
+	}
+	if (caps & SND_PCM_SIMD_SSE2) {
+		iec958_encode_sse2(buf, status, samples, byteswap);
+		return;
+	}
+#endif
+	iec958_encode_generic(buf, status, samples, byteswap);
+}
+
+void snd_pcm_simd_iec958_decode(int32_t *dst, const uint32_t *src,
+				unsigned int samples, int byteswap)
+{
+#ifdef HAVE_X86_SIMD
+	unsigned int caps = snd_pcm_simd_caps();
+
+	if (caps & SND_PCM_SIMD_AVX2) {
+		iec958_decode_avx2(dst, src, samples, byteswap);
+		return;
+	}
+	if (caps & SND_PCM_SIMD_SSE2) {
+		iec958_decode_sse2(dst, src, samples, byteswap);
+		return;
+	}
+#endif
+	iec958_decode_generic(dst, src, samples, byteswap);
+}
+
+/*
+ * float blocks for mixing
+ *
+ * The integer samples are taken at their S32 value, unscaled.  The
+ * conversion back rounds to nearest and saturates.
+ */
+
+static void mix_s32_to_float_generic(float *dst, const int32_t *src,
+				     unsigned int samples)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++)
+		dst[i] = src[i];
+}
+
+static void mix_mac_generic(float *acc, const float *src, float gain,
+			    unsigned int samples)
+{
+	unsigned int i;
+
+	if (gain == 1.0f) {
+		for (i = 0; i < samples; i++)
+			acc[i] += src[i];
+	} else {
+		for (i = 0; i < samples; i++)
+			acc[i] += src[i] * gain;
+	}
+}
+
+static void mix_float_to_s32_generic(int32_t *dst, const float *src,
+				     unsigned int samples)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++) {
+		double v = rint(src[i]);
+		if (v >= 2147483648.0)
+			dst[i] = 0x7fffffff;
+		else if (v < -2147483648.0)
+			dst[i] = -0x7fffffff - 1;
+		else
+			dst[i] = v;
+	}
+}
+
+#ifdef HAVE_X86_SIMD
+
+static SND_PCM_SIMD_TARGET("sse2")
+void mix_s32_to_float_sse2(float *dst, const int32_t *src,
+			   unsigned int samples)
+{
+	unsigned int i;
+
+	for (i = 0; i + 4 <= samples; i += 4)
+		_mm_storeu_ps(dst + i,
+			      _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(src + i))));
+	mix_s32_to_float_generic(dst + i, src + i, samples - i);
+}
+
+static SND_PCM_SIMD_TARGET("sse2")
+void mix_mac_sse2(float *acc, const float *src, float gain,
+		  unsigned int samples)
+{
+	__m128 g = _mm_set1_ps(gain);
+	unsigned int i;
+
+	if (gain == 1.0f) {
+		for (i = 0; i + 4 <= samples; i += 4)
+			_mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i),
+							  _mm_loadu_ps(src + i)));
+	} else {
+		for (i = 0; i + 4 <= samples; i += 4)
+			_mm_storeu_ps(acc + i,
+				      _mm_add_ps(_mm_loadu_ps(acc + i),
+						 _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+	}
+	mix_mac_generic(acc + i, src + i, gain, samples - i);
+}
+
+/* out of range values convert to 0x80000000, flip the positive ones */
+static SND_PCM_SIMD_TARGET("sse2")
+void mix_float_to_s32_sse2(int32_t *dst, const float *src,
+			   unsigned int samples)
+{
+	const __m128 limit = _mm_set1_ps(2147483648.0f);
+	unsigned int i;
+
+	for (i = 0; i + 4 <= samples; i += 4) {
+		__m128 v = _mm_loadu_ps(src + i);
+		__m128i x = _mm_cvtps_epi32(v);
+		x = _mm_xor_si128(x, _mm_castps_si128(_mm_cmpge_ps(v, limit)));
+		_mm_storeu_si128((__m128i *)(dst + i), x);
+	}
+	mix_float_to_s32_generic(dst + i, src + i, samples - i);
+}
+
+static SND_PCM_SIMD_TARGET("avx2")
+void mix_s32_to_float_avx2(float *dst, const int32_t *src,
+			   unsigned int samples)
+{
+	unsigned int i;
+
+	for (i = 0; i + 8 <= samples; i += 8)
+		_mm256_storeu_ps(dst + i,
+				 _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)(src + i))));
+	_mm256_zeroupper();
+	mix_s32_to_float_generic(dst + i, src + i, samples - i);
+}
+
+static SND_PCM_SIMD_TARGET("avx2")
+void mix_mac_avx2(float *acc, const float *src, float gain,
+		  unsigned int samples)
+{
+	__m256 g = _mm256_set1_ps(gain);
+	unsigned int i;
+
+	if (gain == 1.0f) {
+		for (i = 0; i + 8 <= samples; i += 8)
+			_mm256_storeu_ps(acc + i,
+					 _mm256_add_ps(_mm256_loadu_ps(acc + i),
+						       _mm256_loadu_ps(src + i)));
+	} else {
+		for (i = 0; i + 8 <= samples; i += 8)
+			_mm256_storeu_ps(acc + i,
+					 _mm256_add_ps(_mm256_loadu_ps(acc + i),
+						       _mm256_mul_ps(_mm256_loadu_ps(src + i), g)));
+	}
+	_mm256_zeroupper();
+	mix_mac_generic(acc + i, src + i, gain, samples - i);
+}
+
+static SND_PCM_SIMD_TARGET("avx2")
+void mix_float_to_s32_avx2(int32_t *dst, const float *src,
+			   unsigned int samples)
+{
+	const __m256 limit = _mm256_set1_ps(2147483648.0f);
+	unsigned int i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m256 v = _mm256_loadu_ps(src + i);
+		__m256i x = _mm256_cvtps_epi32(v);
+		x = _mm256_xor_si256(x, _mm256_castps_si256(_mm256_cmp_ps(v, limit, _CMP_GE_OQ)));
+		_mm256_storeu_si256((__m256i *)(dst + i), x);
+	}
+	_mm256_zeroupper();
+	mix_float_to_s32_generic(dst + i, src + i, samples - i);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+void snd_pcm_simd_s32_to_float(float *dst, const int32_t *src,
+			       unsigned int samples)
+{
+#ifdef HAVE_X86_SIMD
+	unsigned int caps = snd_pcm_simd_caps();
+
+	if (caps & SND_PCM_SIMD_AVX2) {
+		mix_s32_to_float_avx2(dst, src, samples);
+		return;
+	}
+	if (caps & SND_PCM_SIMD_SSE2) {
+		mix_s32_to_float_sse2(dst, src, samples);
+		return;
+	}
+#endif
+	mix_s32_to_float_generic(dst, src, samples);
+}
+
+void snd_pcm_simd_mac_float(float *acc, const float *src, float gain,
+			    unsigned int samples)
+{
+#ifdef HAVE_X86_SIMD
+	unsigned int caps = snd_pcm_simd_caps();
+
+	if (caps & SND_PCM_SIMD_AVX2) {
+		mix_mac_avx2(acc, src, gain, samples);
+		return;
+	}
+	if (caps & SND_PCM_SIMD_SSE2) {
+		mix_mac_sse2(acc, src, gain, samples);
+		return;
+	}
+#endif
+	mix_mac_generic(acc, src, gain, samples);
+}
+
+void snd_pcm_simd_float_to_s32(int32_t *dst, const float *src,
+			       unsigned int samples)
+{
+#ifdef HAVE_X86_SIMD
+	unsigned int caps = snd_pcm_simd_caps();
+
+	if (caps & SND_PCM_SIMD_AVX2) {
+		mix_float_to_s32_avx2(dst, src, samples);
+		return;
+	}
+	if (caps & SND_PCM_SIMD_SSE2) {
+		mix_float_to_s32_sse2(dst, src, samples);
+		return;
+	}
+#endif
+	mix_float_to_s32_generic(dst, src, samples);
+}
+
+/*
+ * software volume
+ *
+ * The volume is a 16.16 fixed point factor as in pcm_softvol.c.  An
+ * integer sample becomes floor(sample * vol / 65536), saturated, which
+ * is what the MULTI_DIV helpers of the plugin used to compute; a float
+ * sample is multiplied by vol / 65536 in single precision.  When the
+ * volume changes, sample i of n gets the volume
+ * vol0 + (vol1 - vol0) * (i + 1) / n, in 16.16 steps, so a ramp ends at
+ * the new value.  The vector code covers the attenuating volumes
+ * (up to 0xffff), where nothing saturates.
+ */
+
+struct gain_ramp {
+	uint64_t from;			/* about vol0 << 16 */
+	int64_t step;			/* per sample, in 1/65536 */
+	float gain;			/* vol0 / 65536 */
+	float fstep;
+};
+
+static void gain_ramp_init(struct gain_ramp *r, unsigned int vol0,
+			   unsigned int vol1, snd_pcm_uframes_t samples)
+{
+	r->from = (uint64_t)vol0 << 16;
+	r->step = 0;
+	r->gain = vol0 * (1.0 / (1 << 16));
+	r->fstep = 0;
+	if (vol0 != vol1 && samples > 0) {
+		/* counted back from the end, which the steps hit exactly */
+		r->step = ((int64_t)vol1 - vol0) * 65536 / (int64_t)samples;
+		r->from = ((uint64_t)vol1 << 16) - r->step * (int64_t)samples;
+		r->fstep = ((float)(vol1 * (1.0 / (1 << 16))) - r->gain) / samples;
+	}
+}
+
+static inline int32_t gain_apply(int32_t a, uint32_t vol, int32_t max)
+{
+	int64_t v = ((int64_t)a * vol) >> 16;
+
+	if (v > max)
+		return max;
+	if (v < -max - 1)
+		return -max - 1;
+	return v;
+}
+
+/*
+ * The kernels take the index of their first sample in the ramp, so that
+ * the vector code can leave its tail to the loop.
+ */
+typedef void (*gain_kernel_t)(char *dst, int dst_step, const char *src,
+			      int src_step, snd_pcm_uframes_t first,
+			      snd_pcm_uframes_t samples,
+			      const struct gain_ramp *r);
+
+#define GAIN_FORMAT(f, max, load, store) \
+static inline int32_t gain_load_##f(const unsigned char *p) \
+{ \
+	return load; \
+} \
+static inline void gain_store_##f(unsigned char *p, int32_t v) \
+{ \
+	store; \
+} \
+static void gain_##f##_generic(char *dst, int dst_step, const char *src, \
+			       int src_step, snd_pcm_uframes_t first, \
+			       snd_pcm_uframes_t samples, \
+			       const struct gain_ramp *r) \
+{ \
+	int64_t step = r->step; \
+	uint64_t acc = r->from + step * (int64_t)(first + 1); \
+	while (samples-- > 0) { \
+		int32_t v = gain_load_##f((const unsigned char *)src); \
+		gain_store_##f((unsigned char *)dst, \
+			       gain_apply(v, acc >> 16, max)); \
+		acc += step; \
+		src += src_step; \
+		dst += dst_step; \
+	} \
+}
+
+GAIN_FORMAT(S16_LE, 0x7fff, (int16_t)lin_le16(lin_rd16(p)),
+	    lin_wr16(p, lin_le16((uint16_t)v)))
+GAIN_FORMAT(S16_BE, 0x7fff, (int16_t)lin_be16(lin_rd16(p)),
+	    lin_wr16(p, lin_be16((uint16_t)v)))
+GAIN_FORMAT(S24_LE, 0x7fffff, (int32_t)(lin_le32(lin_rd32(p)) << 8) >> 8,
+	    lin_wr32(p, lin_le32((uint32_t)v)))
+GAIN_FORMAT(S24_3LE, 0x7fffff,
+	    (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 |
+		      (uint32_t)p[2] << 24) >> 8,
+	    p[0] = v; p[1] = v >> 8; p[2] = v >> 16)
+GAIN_FORMAT(S32_LE, 0x7fffffff, (int32_t)lin_le32(lin_rd32(p)),
+	    lin_wr32(p, lin_le32((uint32_t)v)))
+GAIN_FORMAT(S32_BE, 0x7fffffff, (int32_t)lin_be32(lin_rd32(p)),
+	    lin_wr32(p, lin_be32((uint32_t)v)))
+
+static void gain_FLOAT_generic(char *dst, int dst_step, const char *src,
+			       int src_step, snd_pcm_uframes_t first,
+			       snd_pcm_uframes_t samples,
+			       const struct gain_ramp *r)
+{
+	float gain = r->gain, step = r->fstep;
+	snd_pcm_uframes_t i;
+	float v;
+
+	for (i = first + 1; i <= first + samples; i++) {
+		memcpy(&v, src, sizeof(v));
+		v *= gain + step * (float)i;
+		memcpy(dst, &v, sizeof(v));
+		src += src_step;
+		dst += dst_step;
+	}
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* volumes of the next 'n' samples, as 32-bit lanes */
+static inline void gain_vols(uint32_t *vols, const struct gain_ramp *r,
+			     snd_pcm_uframes_t first, unsigned int n)
+{
+	unsigned int k;
+
+	for (k = 0; k < n; k++)
+		vols[k] = r->from + r->step * (int64_t)(first + k + 1);
+}
+
+/*
+ * floor(a * b / 65536) for b up to 0xffff in the low half of each lane:
+ * the high half of a goes through a signed 16-bit multiply-add, which
+ * sees b as negative from 0x8000 on, so a & 0xffff0000 is added back for
+ * those, and the low half through an unsigned high multiply.
+ */
+static inline SND_PCM_SIMD_TARGET("sse2")
+__m128i gain_mul32_sse2(__m128i a, __m128i b)
+{
+	__m128i neg = _mm_srai_epi32(_mm_slli_epi32(b, 16), 31);
+	__m128i hi = _mm_madd_epi16(_mm_srai_epi32(a, 16), b);
+	__m128i fix = _mm_and_si128(_mm_and_si128(a, _mm_set1_epi32(0xffff0000)), neg);
+
+	return _mm_add_epi32(_mm_add_epi32(hi, fix), _mm_mulhi_epu16(a, b));
+}
+
+/* floor(a * b / 65536) for 16-bit lanes, b unsigned */
+static inline SND_PCM_SIMD_TARGET("sse2")
+__m128i gain_mul16_sse2(__m128i a, __m128i b)
+{
+	return _mm_add_epi16(_mm_mulhi_epi16(a, b),
+			     _mm_and_si128(a, _mm_srai_epi16(b, 15)));
+}
+
+/* 32-bit lanes holding 16.16 volumes -> unsigned 16-bit volumes */
+static inline SND_PCM_SIMD_TARGET("sse2")
+__m128i gain_pack16_sse2(__m128i lo, __m128i hi)
+{
+	const __m128i bias = _mm_set1_epi32(0x8000);
+
+	lo = _mm_sub_epi32(_mm_srli_epi32(lo, 16), bias);
+	hi = _mm_sub_epi32(_mm_srli_epi32(hi, 16), bias);
+	return _mm_xor_si128(_mm_packs_epi32(lo, hi), _mm_set1_epi16(-0x8000));
+}
+
+#define GAIN_SSE32(f, isa, load, store) \
+static SND_PCM_SIMD_TARGET(#isa) \
+void gain_##f##_##isa(char *dst, int dst_step, const char *src, \
+		      int src_step, snd_pcm_uframes_t first, \
+		      snd_pcm_uframes_t samples, const struct gain_ramp *r) \
+{ \
+	snd_pcm_uframes_t n = 0; \
+	if (dst_step == LIN_BYTES_##f && src_step == LIN_BYTES_##f) { \
+		uint32_t vols[4]; \
+		__m128i acc, inc = _mm_set1_epi32((uint32_t)(r->step * 4)); \
+		gain_vols(vols, r, first, 4); \
+		acc = LD128(vols); \
+		for (; n + 4 <= samples; n += 4) { \
+			const char *p = src + n * LIN_BYTES_##f; \
+			__m128i x = gain_mul32_sse2(load, _mm_srli_epi32(acc, 16)); \
+			char *q = dst + n * LIN_BYTES_##f; \
+			store; \
+			acc = _mm_add_epi32(acc, inc); \
+		} \
+	} \
+	gain_##f##_generic(dst + n * dst_step, dst_step, src + n * src_step, \
+			   src_step, first + n, samples - n, r); \
+}
+
+GAIN_SSE32(S24_LE, sse2, _mm_srai_epi32(_mm_slli_epi32(LD128(p), 8), 8),
+	   ST128(q, x))
+GAIN_SSE32(S24_3LE, ssse3, _mm_srai_epi32(lin_load24x4(p), 8),
+	   lin_store24x4(q, _mm_slli_epi32(x, 8)))
+GAIN_SSE32(S32_LE, sse2, LD128(p),
+	   ST128(q, x))
+GAIN_SSE32(S32_BE, sse2, lin_bswap32_sse2(LD128(p)),
+	   ST128(q, lin_bswap32_sse2(x)))
+
+#define GAIN_SSE16(f, load, store) \
+static SND_PCM_SIMD_TARGET("sse2") \
+void gain_##f##_sse2(char *dst, int dst_step, const char *src, \
+		     int src_step, snd_pcm_uframes_t first, \
+		     snd_pcm_uframes_t samples, const struct gain_ramp *r) \
+{ \
+	snd_pcm_uframes_t n = 0; \
+	if (dst_step == 2 && src_step == 2) { \
+		uint32_t vols[8]; \
+		__m128i lo, hi, inc = _mm_set1_epi32((uint32_t)(r->step * 8)); \
+		gain_vols(vols, r, first, 8); \
+		lo = LD128(vols); \
+		hi = LD128(vols + 4); \
+		for (; n + 8 <= samples; n += 8) { \
+			const char *p = src + n * 2; \
+			__m128i x = gain_mul16_sse2(load, gain_pack16_sse2(lo, hi)); \
+			char *q = dst + n * 2; \
+			store; \
+			lo = _mm_add_epi32(lo, inc); \
+			hi = _mm_add_epi32(hi, inc); \
+		} \
+	} \
+	gain_##f##_generic(dst + n * dst_step, dst_step, src + n * src_step, \
+			   src_step, first + n, samples - n, r); \
+}
+
+GAIN_SSE16(S16_LE, LD128(p), ST128(q, x))
+GAIN_SSE16(S16_BE, lin_bswap16_sse2(LD128(p)), ST128(q, lin_bswap16_sse2(x)))
+
+static SND_PCM_SIMD_TARGET("sse2")
+void gain_FLOAT_sse2(char *dst, int dst_step, const char *src,
+		     int src_step, snd_pcm_uframes_t first,
+		     snd_pcm_uframes_t samples, const struct gain_ramp *r)
+{
+	snd_pcm_uframes_t n = 0;
+
+	if (dst_step == 4 && src_step == 4) {
+		__m128 g0 = _mm_set1_ps(r->gain), step = _mm_set1_ps(r->fstep);
+		__m128 idx = _mm_setr_ps(first + 1, first + 2, first + 3, first + 4);
+		for (; n + 4 <= samples; n += 4) {
+			__m128 g = _mm_add_ps(g0, _mm_mul_ps(step, idx));
+			_mm_storeu_ps((float *)(dst + n * 4),
+				      _mm_mul_ps(_mm_loadu_ps((const float *)(src + n * 4)), g));
+			idx = _mm_add_ps(idx, _mm_set1_ps(4.0f));
+		}
+	}
+	gain_FLOAT_generic(dst + n * dst_step, dst_step, src + n * src_step,
+			   src_step, first + n, samples - n, r);
+}
+
+static inline SND_PCM_SIMD_TARGET("avx2")
+__m256i gain_mul32_avx2(__m256i a, __m256i b)
+{
+	__m256i neg = _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 31);
+	__m256i hi = _mm256_madd_epi16(_mm256_srai_epi32(a, 16), b);
+	__m256i fix = _mm256_and_si256(_mm256_and_si256(a, _mm256_set1_epi32(0xffff0000)),
+				       neg);
+
+	return _mm256_add_epi32(_mm256_add_epi32(hi, fix), _mm256_mulhi_epu16(a, b));
+}
+
+static inline SND_PCM_SIMD_TARGET("avx2")
+__m256i gain_mul16_avx2(__m256i a, __m256i b)
+{
+	return _mm256_add_epi16(_mm256_mulhi_epi16(a, b),
+				_mm256_and_si256(a, _mm256_srai_epi16(b, 15)));
+}
+
+/* the pack works per 128-bit lane: 'lo' holds the samples 0-3 and 8-11 */
+static inline SND_PCM_SIMD_TARGET("avx2")
+__m256i gain_pack16_avx2(__m256i lo, __m256i hi)
+{
+	const __m256i bias = _mm256_set1_epi32(0x8000);
+
+	lo = _mm256_sub_epi32(_mm256_srli_epi32(lo, 16), bias);
+	hi = _mm256_sub_epi32(_mm256_srli_epi32(hi, 16), bias);
+	return _mm256_xor_si256(_mm256_packs_epi32(lo, hi),
+				_mm256_set1_epi16(-0x8000));
+}
+
+static inline SND_PCM_SIMD_TARGET("avx2") __m256i gain_bswap16_avx2(__m256i x)
+{
+	return _mm256_or_si256(_mm256_slli_epi16(x, 8), _mm256_srli_epi16(x, 8));
+}
+
+#define GAIN_AVX2_32(f, load, store) \
+static SND_PCM_SIMD_TARGET("avx2") \
+void gain_##f##_avx2(char *dst, int dst_step, const char *src, \
+		     int src_step, snd_pcm_uframes_t first, \
+		     snd_pcm_uframes_t samples, const struct gain_ramp *r) \
+{ \
+	snd_pcm_uframes_t n = 0; \
+	if (dst_step == 4 && src_step == 4) { \
+		uint32_t vols[8]; \
+		__m256i acc, inc = _mm256_set1_epi32((uint32_t)(r->step * 8)); \
+		gain_vols(vols, r, first, 8); \
+		acc = LD256(vols); \
+		for (; n + 8 <= samples; n += 8) { \
+			const char *p = src + n * 4; \
+			__m256i x = gain_mul32_avx2(load, _mm256_srli_epi32(acc, 16)); \
+			char *q = dst + n * 4; \
+			store; \
+			acc = _mm256_add_epi32(acc, inc); \
+		} \
+	} \
+	_mm256_zeroupper(); \
+	gain_##f##_generic(dst + n * dst_step, dst_step, src + n * src_step, \
+			   src_step, first + n, samples - n, r); \
+}
+
+GAIN_AVX2_32(S24_LE, _mm256_srai_epi32(_mm256_slli_epi32(LD256(p), 8), 8),
+	     ST256(q, x))
+GAIN_AVX2_32(S32_LE, LD256(p),
+	     ST256(q, x))
+GAIN_AVX2_32(S32_BE, iec958_bswap_avx2(LD256(p)),
+	     ST256(q, iec958_bswap_avx2(x)))
+
+#define GAIN_AVX2_16(f, load, store) \
+static SND_PCM_SIMD_TARGET("avx2") \
+void gain_##f##_avx2(char *dst, int dst_step, const char *src, \
+		     int src_step, snd_pcm_uframes_t first, \
+		     snd_pcm_uframes_t samples, const struct gain_ramp *r) \
+{ \
+	snd_pcm_uframes_t n = 0; \
+	if (dst_step == 2 && src_step == 2) { \
+		uint32_t vols[16], order[16]; \
+		__m256i lo, hi, inc = _mm256_set1_epi32((uint32_t)(r->step * 16)); \
+		unsigned int k; \
+		gain_vols(vols, r, first, 16); \
+		for (k = 0; k < 4; k++) { \
+			order[k] = vols[k]; \
+			order[k + 4] = vols[k + 8]; \
+			order[k + 8] = vols[k + 4]; \
+			order[k + 12] = vols[k + 12]; \
+		} \
+		lo = LD256(order); \
+		hi = LD256(order + 8); \
+		for (; n + 16 <= samples; n += 16) { \
+			const char *p = src + n * 2; \
+			__m256i x = gain_mul16_avx2(load, gain_pack16_avx2(lo, hi)); \
+			char *q = dst + n * 2; \
+			store; \
+			lo = _mm256_add_epi32(lo, inc); \
+			hi = _mm256_add_epi32(hi, inc); \
+		} \
+	} \
+	_mm256_zeroupper(); \
+	gain_##f##_generic(dst + n * dst_step, dst_step, src + n * src_step, \
+			   src_step, first + n, samples - n, r); \
+}
+
+GAIN_AVX2_16(S16_LE, LD256(p), ST256(q, x))
+GAIN_AVX2_16(S16_BE, gain_bswap16_avx2(LD256(p)), ST256(q, gain_bswap16_avx2(x)))
+
+static SND_PCM_SIMD_TARGET("avx2")
+void gain_FLOAT_avx2(char *dst, int dst_step, const char *src,
+		     int src_step, snd_pcm_uframes_t first,
+		     snd_pcm_uframes_t samples, const struct gain_ramp *r)
+{
+	snd_pcm_uframes_t n = 0;
+
+	if (dst_step == 4 && src_step == 4) {
+		__m256 g0 = _mm256_set1_ps(r->gain), step = _mm256_set1_ps(r->fstep);
+		__m256 idx = _mm256_setr_ps(first + 1, first + 2, first + 3, first + 4,
+					    first + 5, first + 6, first + 7, first + 8);
+		for (; n + 8 <= samples; n += 8) {
+			__m256 g = _mm256_add_ps(g0, _mm256_mul_ps(step, idx));
+			_mm256_storeu_ps((float *)(dst + n * 4),
+					 _mm256_mul_ps(_mm256_loadu_ps((const float *)(src + n * 4)), g));
+			idx = _mm256_add_ps(idx, _mm256_set1_ps(8.0f));
+		}
+	}
+	_mm256_zeroupper();
+	gain_FLOAT_generic(dst + n * dst_step, dst_step, src + n * src_step,
+			   src_step, first + n, samples - n, r);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* the best kernel for the volumes of a ramp */
+static gain_kernel_t gain_select(gain_kernel_t generic,
+				 gain_kernel_t sse ATTRIBUTE_UNUSED,
+				 gain_kernel_t avx2 ATTRIBUTE_UNUSED,
+				 unsigned int sse_caps ATTRIBUTE_UNUSED,
+				 unsigned int vol0 ATTRIBUTE_UNUSED,
+				 unsigned int vol1 ATTRIBUTE_UNUSED)
+{
+#ifdef HAVE_X86_SIMD
+	unsigned int caps = snd_pcm_simd_caps();
+
+	if (vol0 <= 0xffff && vol1 <= 0xffff) {
+		if (avx2 && (caps & SND_PCM_SIMD_AVX2))
+			return avx2;
+		if (sse && (caps & sse_caps) == sse_caps)
+			return sse;
+	}
+#endif
+	return generic;
+}
+
+#ifdef HAVE_X86_SIMD
+#define GAIN_SSE(f)	gain_##f##_sse2
+#define GAIN_SSSE3(f)	gain_##f##_ssse3
+#define GAIN_AVX2(f)	gain_##f##_avx2
+#else
+#define GAIN_SSE(f)	NULL
+#define GAIN_SSSE3(f)	NULL
+#define GAIN_AVX2(f)	NULL
+#endif
+
+#define GAIN_ENTRY(f, sse, avx2, sse_caps) \
+static void gain_##f(char *dst, int dst_step, const char *src, int src_step, \
+		     unsigned int vol0, unsigned int vol1, \
+		     snd_pcm_uframes_t samples) \
+{ \
+	struct gain_ramp r; \
+	gain_ramp_init(&r, vol0, vol1, samples); \
+	gain_select(gain_##f##_generic, sse, avx2, sse_caps, vol0, vol1) \
+		(dst, dst_step, src, src_step, 0, samples, &r); \
+}
+
+GAIN_ENTRY(S16_LE, GAIN_SSE(S16_LE), GAIN_AVX2(S16_LE), SND_PCM_SIMD_SSE2)
+GAIN_ENTRY(S16_BE, GAIN_SSE(S16_BE), GAIN_AVX2(S16_BE), SND_PCM_SIMD_SSE2)
+GAIN_ENTRY(S24_LE, GAIN_SSE(S24_LE), GAIN_AVX2(S24_LE), SND_PCM_SIMD_SSE2)
+GAIN_ENTRY(S24_3LE, GAIN_SSSE3(S24_3LE), NULL, SND_PCM_SIMD_SSSE3)
+GAIN_ENTRY(S32_LE, GAIN_SSE(S32_LE), GAIN_AVX2(S32_LE), SND_PCM_SIMD_SSE2)
+GAIN_ENTRY(S32_BE, GAIN_SSE(S32_BE), GAIN_AVX2(S32_BE), SND_PCM_SIMD_SSE2)
+GAIN_ENTRY(FLOAT, GAIN_SSE(FLOAT), GAIN_AVX2(FLOAT), SND_PCM_SIMD_SSE2)
+
+snd_pcm_simd_gain_t snd_pcm_simd_gain_kernel(snd_pcm_format_t format)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+		return gain_S16_LE;
+	case SND_PCM_FORMAT_S16_BE:
+		return gain_S16_BE;
+	case SND_PCM_FORMAT_S24_LE:
+		return gain_S24_LE;
+	case SND_PCM_FORMAT_S24_3LE:
+		return gain_S24_3LE;
+	case SND_PCM_FORMAT_S32_LE:
+		return gain_S32_LE;
+	case SND_PCM_FORMAT_S32_BE:
+		return gain_S32_BE;
+	case SND_PCM_FORMAT_FLOAT:
+		return gain_FLOAT;
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * polyphase FIR
+ *
+ * One dot product per output sample; the vector kernels keep the sums of
+ * both filters in one register and blend them before the horizontal add.
+ */
+
+static void fir_generic(float *dst, const float *src, const float *bank,
+			unsigned int taps, const snd_pcm_simd_fir_step_t *steps,
+			unsigned int frames, int interp)
+{
+	unsigned int i, k;
+
+	for (i = 0; i < frames; i++) {
+		const float *x = src + steps[i].src;
+		const float *h = bank + steps[i].coef;
+		float s0 = 0, s1 = 0;
+
+		if (interp) {
+			for (k = 0; k < taps; k++) {
+				s0 += x[k] * h[k];
+				s1 += x[k] * h[k + taps];
+			}
+			dst[i] = s0 + (s1 - s0) * steps[i].frac;
+		} else {
+			for (k = 0; k < taps; k++)
+				s0 += x[k] * h[k];
+			dst[i] = s0;
+		}
+	}
+}
+
+#ifdef HAVE_X86_SIMD
+
+static inline SND_PCM_SIMD_TARGET("sse2")
+float fir_hsum_sse2(__m128 s)
+{
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+
+static SND_PCM_SIMD_TARGET("sse2")
+void fir_sse2(float *dst, const float *src, const float *bank,
+	      unsigned int taps, const snd_pcm_simd_fir_step_t *steps,
+	      unsigned int frames, int interp)
+{
+	unsigned int i, k;
+
+	for (i = 0; i < frames; i++) {
+		const float *x = src + steps[i].src;
+		const float *h = bank + steps[i].coef;
+		__m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+
+		if (interp) {
+			__m128 t0 = _mm_setzero_ps(), t1 = _mm_setzero_ps();
+			for (k = 0; k < taps; k += 8) {
+				__m128 x0 = _mm_loadu_ps(x + k);
+				__m128 x1 = _mm_loadu_ps(x + k + 4);
+				s0 = _mm_add_ps(s0, _mm_mul_ps(x0, _mm_load_ps(h + k)));
+				s1 = _mm_add_ps(s1, _mm_mul_ps(x1, _mm_load_ps(h + k + 4)));
+				t0 = _mm_add_ps(t0, _mm_mul_ps(x0, _mm_load_ps(h + taps + k)));
+				t1 = _mm_add_ps(t1, _mm_mul_ps(x1, _mm_load_ps(h + taps + k + 4)));
+			}
+			s0 = _mm_add_ps(s0, s1);
+			t0 = _mm_add_ps(t0, t1);
+			s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_sub_ps(t0, s0),
+						       _mm_set1_ps(steps[i].frac)));
+		} else {
+			for (k = 0; k < taps; k += 8) {
+				s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x + k),
+							       _mm_load_ps(h + k)));
+				s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(x + k + 4),
+							       _mm_load_ps(h + k + 4)));
+			}
+			s0 = _mm_add_ps(s0, s1);
+		}
+		dst[i] = fir_hsum_sse2(s0);
+	}
+}
+
+static SND_PCM_SIMD_TARGET("avx2")
+void fir_avx2(float *dst, const float *src, const float *bank,
+	      unsigned int taps, const snd_pcm_simd_fir_step_t *steps,
+	      unsigned int frames, int interp)
+{
+	unsigned int i, k;
+
+	for (i = 0; i < frames; i++) {
+		const float *x = src + steps[i].src;
+		const float *h = bank + steps[i].coef;
+		__m256 s0 = _mm256_setzero_ps();
+		__m128 s;
+
+		if (interp) {
+			__m256 t0 = _mm256_setzero_ps();
+			for (k = 0; k < taps; k += 8) {
+				__m256 x0 = _mm256_loadu_ps(x + k);
+				s0 = _mm256_add_ps(s0, _mm256_mul_ps(x0, _mm256_load_ps(h + k)));
+				t0 = _mm256_add_ps(t0, _mm256_mul_ps(x0, _mm256_load_ps(h + taps + k)));
+			}
+			s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_sub_ps(t0, s0),
+							     _mm256_set1_ps(steps[i].frac)));
+		} else {
+			__m256 s1 = _mm256_setzero_ps();
+			for (k = 0; k + 16 <= taps; k += 16) {
+				s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(x + k),
+								     _mm256_load_ps(h + k)));
+				s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(x + k + 8),
+								     _mm256_load_ps(h + k + 8)));
+			}
+			if (k < taps)
+				s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(x + k),
+								     _mm256_load_ps(h + k)));
+			s0 = _mm256_add_ps(s0, s1);
+		}
+		s = _mm_add_ps(_mm256_castps256_ps128(s0),
+			       _mm256_extractf128_ps(s0, 1));
+		dst[i] = fir_hsum_sse2(s);
+	}
+	_mm256_zeroupper();
+}
+
+#endif /* HAVE_X86_SIMD */
+
+void snd_pcm_simd_fir(float *dst, const float *src, const float *bank,
+		      unsigned int taps, const snd_pcm_simd_fir_step_t *steps,
+		      unsigned int frames, int interp)
+{
+#ifdef HAVE_X86_SIMD
+	unsigned int caps = snd_pcm_simd_caps();
+
+	if (caps & SND_PCM_SIMD_AVX2) {
+		fir_avx2(dst, src, bank, taps, steps, frames, interp);
+		return;
+	}
+	if (caps & SND_PCM_SIMD_SSE2) {
+		fir_sse2(dst, src, bank, taps, steps, frames, interp);
+		return;
+	}
+#endif
+	fir_generic(dst, src, bank, taps, steps, frames, interp);
+}
+
+/*
+ * linear interpolation of interleaved frames
+ *
+ * The weight is set up once per frame, the vector kernels then go over
+ * the channels.  Integer samples take the 16.16 weight and the truncating
+ * shift of the per channel loops of the linear rate converter, in 32 bits
+ * for S16 and in 64 bits for S32, so that every level gives the same
+ * output.
+ */
+
+#define LERP_FRAME(base, prev, idx, channels) \
+	((idx) < 0 ? (prev) : (base) + (size_t)(idx) * (channels))
+
+static inline int16_t lerp_s16_one(int16_t a, int16_t b, unsigned int weight)
+{
+	return (a * (int)(0x10000 - weight) + b * (int)weight) >> 16;
+}
+
+static inline int32_t lerp_s32_one(int32_t a, int32_t b, unsigned int weight)
+{
+	return ((int64_t)a * (0x10000 - weight) + (int64_t)b * weight) >> 16;
+}
+
+static void lerp_s16_generic(int16_t *dst, const int16_t *src,
+			     const int16_t *prev,
+			     const snd_pcm_simd_lerp_step_t *steps,
+			     unsigned int frames, unsigned int channels)
+{
+	unsigned int i, c;
+
+	for (i = 0; i < frames; i++, dst += channels) {
+		const int16_t *a = LERP_FRAME(src, prev, steps[i].a, channels);
+		const int16_t *b = LERP_FRAME(src, prev, steps[i].b, channels);
+
+		for (c = 0; c < channels; c++)
+			dst[c] = lerp_s16_one(a[c], b[c], steps[i].weight);
+	}
+}
+
+static void lerp_s32_generic(int32_t *dst, const int32_t *src,
+			     const int32_t *prev,
+			     const snd_pcm_simd_lerp_step_t *steps,
+			     unsigned int frames, unsigned int channels)
+{
+	unsigned int i, c;
+
+	for (i = 0; i < frames; i++, dst += channels) {
+		const int32_t *a = LERP_FRAME(src, prev, steps[i].a, channels);
+		const int32_t *b = LERP_FRAME(src, prev, steps[i].b, channels);
+
+		for (c = 0; c < channels; c++)
+			dst[c] = lerp_s32_one(a[c], b[c], steps[i].weight);
+	}
+}
+
+static void lerp_float_generic(float *dst, const float *src,
+			       const float *prev,
+			       const snd_pcm_simd_lerp_step_t *steps,
+			       unsigned int frames, unsigned int channels)
+{
+	unsigned int i, c;
+
+	for (i = 0; i < frames; i++, dst += channels) {
+		const float *a = LERP_FRAME(src, prev, steps[i].a, channels);
+		const float *b = LERP_FRAME(src, prev, steps[i].b, channels);
+
+		for (c = 0; c < channels; c++)
+			dst[c] = a[c] + (b[c] - a[c]) * steps[i].frac;
+	}
+}
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * a * (0x10000 - weight) + b * weight >> 16 of eight S16 samples: the sum
+ * fits 32 bits, so it is a * 0x10000 - a * weight + b * weight there.  The
+ * weight is unsigned, the signed high halves of its products miss the
+ * sample once when its top bit is set ('top' all ones).
+ */
+static inline SND_PCM_SIMD_TARGET("sse2")
+__m128i lerp_s16_blend_sse2(__m128i a, __m128i b, __m128i weight, __m128i top)
+{
+	__m128i ah = _mm_add_epi16(_mm_mulhi_epi16(a, weight), _mm_and_si128(a, top));
+	__m128i bh = _mm_add_epi16(_mm_mulhi_epi16(b, weight), _mm_and_si128(b, top));
+	__m128i al = _mm_mullo_epi16(a, weight);
+	__m128i bl = _mm_mullo_epi16(b, weight);
+	__m128i zero = _mm_setzero_si128();
+	__m128i x0, x1;
+
+	x0 = _mm_sub_epi32(_mm_unpacklo_epi16(zero, a), _mm_unpacklo_epi16(al, ah));
+	x1 = _mm_sub_epi32(_mm_unpackhi_epi16(zero, a), _mm_unpackhi_epi16(al, ah));
+	x0 = _mm_add_epi32(x0, _mm_unpacklo_epi16(bl, bh));
+	x1 = _mm_add_epi32(x1, _mm_unpackhi_epi16(bl, bh));
+	return _mm_packs_epi32(_mm_srai_epi32(x0, 16), _mm_srai_epi32(x1, 16));
+}
+
+static SND_PCM_SIMD_TARGET("sse2")
+void lerp_s16_sse2(int16_t *dst, const int16_t *src, const int16_t *prev,
+		   const snd_pcm_simd_lerp_step_t *steps,
+		   unsigned int frames, unsigned int channels)
+{
+	unsigned int i, c;
+
+	for (i = 0; i < frames; i++, dst += channels) {
+		const int16_t *a = LERP_FRAME(src, prev, steps[i].a, channels);
+		const int16_t *b = LERP_FRAME(src, prev, steps[i].b, channels);
+		__m128i w = _mm_set1_epi16((short)steps[i].weight);
+		__m128i top = _mm_set1_epi16(steps[i].weight & 0x8000 ? -1 : 0);
+
+		for (c = 0; c + 8 <= channels; c += 8)
+			_mm_storeu_si128((__m128i *)(dst + c),
+					 lerp_s16_blend_sse2(
+						 _mm_loadu_si128((const __m128i *)(a + c)),
+						 _mm_loadu_si128((const __m128i *)(b + c)),
+						 w, top));
+		if (c + 4 <= channels) {
+			_mm_storel_epi64((__m128i *)(dst + c),
+					 lerp_s16_blend_sse2(
+						 _mm_loadl_epi64((const __m128i *)(a + c)),
+						 _mm_loadl_epi64((const __m128i *)(b + c)),
+						 w, top));
+			c += 4;
+		}
+		for (; c < channels; c++)
+			dst[c] = lerp_s16_one(a[c], b[c], steps[i].weight);
+	}
+}
+
+/*
+ * a * (0x10000 - weight) + b * weight >> 16 of four S32 samples, the
+ * products of the even and of the odd samples in 64 bits.  The unsigned
+ * multiply is short of weight << 32 for a negative sample; the result is
+ * in bits 16 to 47 of the sum.
+ */
+static inline SND_PCM_SIMD_TARGET("sse2")
+__m128i lerp_s32_mul_sse2(__m128i x, __m128i weight)
+{
+	__m128i fix = _mm_and_si128(_mm_srai_epi32(x, 31), weight);
+
+	return _mm_sub_epi64(_mm_mul_epu32(x, weight), _mm_slli_epi64(fix, 32));
+}
+
+static inline SND_PCM_SIMD_TARGET("sse2")
+__m128i lerp_s32_blend_sse2(__m128i a, __m128i b, __m128i wa, __m128i wb)
+{
+	__m128i even = _mm_add_epi64(lerp_s32_mul_sse2(a, wa),
+				     lerp_s32_mul_sse2(b, wb));
+	__m128i odd = _mm_add_epi64(lerp_s32_mul_sse2(_mm_srli_epi64(a, 32), wa),
+				    lerp_s32_mul_sse2(_mm_srli_epi64(b, 32), wb));
+	__m128i low = _mm_set_epi32(0, -1, 0, -1);
+
+	return _mm_or_si128(_mm_and_si128(_mm_srli_epi64(even, 16), low),
+			    _mm_andnot_si128(low, _mm_slli_epi64(odd, 16)));
+}
+
+static SND_PCM_SIMD_TARGET("sse2")
+void lerp_s32_sse2(int32_t *dst, const int32_t *src, const int32_t *prev,
+		   const snd_pcm_simd_lerp_step_t *steps,
+		   unsigned int frames, unsigned int channels)
+{
+	unsigned int i, c;
+
+	for (i = 0; i < frames; i++, dst += channels) {
+		const int32_t *a = LERP_FRAME(src, prev, steps[i].a, channels);
+		const int32_t *b = LERP_FRAME(src, prev, steps[i].b, channels);
+		__m128i wa = _mm_set1_epi32(0x10000 - steps[i].weight);
+		__m128i wb = _mm_set1_epi32(steps[i].weight);
+
+		for (c = 0; c + 4 <= channels; c += 4)
+			_mm_storeu_si128((__m128i *)(dst + c),
+					 lerp_s32_blend_sse2(
+						 _mm_loadu_si128((const __m128i *)(a + c)),
+						 _mm_loadu_si128((const __m128i *)(b + c)),
+						 wa, wb));
+		for (; c < channels; c++)
+			dst[c] = lerp_s32_one(a[c], b[c], steps[i].weight);
+	}
+}
+
+static SND_PCM_SIMD_TARGET("sse2")
+void lerp_float_sse2(float *dst, const float *src, const float *prev,
+		     const snd_pcm_simd_lerp_step_t *steps,
+		     unsigned int frames, unsigned int channels)
+{
+	unsigned int i, c;
+
+	for (i = 0; i < frames; i++, dst += channels) {
+		const float *a = LERP_FRAME(src, prev, steps[i].a, channels);
+		const float *b = LERP_FRAME(src, prev, steps[i].b, channels);
+		__m128 f = _mm_set1_ps(steps[i].frac);
+
+		for (c = 0; c + 4 <= channels; c += 4) {
+			__m128 a0 = _mm_loadu_ps(a + c);
+			__m128 b0 = _mm_loadu_ps(b + c);
+			_mm_storeu_ps(dst + c,
+				      _mm_add_ps(a0, _mm_mul_ps(_mm_sub_ps(b0, a0), f)));
+		}
+		for (; c < channels; c++)
+			dst[c] = a[c] + (b[c] - a[c]) * steps[i].frac;
+	}
+}
+
+/* lerp_s16_blend_sse2() of 16 samples, unpacked and packed per lane */
+static SND_PCM_SIMD_TARGET("avx2")
+void lerp_s16_avx2(int16_t *dst, const int16_t *src, const int16_t *prev,
+		   const snd_pcm_simd_lerp_step_t *steps,
+		   unsigned int frames, unsigned int channels)
+{
+	__m256i zero = _mm256_setzero_si256();
+	unsigned int i, c;
+
+	for (i = 0; i < frames; i++, dst += channels) {
+		const int16_t *a = LERP_FRAME(src, prev, steps[i].a, channels);
+		const int16_t *b = LERP_FRAME(src, prev, steps[i].b, channels);
+		__m256i w = _mm256_set1_epi16((short)steps[i].weight);
+		__m256i top = _mm256_set1_epi16(steps[i].weight & 0x8000 ? -1 : 0);
+
+		for (c = 0; c + 16 <= channels; c += 16) {
+			__m256i xa = _mm256_loadu_si256((const __m256i *)(a + c));
+			__m256i xb = _mm256_loadu_si256((const __m256i *)(b + c));
+			__m256i ah = _mm256_add_epi16(_mm256_mulhi_epi16(xa, w),
+						      _mm256_and_si256(xa, top));
+			__m256i bh = _mm256_add_epi16(_mm256_mulhi_epi16(xb, w),
+						      _mm256_and_si256(xb, top));
+			__m256i al = _mm256_mullo_epi16(xa, w);
+			__m256i bl = _mm256_mullo_epi16(xb, w);
+			__m256i x0, x1;
+
+			x0 = _mm256_sub_epi32(_mm256_unpacklo_epi16(zero, xa),
+					      _mm256_unpacklo_epi16(al, ah));
+			x1 = _mm256_sub_epi32(_mm256_unpackhi_epi16(zero, xa),
+					      _mm256_unpackhi_epi16(al, ah));
+			x0 = _mm256_add_epi32(x0, _mm256_unpacklo_epi16(bl, bh));
+			x1 = _mm256_add_epi32(x1, _mm256_unpackhi_epi16(bl, bh));
+			_mm256_storeu_si256((__m256i *)(dst + c),
+					    _mm256_packs_epi32(_mm256_srai_epi32(x0, 16),
+							       _mm256_srai_epi32(x1, 16)));
+		}
+		if (c + 8 <= channels) {
+			_mm_storeu_si128((__m128i *)(dst + c),
+					 lerp_s16_blend_sse2(
+						 _mm_loadu_si128((const __m128i *)(a + c)),
+						 _mm_loadu_si128((const __m128i *)(b + c)),
+						 _mm256_castsi256_si128(w),
+						 _mm256_castsi256_si128(top)));
+			c += 8;
+		}
+		if (c + 4 <= channels) {
+			_mm_storel_epi64((__m128i *)(dst + c),
+					 lerp_s16_blend_sse2(
+						 _mm_loadl_epi64((const __m128i *)(a + c)),
+						 _mm_loadl_epi64((const __m128i *)(b + c)),
+						 _mm256_castsi256_si128(w),
+						 _mm256_castsi256_si128(top)));
+			c += 4;
+		}
+		for (; c < channels; c++)
+			dst[c] = lerp_s16_one(a[c], b[c], steps[i].weight);
+	}
+	_mm256_zeroupper();
+}
+
+/* the signed multiply needs no fix up, the odd sums go to the odd halves */
+static SND_PCM_SIMD_TARGET("avx2")
+void lerp_s32_avx2(int32_t *dst, const int32_t *src, const int32_t *prev,
+		   const snd_pcm_simd_lerp_step_t *steps,
+		   unsigned int frames, unsigned int channels)
+{
+	unsigned int i, c;
+
+	for (i = 0; i < frames; i++, dst += channels) {
+		const int32_t *a = LERP_FRAME(src, prev, steps[i].a, channels);
+		const int32_t *b = LERP_FRAME(src, prev, steps[i].b, channels);
+		__m256i wa = _mm256_set1_epi32(0x10000 - steps[i].weight);
+		__m256i wb = _mm256_set1_epi32(steps[i].weight);
+
+		for (c = 0; c + 8 <= channels; c += 8) {
+			__m256i xa = _mm256_loadu_si256((const __m256i *)(a + c));
+			__m256i xb = _mm256_loadu_si256((const __m256i *)(b + c));
+			__m256i even = _mm256_add_epi64(_mm256_mul_epi32(xa, wa),
+							_mm256_mul_epi32(xb, wb));
+			__m256i odd = _mm256_add_epi64(
+				_mm256_mul_epi32(_mm256_srli_epi64(xa, 32), wa),
+				_mm256_mul_epi32(_mm256_srli_epi64(xb, 32), wb));
+			_mm256_storeu_si256((__m256i *)(dst + c),
+					    _mm256_blend_epi32(_mm256_srli_epi64(even, 16),
+							       _mm256_slli_epi64(odd, 16),
+							       0xaa));
+		}
+		if (c + 4 <= channels) {
+			_mm_storeu_si128((__m128i *)(dst + c),
+					 lerp_s32_blend_sse2(
+						 _mm_loadu_si128((const __m128i *)(a + c)),
+						 _mm_loadu_si128((const __m128i *)(b + c)),
+						 _mm256_castsi256_si128(wa),
+						 _mm256_castsi256_si128(wb)));
+			c += 4;
+		}
+		for (; c < channels; c++)
+			dst[c] = lerp_s32_one(a[c], b[c], steps[i].weight);
+	}
+	_mm256_zeroupper();
+}
+
+static SND_PCM_SIMD_TARGET("avx2")
+void lerp_float_avx2(float *dst, const float *src, const float *prev,
+		     const snd_pcm_simd_lerp_step_t *steps,
+		     unsigned int frames, unsigned int channels)
+{
+	unsigned int i, c;
+
+	for (i = 0; i < frames; i++, dst += channels) {
+		const float *a = LERP_FRAME(src, prev, steps[i].a, channels);
+		const float *b = LERP_FRAME(src, prev, steps[i].b, channels);
+		__m256 f = _mm256_set1_ps(steps[i].frac);
+
+		for (c = 0; c + 8 <= channels; c += 8) {
+			__m256 a0 = _mm256_loadu_ps(a + c);
+			__m256 b0 = _mm256_loadu_ps(b + c);
+			_mm256_storeu_ps(dst + c,
+					 _mm256_add_ps(a0, _mm256_mul_ps(_mm256_sub_ps(b0, a0), f)));
+		}
+		if (c + 4 <= channels) {
+			__m128 a0 = _mm_loadu_ps(a + c);
+			__m128 b0 = _mm_loadu_ps(b + c);
+			_mm_storeu_ps(dst + c,
+				      _mm_add_ps(a0, _mm_mul_ps(_mm_sub_ps(b0, a0),
+								_mm256_castps256_ps128(f))));
+			c += 4;
+		}
+		for (; c < channels; c++)
+			dst[c] = a[c] + (b[c] - a[c]) * steps[i].frac;
+	}
+	_mm256_zeroupper();
+}
+
+#endif /* HAVE_X86_SIMD */
+
+void snd_pcm_simd_lerp_s16(int16_t *dst, const int16_t *src,
+			   const int16_t *prev,
+			   const snd_pcm_simd_lerp_step_t *steps,
+			   unsigned int frames, unsigned int channels)
+{
+#ifdef HAVE_X86_SIMD
+	unsigned int caps = snd_pcm_simd_caps();
+
+	if ((caps & SND_PCM_SIMD_AVX2) && channels >= 16) {
+		lerp_s16_avx2(dst, src, prev, steps, frames, channels);
+		return;
+	}
+	if ((caps & SND_PCM_SIMD_SSE2) && channels >= 4) {
+		lerp_s16_sse2(dst, src, prev, steps, frames, channels);
+		return;
+	}
+#endif
+	lerp_s16_generic(dst, src, prev, steps, frames, channels);
+}
+
+void snd_pcm_simd_lerp_s32(int32_t *dst, const int32_t *src,
+			   const int32_t *prev,
+			   const snd_pcm_simd_lerp_step_t *steps,
+			   unsigned int frames, unsigned int channels)
+{
+#ifdef HAVE_X86_SIMD
+	unsigned int caps = snd_pcm_simd_caps();
+
+	if ((caps & SND_PCM_SIMD_AVX2) && channels >= 8) {
+		lerp_s32_avx2(dst, src, prev, steps, frames, channels);
+		return;
+	}
+	if ((caps & SND_PCM_SIMD_SSE2) && channels >= 4) {
+		lerp_s32_sse2(dst, src, prev, steps, frames, channels);
+		return;
+	}
+#endif
+	lerp_s32_generic(dst, src, prev, steps, frames, channels);
+}
+
+void snd_pcm_simd_lerp_float(float *dst, const float *src, const float *prev,
+			     const snd_pcm_simd_lerp_step_t *steps,
+			     unsigned int frames, unsigned int channels)
+{
+#ifdef HAVE_X86_SIMD
+	unsigned int caps = snd_pcm_simd_caps();
+
+	if ((caps & SND_PCM_SIMD_AVX2) && channels >= 8) {
+		lerp_float_avx2(dst, src, prev, steps, frames, channels);
+		return;
+	}
+	if ((caps & SND_PCM_SIMD_SSE2) && channels >= 4) {
+		lerp_float_sse2(dst, src, prev, steps, frames, channels);
+		return;
+	}
+#endif
+	lerp_float_generic(dst, src, prev, steps, frames, channels);
+}
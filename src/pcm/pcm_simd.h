@@ -0,0 +1,231 @@
+/*
+ *  PCM Interface - SIMD helpers
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __PCM_SIMD_H
+#define __PCM_SIMD_H
+
+/* CPU features usable by the optimized PCM routines */
+#define SND_PCM_SIMD_SSE2	(1U << 0)
+#define SND_PCM_SIMD_SSSE3	(1U << 1)
+#define SND_PCM_SIMD_SSE41	(1U << 2)
+#define SND_PCM_SIMD_AVX2	(1U << 3)
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#define SND_PCM_SIMD_TARGET(isa)	__attribute__((target(isa)))
+#endif
+
+#define snd_pcm_simd_caps \
+	snd1_pcm_simd_caps
+#define snd_pcm_simd_transpose \
+	snd1_pcm_simd_transpose
+#define snd_pcm_simd_fill \
+	snd1_pcm_simd_fill
+#define snd_pcm_simd_linear_kernel \
+	snd1_pcm_simd_linear_kernel
+#define snd_pcm_simd_float_kernel \
+	snd1_pcm_simd_float_kernel
+#define snd_pcm_simd_g711_kernel \
+	snd1_pcm_simd_g711_kernel
+#define snd_pcm_simd_convert_areas \
+	snd1_pcm_simd_convert_areas
+#define snd_pcm_simd_areas_packed \
+	snd1_pcm_simd_areas_packed
+#define snd_pcm_simd_iec958_encode \
+	snd1_pcm_simd_iec958_encode
+#define snd_pcm_simd_iec958_decode \
+	snd1_pcm_simd_iec958_decode
+#define snd_pcm_simd_s32_to_float \
+	snd1_pcm_simd_s32_to_float
+#define snd_pcm_simd_mac_float \
+	snd1_pcm_simd_mac_float
+#define snd_pcm_simd_float_to_s32 \
+	snd1_pcm_simd_float_to_s32
+#define snd_pcm_simd_gain_kernel \
+	snd1_pcm_simd_gain_kernel
+#define snd_pcm_simd_fir \
+	snd1_pcm_simd_fir
+#define snd_pcm_simd_lerp_s16 \
+	snd1_pcm_simd_lerp_s16
+#define snd_pcm_simd_lerp_s32 \
+	snd1_pcm_simd_lerp_s32
+#define snd_pcm_simd_lerp_float \
+	snd1_pcm_simd_lerp_float
+
+unsigned int snd_pcm_simd_caps(void);
+
+/*
+ * Copy samples between one interleaved area and per-channel contiguous
+ * buffers.  'frame_bytes' is the distance of two frames in the interleaved
+ * buffer, 'width' the sample width in bytes (1, 2, 3, 4 or 8).
+ * If 'to_planar' is set, data is moved from the interleaved buffer into the
+ * planar ones, otherwise in the other direction.
+ */
+void snd_pcm_simd_transpose(char **planar, char *interleaved,
+			    unsigned int frame_bytes, unsigned int channels,
+			    snd_pcm_uframes_t frames, unsigned int width,
+			    int to_planar);
+
+/* fills of this size and more use non-temporal stores */
+#define SND_PCM_SILENCE_NT_BYTES	(256 * 1024)
+
+/*
+ * Fill 'bytes' bytes with a repeated sample pattern of 'size' bytes
+ * (1, 2, 3, 4 or 8).  Large fills bypass the cache.
+ */
+void snd_pcm_simd_fill(void *data, size_t bytes, const void *pattern,
+		       unsigned int size);
+
+/*
+ * Convert 'samples' samples between two sample formats.  The steps are
+ * the distances of two samples in bytes; the vector code is used when
+ * both buffers are contiguous.
+ */
+typedef void (*snd_pcm_simd_convert_t)(char *dst, int dst_step,
+				       const char *src, int src_step,
+				       snd_pcm_uframes_t samples);
+
+/*
+ * Return the conversion kernel for a pair of linear formats, NULL if the
+ * pair is not covered (e.g. 20-bit or 18-bit formats).
+ */
+snd_pcm_simd_convert_t snd_pcm_simd_linear_kernel(snd_pcm_format_t src_format,
+						  snd_pcm_format_t dst_format);
+
+/*
+ * Return the kernel converting between a float format and one of the
+ * linear formats above, NULL if the pair is not covered.
+ */
+snd_pcm_simd_convert_t snd_pcm_simd_float_kernel(snd_pcm_format_t src_format,
+						 snd_pcm_format_t dst_format);
+
+/*
+ * Return the kernel converting between MU_LAW or A_LAW and one of the
+ * linear formats above, NULL if the pair is not covered.
+ */
+snd_pcm_simd_convert_t snd_pcm_simd_g711_kernel(snd_pcm_format_t src_format,
+						snd_pcm_format_t dst_format);
+
+/*
+ * Run a kernel over all channels: one call when both sides are interleaved
+ * in channel order, one call per channel otherwise.  The widths are the
+ * physical sample widths in bits.
+ */
+void snd_pcm_simd_convert_areas(snd_pcm_simd_convert_t kernel,
+				const snd_pcm_channel_area_t *dst_areas,
+				snd_pcm_uframes_t dst_offset,
+				unsigned int dst_width,
+				const snd_pcm_channel_area_t *src_areas,
+				snd_pcm_uframes_t src_offset,
+				unsigned int src_width,
+				unsigned int channels, snd_pcm_uframes_t frames);
+
+/*
+ * Are all channels interleaved in one buffer in their natural order?
+ * 'width' is the physical sample width in bits.
+ */
+int snd_pcm_simd_areas_packed(const snd_pcm_channel_area_t *areas,
+			      unsigned int channels, unsigned int width);
+
+/*
+ * Turn 'samples' S32 samples into IEC958 subframes in place.  'status'
+ * holds the bits ORed into each subframe before the parity is computed
+ * (preamble and channel status); the result is byte swapped if requested.
+ */
+void snd_pcm_simd_iec958_encode(uint32_t *buf, const uint32_t *status,
+				unsigned int samples, int byteswap);
+
+/* extract the S32 samples of 'samples' IEC958 subframes */
+void snd_pcm_simd_iec958_decode(int32_t *dst, const uint32_t *src,
+				unsigned int samples, int byteswap);
+
+/*
+ * Mixing in float: S32 samples are taken at their integer value, 'acc'
+ * gets src * gain added (src alone for a unity gain), and the sums are
+ * rounded to nearest and saturated when converted back.
+ */
+void snd_pcm_simd_s32_to_float(float *dst, const int32_t *src,
+			       unsigned int samples);
+void snd_pcm_simd_mac_float(float *acc, const float *src, float gain,
+			    unsigned int samples);
+void snd_pcm_simd_float_to_s32(int32_t *dst, const float *src,
+			       unsigned int samples);
+
+/*
+ * Apply a 16.16 fixed point volume to 'samples' samples.  When 'vol1'
+ * differs from 'vol0' the volume moves linearly from one to the other
+ * over the samples, reaching 'vol1' on the last one.
+ */
+typedef void (*snd_pcm_simd_gain_t)(char *dst, int dst_step,
+				    const char *src, int src_step,
+				    unsigned int vol0, unsigned int vol1,
+				    snd_pcm_uframes_t samples);
+
+/*
+ * Return the volume kernel for S16, S24_LE, S24_3LE, S32 or native FLOAT
+ * samples, NULL for the other formats.
+ */
+snd_pcm_simd_gain_t snd_pcm_simd_gain_kernel(snd_pcm_format_t format);
+
+/* where an output sample of snd_pcm_simd_fir() is taken from */
+typedef struct {
+	unsigned int src;	/* first input sample */
+	unsigned int coef;	/* offset of the filter in the bank */
+	float frac;		/* weight of the next filter */
+} snd_pcm_simd_fir_step_t;
+
+/*
+ * Polyphase FIR: output sample i is the dot product of 'taps' input
+ * samples from src + steps[i].src on with the filter at bank +
+ * steps[i].coef.  With 'interp' set, the result of the following filter
+ * of the bank is blended in by steps[i].frac.  'taps' must be a multiple
+ * of 8 and the filters 32-byte aligned.
+ */
+void snd_pcm_simd_fir(float *dst, const float *src, const float *bank,
+		      unsigned int taps, const snd_pcm_simd_fir_step_t *steps,
+		      unsigned int frames, int interp);
+
+/* the input frames an output frame of snd_pcm_simd_lerp_*() is made of */
+typedef struct {
+	int a;			/* frame weighted by 1 - frac, -1 for 'prev' */
+	int b;			/* frame weighted by frac, -1 for 'prev' */
+	float frac;		/* of FLOAT samples */
+	unsigned int weight;	/* frac in 16.16 below 0x10000, of integer samples */
+} snd_pcm_simd_lerp_step_t;
+
+/*
+ * Linear interpolation of interleaved frames: every channel of output
+ * frame i is a + (b - a) * frac from the input frames of steps[i].
+ * Integer samples are (a * (0x10000 - weight) + b * weight) >> 16, the
+ * same at every level.
+ */
+void snd_pcm_simd_lerp_s16(int16_t *dst, const int16_t *src,
+			   const int16_t *prev,
+			   const snd_pcm_simd_lerp_step_t *steps,
+			   unsigned int frames, unsigned int channels);
+void snd_pcm_simd_lerp_s32(int32_t *dst, const int32_t *src,
+			   const int32_t *prev,
+			   const snd_pcm_simd_lerp_step_t *steps,
+			   unsigned int frames, unsigned int channels);
+void snd_pcm_simd_lerp_float(float *dst, const float *src, const float *prev,
+			     const snd_pcm_simd_lerp_step_t *steps,
+			     unsigned int frames, unsigned int channels);
+
+#endif /* __PCM_SIMD_H */
@@ -26,10 +26,16 @@
  *
  */
 
-#include "bswap.h"
 #include <math.h>
+#include <unistd.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#include "pcm_simd.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#include <signal.h>
+#include <poll.h>
+#endif
 
 #include <sound/tlv.h>
 
@@ -53,10 +59,19 @@ typedef struct {
 	double min_dB;
 	double max_dB;
 	unsigned int *dB_value;
+	snd_pcm_simd_gain_t gain;
+	unsigned int width;		/* physical sample bits */
+	unsigned int ramp_scale[3];	/* last applied, see softvol_convert() */
+	int ramp_valid;
+#ifdef HAVE_LIBPTHREAD
+	int watching;			/* see softvol_watch() */
+	pid_t watch_pid;		/* the process owning the thread */
+	pthread_t watch_thread;
+	unsigned int watch_vol[2];
+#endif
 } snd_pcm_softvol_t;
 
 #define VOL_SCALE_SHIFT		16
-#define VOL_SCALE_MASK          ((1 << VOL_SCALE_SHIFT) - 1)
 
 #define PRESET_RESOLUTION	256
 #define PRESET_MIN_DB		-51.0
@@ -102,216 +117,117 @@ static const unsigned int preset_dB_value[PRESET_RESOLUTION] = {
 	0xd9e3, 0xdef6, 0xe428, 0xe978, 0xeee8, 0xf479, 0xfa2b, 0xffff,
 };
 
-/* (32bit x 16bit) >> 16 */
-typedef union {
-	int i;
-	short s[2];
-} val_t;
-static inline int MULTI_DIV_32x16(int a, unsigned short b)
-{
-	val_t v, x, y;
-	v.i = a;
-	y.i = 0;
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-	x.i = (unsigned short)v.s[0];
-	x.i *= b;
-	y.s[0] = x.s[1];
-	y.i += (int)v.s[1] * b;
-#else
-	x.i = (unsigned int)v.s[1] * b;
-	y.s[1] = x.s[0];
-	y.i += (int)v.s[0] * b;
-#endif
-	return y.i;
-}
+#endif /* DOC_HIDDEN */
 
-static inline int MULTI_DIV_int(int a, unsigned int b, int swap)
+/*
+ * apply volume attenuation
+ *
+ * scale[] holds the 16.16 factors of the left, right and center
+ * channels, 0 mutes and 0xffff passes the samples unchanged.  A change
+ * of volume is ramped over the frames of the transfer.
+ */
+
+/* the control channel of a stream channel: 2.0, 2.1, 4.0, 4.1, 5.1, 7.1 */
+static unsigned int softvol_scale_index(unsigned int ch, unsigned int channels)
 {
-	unsigned int gain = (b >> VOL_SCALE_SHIFT);
-	int fraction;
-	a = swap ? (int)bswap_32(a) : a;
-	fraction = MULTI_DIV_32x16(a, b & VOL_SCALE_MASK);
-	if (gain) {
-		long long amp = (long long)a * gain + fraction;
-		if (amp > (int)0x7fffffff)
-			amp = (int)0x7fffffff;
-		else if (amp < (int)0x80000000)
-			amp = (int)0x80000000;
-		return swap ? (int)bswap_32((int)amp) : (int)amp;
+	switch (ch) {
+	case 0:
+	case 2:
+		return channels == ch + 1 ? 2 : 0;
+	case 4:
+	case 5:
+		return 2;
+	default:
+		return ch & 1;
 	}
-	return swap ? (int)bswap_32(fraction) : fraction;
 }
 
-/* always little endian */
-static inline int MULTI_DIV_24(int a, unsigned int b)
+static void softvol_convert_area(snd_pcm_softvol_t *svol,
+				 const snd_pcm_channel_area_t *dst_area,
+				 snd_pcm_uframes_t dst_offset,
+				 const snd_pcm_channel_area_t *src_area,
+				 snd_pcm_uframes_t src_offset,
+				 snd_pcm_uframes_t frames,
+				 unsigned int vol0, unsigned int vol1)
 {
-	unsigned int gain = b >> VOL_SCALE_SHIFT;
-	int fraction;
-	fraction = MULTI_DIV_32x16(a, b & VOL_SCALE_MASK);
-	if (gain) {
-		long long amp = (long long)a * gain + fraction;
-		if (amp > (int)0x7fffff)
-			amp = (int)0x7fffff;
-		else if (amp < (int)0x800000)
-			amp = (int)0x800000;
-		return (int)amp;
-	}
-	return fraction;
+	if (vol0 == vol1 && vol1 == 0)
+		snd_pcm_area_silence(dst_area, dst_offset, frames,
+				     svol->sformat);
+	else if (vol0 == vol1 && vol1 == 0xffff)
+		snd_pcm_area_copy(dst_area, dst_offset, src_area, src_offset,
+				  frames, svol->sformat);
+	else
+		svol->gain(snd_pcm_channel_area_addr(dst_area, dst_offset),
+			   snd_pcm_channel_area_step(dst_area),
+			   snd_pcm_channel_area_addr(src_area, src_offset),
+			   snd_pcm_channel_area_step(src_area),
+			   vol0, vol1, frames);
 }
 
-static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
+static void softvol_convert(snd_pcm_softvol_t *svol,
+			    const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_offset,
+			    unsigned int channels,
+			    snd_pcm_uframes_t frames,
+			    const unsigned int *scale)
 {
-	unsigned int gain = b >> VOL_SCALE_SHIFT;
-	int fraction;
-	a = swap ? (short)bswap_16(a) : a;
-	fraction = (int)(a * (b & VOL_SCALE_MASK)) >> VOL_SCALE_SHIFT;
-	if (gain) {
-		int amp = a * gain + fraction;
-		if (abs(amp) > 0x7fff)
-			amp = (a<0) ? (short)0x8000 : (short)0x7fff;
-		return swap ? (short)bswap_16((short)amp) : (short)amp;
+	unsigned int from[3], ch, i, k;
+	int ramp = 0;
+
+	for (i = 0; i < 3; i++) {
+		from[i] = svol->ramp_valid ? svol->ramp_scale[i] : scale[i];
+		if (from[i] != scale[i])
+			ramp = 1;
+		svol->ramp_scale[i] = scale[i];
 	}
-	return swap ? (short)bswap_16((short)fraction) : (short)fraction;
-}
-
-#endif /* DOC_HIDDEN */
+	svol->ramp_valid = 1;
 
-/*
- * apply volumue attenuation
- *
- * TODO: use SIMD operations
- */
+	if (!ramp && scale[0] == 0 && scale[1] == 0 && scale[2] == 0) {
+		snd_pcm_areas_silence(dst_areas, dst_offset, channels, frames,
+				      svol->sformat);
+		return;
+	} else if (!ramp && scale[0] == 0xffff && scale[1] == 0xffff &&
+		   scale[2] == 0xffff) {
+		snd_pcm_areas_copy(dst_areas, dst_offset, src_areas, src_offset,
+				   channels, frames, svol->sformat);
+		return;
+	}
 
-#ifndef DOC_HIDDEN
-#define CONVERT_AREA(TYPE, swap) do {	\
-	unsigned int ch, fr; \
-	TYPE *src, *dst; \
-	for (ch = 0; ch < channels; ch++) { \
-		src_area = &src_areas[ch]; \
-		dst_area = &dst_areas[ch]; \
-		src = snd_pcm_channel_area_addr(src_area, src_offset); \
-		dst = snd_pcm_channel_area_addr(dst_area, dst_offset); \
-		src_step = snd_pcm_channel_area_step(src_area) / sizeof(TYPE); \
-		dst_step = snd_pcm_channel_area_step(dst_area) / sizeof(TYPE); \
-		GET_VOL_SCALE; \
-		fr = frames; \
-		if (! vol_scale) { \
-			while (fr--) { \
-				*dst = 0; \
-				dst += dst_step; \
-			} \
-		} else if (vol_scale == 0xffff) { \
-			while (fr--) { \
-				*dst = *src; \
-				src += src_step; \
-				dst += dst_step; \
-			} \
-		} else { \
-			while (fr--) { \
-				*dst = (TYPE) MULTI_DIV_##TYPE(*src, vol_scale, swap); \
-				src += src_step; \
-				dst += dst_step; \
-			} \
-		} \
-	} \
-} while (0)
-
-#define CONVERT_AREA_S24_3LE() do {					\
-	unsigned int ch, fr;						\
-	unsigned char *src, *dst;					\
-	int tmp;							\
-	for (ch = 0; ch < channels; ch++) {				\
-		src_area = &src_areas[ch];				\
-		dst_area = &dst_areas[ch];				\
-		src = snd_pcm_channel_area_addr(src_area, src_offset);	\
-		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);	\
-		src_step = snd_pcm_channel_area_step(src_area);		\
-		dst_step = snd_pcm_channel_area_step(dst_area);		\
-		GET_VOL_SCALE;						\
-		fr = frames;						\
-		if (! vol_scale) {					\
-			while (fr--) {					\
-				dst[0] = dst[1] = dst[2] = 0;		\
-				dst += dst_step;			\
-			}						\
-		} else if (vol_scale == 0xffff) {			\
-			while (fr--) {					\
-				dst[0] = src[0];			\
-				dst[1] = src[1];			\
-				dst[2] = src[2];			\
-				src += dst_step;			\
-				dst += src_step;			\
-			}						\
-		} else {						\
-			while (fr--) {					\
-				tmp = src[0] |				\
-				      (src[1] << 8) |			\
-				      (((signed char *) src)[2] << 16);	\
-				tmp = MULTI_DIV_24(tmp, vol_scale);	\
-				dst[0] = tmp;				\
-				dst[1] = tmp >> 8;			\
-				dst[2] = tmp >> 16;			\
-				src += dst_step;			\
-				dst += src_step;			\
-			}						\
-		}							\
-	}								\
-} while (0)
-
-#define CONVERT_AREA_S24_LE() do {					\
-	unsigned int ch, fr;						\
-	int *src, *dst;							\
-	int tmp;							\
-	for (ch = 0; ch < channels; ch++) {				\
-		src_area = &src_areas[ch];				\
-		dst_area = &dst_areas[ch];				\
-		src = snd_pcm_channel_area_addr(src_area, src_offset);	\
-		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);	\
-		src_step = snd_pcm_channel_area_step(src_area)		\
-				/ sizeof(int);				\
-		dst_step = snd_pcm_channel_area_step(dst_area)		\
-				/ sizeof(int);				\
-		GET_VOL_SCALE;						\
-		fr = frames;						\
-		if (! vol_scale) {					\
-			while (fr--) {					\
-				*dst = 0;				\
-				dst += dst_step;			\
-			}						\
-		} else if (vol_scale == 0xffff) {			\
-			while (fr--) {					\
-				*dst = *src;				\
-				src += dst_step;			\
-				dst += src_step;			\
-			}						\
-		} else {						\
-			while (fr--) {					\
-				tmp = *src << 8;			\
-				tmp = (signed int) tmp >> 8;		\
-				*dst = MULTI_DIV_24(tmp, vol_scale);	\
-				src += dst_step;			\
-				dst += src_step;			\
-			}						\
-		}							\
-	}								\
-} while (0)
-		
-#define GET_VOL_SCALE \
-	switch (ch) { \
-	case 0: \
-	case 2: \
-		vol_scale = (channels == ch + 1) ? vol_c : vol[0]; \
-		break; \
-	case 4: \
-	case 5: \
-		vol_scale = vol_c; \
-		break; \
-	default: \
-		vol_scale = vol[ch & 1]; \
-		break; \
+	/*
+	 * the same volume on all channels: one pass over the interleaved
+	 * samples, a ramp then moves on every sample instead of every frame
+	 */
+	i = softvol_scale_index(0, channels);
+	for (ch = 1; ch < channels; ch++) {
+		k = softvol_scale_index(ch, channels);
+		if (from[k] != from[i] || scale[k] != scale[i])
+			break;
+	}
+	if (ch == channels &&
+	    snd_pcm_simd_areas_packed(src_areas, channels, svol->width) &&
+	    snd_pcm_simd_areas_packed(dst_areas, channels, svol->width)) {
+		snd_pcm_channel_area_t src_area = {
+			snd_pcm_channel_area_addr(src_areas, src_offset), 0,
+			svol->width
+		};
+		snd_pcm_channel_area_t dst_area = {
+			snd_pcm_channel_area_addr(dst_areas, dst_offset), 0,
+			svol->width
+		};
+		softvol_convert_area(svol, &dst_area, 0, &src_area, 0,
+				     frames * channels, from[i], scale[i]);
+		return;
 	}
 
-#endif /* DOC_HIDDEN */
+	for (ch = 0; ch < channels; ch++) {
+		i = softvol_scale_index(ch, channels);
+		softvol_convert_area(svol, &dst_areas[ch], dst_offset,
+				     &src_areas[ch], src_offset, frames,
+				     from[i], scale[i]);
+	}
+}
 
 /* 2-channel stereo control */
 static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
@@ -322,58 +238,26 @@ static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 				       unsigned int channels,
 				       snd_pcm_uframes_t frames)
 {
-	const snd_pcm_channel_area_t *dst_area, *src_area;
-	unsigned int src_step, dst_step;
-	unsigned int vol_scale, vol[2], vol_c;
+	unsigned int scale[3];
 
 	if (svol->cur_vol[0] == 0 && svol->cur_vol[1] == 0) {
-		snd_pcm_areas_silence(dst_areas, dst_offset, channels, frames,
-				      svol->sformat);
-		return;
+		scale[0] = scale[1] = scale[2] = 0;
 	} else if (svol->zero_dB_val && svol->cur_vol[0] == svol->zero_dB_val &&
 		   svol->cur_vol[1] == svol->zero_dB_val) {
-		snd_pcm_areas_copy(dst_areas, dst_offset, src_areas, src_offset,
-				   channels, frames, svol->sformat);
-		return;
-	}
-
-	if (svol->max_val == 1) {
-		vol[0] = svol->cur_vol[0] ? 0xffff : 0;
-		vol[1] = svol->cur_vol[1] ? 0xffff : 0;
-		vol_c = vol[0] | vol[1];
+		scale[0] = scale[1] = scale[2] = 0xffff;
+	} else if (svol->max_val == 1) {
+		scale[0] = svol->cur_vol[0] ? 0xffff : 0;
+		scale[1] = svol->cur_vol[1] ? 0xffff : 0;
+		scale[2] = scale[0] | scale[1];
 	} else {
-		vol[0] = svol->dB_value[svol->cur_vol[0]];
-		vol[1] = svol->dB_value[svol->cur_vol[1]];
-		vol_c = svol->dB_value[(svol->cur_vol[0] + svol->cur_vol[1]) / 2];
-	}
-	switch (svol->sformat) {
-	case SND_PCM_FORMAT_S16_LE:
-	case SND_PCM_FORMAT_S16_BE:
-		/* 16bit samples */
-		CONVERT_AREA(short, 
-			     !snd_pcm_format_cpu_endian(svol->sformat));
-		break;
-	case SND_PCM_FORMAT_S32_LE:
-	case SND_PCM_FORMAT_S32_BE:
-		/* 32bit samples */
-		CONVERT_AREA(int,
-			     !snd_pcm_format_cpu_endian(svol->sformat));
-		break;
-	case SND_PCM_FORMAT_S24_LE:
-		/* 24bit samples */
-		CONVERT_AREA_S24_LE();
-		break;
-	case SND_PCM_FORMAT_S24_3LE:
-		CONVERT_AREA_S24_3LE();
-		break;
-	default:
-		break;
+		scale[0] = svol->dB_value[svol->cur_vol[0]];
+		scale[1] = svol->dB_value[svol->cur_vol[1]];
+		scale[2] = svol->dB_value[(svol->cur_vol[0] + svol->cur_vol[1]) / 2];
 	}
+	softvol_convert(svol, dst_areas, dst_offset, src_areas, src_offset,
+			channels, frames, scale);
 }
 
-#undef GET_VOL_SCALE
-#define GET_VOL_SCALE
-
 /* mono control */
 static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 				     const snd_pcm_channel_area_t *dst_areas,
@@ -383,55 +267,23 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 				     unsigned int channels,
 				     snd_pcm_uframes_t frames)
 {
-	const snd_pcm_channel_area_t *dst_area, *src_area;
-	unsigned int src_step, dst_step;
-	unsigned int vol_scale;
-
-	if (svol->cur_vol[0] == 0) {
-		snd_pcm_areas_silence(dst_areas, dst_offset, channels, frames,
-				      svol->sformat);
-		return;
-	} else if (svol->zero_dB_val && svol->cur_vol[0] == svol->zero_dB_val) {
-		snd_pcm_areas_copy(dst_areas, dst_offset, src_areas, src_offset,
-				   channels, frames, svol->sformat);
-		return;
-	}
-
-	if (svol->max_val == 1)
-		vol_scale = svol->cur_vol[0] ? 0xffff : 0;
+	unsigned int scale[3];
+
+	if (svol->cur_vol[0] == 0)
+		scale[0] = 0;
+	else if (svol->zero_dB_val && svol->cur_vol[0] == svol->zero_dB_val)
+		scale[0] = 0xffff;
+	else if (svol->max_val == 1)
+		scale[0] = 0xffff;
 	else
-		vol_scale = svol->dB_value[svol->cur_vol[0]];
-	switch (svol->sformat) {
-	case SND_PCM_FORMAT_S16_LE:
-	case SND_PCM_FORMAT_S16_BE:
-		/* 16bit samples */
-		CONVERT_AREA(short, 
-			     !snd_pcm_format_cpu_endian(svol->sformat));
-		break;
-	case SND_PCM_FORMAT_S32_LE:
-	case SND_PCM_FORMAT_S32_BE:
-		/* 32bit samples */
-		CONVERT_AREA(int,
-			     !snd_pcm_format_cpu_endian(svol->sformat));
-		break;
-	case SND_PCM_FORMAT_S24_LE:
-		/* 24bit samples */
-		CONVERT_AREA_S24_LE();
-		break;
-	case SND_PCM_FORMAT_S24_3LE:
-		CONVERT_AREA_S24_3LE();
-		break;
-	default:
-		break;
-	}
+		scale[0] = svol->dB_value[svol->cur_vol[0]];
+	scale[1] = scale[2] = scale[0];
+	softvol_convert(svol, dst_areas, dst_offset, src_areas, src_offset,
+			channels, frames, scale);
 }
 
-/*
- * get the current volume value from driver
- *
- * TODO: mmap support?
- */
-static void get_current_volume(snd_pcm_softvol_t *svol)
+/* read the control into 'vol' */
+static void read_volume(snd_pcm_softvol_t *svol, unsigned int *vol)
 {
 	unsigned int val;
 	unsigned int i;
@@ -442,12 +294,133 @@ static void get_current_volume(snd_pcm_softvol_t *svol)
 		val = svol->elem.value.integer.value[i];
 		if (val > svol->max_val)
 			val = svol->max_val;
-		svol->cur_vol[i] = val;
+#ifdef HAVE_LIBPTHREAD
+		__atomic_store_n(&vol[i], val, __ATOMIC_RELAXED);
+#else
+		vol[i] = val;
+#endif
+	}
+}
+
+#ifdef HAVE_LIBPTHREAD
+static int softvol_event_match(snd_pcm_softvol_t *svol,
+			       const snd_ctl_event_t *event)
+{
+	const snd_ctl_elem_id_t *id = &svol->elem.id;
+
+	return snd_ctl_event_get_type(event) == SND_CTL_EVENT_ELEM &&
+	       (snd_ctl_event_elem_get_mask(event) & SND_CTL_EVENT_MASK_VALUE) &&
+	       snd_ctl_event_elem_get_interface(event) == snd_ctl_elem_id_get_interface(id) &&
+	       snd_ctl_event_elem_get_device(event) == snd_ctl_elem_id_get_device(id) &&
+	       snd_ctl_event_elem_get_subdevice(event) == snd_ctl_elem_id_get_subdevice(id) &&
+	       snd_ctl_event_elem_get_index(event) == snd_ctl_elem_id_get_index(id) &&
+	       !strcmp(snd_ctl_event_elem_get_name(event), snd_ctl_elem_id_get_name(id));
+}
+
+/*
+ * The control is watched by a thread sleeping on its change events,
+ * which keeps watch_vol[] up to date; the transfers only load the
+ * cached values and make no system call for them.  The thread can be
+ * cancelled only while it waits.  It runs between hw_params and hw_free;
+ * a forked child does not have it and reads the control itself.
+ */
+static void *softvol_watch(void *arg)
+{
+	snd_pcm_softvol_t *svol = arg;
+	snd_ctl_event_t event;
+	struct pollfd pfd;
+	int changed, err;
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	if (snd_ctl_poll_descriptors(svol->ctl, &pfd, 1) != 1)
+		return NULL;
+	for (;;) {
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+		err = poll(&pfd, 1, -1);
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		if (err < 0 && errno != EINTR)
+			return NULL;
+		/* the card is gone, the volume stays as it is */
+		if (err > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+			return NULL;
+		changed = 0;
+		while (snd_ctl_read(svol->ctl, &event) > 0) {
+			if (softvol_event_match(svol, &event))
+				changed = 1;
+		}
+		if (changed)
+			read_volume(svol, svol->watch_vol);
+	}
+	return NULL;
+}
+
+static void softvol_watch_start(snd_pcm_softvol_t *svol)
+{
+	sigset_t all, old;
+	int err;
+
+	if (svol->watching)
+		return;
+	/* a control without events is read at each transfer */
+	if (snd_ctl_poll_descriptors_count(svol->ctl) != 1)
+		return;
+	if (snd_ctl_nonblock(svol->ctl, 1) < 0 ||
+	    snd_ctl_subscribe_events(svol->ctl, 1) < 0)
+		goto fail;
+	/* subscribed first, so that no change can be missed */
+	read_volume(svol, svol->watch_vol);
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	err = pthread_create(&svol->watch_thread, NULL, softvol_watch, svol);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err)
+		goto fail;
+	svol->watching = 1;
+	svol->watch_pid = getpid();
+	return;
+
+ fail:
+	/* the volume is read at each transfer then */
+	snd_ctl_subscribe_events(svol->ctl, 0);
+	snd_ctl_nonblock(svol->ctl, 0);
+}
+
+static void softvol_watch_stop(snd_pcm_softvol_t *svol)
+{
+	if (!svol->watching)
+		return;
+	svol->watching = 0;
+	/* the ctl file is shared with the parent, leave it as it is */
+	if (svol->watch_pid != getpid())
+		return;
+	pthread_cancel(svol->watch_thread);
+	pthread_join(svol->watch_thread, NULL);
+	snd_ctl_subscribe_events(svol->ctl, 0);
+	snd_ctl_nonblock(svol->ctl, 0);
+}
+#endif /* HAVE_LIBPTHREAD */
+
+/* get the current volume value */
+static void get_current_volume(snd_pcm_softvol_t *svol)
+{
+#ifdef HAVE_LIBPTHREAD
+	unsigned int i;
+
+	if (svol->watching && svol->watch_pid == getpid()) {
+		for (i = 0; i < svol->cchannels; i++)
+			svol->cur_vol[i] = __atomic_load_n(&svol->watch_vol[i],
+							   __ATOMIC_RELAXED);
+		return;
 	}
+#endif
+	read_volume(svol, svol->cur_vol);
 }
 
 static void softvol_free(snd_pcm_softvol_t *svol)
 {
+#ifdef HAVE_LIBPTHREAD
+	softvol_watch_stop(svol);
+#endif
 	if (svol->plug.gen.close_slave)
 		snd_pcm_close(svol->plug.gen.slave);
 	if (svol->ctl)
@@ -476,7 +449,8 @@ static int snd_pcm_softvol_hw_refine_cprepare(snd_pcm_t *pcm,
 			(1ULL << SND_PCM_FORMAT_S16_BE) |
 			(1ULL << SND_PCM_FORMAT_S24_LE) |
 			(1ULL << SND_PCM_FORMAT_S32_LE) |
- 			(1ULL << SND_PCM_FORMAT_S32_BE),
+ 			(1ULL << SND_PCM_FORMAT_S32_BE) |
+			(1ULL << SND_PCM_FORMAT_FLOAT),
 			(1ULL << (SND_PCM_FORMAT_S24_3LE - 32))
 		}
 	};
@@ -632,12 +606,36 @@ static int snd_pcm_softvol_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * param
 	    slave->format != SND_PCM_FORMAT_S24_3LE && 
 	    slave->format != SND_PCM_FORMAT_S24_LE &&
 	    slave->format != SND_PCM_FORMAT_S32_LE &&
-	    slave->format != SND_PCM_FORMAT_S32_BE) {
+	    slave->format != SND_PCM_FORMAT_S32_BE &&
+	    slave->format != SND_PCM_FORMAT_FLOAT) {
 		SNDERR("softvol supports only S16_LE, S16_BE, S24_LE, S24_3LE, "
-		       "S32_LE or S32_BE");
+		       "S32_LE, S32_BE or FLOAT");
 		return -EINVAL;
 	}
 	svol->sformat = slave->format;
+	svol->gain = snd_pcm_simd_gain_kernel(svol->sformat);
+	svol->width = snd_pcm_format_physical_width(svol->sformat);
+#ifdef HAVE_LIBPTHREAD
+	softvol_watch_start(svol);
+#endif
+	return 0;
+}
+
+static int snd_pcm_softvol_hw_free(snd_pcm_t *pcm)
+{
+#ifdef HAVE_LIBPTHREAD
+	snd_pcm_softvol_t *svol = pcm->private_data;
+
+	softvol_watch_stop(svol);
+#endif
+	return snd_pcm_generic_hw_free(pcm);
+}
+
+static int snd_pcm_softvol_init(snd_pcm_t *pcm)
+{
+	snd_pcm_softvol_t *svol = pcm->private_data;
+	/* no ramp from the volume of the previous run */
+	svol->ramp_valid = 0;
 	return 0;
 }
 
@@ -872,7 +870,7 @@ static const snd_pcm_ops_t snd_pcm_softvol_ops = {
 	.info = snd_pcm_generic_info,
 	.hw_refine = snd_pcm_softvol_hw_refine,
 	.hw_params = snd_pcm_softvol_hw_params,
-	.hw_free = snd_pcm_generic_hw_free,
+	.hw_free = snd_pcm_softvol_hw_free,
 	.sw_params = snd_pcm_generic_sw_params,
 	.channel_info = snd_pcm_generic_channel_info,
 	.dump = snd_pcm_softvol_dump,
@@ -920,7 +918,8 @@ int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	    sformat != SND_PCM_FORMAT_S24_3LE && 
 	    sformat != SND_PCM_FORMAT_S24_LE &&
 	    sformat != SND_PCM_FORMAT_S32_LE &&
-	    sformat != SND_PCM_FORMAT_S32_BE)
+	    sformat != SND_PCM_FORMAT_S32_BE &&
+	    sformat != SND_PCM_FORMAT_FLOAT)
 		return -EINVAL;
 	svol = calloc(1, sizeof(*svol));
 	if (! svol)
@@ -947,6 +946,7 @@ int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	svol->plug.write = snd_pcm_softvol_write_areas;
 	svol->plug.undo_read = snd_pcm_plugin_undo_read_generic;
 	svol->plug.undo_write = snd_pcm_plugin_undo_write_generic;
+	svol->plug.init = snd_pcm_softvol_init;
 	svol->plug.gen.slave = slave;
 	svol->plug.gen.close_slave = close_slave;
 
@@ -984,6 +984,15 @@ int snd_pcm_parse_control_id(snd_config_t *conf, snd_ctl_elem_id_t *ctl_id, int
 
 This plugin applies the software volume attenuation.
 The format, rate and channels must match for both of source and destination.
+The native FLOAT format is accepted as well; float samples are scaled
+without clipping.
+
+The plugin follows the control through its change events, so that no
+system call is made on the transfer path to get the volume.
+
+A volume change does not take effect as a step: the gain moves linearly
+from the old to the new value over the frames of the next transfer
+(usually a period), which avoids clicks.
 
 When the control is stereo (count=2), the channels are assumed to be either
 mono, 2.0, 2.1, 4.0, 4.1, 5.1 or 7.1.
@@ -1140,8 +1149,9 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 		    sformat != SND_PCM_FORMAT_S24_3LE && 
 		    sformat != SND_PCM_FORMAT_S24_LE &&
 		    sformat != SND_PCM_FORMAT_S32_LE &&
-		    sformat != SND_PCM_FORMAT_S32_BE) {
-			SNDERR("only S16_LE, S16_BE, S24_LE, S24_3LE, S32_LE or S32_BE format is supported");
+		    sformat != SND_PCM_FORMAT_S32_BE &&
+		    sformat != SND_PCM_FORMAT_FLOAT) {
+			SNDERR("only S16_LE, S16_BE, S24_LE, S24_3LE, S32_LE, S32_BE or FLOAT format is supported");
 			snd_config_delete(sconf);
 			return -EINVAL;
 		}
@@ -0,0 +1,271 @@
+/*
+ * Card-less control device for the tests and benchmarks
+ *
+ * It has a single mixer element which looks like a user control, e.g.
+ * the one of a softvol plugin, so that such plugins can run without any
+ * hardware.  The values are shared by all handles in the process, and a
+ * write is reported as a change event to every handle subscribed, unless
+ * the handle was opened without events.  The reads of the values are
+ * counted in dummy_ctl_reads, for the tests to look up.
+ *
+ *   ctl_type.dummy { lib "/path/to/dummy_ctl.so" }
+ *   ctl.!hw {
+ *           @args [ CARD ]
+ *           @args.CARD { type string default "0" }
+ *           type dummy
+ *           name "Soft Volume"	# element name
+ *           channels 2		# element count
+ *           max 255			# maximum value
+ *           value 200		# initial value
+ *           events false		# no poll descriptor, no events
+ *   }
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "../include/asoundlib.h"
+#include "../include/control_external.h"
+
+/* SNDRV_CTL_ELEM_ACCESS_USER */
+#define DUMMY_ACCESS_USER	(1 << 29)
+#define DUMMY_MAX_CHANNELS	32
+
+typedef struct snd_ctl_dummy {
+	snd_ctl_ext_t ext;
+	int pipe[2];			/* change events */
+	struct snd_ctl_dummy *next;
+} snd_ctl_dummy_t;
+
+static struct {
+	char name[44];
+	unsigned int channels;
+	long max;
+	long value[DUMMY_MAX_CHANNELS];
+	int valid;
+	snd_ctl_dummy_t *handles;
+} elem;
+
+/* read_integer calls of all handles */
+unsigned long dummy_ctl_reads;
+
+static int dummy_elem_count(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED)
+{
+	return 1;
+}
+
+static int dummy_elem_list(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			   unsigned int offset, snd_ctl_elem_id_t *id)
+{
+	if (offset)
+		return -EINVAL;
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, elem.name);
+	return 0;
+}
+
+static snd_ctl_ext_key_t dummy_find_elem(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+					 const snd_ctl_elem_id_t *id)
+{
+	if (snd_ctl_elem_id_get_interface(id) != SND_CTL_ELEM_IFACE_MIXER ||
+	    strcmp(snd_ctl_elem_id_get_name(id), elem.name))
+		return SND_CTL_EXT_KEY_NOT_FOUND;
+	return 0;
+}
+
+static int dummy_get_attribute(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			       snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+			       int *type, unsigned int *acc, unsigned int *count)
+{
+	*type = SND_CTL_ELEM_TYPE_INTEGER;
+	*acc = SND_CTL_EXT_ACCESS_READWRITE | DUMMY_ACCESS_USER;
+	*count = elem.channels;
+	return 0;
+}
+
+static int dummy_get_integer_info(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				  snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				  long *imin, long *imax, long *istep)
+{
+	*imin = 0;
+	*imax = elem.max;
+	*istep = 1;
+	return 0;
+}
+
+static int dummy_read_integer(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			      snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+			      long *value)
+{
+	unsigned int i;
+
+	__atomic_add_fetch(&dummy_ctl_reads, 1, __ATOMIC_RELAXED);
+	for (i = 0; i < elem.channels; i++)
+		value[i] = __atomic_load_n(&elem.value[i], __ATOMIC_RELAXED);
+	return 0;
+}
+
+static int dummy_write_integer(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			       snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+			       long *value)
+{
+	snd_ctl_dummy_t *h;
+	unsigned int i;
+	int changed = 0;
+	char c = 0;
+
+	for (i = 0; i < elem.channels; i++) {
+		if (value[i] < 0 || value[i] > elem.max)
+			return -EINVAL;
+		if (value[i] != elem.value[i]) {
+			__atomic_store_n(&elem.value[i], value[i], __ATOMIC_RELAXED);
+			changed = 1;
+		}
+	}
+	if (!changed)
+		return 0;
+	for (h = elem.handles; h; h = h->next)
+		if (h->ext.subscribed && h->ext.poll_fd >= 0 &&
+		    write(h->pipe[1], &c, 1) < 0)
+			continue;
+	return 1;
+}
+
+static int dummy_read_event(snd_ctl_ext_t *ext, snd_ctl_elem_id_t *id,
+			    unsigned int *event_mask)
+{
+	snd_ctl_dummy_t *h = ext->private_data;
+	char c;
+
+	if (read(h->pipe[0], &c, 1) != 1)
+		return -EAGAIN;
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, elem.name);
+	*event_mask = SND_CTL_EVENT_MASK_VALUE;
+	return 1;
+}
+
+static void dummy_close(snd_ctl_ext_t *ext)
+{
+	snd_ctl_dummy_t *h = ext->private_data, **p;
+
+	for (p = &elem.handles; *p; p = &(*p)->next) {
+		if (*p == h) {
+			*p = h->next;
+			break;
+		}
+	}
+	close(h->pipe[0]);
+	close(h->pipe[1]);
+	free(h);
+}
+
+static const snd_ctl_ext_callback_t dummy_ext_callback = {
+	.close = dummy_close,
+	.elem_count = dummy_elem_count,
+	.elem_list = dummy_elem_list,
+	.find_elem = dummy_find_elem,
+	.get_attribute = dummy_get_attribute,
+	.get_integer_info = dummy_get_integer_info,
+	.read_integer = dummy_read_integer,
+	.write_integer = dummy_write_integer,
+	.read_event = dummy_read_event,
+};
+
+SND_CTL_PLUGIN_DEFINE_FUNC(dummy)
+{
+	snd_config_iterator_t i, next;
+	const char *ename = "Soft Volume";
+	long channels = 2, max = 255, value = -1;
+	snd_ctl_dummy_t *h;
+	unsigned int c;
+	int events = 1, err;
+
+	(void)root;
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (!strcmp(id, "comment") || !strcmp(id, "type") ||
+		    !strcmp(id, "hint"))
+			continue;
+		if (!strcmp(id, "name")) {
+			if (snd_config_get_string(n, &ename) < 0)
+				return -EINVAL;
+			continue;
+		}
+		if (!strcmp(id, "channels")) {
+			if (snd_config_get_integer(n, &channels) < 0 ||
+			    channels < 1 || channels > DUMMY_MAX_CHANNELS)
+				return -EINVAL;
+			continue;
+		}
+		if (!strcmp(id, "max")) {
+			if (snd_config_get_integer(n, &max) < 0 || max < 1)
+				return -EINVAL;
+			continue;
+		}
+		if (!strcmp(id, "value")) {
+			if (snd_config_get_integer(n, &value) < 0)
+				return -EINVAL;
+			continue;
+		}
+		if (!strcmp(id, "events")) {
+			events = snd_config_get_bool(n);
+			if (events < 0)
+				return -EINVAL;
+			continue;
+		}
+		SNDERR("Unknown field %s", id);
+		return -EINVAL;
+	}
+	if (value < 0 || value > max)
+		value = max;
+
+	/* the first handle defines the element */
+	if (!elem.valid) {
+		snprintf(elem.name, sizeof(elem.name), "%s", ename);
+		elem.channels = channels;
+		elem.max = max;
+		for (c = 0; c < elem.channels; c++)
+			elem.value[c] = value;
+		elem.valid = 1;
+	}
+
+	h = calloc(1, sizeof(*h));
+	if (!h)
+		return -ENOMEM;
+	if (pipe(h->pipe) < 0) {
+		free(h);
+		return -errno;
+	}
+	fcntl(h->pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(h->pipe[1], F_SETFL, O_NONBLOCK);
+	h->ext.version = SND_CTL_EXT_VERSION;
+	h->ext.card_idx = 0;
+	strcpy(h->ext.id, "Dummy");
+	strcpy(h->ext.driver, "Dummy");
+	strcpy(h->ext.name, "Dummy");
+	strcpy(h->ext.longname, "Dummy control device");
+	strcpy(h->ext.mixername, "Dummy");
+	h->ext.poll_fd = events ? h->pipe[0] : -1;
+	h->ext.callback = &dummy_ext_callback;
+	h->ext.private_data = h;
+
+	err = snd_ctl_ext_create(&h->ext, name, mode);
+	if (err < 0) {
+		close(h->pipe[0]);
+		close(h->pipe[1]);
+		free(h);
+		return err;
+	}
+	h->next = elem.handles;
+	elem.handles = h;
+	*handlep = h->ext.handle;
+	return 0;
+}
+
+SND_CTL_PLUGIN_SYMBOL(dummy);
@@ -0,0 +1,372 @@
+#include <stdint.h>
+#include "pcm_test.h"
+#include <alsa/pcm_ioplug.h>
+#include <alsa/pcm_plugin.h>
+
+/*
+ * IMA ADPCM coding of the adpcm plugin in both directions against the
+ * scalar coder it used before.  The coder state of each channel must run
+ * on over all periods of the stream.  The 8 to 32-bit linear formats are
+ * tried with interleaved, misaligned interleaved and non-interleaved client
+ * buffers, with and without worker threads, and with each $LIBASOUND_SIMD
+ * level.  The output is taken by an ioplug sink.
+ */
+
+#define MAX_CHANNELS	20
+#define FRAMES		1000
+#define BUFFER_SIZE	256
+#define PERIOD_SIZE	64
+
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S8,
+	SND_PCM_FORMAT_U8,
+	SND_PCM_FORMAT_S16_LE,
+	SND_PCM_FORMAT_S16_BE,
+	SND_PCM_FORMAT_U16_LE,
+	SND_PCM_FORMAT_U16_BE,
+	SND_PCM_FORMAT_S24_LE,
+	SND_PCM_FORMAT_S24_BE,
+	SND_PCM_FORMAT_U24_LE,
+	SND_PCM_FORMAT_U24_BE,
+	SND_PCM_FORMAT_S32_LE,
+	SND_PCM_FORMAT_S32_BE,
+	SND_PCM_FORMAT_U32_LE,
+	SND_PCM_FORMAT_U32_BE,
+	SND_PCM_FORMAT_S24_3LE,
+	SND_PCM_FORMAT_S24_3BE,
+	SND_PCM_FORMAT_U24_3LE,
+	SND_PCM_FORMAT_U24_3BE,
+};
+
+/* 20 channels make three lane groups */
+static const unsigned int channels[] = { 1, 2, 3, 8, 20 };
+
+struct state {
+	int pred_val;
+	int step_idx;
+};
+
+static const char IndexAdjust[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+static const short StepSize[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+	19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+	130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+	876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+	5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static void clamp_state(struct state *state)
+{
+	if (state->pred_val > 32767)
+		state->pred_val = 32767;
+	else if (state->pred_val < -32768)
+		state->pred_val = -32768;
+	if (state->step_idx < 0)
+		state->step_idx = 0;
+	else if (state->step_idx > 88)
+		state->step_idx = 88;
+}
+
+/* the 16-bit wrap-arounds are a part of the format as alsa-lib codes it */
+static unsigned char ref_encode(int sl, struct state *state)
+{
+	short diff, pred_diff, step;
+	unsigned char sign, adjust_idx;
+	int i;
+
+	diff = sl - state->pred_val;
+	sign = (diff < 0) ? 0x8 : 0x0;
+	if (sign)
+		diff = -diff;
+	step = StepSize[state->step_idx];
+	pred_diff = step >> 3;
+	for (adjust_idx = 0, i = 0x4; i; i >>= 1, step >>= 1) {
+		if (diff >= step) {
+			adjust_idx |= i;
+			diff -= step;
+			pred_diff += step;
+		}
+	}
+	state->pred_val += sign ? -pred_diff : pred_diff;
+	state->step_idx += IndexAdjust[adjust_idx];
+	clamp_state(state);
+	return sign | adjust_idx;
+}
+
+static int ref_decode(unsigned char code, struct state *state)
+{
+	short pred_diff, step;
+	char sign;
+	int i;
+
+	sign = code & 0x8;
+	code &= 0x7;
+	step = StepSize[state->step_idx];
+	pred_diff = step >> 3;
+	for (i = 0x4; i; i >>= 1, step >>= 1)
+		if (code & i)
+			pred_diff += step;
+	state->pred_val += sign ? -pred_diff : pred_diff;
+	state->step_idx += IndexAdjust[code];
+	clamp_state(state);
+	return state->pred_val;
+}
+
+/* the linear sample as a signed 16-bit value, truncated like get16 */
+static int ref_load16(snd_pcm_format_t format, const unsigned char *p)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int width = snd_pcm_format_width(format);
+	uint32_t word = 0, v;
+	unsigned int b;
+
+	for (b = 0; b < bytes; b++)
+		word = (word << 8) |
+			p[snd_pcm_format_big_endian(format) ? b : bytes - 1 - b];
+	v = word << (32 - width);
+	if (snd_pcm_format_unsigned(format))
+		v ^= 0x80000000;
+	return (int16_t)(v >> 16);
+}
+
+/* a 16-bit value stored like put16, the padding of 24-bit in 32 is the sign */
+static void ref_store16(snd_pcm_format_t format, unsigned char *p, int sample)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int width = snd_pcm_format_width(format);
+	uint32_t v = (uint32_t)sample << 16, word;
+	unsigned int b;
+
+	if (snd_pcm_format_unsigned(format))
+		v ^= 0x80000000;
+	word = v >> (32 - width);
+	if (bytes * 8 > width && (word & (1U << (width - 1))))
+		word |= ~0U << width;
+	for (b = 0; b < bytes; b++)
+		p[snd_pcm_format_big_endian(format) ? bytes - 1 - b : b] = word >> (8 * b);
+}
+
+/* everything played is taken at once and appended to 'captured' */
+static unsigned char *captured;
+static size_t captured_size, captured_samples;
+static snd_pcm_uframes_t consumed;
+
+static int sink_start(snd_pcm_ioplug_t *io ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int sink_stop(snd_pcm_ioplug_t *io ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static snd_pcm_sframes_t sink_pointer(snd_pcm_ioplug_t *io)
+{
+	return consumed % io->buffer_size;
+}
+
+static snd_pcm_sframes_t sink_transfer(snd_pcm_ioplug_t *io,
+				       const snd_pcm_channel_area_t *areas,
+				       snd_pcm_uframes_t offset,
+				       snd_pcm_uframes_t size)
+{
+	unsigned int bits = snd_pcm_format_physical_width(io->format);
+	snd_pcm_uframes_t f;
+	unsigned int c;
+
+	for (f = offset; f < offset + size; f++)
+		for (c = 0; c < io->channels; c++) {
+			unsigned int bit = areas[c].first + f * areas[c].step;
+			const unsigned char *p = (const unsigned char *)areas[c].addr + bit / 8;
+
+			if ((captured_samples + 1) * bits > captured_size * 8)
+				return -EIO;
+			if (bits == 4)
+				test_put_nibble(captured, captured_samples,
+					 test_get_nibble(p, bit % 8 ? 1 : 0));
+			else
+				memcpy(captured + captured_samples * bits / 8, p, bits / 8);
+			captured_samples++;
+		}
+	consumed += size;
+	return size;
+}
+
+static const snd_pcm_ioplug_callback_t sink_callback = {
+	.start = sink_start,
+	.stop = sink_stop,
+	.pointer = sink_pointer,
+	.transfer = sink_transfer,
+};
+
+static snd_pcm_ioplug_t sink;
+static int sink_fd;		/* never waited on, the sink always has room */
+
+/* the adpcm plugin over a sink in 'slave_format' */
+static int open_chain(snd_pcm_t **pcmp, snd_pcm_format_t slave_format)
+{
+	unsigned int format = slave_format;
+	int err;
+
+	memset(&sink, 0, sizeof(sink));
+	sink.version = SND_PCM_IOPLUG_VERSION;
+	sink.name = "adpcm test sink";
+	sink.poll_fd = sink_fd;
+	sink.poll_events = POLLOUT;
+	sink.callback = &sink_callback;
+	err = ALSA_CHECK(snd_pcm_ioplug_create(&sink, "sink",
+					       SND_PCM_STREAM_PLAYBACK, 0));
+	if (err < 0)
+		return err;
+	snd_pcm_ioplug_set_param_list(&sink, SND_PCM_IOPLUG_HW_FORMAT, 1, &format);
+	snd_pcm_ioplug_set_param_minmax(&sink, SND_PCM_IOPLUG_HW_CHANNELS, 1, MAX_CHANNELS);
+	snd_pcm_ioplug_set_param_minmax(&sink, SND_PCM_IOPLUG_HW_RATE, 48000, 48000);
+	err = ALSA_CHECK(snd_pcm_adpcm_open(pcmp, "adpcm", slave_format, sink.pcm, 1));
+	if (err < 0)
+		snd_pcm_ioplug_delete(&sink);
+	return err;
+}
+
+/* play the interleaved 'src' in the given layout, return the output size */
+static long play(snd_pcm_format_t format, snd_pcm_format_t slave_format,
+		 unsigned int channels, int layout, const unsigned char *src,
+		 unsigned char *out, size_t out_size)
+{
+	unsigned int bits = snd_pcm_format_physical_width(format);
+	unsigned int chunk;
+	snd_pcm_t *pcm;
+
+	/* odd lengths, as long as the chunks start on a byte */
+	chunk = (channels * bits) % 8 || (bits == 4 && layout == NONINTERLEAVED) ?
+		98 : 97;
+	captured = out;
+	captured_size = out_size;
+	captured_samples = 0;
+	consumed = 0;
+	if (open_chain(&pcm, slave_format) < 0)
+		return -1;
+	if (test_pcm_setup(pcm, test_access(layout), format, channels, 48000,
+			   PERIOD_SIZE, BUFFER_SIZE) < 0) {
+		snd_pcm_close(pcm);
+		return -1;
+	}
+	test_pcm_write(pcm, format, channels, layout, src, FRAMES, chunk, NULL);
+	snd_pcm_close(pcm);
+
+	return (captured_samples * snd_pcm_format_physical_width(slave_format) + 7) / 8;
+}
+
+static void test_encode(snd_pcm_format_t format, unsigned int channels, int layout)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	size_t samples = (size_t)FRAMES * channels;
+	size_t out_size = samples / 2;
+	unsigned char *src = malloc(samples * bytes);
+	unsigned char *ref = calloc(1, out_size);
+	unsigned char *out = malloc(out_size + 1);
+	struct state states[MAX_CHANNELS];
+	unsigned int f, c;
+	size_t i;
+	long size;
+
+	/* noise to the clamps of the coder and ramps to let it settle */
+	for (i = 0; i < samples * bytes; i++)
+		src[i] = rand();
+	for (f = FRAMES / 2; f < FRAMES; f++)
+		for (c = 0; c < channels; c++)
+			ref_store16(format, src + ((size_t)f * channels + c) * bytes,
+				    (int16_t)(f * 97 * (c + 1)));
+	memset(states, 0, sizeof(states));
+	for (f = 0; f < FRAMES; f++)
+		for (c = 0; c < channels; c++) {
+			i = (size_t)f * channels + c;
+			test_put_nibble(ref, i, ref_encode(ref_load16(format, src + i * bytes),
+						    &states[c]));
+		}
+	size = play(format, SND_PCM_FORMAT_IMA_ADPCM, channels, layout, src,
+		    out, out_size + 1);
+	if (size != (long)out_size || memcmp(out, ref, out_size)) {
+		fprintf(stderr, "%s -> IMA_ADPCM, %u channels, layout %d: wrong output\n",
+			snd_pcm_format_name(format), channels, layout);
+		any_test_failed = 1;
+	}
+	free(out);
+	free(ref);
+	free(src);
+}
+
+static void test_decode(snd_pcm_format_t format, unsigned int channels, int layout)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	size_t samples = (size_t)FRAMES * channels;
+	size_t out_size = samples * bytes;
+	unsigned char *src = malloc(samples / 2);
+	unsigned char *ref = malloc(out_size);
+	unsigned char *out = malloc(out_size + 1);
+	struct state states[MAX_CHANNELS];
+	unsigned int f, c;
+	size_t i;
+	long size;
+
+	/* random codes, and runs of the largest steps to hit the clamps */
+	for (i = 0; i < samples / 2; i++)
+		src[i] = rand();
+	for (i = samples / 4; i < samples / 3; i++)
+		test_put_nibble(src, i, i < samples * 7 / 24 ? 0x7 : 0xf);
+	memset(states, 0, sizeof(states));
+	for (f = 0; f < FRAMES; f++)
+		for (c = 0; c < channels; c++) {
+			i = (size_t)f * channels + c;
+			ref_store16(format, ref + i * bytes,
+				    ref_decode(test_get_nibble(src, i), &states[c]));
+		}
+	size = play(SND_PCM_FORMAT_IMA_ADPCM, format, channels, layout, src,
+		    out, out_size + 1);
+	if (size != (long)out_size || memcmp(out, ref, out_size)) {
+		fprintf(stderr, "IMA_ADPCM -> %s, %u channels, layout %d: wrong output\n",
+			snd_pcm_format_name(format), channels, layout);
+		any_test_failed = 1;
+	}
+	free(out);
+	free(ref);
+	free(src);
+}
+
+static void test_all(void)
+{
+	static const char *const threads[] = { NULL, "3" };
+	unsigned int i, j, t;
+	int layout;
+
+	for (t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+		if (threads[t])
+			setenv("LIBASOUND_ADPCM_THREADS", threads[t], 1);
+		else
+			unsetenv("LIBASOUND_ADPCM_THREADS");
+		for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+			for (j = 0; j < sizeof(channels) / sizeof(channels[0]); j++)
+				for (layout = 0; layout < LAYOUTS; layout++) {
+					test_encode(formats[i], channels[j], layout);
+					test_decode(formats[i], channels[j], layout);
+				}
+	}
+}
+
+int main(void)
+{
+	int fds[2];
+
+	if (pipe(fds) < 0)
+		return 1;
+	sink_fd = fds[1];
+	test_simd_levels(test_all);
+	close(fds[0]);
+	close(fds[1]);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "test.h"
+
+#define MAX_CHANNELS	40
+#define MAX_FRAMES	1031
+
+static unsigned char *interleaved;
+static unsigned char *planar[MAX_CHANNELS];
+
+static void fill_random(unsigned char *buf, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = rand();
+}
+
+static void setup_areas(snd_pcm_channel_area_t *inter, snd_pcm_channel_area_t *plan,
+			unsigned int channels, unsigned int stride_channels,
+			unsigned int width)
+{
+	unsigned int c;
+
+	for (c = 0; c < channels; c++) {
+		inter[c].addr = interleaved;
+		inter[c].first = c * width;
+		inter[c].step = stride_channels * width;
+		plan[c].addr = planar[c];
+		plan[c].first = 0;
+		plan[c].step = width;
+	}
+}
+
+/* compare a copy between both layouts with a sample by sample reference */
+static void test_transpose(snd_pcm_format_t format, unsigned int channels,
+			   unsigned int stride_channels, unsigned int frames,
+			   unsigned int offset)
+{
+	snd_pcm_channel_area_t inter[MAX_CHANNELS], plan[MAX_CHANNELS];
+	unsigned int width = snd_pcm_format_physical_width(format);
+	unsigned int bytes = width / 8;
+	unsigned int frame_bytes = stride_channels * bytes;
+	size_t size = (size_t)(frames + offset) * frame_bytes;
+	unsigned char *ref = malloc(size);
+	unsigned int c, f;
+	int ok;
+
+	setup_areas(inter, plan, channels, stride_channels, width);
+
+	/* interleaved -> planar */
+	fill_random(interleaved, size);
+	for (c = 0; c < channels; c++)
+		fill_random(planar[c], (size_t)(frames + offset) * bytes);
+	ALSA_CHECK(snd_pcm_areas_copy(plan, offset, inter, offset,
+				      channels, frames, format));
+	ok = 1;
+	for (c = 0; c < channels; c++)
+		for (f = offset; f < offset + frames; f++)
+			if (memcmp(planar[c] + f * bytes,
+				   interleaved + f * frame_bytes + c * bytes, bytes))
+				ok = 0;
+	TEST_CHECK(ok);
+
+	/* planar -> interleaved, untouched channels must survive */
+	fill_random(interleaved, size);
+	memcpy(ref, interleaved, size);
+	for (c = 0; c < channels; c++)
+		fill_random(planar[c], (size_t)(frames + offset) * bytes);
+	ALSA_CHECK(snd_pcm_areas_copy(inter, offset, plan, offset,
+				      channels, frames, format));
+	for (c = 0; c < channels; c++)
+		for (f = offset; f < offset + frames; f++)
+			memcpy(ref + f * frame_bytes + c * bytes,
+			       planar[c] + f * bytes, bytes);
+	TEST_CHECK(memcmp(ref, interleaved, size) == 0);
+
+	free(ref);
+}
+
+/* fill a buffer at odd offsets and compare with the format silence */
+static void test_silence(snd_pcm_format_t format, unsigned int samples,
+			 unsigned int misalign)
+{
+	unsigned int width = snd_pcm_format_physical_width(format);
+	unsigned int bytes = width / 8;
+	size_t size = (size_t)samples * bytes;
+	unsigned char *buf = malloc(size + misalign + 16);
+	unsigned char *data = buf + misalign;
+	unsigned char sample[8];
+	snd_pcm_channel_area_t area;
+	unsigned int i;
+	int ok = 1;
+
+	/* a one sample reference written by the generic path */
+	area.addr = sample;
+	area.first = 0;
+	area.step = width * 2;
+	ALSA_CHECK(snd_pcm_area_silence(&area, 0, 1, format));
+
+	memset(buf, 0xa5, size + misalign + 16);
+	ALSA_CHECK(snd_pcm_format_set_silence(format, data, samples));
+	for (i = 0; i < samples; i++)
+		if (memcmp(data + i * bytes, sample, bytes))
+			ok = 0;
+	for (i = 0; i < 16; i++)
+		if (data[size + i] != 0xa5)
+			ok = 0;
+	TEST_CHECK(ok);
+
+	memset(buf, 0xa5, size + misalign + 16);
+	area.addr = data;
+	area.step = width;
+	ALSA_CHECK(snd_pcm_area_silence(&area, 0, samples, format));
+	TEST_CHECK(memcmp(data, data + bytes, size - bytes) == 0);
+	TEST_CHECK(memcmp(data, sample, bytes) == 0);
+	TEST_CHECK(data[size] == 0xa5);
+
+	free(buf);
+}
+
+int main(void)
+{
+	static const snd_pcm_format_t silence_formats[] = {
+		SND_PCM_FORMAT_U8,
+		SND_PCM_FORMAT_S16_LE,
+		SND_PCM_FORMAT_U16_LE,
+		SND_PCM_FORMAT_U16_BE,
+		SND_PCM_FORMAT_U24_3LE,
+		SND_PCM_FORMAT_U24_3BE,
+		SND_PCM_FORMAT_U32_BE,
+		SND_PCM_FORMAT_FLOAT_LE,
+		SND_PCM_FORMAT_FLOAT64_BE,
+	};
+	static const unsigned int silence_sizes[] = { 1, 7, 33, 1000, 200000 };
+	static const snd_pcm_format_t formats[] = {
+		SND_PCM_FORMAT_U8,
+		SND_PCM_FORMAT_S16_LE,
+		SND_PCM_FORMAT_S24_3LE,
+		SND_PCM_FORMAT_S32_LE,
+		SND_PCM_FORMAT_FLOAT64_LE,
+	};
+	static const unsigned int channels[] = { 2, 3, 4, 6, 8, 13, 32, 40 };
+	unsigned int i, j, c;
+
+	interleaved = malloc((size_t)(MAX_FRAMES + 7) * MAX_CHANNELS * 8);
+	for (c = 0; c < MAX_CHANNELS; c++)
+		planar[c] = malloc((MAX_FRAMES + 7) * 8);
+
+	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		for (j = 0; j < sizeof(channels) / sizeof(channels[0]); j++) {
+			test_transpose(formats[i], channels[j], channels[j], MAX_FRAMES, 0);
+			test_transpose(formats[i], channels[j], channels[j], 5, 3);
+			/* subset of a wider interleaved buffer */
+			if (channels[j] < MAX_CHANNELS)
+				test_transpose(formats[i], channels[j], MAX_CHANNELS,
+					       MAX_FRAMES, 7);
+		}
+	}
+
+	for (i = 0; i < sizeof(silence_formats) / sizeof(silence_formats[0]); i++)
+		for (j = 0; j < sizeof(silence_sizes) / sizeof(silence_sizes[0]); j++)
+			for (c = 0; c < 4; c++)
+				test_silence(silence_formats[i], silence_sizes[j], c * 5);
+
+	for (c = 0; c < MAX_CHANNELS; c++)
+		free(planar[c]);
+	free(interleaved);
+	return TEST_EXIT_CODE();
+}
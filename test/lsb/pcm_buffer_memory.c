@@ -0,0 +1,148 @@
+#include <stdint.h>
+#include "pcm_test.h"
+
+/*
+ * snd_pcm_buffer_memory() of plugin chains over the null PCM: the buffers
+ * are counted after hw_params, are not counted twice after a second
+ * hw_params, and the counters of the handle and of the process return to
+ * zero after hw_free and after close.  The mmap ring buffers of the plugins
+ * are 64-byte aligned; the rate plugin checks its own period planes.  The
+ * chains are run with the plain allocation and with transparent huge
+ * pages.
+ */
+
+static const struct {
+	const char *def;
+	snd_pcm_access_t access;
+	snd_pcm_format_t format;
+	int large;		/* takes the buffer size of the huge page run */
+} chains[] = {
+	{ "{ type null }", SND_PCM_ACCESS_MMAP_INTERLEAVED, SND_PCM_FORMAT_S16_LE, 1 },
+	{ "{ type linear slave { pcm { type null } format S32_LE } }",
+	  SND_PCM_ACCESS_RW_INTERLEAVED, SND_PCM_FORMAT_S16_LE, 1 },
+	{ "{ type linear slave { pcm { type null } format S32_LE } }",
+	  SND_PCM_ACCESS_MMAP_INTERLEAVED, SND_PCM_FORMAT_S16_LE, 1 },
+	{ "{ type lfloat slave { pcm { type null } format FLOAT_LE } }",
+	  SND_PCM_ACCESS_RW_NONINTERLEAVED, SND_PCM_FORMAT_S16_LE, 1 },
+	{ "{ type lfloat slave { pcm { type null } format FLOAT_LE } }",
+	  SND_PCM_ACCESS_MMAP_NONINTERLEAVED, SND_PCM_FORMAT_S16_LE, 1 },
+	{ "{ type mulaw slave { pcm { type null } format MU_LAW } }",
+	  SND_PCM_ACCESS_RW_INTERLEAVED, SND_PCM_FORMAT_S16_LE, 1 },
+	{ "{ type adpcm slave { pcm { type null } format IMA_ADPCM } }",
+	  SND_PCM_ACCESS_RW_INTERLEAVED, SND_PCM_FORMAT_S16_LE, 1 },
+	{ "{ type route slave { pcm { type null } channels 2 } ttable.0.1 1 ttable.1.0 1 }",
+	  SND_PCM_ACCESS_RW_INTERLEAVED, SND_PCM_FORMAT_S16_LE, 1 },
+	/* the rate plugin limits the buffer size */
+	{ "{ type rate slave { pcm { type null } rate 48000 } }",
+	  SND_PCM_ACCESS_RW_INTERLEAVED, SND_PCM_FORMAT_S16_LE, 0 },
+	/* one plane per channel */
+	{ "{ type rate slave { pcm { type null } rate 48000 } }",
+	  SND_PCM_ACCESS_RW_NONINTERLEAVED, SND_PCM_FORMAT_S16_LE, 0 },
+	{ "{ type plug slave { pcm { type null } format FLOAT_LE rate 48000 channels 6 } }",
+	  SND_PCM_ACCESS_MMAP_INTERLEAVED, SND_PCM_FORMAT_S16_LE, 0 },
+};
+
+static int setup(snd_pcm_t *pcm, snd_pcm_access_t access,
+		 snd_pcm_format_t format, snd_pcm_uframes_t buffer_size)
+{
+	return test_pcm_setup(pcm, access, format, 2, 44100, buffer_size / 4,
+			      buffer_size);
+}
+
+/* the areas of the ring buffer, each channel from an aligned address */
+static void check_areas(unsigned int i, snd_pcm_t *pcm)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, frames = 1;
+	unsigned int c;
+
+	/* a plugin written by read/write has no ring buffer of its own */
+	if (chains[i].access != SND_PCM_ACCESS_MMAP_INTERLEAVED &&
+	    chains[i].access != SND_PCM_ACCESS_MMAP_NONINTERLEAVED)
+		return;
+	if (ALSA_CHECK(snd_pcm_mmap_begin(pcm, &areas, &offset, &frames)) < 0)
+		return;
+	for (c = 0; c < 2; c++) {
+		if ((uintptr_t)areas[c].addr & 63)
+			fprintf(stderr, "chain %u: channel %u at %p\n", i, c,
+				areas[c].addr);
+		TEST_CHECK(((uintptr_t)areas[c].addr & 63) == 0);
+	}
+}
+
+static void test_chain(unsigned int i, snd_pcm_uframes_t buffer_size)
+{
+	snd_pcm_t *pcm;
+	size_t first, total;
+
+	TEST_CHECK(snd_pcm_buffer_memory(NULL) == 0);
+	if (test_pcm_open(&pcm, "pcm.test %s", chains[i].def) < 0)
+		return;
+	if (setup(pcm, chains[i].access, chains[i].format, buffer_size) < 0) {
+		snd_pcm_close(pcm);
+		return;
+	}
+	first = snd_pcm_buffer_memory(NULL);
+	/* the emulated mmap and the conversions need buffers */
+	if (i > 0 && first == 0)
+		fprintf(stderr, "chain %u: no buffer memory counted\n", i);
+	TEST_CHECK(i == 0 || first > 0);
+	TEST_CHECK(snd_pcm_buffer_memory(pcm) <= first);
+	check_areas(i, pcm);
+
+	/* hw_params again, the old buffers are released first */
+	TEST_CHECK(setup(pcm, chains[i].access, chains[i].format, buffer_size) >= 0);
+	TEST_CHECK(snd_pcm_buffer_memory(NULL) == first);
+
+	ALSA_CHECK(snd_pcm_hw_free(pcm));
+	total = snd_pcm_buffer_memory(NULL);
+	if (total)
+		fprintf(stderr, "chain %u: %zu bytes left after hw_free\n", i, total);
+	TEST_CHECK(snd_pcm_buffer_memory(pcm) == 0);
+	TEST_CHECK(total == 0);
+
+	/* and closed while set up */
+	TEST_CHECK(setup(pcm, chains[i].access, chains[i].format, buffer_size) >= 0);
+	TEST_CHECK(snd_pcm_buffer_memory(NULL) == first);
+	snd_pcm_close(pcm);
+	total = snd_pcm_buffer_memory(NULL);
+	if (total)
+		fprintf(stderr, "chain %u: %zu bytes left after close\n", i, total);
+	TEST_CHECK(total == 0);
+}
+
+/* run all chains in a child, as the huge page mode is read only once */
+static int run(const char *hugepages, snd_pcm_uframes_t buffer_size, int large)
+{
+	unsigned int i;
+	int status;
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		return 1;
+	if (pid == 0) {
+		setenv("LIBASOUND_HUGEPAGES", hugepages, 1);
+		for (i = 0; i < sizeof(chains) / sizeof(chains[0]); i++)
+			if (chains[i].large || !large)
+				test_chain(i, buffer_size);
+		exit(TEST_EXIT_CODE());
+	}
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status)) {
+		fprintf(stderr, "LIBASOUND_HUGEPAGES=%s failed\n", hugepages);
+		return 1;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	/* periods of 1000 frames, the planes of the rate plugin are padded */
+	if (run("0", 4000, 0))
+		any_test_failed = 1;
+	/* large enough for huge pages */
+	if (run("1", 1 << 20, 1))
+		any_test_failed = 1;
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,321 @@
+#include <stdint.h>
+#include "pcm_test.h"
+
+/*
+ * snd_pcm_areas_{mulaw,alaw}_{decode,encode}() between the companded
+ * formats and the 8 to 32-bit linear formats against the scalar G.711
+ * code the plugins used before, for packed, misaligned, strided and
+ * planar areas, and with each $LIBASOUND_SIMD level.
+ */
+
+#define MAX_CHANNELS	8
+#define MAX_FRAMES	1001
+
+/* the layouts of the areas */
+enum { PACKED, ODD_ADDRESS, STRIDED, PLANAR, AREA_LAYOUTS };
+
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S8,
+	SND_PCM_FORMAT_U8,
+	SND_PCM_FORMAT_S16_LE,
+	SND_PCM_FORMAT_S16_BE,
+	SND_PCM_FORMAT_U16_LE,
+	SND_PCM_FORMAT_U16_BE,
+	SND_PCM_FORMAT_S24_LE,
+	SND_PCM_FORMAT_S24_BE,
+	SND_PCM_FORMAT_U24_LE,
+	SND_PCM_FORMAT_U24_BE,
+	SND_PCM_FORMAT_S32_LE,
+	SND_PCM_FORMAT_S32_BE,
+	SND_PCM_FORMAT_U32_LE,
+	SND_PCM_FORMAT_U32_BE,
+	SND_PCM_FORMAT_S24_3LE,
+	SND_PCM_FORMAT_S24_3BE,
+	SND_PCM_FORMAT_U24_3LE,
+	SND_PCM_FORMAT_U24_3BE,
+};
+
+static const unsigned int channels[] = { 1, 2, 3, 8 };
+
+static const struct {
+	unsigned int frames, offset;
+} sizes[] = {
+	{ 1, 0 },
+	{ 7, 3 },
+	{ 33, 1 },
+	{ MAX_FRAMES, 0 },
+	{ MAX_FRAMES - 2, 5 },
+};
+
+typedef int (*convert_t)(const snd_pcm_channel_area_t *dst_areas,
+			 snd_pcm_uframes_t dst_offset,
+			 const snd_pcm_channel_area_t *src_areas,
+			 snd_pcm_uframes_t src_offset,
+			 unsigned int channels, snd_pcm_uframes_t frames,
+			 snd_pcm_format_t format);
+
+static unsigned char *src_buf, *dst_buf, *ref_buf, *pattern;
+static size_t buf_size;
+
+static int val_seg_ulaw(int val)
+{
+	int r = 0;
+	val >>= 7;
+	if (val & 0xf0) {
+		val >>= 4;
+		r += 4;
+	}
+	if (val & 0x0c) {
+		val >>= 2;
+		r += 2;
+	}
+	if (val & 0x02)
+		r += 1;
+	return r;
+}
+
+static unsigned char s16_to_ulaw(int pcm_val)
+{
+	int mask, seg;
+
+	if (pcm_val < 0) {
+		pcm_val = 0x84 - pcm_val;
+		mask = 0x7f;
+	} else {
+		pcm_val += 0x84;
+		mask = 0xff;
+	}
+	if (pcm_val > 0x7fff)
+		pcm_val = 0x7fff;
+	seg = val_seg_ulaw(pcm_val);
+	return ((seg << 4) | ((pcm_val >> (seg + 3)) & 0x0f)) ^ mask;
+}
+
+static int ulaw_to_s16(unsigned char u_val)
+{
+	int t;
+
+	u_val = ~u_val;
+	t = ((u_val & 0x0f) << 3) + 0x84;
+	t <<= (u_val & 0x70) >> 4;
+	return (u_val & 0x80) ? (0x84 - t) : (t - 0x84);
+}
+
+static int val_seg_alaw(int val)
+{
+	int r = 1;
+	val >>= 8;
+	if (val & 0xf0) {
+		val >>= 4;
+		r += 4;
+	}
+	if (val & 0x0c) {
+		val >>= 2;
+		r += 2;
+	}
+	if (val & 0x02)
+		r += 1;
+	return r;
+}
+
+static unsigned char s16_to_alaw(int pcm_val)
+{
+	int mask, seg;
+
+	if (pcm_val >= 0) {
+		mask = 0xD5;
+	} else {
+		mask = 0x55;
+		pcm_val = -pcm_val;
+		if (pcm_val > 0x7fff)
+			pcm_val = 0x7fff;
+	}
+	if (pcm_val < 256)
+		return (pcm_val >> 4) ^ mask;
+	seg = val_seg_alaw(pcm_val);
+	return ((seg << 4) | ((pcm_val >> (seg + 3)) & 0x0f)) ^ mask;
+}
+
+static int alaw_to_s16(unsigned char a_val)
+{
+	int t, seg;
+
+	a_val ^= 0x55;
+	t = a_val & 0x7f;
+	if (t < 16) {
+		t = (t << 4) + 8;
+	} else {
+		seg = (t >> 4) & 0x07;
+		t = ((t & 0x0f) << 4) + 0x108;
+		t <<= seg - 1;
+	}
+	return (a_val & 0x80) ? t : -t;
+}
+
+/* the linear sample as a signed 16-bit value, truncated like get16 */
+static int ref_load16(snd_pcm_format_t format, const unsigned char *p)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int width = snd_pcm_format_width(format);
+	uint32_t word = 0, v;
+	unsigned int b;
+
+	for (b = 0; b < bytes; b++)
+		word = (word << 8) |
+			p[snd_pcm_format_big_endian(format) ? b : bytes - 1 - b];
+	v = word << (32 - width);
+	if (snd_pcm_format_unsigned(format))
+		v ^= 0x80000000;
+	return (int16_t)(v >> 16);
+}
+
+/* a 16-bit value stored like put16, the padding of 24-bit in 32 is the sign */
+static void ref_store16(snd_pcm_format_t format, unsigned char *p, int sample)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int width = snd_pcm_format_width(format);
+	uint32_t v = (uint32_t)sample << 16, word;
+	unsigned int b;
+
+	if (snd_pcm_format_unsigned(format))
+		v ^= 0x80000000;
+	word = v >> (32 - width);
+	if (bytes * 8 > width && (word & (1U << (width - 1))))
+		word |= ~0U << width;
+	for (b = 0; b < bytes; b++)
+		p[snd_pcm_format_big_endian(format) ? bytes - 1 - b : b] = word >> (8 * b);
+}
+
+static void setup_areas(snd_pcm_channel_area_t *areas, unsigned char *buf,
+			int layout, unsigned int channels, unsigned int width,
+			unsigned int frames)
+{
+	unsigned int c;
+
+	for (c = 0; c < channels; c++) {
+		switch (layout) {
+		case PACKED:
+			areas[c].addr = buf;
+			areas[c].first = c * width;
+			areas[c].step = channels * width;
+			break;
+		case ODD_ADDRESS:
+			areas[c].addr = buf + 1;
+			areas[c].first = c * width;
+			areas[c].step = channels * width;
+			break;
+		case STRIDED:	/* a subset of a wider interleaved buffer */
+			areas[c].addr = buf;
+			areas[c].first = (c + 1) * width;
+			areas[c].step = (channels + 2) * width;
+			break;
+		default:	/* each channel at another misalignment */
+			areas[c].addr = buf + c * (frames * width / 8 + 1);
+			areas[c].first = 0;
+			areas[c].step = width;
+			break;
+		}
+	}
+}
+
+static unsigned char *sample_addr(const snd_pcm_channel_area_t *area,
+				  unsigned int frame)
+{
+	return (unsigned char *)area->addr + (area->first + frame * area->step) / 8;
+}
+
+static void test_convert(const char *name, convert_t convert, int encode,
+			 int (*decode_ref)(unsigned char),
+			 unsigned char (*encode_ref)(int),
+			 snd_pcm_format_t format, unsigned int channels,
+			 int src_layout, int dst_layout,
+			 unsigned int frames, unsigned int offset)
+{
+	snd_pcm_channel_area_t src[MAX_CHANNELS], dst[MAX_CHANNELS];
+	unsigned int width = snd_pcm_format_physical_width(format);
+	unsigned int c, f;
+
+	setup_areas(src, src_buf, src_layout, channels, encode ? width : 8,
+		    frames + offset);
+	setup_areas(dst, dst_buf, dst_layout, channels, encode ? 8 : width,
+		    frames + offset);
+	/* the samples around the converted ones must survive */
+	memcpy(dst_buf, pattern, buf_size);
+	memcpy(ref_buf, pattern, buf_size);
+	for (c = 0; c < channels; c++)
+		for (f = offset; f < offset + frames; f++) {
+			const unsigned char *s = sample_addr(&src[c], f);
+			unsigned char *d = ref_buf + (sample_addr(&dst[c], f) - dst_buf);
+			if (encode)
+				*d = encode_ref(ref_load16(format, s));
+			else
+				ref_store16(format, d, decode_ref(*s));
+		}
+
+	TEST_CHECK(convert(dst, offset, src, offset, channels, frames, format) == 0);
+	if (memcmp(dst_buf, ref_buf, buf_size)) {
+		fprintf(stderr, "%s %s, %u channels, %u frames, layouts %d/%d: wrong output\n",
+			name, snd_pcm_format_name(format), channels, frames,
+			src_layout, dst_layout);
+		any_test_failed = 1;
+	}
+}
+
+static void test_all(void)
+{
+	static const struct {
+		const char *name;
+		convert_t convert;
+		int encode;
+	} funcs[] = {
+		{ "mulaw decode", snd_pcm_areas_mulaw_decode, 0 },
+		{ "mulaw encode", snd_pcm_areas_mulaw_encode, 1 },
+		{ "alaw decode", snd_pcm_areas_alaw_decode, 0 },
+		{ "alaw encode", snd_pcm_areas_alaw_encode, 1 },
+	};
+	snd_pcm_channel_area_t area = { NULL, 0, 16 };
+	unsigned int i, j, k, l;
+	int s, d;
+
+	for (l = 0; l < sizeof(funcs) / sizeof(funcs[0]); l++) {
+		int mulaw = l < 2;
+		for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+			for (j = 0; j < sizeof(channels) / sizeof(channels[0]); j++)
+				for (k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++)
+					for (s = 0; s < AREA_LAYOUTS; s++)
+						for (d = 0; d < AREA_LAYOUTS; d++)
+							test_convert(funcs[l].name, funcs[l].convert,
+								     funcs[l].encode,
+								     mulaw ? ulaw_to_s16 : alaw_to_s16,
+								     mulaw ? s16_to_ulaw : s16_to_alaw,
+								     formats[i], channels[j], s, d,
+								     sizes[k].frames, sizes[k].offset);
+		/* not covered */
+		area.addr = src_buf;
+		TEST_CHECK(funcs[l].convert(&area, 0, &area, 0, 1, 1,
+					    SND_PCM_FORMAT_S20_LE) == -EINVAL);
+	}
+}
+
+int main(void)
+{
+	unsigned int i;
+
+	/* room for the widest stride and for the planar gaps */
+	buf_size = (size_t)(MAX_FRAMES + 8) * (MAX_CHANNELS + 2) * 4 + MAX_CHANNELS;
+	src_buf = malloc(buf_size);
+	dst_buf = malloc(buf_size);
+	ref_buf = malloc(buf_size);
+	pattern = malloc(buf_size);
+	/* random data reaches all codes and the extremes of every format */
+	for (i = 0; i < buf_size; i++) {
+		src_buf[i] = rand();
+		pattern[i] = rand();
+	}
+	test_simd_levels(test_all);
+	free(pattern);
+	free(ref_buf);
+	free(dst_buf);
+	free(src_buf);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include "test.h"
+
+/*
+ * Drain a hw playback stream in the timer-scheduled mode, where period
+ * interrupts are disabled if the driver allows it.  The drain must return
+ * when the queued data has been played, not at the kernel drain timeout.
+ * Needs the first card; skipped without one.
+ */
+
+#define RATE		48000
+#define QUEUED_MS	100
+
+static void drain_timeout(int sig)
+{
+	(void)sig;
+	fprintf(stderr, "drain did not return\n");
+	_exit(1);
+}
+
+static long elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000 +
+		(now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+static int test_drain(int start_first)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_hw_params_t *params;
+	snd_pcm_sw_params_t *swparams;
+	snd_pcm_uframes_t buffer_size = RATE / 2, period_size = RATE / 20;
+	unsigned int rate = RATE;
+	snd_pcm_uframes_t frames;
+	struct timespec start;
+	short *buf;
+	long ms;
+	int err;
+
+	err = snd_pcm_open(&pcm, "hw:0,0", SND_PCM_STREAM_PLAYBACK, 0);
+	if (err < 0)
+		return 77;
+	snd_pcm_hw_params_alloca(&params);
+	snd_pcm_sw_params_alloca(&swparams);
+	if (snd_pcm_hw_params_any(pcm, params) < 0 ||
+	    snd_pcm_hw_params_set_access(pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED) < 0 ||
+	    snd_pcm_hw_params_set_format(pcm, params, SND_PCM_FORMAT_S16) < 0 ||
+	    snd_pcm_hw_params_set_channels(pcm, params, 2) < 0 ||
+	    snd_pcm_hw_params_set_rate_near(pcm, params, &rate, NULL) < 0 ||
+	    snd_pcm_hw_params_set_buffer_size_near(pcm, params, &buffer_size) < 0 ||
+	    snd_pcm_hw_params_set_period_size_near(pcm, params, &period_size, NULL) < 0 ||
+	    snd_pcm_hw_params(pcm, params) < 0) {
+		snd_pcm_close(pcm);
+		return 77;
+	}
+	ALSA_CHECK(snd_pcm_sw_params_current(pcm, swparams));
+	/* start explicitly, or let the drain start the stream */
+	ALSA_CHECK(snd_pcm_sw_params_set_start_threshold(pcm, swparams,
+							 start_first ? 1 : buffer_size));
+	ALSA_CHECK(snd_pcm_sw_params(pcm, swparams));
+
+	frames = (snd_pcm_uframes_t)rate * QUEUED_MS / 1000;
+	if (frames > buffer_size)
+		frames = buffer_size;
+	buf = calloc(frames, 2 * sizeof(*buf));
+	TEST_CHECK(snd_pcm_writei(pcm, buf, frames) == (snd_pcm_sframes_t)frames);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	alarm(5);
+	ALSA_CHECK(snd_pcm_drain(pcm));
+	alarm(0);
+	ms = elapsed_ms(&start);
+	TEST_CHECK(snd_pcm_state(pcm) == SND_PCM_STATE_SETUP);
+	/* the queued data is played, and not much more waited for */
+	TEST_CHECK(ms >= (long)(frames * 1000 / rate) / 2);
+	TEST_CHECK(ms < (long)(frames * 1000 / rate) + 500);
+
+	free(buf);
+	snd_pcm_close(pcm);
+	return 0;
+}
+
+int main(void)
+{
+	setenv("LIBASOUND_TIMER_SCHED", "1", 1);
+	signal(SIGALRM, drain_timeout);
+	if (test_drain(1) == 77)
+		return 77;
+	test_drain(0);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "test.h"
+#include <alsa/pcm_plugin.h>
+
+/*
+ * Rate-limited SYNC_PTR ioctls of the hw plugin, with the mmap of the
+ * status and control forced off by sync_ptr_ioctl.  While the stream
+ * plays, snd_pcm_avail_update() either issues the ioctl or keeps the last
+ * position: never for longer than sync_ptr_max_error frames, nor past the
+ * next period boundary, and each kept one counts as avoided.  Without a
+ * limit, every query is an ioctl.  Needs the first card; skipped without
+ * one.
+ */
+
+#define RATE		48000
+#define PERIOD_SIZE	512
+#define PERIODS		8
+#define SLACK		(RATE / 1000)	/* scheduling between the calls */
+
+static snd_pcm_uframes_t rate, period_size, buffer_size;
+
+static long long elapsed_frames(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((now.tv_sec - start->tv_sec) * 1000000000LL +
+		now.tv_nsec - start->tv_nsec) * (long long)rate / 1000000000LL;
+}
+
+static int open_hw(snd_pcm_t **pcmp, unsigned int max_error)
+{
+	char text[256];
+	snd_config_t *conf;
+	snd_input_t *in;
+	snd_pcm_hw_params_t *params;
+	snd_pcm_sw_params_t *swparams;
+	unsigned int r = RATE;
+	int err;
+
+	snprintf(text, sizeof(text),
+		 "pcm.test { type hw card 0 device 0 sync_ptr_ioctl 1"
+		 " sync_ptr_max_error %u }", max_error);
+	if (ALSA_CHECK(snd_config_top(&conf)) < 0)
+		return -1;
+	ALSA_CHECK(snd_input_buffer_open(&in, text, strlen(text)));
+	ALSA_CHECK(snd_config_load(conf, in));
+	snd_input_close(in);
+	err = snd_pcm_open_lconf(pcmp, "test", SND_PCM_STREAM_PLAYBACK, 0, conf);
+	snd_config_delete(conf);
+	if (err < 0)
+		return 77;
+	period_size = PERIOD_SIZE;
+	buffer_size = PERIOD_SIZE * PERIODS;
+	snd_pcm_hw_params_alloca(&params);
+	snd_pcm_sw_params_alloca(&swparams);
+	if (snd_pcm_hw_params_any(*pcmp, params) < 0 ||
+	    snd_pcm_hw_params_set_access(*pcmp, params, SND_PCM_ACCESS_RW_INTERLEAVED) < 0 ||
+	    snd_pcm_hw_params_set_format(*pcmp, params, SND_PCM_FORMAT_S16) < 0 ||
+	    snd_pcm_hw_params_set_channels(*pcmp, params, 2) < 0 ||
+	    snd_pcm_hw_params_set_rate_near(*pcmp, params, &r, NULL) < 0 ||
+	    snd_pcm_hw_params_set_period_size_near(*pcmp, params, &period_size, NULL) < 0 ||
+	    snd_pcm_hw_params_set_buffer_size_near(*pcmp, params, &buffer_size) < 0 ||
+	    snd_pcm_hw_params(*pcmp, params) < 0) {
+		snd_pcm_close(*pcmp);
+		return 77;
+	}
+	rate = r;
+	/* started by the test */
+	ALSA_CHECK(snd_pcm_sw_params_current(*pcmp, swparams));
+	ALSA_CHECK(snd_pcm_sw_params_set_start_threshold(*pcmp, swparams, buffer_size * 2));
+	ALSA_CHECK(snd_pcm_sw_params(*pcmp, swparams));
+	return 0;
+}
+
+/*
+ * Play a full buffer and query the position for half of it.  A query
+ * which issues no ioctl must keep the position of the last one, within
+ * the limits; its hw_ptr is the avail, as the whole buffer was written.
+ */
+static void play(snd_pcm_t *pcm, unsigned int max_error, unsigned long *issuedp,
+		 unsigned long *avoidedp, unsigned long *keptp)
+{
+	unsigned long issued0, avoided0, issued, avoided, before, kept = 0, bad = 0;
+	snd_pcm_sframes_t avail, synced = 0;
+	long long late;
+	struct timespec start, sync;
+	short *buf;
+
+	buf = calloc(buffer_size, 2 * sizeof(*buf));
+	TEST_CHECK(snd_pcm_writei(pcm, buf, buffer_size) == (snd_pcm_sframes_t)buffer_size);
+	free(buf);
+	ALSA_CHECK(snd_pcm_hw_sync_ptr_stats(pcm, &issued0, &avoided0));
+	ALSA_CHECK(snd_pcm_start(pcm));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	sync = start;
+	while (elapsed_frames(&start) < (long long)buffer_size / 2) {
+		ALSA_CHECK(snd_pcm_hw_sync_ptr_stats(pcm, &before, NULL));
+		avail = snd_pcm_avail_update(pcm);
+		if (avail < 0) {
+			TEST_CHECK(avail >= 0);
+			break;
+		}
+		ALSA_CHECK(snd_pcm_hw_sync_ptr_stats(pcm, &issued, NULL));
+		if (issued != before) {
+			clock_gettime(CLOCK_MONOTONIC, &sync);
+			synced = avail;
+			continue;
+		}
+		kept++;
+		late = elapsed_frames(&sync);
+		if (avail != synced || late > (long long)max_error + SLACK ||
+		    (long long)(synced % period_size) + late > (long long)period_size + SLACK)
+			bad++;
+	}
+	TEST_CHECK(bad == 0);
+	ALSA_CHECK(snd_pcm_drop(pcm));
+	ALSA_CHECK(snd_pcm_hw_sync_ptr_stats(pcm, &issued, &avoided));
+	ALSA_CHECK(snd_pcm_prepare(pcm));
+	*issuedp = issued - issued0;
+	*avoidedp = avoided - avoided0;
+	*keptp = kept;
+}
+
+static int test_limit(unsigned int max_error)
+{
+	unsigned long issued, avoided, kept;
+	snd_pcm_t *pcm;
+	int err;
+
+	err = open_hw(&pcm, max_error);
+	if (err)
+		return err;
+	play(pcm, max_error, &issued, &avoided, &kept);
+	/* each kept position is counted, only these ones */
+	TEST_CHECK(avoided == kept);
+	if (!max_error) {
+		TEST_CHECK(kept == 0);
+	} else {
+		TEST_CHECK(kept > 0);
+		/* asked again at each limit or period boundary, give or take */
+		TEST_CHECK(issued >= (buffer_size / 2) /
+			   (2 * (max_error < period_size ? max_error : period_size)));
+	}
+	snd_pcm_close(pcm);
+	return 0;
+}
+
+int main(void)
+{
+	if (test_limit(0) == 77)
+		return 77;
+	test_limit(PERIOD_SIZE / 4);
+	/* a limit above the period leaves the period boundaries */
+	test_limit(PERIOD_SIZE * PERIODS);
+	return TEST_EXIT_CODE();
+}
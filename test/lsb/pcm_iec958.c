@@ -0,0 +1,217 @@
+#include <stdint.h>
+#include "pcm_test.h"
+
+/*
+ * IEC958 subframe coding of the iec958 plugin in both directions against
+ * a bit by bit reference.  The channel status must follow the frame
+ * counter over the 192 frame blocks across all periods of the stream.
+ * The 8 to 32-bit linear formats are tried with the native subframe byte
+ * order, the only one the null PCM takes, with the default, custom and
+ * wide preamble settings, with interleaved, misaligned interleaved and
+ * non-interleaved client buffers, and with each $LIBASOUND_SIMD level.
+ * The output is captured by the file plugin.
+ */
+
+#define FRAMES		1001
+#define CHUNK		97		/* odd lengths for the kernels */
+#define BUFFER_SIZE	256
+#define PERIOD_SIZE	64
+
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S8,
+	SND_PCM_FORMAT_U8,
+	SND_PCM_FORMAT_S16_LE,
+	SND_PCM_FORMAT_S16_BE,
+	SND_PCM_FORMAT_U16_LE,
+	SND_PCM_FORMAT_U16_BE,
+	SND_PCM_FORMAT_S24_LE,
+	SND_PCM_FORMAT_S24_BE,
+	SND_PCM_FORMAT_U24_LE,
+	SND_PCM_FORMAT_U24_BE,
+	SND_PCM_FORMAT_S32_LE,
+	SND_PCM_FORMAT_S32_BE,
+	SND_PCM_FORMAT_U32_LE,
+	SND_PCM_FORMAT_U32_BE,
+	SND_PCM_FORMAT_S24_3LE,
+	SND_PCM_FORMAT_S24_3BE,
+	SND_PCM_FORMAT_U24_3LE,
+	SND_PCM_FORMAT_U24_3BE,
+};
+
+static const unsigned int channels[] = { 1, 2, 3, 8 };
+
+/* the plugin options and what they mean for the reference */
+static const struct {
+	const char *conf;
+	unsigned char status[24];
+	unsigned char preamble[3];	/* Z, X, Y */
+} options[] = {
+	{ "",
+	  { 0x00, 0x82, 0x00, 0x02 },
+	  { 0x08, 0x02, 0x04 } },
+	{ "status [ 0x05 0x80 0x0f 0x02 0x00 0x00 0xa5 0x5a 0xff 0x01 0x80 0x00"
+	  " 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x81 ]"
+	  " preamble { z 0x03 x 0x05 y 0x09 }",
+	  { 0x05, 0x80, 0x0f, 0x02, 0x00, 0x00, 0xa5, 0x5a, 0xff, 0x01, 0x80, 0x00,
+	    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x81 },
+	  { 0x03, 0x05, 0x09 } },
+	/* wider than the four preamble bits */
+	{ "preamble { b 0x13 m 0x25 w 0x49 }",
+	  { 0x00, 0x82, 0x00, 0x02 },
+	  { 0x13, 0x25, 0x49 } },
+};
+
+static uint32_t get_bytes(snd_pcm_format_t format, const unsigned char *p)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	uint32_t word = 0;
+	unsigned int b;
+
+	for (b = 0; b < bytes; b++)
+		word = (word << 8) |
+			p[snd_pcm_format_big_endian(format) ? b : bytes - 1 - b];
+	return word;
+}
+
+static void put_bytes(snd_pcm_format_t format, unsigned char *p, uint32_t word)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int b;
+
+	for (b = 0; b < bytes; b++)
+		p[snd_pcm_format_big_endian(format) ? bytes - 1 - b : b] = word >> (8 * b);
+}
+
+/* the sample as a signed, MSB aligned 32-bit value */
+static uint32_t ref_load(snd_pcm_format_t format, const unsigned char *p)
+{
+	unsigned int width = snd_pcm_format_width(format);
+	uint32_t v = get_bytes(format, p) << (32 - width);
+
+	if (snd_pcm_format_unsigned(format))
+		v ^= 0x80000000;
+	return v;
+}
+
+/* truncate to the format, the padding of 24-bit in 32 is the sign */
+static void ref_store(snd_pcm_format_t format, unsigned char *p, uint32_t v)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int width = snd_pcm_format_width(format);
+	uint32_t word;
+
+	if (snd_pcm_format_unsigned(format))
+		v ^= 0x80000000;
+	word = v >> (32 - width);
+	if (bytes * 8 > width && (word & (1U << (width - 1))))
+		word |= ~0U << width;
+	put_bytes(format, p, word);
+}
+
+/*
+ * bit 0-3 preamble, 4-27 data, 28 validity, 29 user data,
+ * 30 channel status, 31 parity of the bits 4-30
+ */
+static uint32_t ref_subframe(uint32_t sample, unsigned int opt,
+			     unsigned int frame, unsigned int channel)
+{
+	unsigned int counter = frame % 192, bit, parity = 0;
+	uint32_t data = (sample >> 4) & ~0xfU;
+
+	if (options[opt].status[counter / 8] & (1 << (counter % 8)))
+		data |= 0x40000000;
+	for (bit = 4; bit <= 30; bit++)
+		parity ^= (data >> bit) & 1;
+	if (parity)
+		data |= 0x80000000;
+	if (channel)
+		data |= options[opt].preamble[2];
+	else if (!counter)
+		data |= options[opt].preamble[0];
+	else
+		data |= options[opt].preamble[1];
+	return data;
+}
+
+/* play the interleaved 'src' in the given layout, return the file size */
+static long play(snd_pcm_format_t format, snd_pcm_format_t slave_format,
+		 unsigned int opt, unsigned int channels, int layout,
+		 const unsigned char *src, unsigned char *out, size_t out_size)
+{
+	snd_pcm_t *pcm;
+
+	if (test_pcm_open(&pcm, "pcm.test { type iec958 %s slave { format %s pcm out } }",
+			  options[opt].conf, snd_pcm_format_name(slave_format)) < 0)
+		return -1;
+	if (test_pcm_setup(pcm, test_access(layout), format, channels, 48000,
+			   PERIOD_SIZE, BUFFER_SIZE) < 0) {
+		snd_pcm_close(pcm);
+		return -1;
+	}
+	test_pcm_write(pcm, format, channels, layout, src, FRAMES, CHUNK, NULL);
+	snd_pcm_close(pcm);
+	return test_out_read(out, out_size);
+}
+
+static void test_pair(snd_pcm_format_t format, snd_pcm_format_t slave_format,
+		      unsigned int opt, unsigned int channels, int layout)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int slave_bytes = snd_pcm_format_physical_width(slave_format) / 8;
+	size_t samples = (size_t)FRAMES * channels;
+	size_t out_size = samples * slave_bytes;
+	unsigned char *src = malloc(samples * bytes);
+	unsigned char *ref = malloc(out_size);
+	unsigned char *out = malloc(out_size + 1);
+	int encode = !snd_pcm_format_linear(slave_format);
+	size_t i;
+	long size;
+
+	/* random data reaches the extremes of every format */
+	for (i = 0; i < samples * bytes; i++)
+		src[i] = rand();
+	for (i = 0; i < samples; i++) {
+		if (encode)
+			put_bytes(slave_format, ref + i * slave_bytes,
+				  ref_subframe(ref_load(format, src + i * bytes), opt,
+					       i / channels, i % channels));
+		else	/* the preamble and AUX bits are dropped */
+			ref_store(slave_format, ref + i * slave_bytes,
+				  (get_bytes(format, src + i * bytes) & ~0xfU) << 4);
+	}
+	size = play(format, slave_format, opt, channels, layout, src, out, out_size + 1);
+	if (size != (long)out_size || memcmp(out, ref, out_size)) {
+		fprintf(stderr, "%s -> %s, options %u, %u channels, layout %d: wrong output\n",
+			snd_pcm_format_name(format), snd_pcm_format_name(slave_format),
+			opt, channels, layout);
+		any_test_failed = 1;
+	}
+	free(out);
+	free(ref);
+	free(src);
+}
+
+static void test_all(void)
+{
+	unsigned int i, k, opt;
+	int layout;
+
+	for (opt = 0; opt < sizeof(options) / sizeof(options[0]); opt++)
+		for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+			for (k = 0; k < sizeof(channels) / sizeof(channels[0]); k++)
+				for (layout = 0; layout < LAYOUTS; layout++) {
+					test_pair(formats[i], SND_PCM_FORMAT_IEC958_SUBFRAME,
+						  opt, channels[k], layout);
+					test_pair(SND_PCM_FORMAT_IEC958_SUBFRAME, formats[i],
+						  opt, channels[k], layout);
+				}
+}
+
+int main(void)
+{
+	if (test_out_create() < 0)
+		return 1;
+	test_simd_levels(test_all);
+	unlink(test_out_path);
+	return TEST_EXIT_CODE();
+}
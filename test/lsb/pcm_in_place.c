@@ -0,0 +1,174 @@
+#include <stdint.h>
+#include "pcm_test.h"
+
+/*
+ * A softvol, linear and route chain whose conversions keep the sample
+ * width, played once with $LIBASOUND_PLUGIN_IN_PLACE=0 and once with the
+ * default, from MMAP_INTERLEAVED and RW_INTERLEAVED client buffers.  Both
+ * must give the same output, captured by the file plugin.  The mmap areas
+ * of the client show whether the plugins converted in the slave buffer:
+ * read back after a commit, they then hold the converted output, else
+ * only what softvol wrote into the buffer of linear.  The control is the
+ * card-less one of test/dummy_ctl.c.
+ */
+
+#define CHANNELS	2
+#define FRAMES		1001
+#define CHUNK		97
+#define BUFFER_SIZE	256
+#define PERIOD_SIZE	64
+
+/* test/dummy_ctl.la, see Makefile.am */
+#ifndef DUMMY_CTL_LIB
+#define DUMMY_CTL_LIB	""
+#endif
+
+/* let "hw:0" open the dummy control device */
+static const char config[] =
+	"ctl_type.dummy { lib \"" DUMMY_CTL_LIB "\" }\n"
+	"ctl.hw {\n"
+	"	@args [ CARD ]\n"
+	"	@args.CARD { type string default \"0\" }\n"
+	"	type dummy\n"
+	"	name \"Test Volume\"\n"
+	"	channels 2\n"
+	"	max 255\n"
+	"	value 200\n"	/* below 0 dB, softvol scales */
+	"}\n";
+
+static char config_path[] = "/tmp/alsa-in-place-conf-XXXXXX";
+
+/* S16_LE in, S16_BE between linear and route, U16_LE out */
+static const char chain[] =
+	"pcm.test { type softvol slave.pcm lin"
+	" control { name \"Test Volume\" card 0 }"
+	" min_dB -60.0 max_dB 0.0 resolution 256 }\n"
+	"pcm.lin { type linear slave { format S16_BE pcm rt } }\n"
+	"pcm.rt { type route slave { format U16_LE channels 2 pcm out }"
+	" ttable { 0.0 1 1.1 1 } }\n";
+
+/* write 'src' through mmap, keep the committed areas as read back in 'seen' */
+static void mmap_write(snd_pcm_t *pcm, const int16_t *src, int16_t *seen)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, frames, f;
+	unsigned int written = 0, c;
+
+	while (written < FRAMES) {
+		if (snd_pcm_avail_update(pcm) <= 0) {
+			TEST_CHECK(snd_pcm_start(pcm) == 0);
+			continue;
+		}
+		frames = FRAMES - written < CHUNK ? FRAMES - written : CHUNK;
+		if (ALSA_CHECK(snd_pcm_mmap_begin(pcm, &areas, &offset, &frames)) < 0)
+			break;
+		for (f = 0; f < frames; f++)
+			for (c = 0; c < CHANNELS; c++)
+				*(int16_t *)((char *)areas[c].addr +
+					     (areas[c].first + (offset + f) * areas[c].step) / 8) =
+					src[(written + f) * CHANNELS + c];
+		TEST_CHECK(snd_pcm_mmap_commit(pcm, offset, frames) == (snd_pcm_sframes_t)frames);
+		for (f = 0; f < frames; f++)
+			for (c = 0; c < CHANNELS; c++)
+				seen[(written + f) * CHANNELS + c] =
+					*(int16_t *)((char *)areas[c].addr +
+						     (areas[c].first + (offset + f) * areas[c].step) / 8);
+		written += frames;
+	}
+}
+
+/* play the chain in a child, the mode is read once per process */
+static long play(int in_place, snd_pcm_access_t access, const int16_t *src,
+		 unsigned char *out, size_t out_size)
+{
+	size_t size = (size_t)FRAMES * CHANNELS * 2;
+	unsigned char *seen;
+	snd_pcm_t *pcm;
+	int status;
+	pid_t pid;
+
+	pid = fork();
+	if (pid == 0) {
+		setenv("LIBASOUND_PLUGIN_IN_PLACE", in_place ? "1" : "0", 1);
+		if (test_pcm_open(&pcm, "%s", chain) < 0)
+			_exit(1);
+		if (test_pcm_setup(pcm, access, SND_PCM_FORMAT_S16_LE, CHANNELS, 48000,
+				   PERIOD_SIZE, BUFFER_SIZE) < 0) {
+			snd_pcm_close(pcm);
+			_exit(1);
+		}
+		if (access == SND_PCM_ACCESS_RW_INTERLEAVED) {
+			test_pcm_write(pcm, SND_PCM_FORMAT_S16_LE, CHANNELS, INTERLEAVED,
+				       (const unsigned char *)src, FRAMES, CHUNK, NULL);
+			snd_pcm_close(pcm);
+			_exit(TEST_EXIT_CODE());
+		}
+		seen = malloc(size);
+		mmap_write(pcm, src, (int16_t *)seen);
+		snd_pcm_close(pcm);
+		/* in place, the client writes into the buffer of the file plugin */
+		if (test_out_read(out, out_size) != (long)size ||
+		    !memcmp(seen, out, size) != !!in_place) {
+			fprintf(stderr, "in place %d: the chain %s\n", in_place,
+				in_place ? "copied" : "converted in place");
+			any_test_failed = 1;
+		}
+		free(seen);
+		_exit(TEST_EXIT_CODE());
+	}
+	if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		any_test_failed = 1;
+	return test_out_read(out, out_size);
+}
+
+static void test_chain(snd_pcm_access_t access)
+{
+	size_t size = (size_t)FRAMES * CHANNELS * 2;
+	int16_t *src = malloc(size);
+	unsigned char *copied = malloc(size + 1);
+	unsigned char *shared = malloc(size + 1);
+	long copied_size, shared_size;
+	size_t i;
+
+	for (i = 0; i < (size_t)FRAMES * CHANNELS; i++)
+		src[i] = rand();
+	copied_size = play(0, access, src, copied, size + 1);
+	shared_size = play(1, access, src, shared, size + 1);
+	if (copied_size != (long)size || shared_size != (long)size ||
+	    memcmp(copied, shared, size)) {
+		fprintf(stderr, "%s: the output differs\n", snd_pcm_access_name(access));
+		any_test_failed = 1;
+	}
+	free(shared);
+	free(copied);
+	free(src);
+}
+
+int main(void)
+{
+	int fd;
+
+	/* skipped without the dummy control */
+	if (access(DUMMY_CTL_LIB, R_OK) < 0)
+		return 77;
+	fd = mkstemp(config_path);
+	if (fd < 0)
+		return 1;
+	if (write(fd, config, strlen(config)) != (ssize_t)strlen(config)) {
+		close(fd);
+		unlink(config_path);
+		return 1;
+	}
+	close(fd);
+	setenv("ALSA_CONFIG_PATH", config_path, 1);
+	if (test_out_create() < 0) {
+		unlink(config_path);
+		return 1;
+	}
+	test_chain(SND_PCM_ACCESS_MMAP_INTERLEAVED);
+	test_chain(SND_PCM_ACCESS_RW_INTERLEAVED);
+	unlink(test_out_path);
+	unlink(config_path);
+	return TEST_EXIT_CODE();
+}
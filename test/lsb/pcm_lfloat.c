@@ -0,0 +1,251 @@
+#include <stdint.h>
+#include <math.h>
+#include "pcm_test.h"
+
+/*
+ * Conversions of the lfloat plugin between the float formats and the 8 to
+ * 32-bit linear formats against a sample by sample reference, with
+ * interleaved, misaligned interleaved and non-interleaved client buffers,
+ * and with each $LIBASOUND_SIMD level.  Integers become floats scaled to
+ * [-1.0, 1.0); floats are rounded to the nearest integer of the
+ * destination width and saturated, and NaN gives silence.
+ */
+
+#define FRAMES		1001
+#define CHUNK		97		/* odd lengths for the kernels */
+#define BUFFER_SIZE	256
+#define PERIOD_SIZE	64
+
+static const snd_pcm_format_t int_formats[] = {
+	SND_PCM_FORMAT_S8,
+	SND_PCM_FORMAT_U8,
+	SND_PCM_FORMAT_S16_LE,
+	SND_PCM_FORMAT_S16_BE,
+	SND_PCM_FORMAT_U16_LE,
+	SND_PCM_FORMAT_U16_BE,
+	SND_PCM_FORMAT_S24_LE,
+	SND_PCM_FORMAT_S24_BE,
+	SND_PCM_FORMAT_U24_LE,
+	SND_PCM_FORMAT_U24_BE,
+	SND_PCM_FORMAT_S32_LE,
+	SND_PCM_FORMAT_S32_BE,
+	SND_PCM_FORMAT_U32_LE,
+	SND_PCM_FORMAT_U32_BE,
+	SND_PCM_FORMAT_S24_3LE,
+	SND_PCM_FORMAT_S24_3BE,
+	SND_PCM_FORMAT_U24_3LE,
+	SND_PCM_FORMAT_U24_3BE,
+};
+
+static const snd_pcm_format_t float_formats[] = {
+	SND_PCM_FORMAT_FLOAT_LE,
+	SND_PCM_FORMAT_FLOAT_BE,
+	SND_PCM_FORMAT_FLOAT64_LE,
+	SND_PCM_FORMAT_FLOAT64_BE,
+};
+
+static const unsigned int channels[] = { 1, 2, 3, 8 };
+
+/* saturation, signed zero, infinities, NaN and denormals */
+static const double specials[] = {
+	0.0, -0.0, 1.0, -1.0, 0.5, -0.5, 1.5, -1.5, 0.99999994, -0.99999994,
+	1e10, -1e10, INFINITY, -INFINITY, NAN, 1e-40, -1e-310,
+};
+
+static void put_bytes(snd_pcm_format_t format, unsigned char *p, uint64_t word)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int b;
+
+	for (b = 0; b < bytes; b++)
+		p[snd_pcm_format_big_endian(format) ? bytes - 1 - b : b] = word >> (8 * b);
+}
+
+static uint64_t get_bytes(snd_pcm_format_t format, const unsigned char *p)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	uint64_t word = 0;
+	unsigned int b;
+
+	for (b = 0; b < bytes; b++)
+		word = (word << 8) |
+			p[snd_pcm_format_big_endian(format) ? b : bytes - 1 - b];
+	return word;
+}
+
+static double load_float(snd_pcm_format_t format, const unsigned char *p)
+{
+	uint64_t word = get_bytes(format, p);
+	uint32_t word32 = word;
+	double d;
+	float f;
+
+	if (snd_pcm_format_physical_width(format) == 32) {
+		memcpy(&f, &word32, 4);
+		return f;
+	}
+	memcpy(&d, &word, 8);
+	return d;
+}
+
+static void store_float(snd_pcm_format_t format, unsigned char *p, double v)
+{
+	uint64_t word;
+	uint32_t word32;
+	float f = v;
+
+	if (snd_pcm_format_physical_width(format) == 32) {
+		memcpy(&word32, &f, 4);
+		put_bytes(format, p, word32);
+	} else {
+		memcpy(&word, &v, 8);
+		put_bytes(format, p, word);
+	}
+}
+
+/* integer -> [-1.0, 1.0) */
+static double ref_to_float(snd_pcm_format_t format, const unsigned char *p)
+{
+	unsigned int width = snd_pcm_format_width(format);
+	uint32_t v = (uint32_t)get_bytes(format, p) << (32 - width);
+
+	if (snd_pcm_format_unsigned(format))
+		v ^= 0x80000000;
+	return (int32_t)v * (1.0 / 2147483648.0);
+}
+
+/* float -> integer, rounded to nearest and saturated */
+static void ref_from_float(snd_pcm_format_t format, unsigned char *p, double v)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int width = snd_pcm_format_width(format);
+	double max = (double)(1U << (width - 1));
+	uint32_t word;
+
+	if (v != v)
+		v = 0;
+	v = rint(v * max);
+	if (v >= max)
+		v = max - 1;
+	else if (v < -max)
+		v = -max;
+	word = (uint32_t)(int32_t)v;
+	if (snd_pcm_format_unsigned(format))
+		word ^= 1U << (width - 1);
+	/* the padding of 24-bit in 32 is the sign */
+	if (bytes * 8 > width && (word & (1U << (width - 1))))
+		word |= ~0U << width;
+	else if (width < 32)
+		word &= (1U << width) - 1;
+	put_bytes(format, p, word);
+}
+
+/* values around the rounding points and the ends of the integer range */
+static void fill_float(snd_pcm_format_t format, unsigned char *p, size_t samples,
+		       unsigned int int_width)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	double max = (double)(1U << (int_width - 1));
+	size_t i;
+	double v;
+
+	for (i = 0; i < samples; i++) {
+		switch (i % 4) {
+		case 0:
+			v = specials[(i / 4) % (sizeof(specials) / sizeof(specials[0]))];
+			break;
+		case 1:		/* a tie */
+			v = ((double)(rand() % (1 << 16)) - (1 << 15) + 0.5) / max;
+			break;
+		case 2:
+			v = (rand() / (double)RAND_MAX - 0.5) * 2.2;
+			break;
+		default:	/* next to the ends */
+			v = (rand() % 2 ? 1 : -1) * (1.0 - (rand() % 8) / max);
+			break;
+		}
+		store_float(format, p + i * bytes, v);
+	}
+}
+
+/* play the interleaved 'src' in the given layout, return the file size */
+static long play(snd_pcm_format_t format, snd_pcm_format_t slave_format,
+		 unsigned int channels, int layout, const unsigned char *src,
+		 unsigned char *out, size_t out_size)
+{
+	snd_pcm_t *pcm;
+
+	if (test_pcm_open(&pcm, "pcm.test { type lfloat slave { format %s pcm out } }",
+			  snd_pcm_format_name(slave_format)) < 0)
+		return -1;
+	if (test_pcm_setup(pcm, test_access(layout), format, channels, 48000,
+			   PERIOD_SIZE, BUFFER_SIZE) < 0) {
+		snd_pcm_close(pcm);
+		return -1;
+	}
+	test_pcm_write(pcm, format, channels, layout, src, FRAMES, CHUNK, NULL);
+	snd_pcm_close(pcm);
+	return test_out_read(out, out_size);
+}
+
+static void test_pair(snd_pcm_format_t format, snd_pcm_format_t slave_format,
+		      unsigned int channels, int layout)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int slave_bytes = snd_pcm_format_physical_width(slave_format) / 8;
+	size_t samples = (size_t)FRAMES * channels;
+	size_t out_size = samples * slave_bytes;
+	unsigned char *src = malloc(samples * bytes);
+	unsigned char *ref = malloc(out_size);
+	unsigned char *out = malloc(out_size + 1);
+	size_t i;
+	long size;
+
+	if (snd_pcm_format_float(format)) {
+		fill_float(format, src, samples, snd_pcm_format_width(slave_format));
+		for (i = 0; i < samples; i++)
+			ref_from_float(slave_format, ref + i * slave_bytes,
+				       load_float(format, src + i * bytes));
+	} else {
+		for (i = 0; i < samples * bytes; i++)
+			src[i] = rand();
+		for (i = 0; i < samples; i++)
+			store_float(slave_format, ref + i * slave_bytes,
+				    ref_to_float(format, src + i * bytes));
+	}
+	size = play(format, slave_format, channels, layout, src, out, out_size + 1);
+	if (size != (long)out_size || memcmp(out, ref, out_size)) {
+		fprintf(stderr, "%s -> %s, %u channels, layout %d: wrong output\n",
+			snd_pcm_format_name(format), snd_pcm_format_name(slave_format),
+			channels, layout);
+		any_test_failed = 1;
+	}
+	free(out);
+	free(ref);
+	free(src);
+}
+
+static void test_all(void)
+{
+	unsigned int i, j, k;
+	int layout;
+
+	for (i = 0; i < sizeof(int_formats) / sizeof(int_formats[0]); i++)
+		for (j = 0; j < sizeof(float_formats) / sizeof(float_formats[0]); j++)
+			for (k = 0; k < sizeof(channels) / sizeof(channels[0]); k++)
+				for (layout = 0; layout < LAYOUTS; layout++) {
+					test_pair(int_formats[i], float_formats[j],
+						  channels[k], layout);
+					test_pair(float_formats[j], int_formats[i],
+						  channels[k], layout);
+				}
+}
+
+int main(void)
+{
+	if (test_out_create() < 0)
+		return 1;
+	test_simd_levels(test_all);
+	unlink(test_out_path);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,148 @@
+#include <stdint.h>
+#include "pcm_test.h"
+
+/*
+ * Conversions of the linear plugin between all pairs of the 8 to 32-bit
+ * formats against a sample by sample reference, with interleaved,
+ * misaligned interleaved and non-interleaved client buffers, and with
+ * each $LIBASOUND_SIMD level.  The converted data is captured by the file
+ * plugin.
+ */
+
+#define FRAMES		1001
+#define CHUNK		97		/* odd lengths for the kernels */
+#define BUFFER_SIZE	256
+#define PERIOD_SIZE	64
+
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S8,
+	SND_PCM_FORMAT_U8,
+	SND_PCM_FORMAT_S16_LE,
+	SND_PCM_FORMAT_S16_BE,
+	SND_PCM_FORMAT_U16_LE,
+	SND_PCM_FORMAT_U16_BE,
+	SND_PCM_FORMAT_S24_LE,
+	SND_PCM_FORMAT_S24_BE,
+	SND_PCM_FORMAT_U24_LE,
+	SND_PCM_FORMAT_U24_BE,
+	SND_PCM_FORMAT_S32_LE,
+	SND_PCM_FORMAT_S32_BE,
+	SND_PCM_FORMAT_U32_LE,
+	SND_PCM_FORMAT_U32_BE,
+	SND_PCM_FORMAT_S24_3LE,
+	SND_PCM_FORMAT_S24_3BE,
+	SND_PCM_FORMAT_U24_3LE,
+	SND_PCM_FORMAT_U24_3BE,
+};
+
+static const unsigned int channels[] = { 1, 2, 3, 8 };
+
+/* the sample as a signed, MSB aligned 32-bit value */
+static uint32_t ref_load(snd_pcm_format_t format, const unsigned char *p)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int width = snd_pcm_format_width(format);
+	uint32_t word = 0, v;
+	unsigned int b;
+
+	for (b = 0; b < bytes; b++)
+		word = (word << 8) |
+			p[snd_pcm_format_big_endian(format) ? b : bytes - 1 - b];
+	v = word << (32 - width);
+	if (snd_pcm_format_unsigned(format))
+		v ^= 0x80000000;
+	return v;
+}
+
+/* truncate to the format, the padding of 24-bit in 32 is the sign */
+static void ref_store(snd_pcm_format_t format, unsigned char *p, uint32_t v)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int width = snd_pcm_format_width(format);
+	uint32_t word;
+	unsigned int b;
+
+	if (snd_pcm_format_unsigned(format))
+		v ^= 0x80000000;
+	word = v >> (32 - width);
+	if (bytes * 8 > width && (word & (1U << (width - 1))))
+		word |= ~0U << width;
+	for (b = 0; b < bytes; b++)
+		p[snd_pcm_format_big_endian(format) ? bytes - 1 - b : b] = word >> (8 * b);
+}
+
+/* play the interleaved 'src' in the given layout, return the file size */
+static long play(snd_pcm_format_t format, snd_pcm_format_t slave_format,
+		 unsigned int channels, int layout, const unsigned char *src,
+		 unsigned char *out, size_t out_size)
+{
+	snd_pcm_t *pcm;
+
+	if (test_pcm_open(&pcm, "pcm.test { type linear slave { format %s pcm out } }",
+			  snd_pcm_format_name(slave_format)) < 0)
+		return -1;
+	if (test_pcm_setup(pcm, test_access(layout), format, channels, 48000,
+			   PERIOD_SIZE, BUFFER_SIZE) < 0) {
+		snd_pcm_close(pcm);
+		return -1;
+	}
+	test_pcm_write(pcm, format, channels, layout, src, FRAMES, CHUNK, NULL);
+	snd_pcm_close(pcm);
+	return test_out_read(out, out_size);
+}
+
+static void test_pair(snd_pcm_format_t format, snd_pcm_format_t slave_format,
+		      unsigned int channels, int layout)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int slave_bytes = snd_pcm_format_physical_width(slave_format) / 8;
+	size_t samples = (size_t)FRAMES * channels;
+	size_t out_size = samples * slave_bytes;
+	unsigned char *src = malloc(samples * bytes);
+	unsigned char *ref = malloc(out_size);
+	unsigned char *out = malloc(out_size + 1);
+	size_t i;
+	long size;
+
+	/* random data reaches the extremes of every format */
+	for (i = 0; i < samples * bytes; i++)
+		src[i] = rand();
+	for (i = 0; i < samples; i++)
+		ref_store(slave_format, ref + i * slave_bytes,
+			  ref_load(format, src + i * bytes));
+	size = play(format, slave_format, channels, layout, src, out, out_size + 1);
+	if (size != (long)out_size || memcmp(out, ref, out_size)) {
+		fprintf(stderr, "%s -> %s, %u channels, layout %d: wrong output\n",
+			snd_pcm_format_name(format), snd_pcm_format_name(slave_format),
+			channels, layout);
+		any_test_failed = 1;
+	}
+	free(out);
+	free(ref);
+	free(src);
+}
+
+static void test_all(void)
+{
+	unsigned int i, j, k;
+	int layout;
+
+	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+		for (j = 0; j < sizeof(formats) / sizeof(formats[0]); j++) {
+			if (i == j)
+				continue;
+			for (k = 0; k < sizeof(channels) / sizeof(channels[0]); k++)
+				for (layout = 0; layout < LAYOUTS; layout++)
+					test_pair(formats[i], formats[j],
+						  channels[k], layout);
+		}
+}
+
+int main(void)
+{
+	if (test_out_create() < 0)
+		return 1;
+	test_simd_levels(test_all);
+	unlink(test_out_path);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,114 @@
+#include <stdint.h>
+#include "pcm_test.h"
+
+/*
+ * MMAP_INTERLEAVED writer through the linear plugin with a page aligned
+ * buffer, once with $LIBASOUND_MMAP_MIRROR=1, where snd_pcm_mmap_begin()
+ * returns areas running past the end of the buffer, and once with the
+ * areas split at the wrap around.  Both must give the same converted
+ * output, captured by the file plugin.
+ */
+
+#define CHANNELS	2
+#define BUFFER_SIZE	1024		/* 4096 bytes of S16 stereo */
+#define PERIOD_SIZE	256
+#define CHUNK		300		/* not a divisor of the buffer size */
+#define TOTAL		10007
+
+static int16_t sample(unsigned int frame, unsigned int channel)
+{
+	return (int16_t)(frame * 31 + channel * 12345);
+}
+
+/*
+ * write TOTAL frames in chunks, return the number of areas which ran
+ * past the end of the buffer and the output in *outp
+ */
+static int run(int mirror, unsigned char **outp, size_t *sizep)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, frames, f;
+	unsigned int written = 0, c;
+	int spanned = 0;
+	snd_pcm_t *pcm;
+	long size;
+
+	setenv("LIBASOUND_MMAP_MIRROR", mirror ? "1" : "0", 1);
+	*outp = NULL;
+	if (test_pcm_open(&pcm, "pcm.test { type linear slave { format S32_LE pcm out } }") < 0)
+		return -1;
+	if (test_pcm_setup(pcm, SND_PCM_ACCESS_MMAP_INTERLEAVED, SND_PCM_FORMAT_S16_LE,
+			   CHANNELS, 48000, PERIOD_SIZE, BUFFER_SIZE) < 0) {
+		snd_pcm_close(pcm);
+		return -1;
+	}
+	while (written < TOTAL) {
+		if (snd_pcm_avail_update(pcm) <= 0) {
+			TEST_CHECK(snd_pcm_start(pcm) == 0);
+			continue;
+		}
+		frames = TOTAL - written < CHUNK ? TOTAL - written : CHUNK;
+		if (ALSA_CHECK(snd_pcm_mmap_begin(pcm, &areas, &offset, &frames)) < 0)
+			break;
+		if (offset + frames > BUFFER_SIZE)
+			spanned++;
+		for (f = 0; f < frames; f++)
+			for (c = 0; c < CHANNELS; c++)
+				*(int16_t *)((char *)areas[c].addr +
+					     (areas[c].first + (offset + f) * areas[c].step) / 8) =
+					sample(written + f, c);
+		TEST_CHECK(snd_pcm_mmap_commit(pcm, offset, frames) == (snd_pcm_sframes_t)frames);
+		written += frames;
+	}
+	snd_pcm_close(pcm);
+
+	/* one more byte to see a longer output */
+	*outp = malloc((size_t)TOTAL * CHANNELS * 4 + 1);
+	size = test_out_read(*outp, (size_t)TOTAL * CHANNELS * 4 + 1);
+	if (size < 0)
+		return -1;
+	*sizep = size;
+	return spanned;
+}
+
+static void check_output(const unsigned char *out, size_t size)
+{
+	const int32_t *s = (const int32_t *)out;
+	unsigned int f, c, bad = 0;
+
+	TEST_CHECK(size == (size_t)TOTAL * CHANNELS * 4);
+	if (size != (size_t)TOTAL * CHANNELS * 4)
+		return;
+	for (f = 0; f < TOTAL; f++)
+		for (c = 0; c < CHANNELS; c++)
+			if (s[f * CHANNELS + c] != (int32_t)((uint32_t)(uint16_t)sample(f, c) << 16))
+				bad++;
+	TEST_CHECK(bad == 0);
+}
+
+int main(void)
+{
+	unsigned char *mirrored, *split;
+	size_t mirrored_size = 0, split_size = 0;
+	int spanned;
+
+	if (test_out_create() < 0)
+		return 1;
+
+	spanned = run(0, &split, &split_size);
+	TEST_CHECK(spanned == 0);
+	spanned = run(1, &mirrored, &mirrored_size);
+	/* the mirror is used and gives areas across the wrap around */
+	TEST_CHECK(spanned > 0);
+
+	if (split && mirrored) {
+		check_output(split, split_size);
+		check_output(mirrored, mirrored_size);
+		TEST_CHECK(split_size == mirrored_size &&
+			   !memcmp(split, mirrored, split_size));
+	}
+	free(split);
+	free(mirrored);
+	unlink(test_out_path);
+	return TEST_EXIT_CODE();
+}
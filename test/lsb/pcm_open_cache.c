@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+
+/*
+ * PCM definition cache: repeated opens of a name of the global
+ * configuration are hits, each set of arguments gets its own entry, and
+ * a flush or a reload of the configuration makes the next open miss.
+ */
+
+static const char config[] =
+	"pcm.cached {\n"
+	"	type plug\n"
+	"	slave.pcm { type null }\n"
+	"}\n"
+	"pcm.withargs {\n"
+	"	@args [ FORMAT ]\n"
+	"	@args.FORMAT { type string default S32_LE }\n"
+	"	type linear\n"
+	"	slave { pcm { type null } format $FORMAT }\n"
+	"}\n";
+
+static char config_path[] = "/tmp/alsa-open-cache-XXXXXX";
+
+/* open the PCM and return the first line of its dump */
+static int open_dump(const char *name, char *line, size_t size)
+{
+	snd_pcm_t *pcm;
+	snd_output_t *out;
+	char *text;
+	size_t len;
+	int err;
+
+	err = ALSA_CHECK(snd_pcm_open(&pcm, name, SND_PCM_STREAM_PLAYBACK, 0));
+	if (err < 0)
+		return err;
+	snd_output_buffer_open(&out);
+	snd_pcm_dump(pcm, out);
+	len = snd_output_buffer_string(out, &text);
+	if (len > size - 1)
+		len = size - 1;
+	memcpy(line, text, len);
+	line[len] = 0;
+	if (strchr(line, '\n'))
+		*strchr(line, '\n') = 0;
+	snd_output_close(out);
+	snd_pcm_close(pcm);
+	return 0;
+}
+
+static void test_hits(void)
+{
+	unsigned long hits0, misses0, hits1, misses1;
+	char line[128];
+
+	TEST_CHECK(open_dump("cached", line, sizeof(line)) == 0);
+	snd_pcm_open_cache_stats(&hits0, &misses0);
+	TEST_CHECK(misses0 > 0);
+
+	TEST_CHECK(open_dump("cached", line, sizeof(line)) == 0);
+	snd_pcm_open_cache_stats(&hits1, &misses1);
+	TEST_CHECK(hits1 > hits0);
+	TEST_CHECK(misses1 == misses0);
+}
+
+static void test_arguments(void)
+{
+	unsigned long hits0, misses0, hits1, misses1;
+	char line[128];
+
+	/* the arguments are a part of the key */
+	TEST_CHECK(open_dump("withargs", line, sizeof(line)) == 0);
+	TEST_CHECK(strstr(line, "(S32_LE)") != NULL);
+	snd_pcm_open_cache_stats(&hits0, &misses0);
+	TEST_CHECK(open_dump("withargs:FORMAT=S24_LE", line, sizeof(line)) == 0);
+	TEST_CHECK(strstr(line, "(S24_LE)") != NULL);
+	snd_pcm_open_cache_stats(&hits1, &misses1);
+	TEST_CHECK(misses1 > misses0);
+
+	TEST_CHECK(open_dump("withargs:FORMAT=S24_LE", line, sizeof(line)) == 0);
+	TEST_CHECK(strstr(line, "(S24_LE)") != NULL);
+	TEST_CHECK(open_dump("withargs", line, sizeof(line)) == 0);
+	TEST_CHECK(strstr(line, "(S32_LE)") != NULL);
+	snd_pcm_open_cache_stats(&hits0, &misses0);
+	TEST_CHECK(misses0 == misses1);
+	TEST_CHECK(hits0 > hits1);
+}
+
+static void test_flush(void)
+{
+	unsigned long hits0, misses0, hits1, misses1;
+	char line[128];
+
+	TEST_CHECK(open_dump("cached", line, sizeof(line)) == 0);
+	TEST_CHECK(snd_pcm_open_cache_flush() > 0);
+	TEST_CHECK(snd_pcm_open_cache_flush() == 0);
+	snd_pcm_open_cache_stats(&hits0, &misses0);
+	TEST_CHECK(open_dump("cached", line, sizeof(line)) == 0);
+	snd_pcm_open_cache_stats(&hits1, &misses1);
+	TEST_CHECK(misses1 > misses0);
+
+	/* entries of an older configuration are not used */
+	snd_config_update_free_global();
+	snd_pcm_open_cache_stats(&hits0, &misses0);
+	TEST_CHECK(open_dump("cached", line, sizeof(line)) == 0);
+	snd_pcm_open_cache_stats(&hits1, &misses1);
+	TEST_CHECK(misses1 > misses0);
+}
+
+int main(void)
+{
+	int fd;
+
+	fd = mkstemp(config_path);
+	if (fd < 0)
+		return 1;
+	if (write(fd, config, strlen(config)) != (ssize_t)strlen(config)) {
+		close(fd);
+		unlink(config_path);
+		return 1;
+	}
+	close(fd);
+	setenv("ALSA_CONFIG_PATH", config_path, 1);
+	setenv("LIBASOUND_OPEN_CACHE", "1", 1);
+
+	test_hits();
+	test_arguments();
+	test_flush();
+
+	snd_config_update_free_global();
+	unlink(config_path);
+	return TEST_EXIT_CODE();
+}
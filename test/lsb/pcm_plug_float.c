@@ -0,0 +1,428 @@
+#include <stdint.h>
+#include <math.h>
+#include "pcm_test.h"
+
+/*
+ * The internal_float mode of the plug plugin against its integer chain:
+ * up and down in rate and channels, from and to S16, S32 and FLOAT, also
+ * with a softvol on FLOAT above and below plug.  The dump must show the
+ * stages plug inserted, on FLOAT in between with internal_float, and the
+ * outputs of both chains must be within 1 LSB of 16-bit samples.  The
+ * route plugin mixing from and to FLOAT is checked against a sample by
+ * sample reference of its float sums.  The control of softvol is the
+ * card-less one of test/dummy_ctl.c, the output is captured by the file
+ * plugin.
+ */
+
+#define FRAMES		2048
+#define CHUNK		97
+#define BUFFER_SIZE	1024
+#define PERIOD_SIZE	256
+#define MAX_STAGES	8
+/* 1 LSB, and the 16-bit interpolation weights of the integer rate */
+#define TOLERANCE	(1.0 / 32768 + 1e-6)
+
+/* test/dummy_ctl.la, see Makefile.am */
+#ifndef DUMMY_CTL_LIB
+#define DUMMY_CTL_LIB	""
+#endif
+
+/* let "hw:0" open the dummy control device */
+static const char config[] =
+	"ctl_type.dummy { lib \"" DUMMY_CTL_LIB "\" }\n"
+	"ctl.hw {\n"
+	"	@args [ CARD ]\n"
+	"	@args.CARD { type string default \"0\" }\n"
+	"	type dummy\n"
+	"	name \"Test Volume\"\n"
+	"	channels 2\n"
+	"	max 255\n"
+	"	value 200\n"
+	"}\n";
+
+static char config_path[] = "/tmp/alsa-plug-float-conf-XXXXXX";
+
+#define SOFTVOL \
+	"type softvol control { name \"Test Volume\" card 0 }" \
+	" min_dB -60.0 max_dB 0.0 resolution 256"
+
+enum { PLAIN, SOFTVOL_ABOVE, SOFTVOL_BELOW };
+
+static const struct {
+	snd_pcm_format_t format, slave_format;
+	unsigned int channels, slave_channels;
+	unsigned int rate, slave_rate;
+	int softvol;
+	/* the dump of the chain down to the file plugin */
+	const char *float_stages[MAX_STAGES];
+	const char *int_stages[MAX_STAGES];
+} chains[] = {
+	{ SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_S32_LE, 2, 8, 44100, 48000, PLAIN,
+	  { "Linear Integer <-> Linear Float conversion PCM (FLOAT_LE)",
+	    "Rate conversion PCM (48000, sformat=FLOAT_LE)",
+	    "Route conversion PCM (sformat=FLOAT_LE)",
+	    "Linear Integer <-> Linear Float conversion PCM (S32_LE)" },
+	  { "Rate conversion PCM (48000, sformat=S16_LE)",
+	    "Route conversion PCM (sformat=S32_LE)" } },
+	{ SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_S16_LE, 8, 2, 48000, 44100, PLAIN,
+	  { "Linear Integer <-> Linear Float conversion PCM (FLOAT_LE)",
+	    "Route conversion PCM (sformat=FLOAT_LE)",
+	    "Rate conversion PCM (44100, sformat=FLOAT_LE)",
+	    "Linear Integer <-> Linear Float conversion PCM (S16_LE)" },
+	  { "Route conversion PCM (sformat=S32_LE)",
+	    "Rate conversion PCM (44100, sformat=S16_LE)" } },
+	{ SND_PCM_FORMAT_FLOAT_LE, SND_PCM_FORMAT_S16_LE, 2, 6, 44100, 48000, PLAIN,
+	  { "Rate conversion PCM (48000, sformat=FLOAT_LE)",
+	    "Route conversion PCM (sformat=FLOAT_LE)",
+	    "Linear Integer <-> Linear Float conversion PCM (S16_LE)" },
+	  { "Linear Integer <-> Linear Float conversion PCM (S16_LE)",
+	    "Rate conversion PCM (48000, sformat=S16_LE)",
+	    "Route conversion PCM (sformat=S16_LE)" } },
+	{ SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_FLOAT_LE, 4, 2, 48000, 22050, PLAIN,
+	  { "Linear Integer <-> Linear Float conversion PCM (FLOAT_LE)",
+	    "Route conversion PCM (sformat=FLOAT_LE)",
+	    "Rate conversion PCM (22050, sformat=FLOAT_LE)" },
+	  { "Route conversion PCM (sformat=S16_LE)",
+	    "Rate conversion PCM (22050, sformat=S16_LE)",
+	    "Linear Integer <-> Linear Float conversion PCM (FLOAT_LE)" } },
+	{ SND_PCM_FORMAT_FLOAT_LE, SND_PCM_FORMAT_S32_LE, 2, 8, 44100, 48000, SOFTVOL_ABOVE,
+	  { "Soft volume PCM",
+	    "Rate conversion PCM (48000, sformat=FLOAT_LE)",
+	    "Route conversion PCM (sformat=FLOAT_LE)",
+	    "Linear Integer <-> Linear Float conversion PCM (S32_LE)" },
+	  { "Soft volume PCM",
+	    "Linear Integer <-> Linear Float conversion PCM (S32_LE)",
+	    "Rate conversion PCM (48000, sformat=S32_LE)",
+	    "Route conversion PCM (sformat=S32_LE)" } },
+	{ SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_FLOAT_LE, 2, 8, 44100, 48000, SOFTVOL_BELOW,
+	  { "Linear Integer <-> Linear Float conversion PCM (FLOAT_LE)",
+	    "Rate conversion PCM (48000, sformat=FLOAT_LE)",
+	    "Route conversion PCM (sformat=FLOAT_LE)",
+	    "Soft volume PCM" },
+	  { "Rate conversion PCM (48000, sformat=S16_LE)",
+	    "Route conversion PCM (sformat=S16_LE)",
+	    "Linear Integer <-> Linear Float conversion PCM (FLOAT_LE)",
+	    "Soft volume PCM" } },
+};
+
+/* the client channel, the slave channel and the gain */
+struct entry {
+	unsigned int src, dst;
+	float gain;
+};
+
+static const struct entry ttable[] = {
+	{ 0, 0, 1.0 }, { 1, 0, 0.5 }, { 2, 0, 0.25 },	/* saturates */
+	{ 1, 1, 1.0 },					/* a copy */
+	{ 0, 2, -0.7 }, { 2, 2, 1.5 },
+	{ 0, 0, 0 }
+};
+
+#define ROUTE_CHANNELS		3
+#define ROUTE_SLAVE_CHANNELS	3
+
+static const struct {
+	snd_pcm_format_t format, slave_format;
+} routes[] = {
+	{ SND_PCM_FORMAT_FLOAT_LE, SND_PCM_FORMAT_FLOAT_LE },
+	{ SND_PCM_FORMAT_FLOAT_LE, SND_PCM_FORMAT_S16_LE },
+	{ SND_PCM_FORMAT_FLOAT_LE, SND_PCM_FORMAT_S32_LE },
+	{ SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_FLOAT_LE },
+	{ SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_FLOAT_LE },
+};
+
+/* the sample as a double from -1 to 1 */
+static double get_sample(snd_pcm_format_t format, const unsigned char *buf, size_t i)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+		return ((const int16_t *)buf)[i] / 32768.0;
+	case SND_PCM_FORMAT_S32_LE:
+		return ((const int32_t *)buf)[i] / 2147483648.0;
+	default:
+		return ((const float *)buf)[i];
+	}
+}
+
+static void put_sample(snd_pcm_format_t format, unsigned char *buf, size_t i, double v)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+		((int16_t *)buf)[i] = lrint(v * 32767);
+		break;
+	case SND_PCM_FORMAT_S32_LE:
+		((int32_t *)buf)[i] = lrint(v * 2147483647.0);
+		break;
+	default:
+		((float *)buf)[i] = v;
+		break;
+	}
+}
+
+/* random samples, FLOAT ones also above full scale */
+static void fill(snd_pcm_format_t format, unsigned char *buf, size_t samples)
+{
+	size_t i;
+
+	for (i = 0; i < samples; i++) {
+		if (format == SND_PCM_FORMAT_FLOAT_LE)
+			((float *)buf)[i] = rand() / (RAND_MAX / 3.0) - 1.5;
+		else if (format == SND_PCM_FORMAT_S32_LE)
+			((int32_t *)buf)[i] = (uint32_t)rand() << 16 ^ rand();
+		else
+			((int16_t *)buf)[i] = rand();
+	}
+}
+
+/* a tone on each channel, the interpolations differ on steep edges */
+static void fill_sine(snd_pcm_format_t format, unsigned char *buf,
+		      unsigned int channels, unsigned int rate)
+{
+	unsigned int f, c;
+
+	for (f = 0; f < FRAMES; f++)
+		for (c = 0; c < channels; c++)
+			put_sample(format, buf, (size_t)f * channels + c,
+				   0.4 * sin(2 * M_PI * (440.0 * (c + 1)) * f / rate));
+}
+
+/* compare the headers in the dump of the chain with 'stages' */
+static int check_stages(snd_pcm_t *pcm, const char *const *stages)
+{
+	snd_output_t *out;
+	char *text, *line, *next;
+	unsigned int n = 0;
+	int ok = 1;
+
+	if (ALSA_CHECK(snd_output_buffer_open(&out)) < 0)
+		return 0;
+	snd_pcm_dump(pcm, out);
+	snd_output_buffer_string(out, &text);
+	text = strdup(text);
+	snd_output_close(out);
+	/* the first line and the slaves, plug shows the head of its chain */
+	for (line = text; line && ok; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = 0;
+		if (!strncmp(line, "Slave: ", 7))
+			line += 7;
+		else if (line != text)
+			continue;
+		if (!strncmp(line, "Plug PCM: ", 10))
+			line += 10;
+		if (!strncmp(line, "File PCM", 8))
+			break;
+		ok = n < MAX_STAGES && stages[n] && !strcmp(line, stages[n]);
+		n++;
+	}
+	free(text);
+	return ok && (n == MAX_STAGES || !stages[n]);
+}
+
+static long play_chain(unsigned int c, int internal_float, const unsigned char *src,
+		       unsigned char *out, size_t out_size)
+{
+	char slave[256];
+	snd_pcm_t *pcm;
+
+	snprintf(slave, sizeof(slave), "format %s channels %u rate %u",
+		 snd_pcm_format_name(chains[c].slave_format),
+		 chains[c].slave_channels, chains[c].slave_rate);
+	switch (chains[c].softvol) {
+	case SOFTVOL_ABOVE:
+		if (test_pcm_open(&pcm, "pcm.test { " SOFTVOL " slave.pcm plug }\n"
+				  "pcm.plug { type plug internal_float %d"
+				  " slave { pcm out %s } }", internal_float, slave) < 0)
+			return -1;
+		break;
+	case SOFTVOL_BELOW:
+		if (test_pcm_open(&pcm, "pcm.test { type plug internal_float %d"
+				  " slave { pcm vol %s } }\n"
+				  "pcm.vol { " SOFTVOL " slave { pcm out format %s } }",
+				  internal_float, slave,
+				  snd_pcm_format_name(chains[c].slave_format)) < 0)
+			return -1;
+		break;
+	default:
+		if (test_pcm_open(&pcm, "pcm.test { type plug internal_float %d"
+				  " slave { pcm out %s } }", internal_float, slave) < 0)
+			return -1;
+		break;
+	}
+	if (test_pcm_setup(pcm, SND_PCM_ACCESS_RW_INTERLEAVED, chains[c].format,
+			   chains[c].channels, chains[c].rate, PERIOD_SIZE,
+			   BUFFER_SIZE) < 0) {
+		snd_pcm_close(pcm);
+		return -1;
+	}
+	if (!check_stages(pcm, internal_float ? chains[c].float_stages :
+			  chains[c].int_stages)) {
+		fprintf(stderr, "chain %u, internal_float %d: other stages\n",
+			c, internal_float);
+		any_test_failed = 1;
+	}
+	test_pcm_write(pcm, chains[c].format, chains[c].channels, INTERLEAVED,
+		       src, FRAMES, CHUNK, NULL);
+	snd_pcm_close(pcm);
+	return test_out_read(out, out_size);
+}
+
+static void test_chain(unsigned int c)
+{
+	size_t bytes = snd_pcm_format_physical_width(chains[c].format) / 8;
+	size_t slave_bytes = snd_pcm_format_physical_width(chains[c].slave_format) / 8;
+	size_t in_size = (size_t)FRAMES * chains[c].channels * bytes;
+	size_t out_size = (size_t)FRAMES * 4 * chains[c].slave_channels * slave_bytes;
+	unsigned char *src = malloc(in_size);
+	unsigned char *float_out = malloc(out_size);
+	unsigned char *int_out = malloc(out_size);
+	long float_size, int_size;
+	size_t i, worse = 0;
+
+	fill_sine(chains[c].format, src, chains[c].channels, chains[c].rate);
+	float_size = play_chain(c, 1, src, float_out, out_size);
+	int_size = play_chain(c, 0, src, int_out, out_size);
+	if (float_size <= 0 || float_size != int_size ||
+	    float_size % (chains[c].slave_channels * slave_bytes)) {
+		fprintf(stderr, "chain %u: %ld and %ld bytes\n", c, float_size, int_size);
+		any_test_failed = 1;
+		goto out;
+	}
+	for (i = 0; i < float_size / slave_bytes; i++)
+		if (fabs(get_sample(chains[c].slave_format, float_out, i) -
+			 get_sample(chains[c].slave_format, int_out, i)) > TOLERANCE)
+			worse++;
+	if (worse) {
+		fprintf(stderr, "chain %u: %zu samples off by more than 1 LSB\n", c, worse);
+		any_test_failed = 1;
+	}
+ out:
+	free(int_out);
+	free(float_out);
+	free(src);
+}
+
+/* the float sum of a destination, stored as the route plugin does */
+static void ref_mix(snd_pcm_format_t format, const unsigned char *frame,
+		    snd_pcm_format_t slave_format, unsigned char *out, unsigned int dst)
+{
+	const struct entry *e;
+	unsigned int c;
+	float sum = 0;
+	double v;
+
+	for (c = 0; c < ROUTE_CHANNELS; c++)
+		for (e = ttable; e->gain != 0; e++) {
+			if (e->src != c || e->dst != dst)
+				continue;
+			if (format == SND_PCM_FORMAT_FLOAT_LE)
+				sum += ((const float *)frame)[c] * e->gain;
+			else if (format == SND_PCM_FORMAT_S16_LE)
+				sum += (float)((int32_t)((uint32_t)((const int16_t *)frame)[c] << 16) *
+					       (1.0 / 2147483648.0)) * e->gain;
+			else
+				sum += (float)(((const int32_t *)frame)[c] *
+					       (1.0 / 2147483648.0)) * e->gain;
+		}
+	if (slave_format == SND_PCM_FORMAT_FLOAT_LE) {
+		memcpy(out, &sum, sizeof(sum));
+		return;
+	}
+	v = rint(sum * 2147483648.0);
+	if (v > 2147483647.0)
+		v = 2147483647.0;
+	else if (v < -2147483648.0)
+		v = -2147483648.0;
+	if (slave_format == SND_PCM_FORMAT_S16_LE) {
+		int16_t s = (int32_t)v >> 16;
+		memcpy(out, &s, sizeof(s));
+	} else {
+		int32_t s = v;
+		memcpy(out, &s, sizeof(s));
+	}
+}
+
+static void test_route(unsigned int r, int layout)
+{
+	snd_pcm_format_t format = routes[r].format, slave_format = routes[r].slave_format;
+	size_t bytes = snd_pcm_format_physical_width(format) / 8;
+	size_t slave_bytes = snd_pcm_format_physical_width(slave_format) / 8;
+	size_t out_size = (size_t)FRAMES * ROUTE_SLAVE_CHANNELS * slave_bytes;
+	unsigned char *src = malloc((size_t)FRAMES * ROUTE_CHANNELS * bytes);
+	unsigned char *ref = malloc(out_size);
+	unsigned char *out = malloc(out_size + 1);
+	const struct entry *e;
+	char text[256];
+	snd_pcm_t *pcm;
+	unsigned int f, d;
+	int len = 0;
+	long size = -1;
+
+	fill(format, src, (size_t)FRAMES * ROUTE_CHANNELS);
+	for (f = 0; f < FRAMES; f++)
+		for (d = 0; d < ROUTE_SLAVE_CHANNELS; d++)
+			ref_mix(format, src + f * ROUTE_CHANNELS * bytes, slave_format,
+				ref + (f * ROUTE_SLAVE_CHANNELS + d) * slave_bytes, d);
+	for (e = ttable; e->gain != 0; e++)
+		len += snprintf(text + len, sizeof(text) - len, " %u.%u %.9g",
+				e->src, e->dst, e->gain);
+	if (test_pcm_open(&pcm, "pcm.test { type route slave { format %s channels %u"
+			  " pcm out } ttable {%s } }", snd_pcm_format_name(slave_format),
+			  ROUTE_SLAVE_CHANNELS, text) >= 0) {
+		if (test_pcm_setup(pcm, test_access(layout), format, ROUTE_CHANNELS,
+				   48000, PERIOD_SIZE, BUFFER_SIZE) >= 0)
+			test_pcm_write(pcm, format, ROUTE_CHANNELS, layout, src,
+				       FRAMES, CHUNK, NULL);
+		snd_pcm_close(pcm);
+		size = test_out_read(out, out_size + 1);
+	}
+	if (size != (long)out_size || memcmp(out, ref, out_size)) {
+		fprintf(stderr, "route %s -> %s, layout %d: wrong output\n",
+			snd_pcm_format_name(format), snd_pcm_format_name(slave_format),
+			layout);
+		any_test_failed = 1;
+	}
+	free(out);
+	free(ref);
+	free(src);
+}
+
+static void test_all(void)
+{
+	unsigned int i;
+	int layout;
+
+	for (i = 0; i < sizeof(chains) / sizeof(chains[0]); i++)
+		test_chain(i);
+	for (i = 0; i < sizeof(routes) / sizeof(routes[0]); i++)
+		for (layout = 0; layout < LAYOUTS; layout++)
+			test_route(i, layout);
+}
+
+int main(void)
+{
+	int fd;
+
+	/* skipped without the dummy control */
+	if (access(DUMMY_CTL_LIB, R_OK) < 0)
+		return 77;
+	fd = mkstemp(config_path);
+	if (fd < 0)
+		return 1;
+	if (write(fd, config, strlen(config)) != (ssize_t)strlen(config)) {
+		close(fd);
+		unlink(config_path);
+		return 1;
+	}
+	close(fd);
+	setenv("ALSA_CONFIG_PATH", config_path, 1);
+	if (test_out_create() < 0) {
+		unlink(config_path);
+		return 1;
+	}
+	test_simd_levels(test_all);
+	unlink(test_out_path);
+	unlink(config_path);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,249 @@
+#include <stdint.h>
+#include "pcm_test.h"
+
+/*
+ * The linear rate converter on S16, S32 and FLOAT streams against a
+ * sample by sample reference of its interpolation, period by period as
+ * the rate plugin calls it.  Interleaved streams with four channels or
+ * more go through the frame path, the other ones through the per channel
+ * loops: both give the same output, integer samples are truncated.  The
+ * rates go up and down, with interleaved, misaligned interleaved and
+ * non-interleaved client buffers, and with each $LIBASOUND_SIMD level.
+ * The converted data is captured by the file plugin.
+ */
+
+#define MAX_CHANNELS	21
+#define PERIODS		16
+#define CHUNK		97		/* odd lengths, across the periods */
+#define BUFFER_SIZE	256
+#define PERIOD_SIZE	64
+
+/* from pcm_rate_linear.c */
+#define LINEAR_DIV_SHIFT	19
+#define LINEAR_DIV		(1 << LINEAR_DIV_SHIFT)
+
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S16,
+	SND_PCM_FORMAT_S32,
+	SND_PCM_FORMAT_FLOAT,
+};
+
+static const unsigned int channels[] = { 2, 4, 5, 8, 11, 21 };
+
+static const struct {
+	unsigned int in, out;
+} rates[] = {
+	{ 44100, 48000 },
+	{ 8000, 44100 },	/* the weights are shifted */
+	{ 48000, 44100 },
+	{ 96000, 22050 },
+};
+
+static double ref_get(snd_pcm_format_t format, const void *buf, size_t i)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16:
+		return ((const int16_t *)buf)[i];
+	case SND_PCM_FORMAT_S32:
+		return ((const int32_t *)buf)[i];
+	default:
+		return ((const float *)buf)[i];
+	}
+}
+
+static void ref_put(snd_pcm_format_t format, void *buf, size_t i, double v)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16:
+		((int16_t *)buf)[i] = v;
+		break;
+	case SND_PCM_FORMAT_S32:
+		((int32_t *)buf)[i] = v;
+		break;
+	default:
+		((float *)buf)[i] = v;
+		break;
+	}
+}
+
+/* a weighted by 1 - w, b by w: 'w' in 16.16, 'fw' for FLOAT */
+static double ref_blend(snd_pcm_format_t format, double a, double b,
+			unsigned int w, float fw)
+{
+	float x = a;
+
+	switch (format) {
+	case SND_PCM_FORMAT_S16:
+		return ((int)a * (int)(0x10000 - w) + (int)b * (int)w) >> 16;
+	case SND_PCM_FORMAT_S32:
+		return ((int64_t)a * (0x10000 - w) + (int64_t)b * w) >> 16;
+	default:
+		return x + ((float)b - x) * fw;
+	}
+}
+
+static unsigned int muldiv_near(unsigned int a, unsigned int b, unsigned int c)
+{
+	uint64_t n = (uint64_t)a * b;
+	unsigned int q = n / c;
+
+	if (n % c >= (c + 1) / 2)
+		q++;
+	return q;
+}
+
+/* linear_adjust_pitch() */
+static unsigned int ref_pitch(unsigned int in_period, unsigned int out_period,
+			      unsigned int *shift)
+{
+	unsigned int pitch = muldiv_near(out_period, LINEAR_DIV, in_period);
+
+	while (muldiv_near(out_period, LINEAR_DIV, pitch) > in_period)
+		pitch++;
+	while (muldiv_near(out_period, LINEAR_DIV, pitch) < in_period)
+		pitch--;
+	*shift = 0;
+	if (pitch >= LINEAR_DIV)
+		while ((pitch >> *shift) >= (1 << 16))
+			(*shift)++;
+	return pitch;
+}
+
+/* one period, 'old' is the last input frame of an expansion */
+static void ref_period(snd_pcm_format_t format, unsigned int chans, int expand,
+		       unsigned int pitch, unsigned int shift, double *old,
+		       const void *src, unsigned int src_frames,
+		       void *dst, unsigned int dst_frames)
+{
+	float scale = 1.0 / pitch;
+	unsigned int c, s, d, pos, w;
+	double prev, cur;
+
+	for (c = 0; c < chans; c++) {
+		if (expand) {
+			prev = 0;
+			cur = old[c];
+			pos = pitch;
+			for (d = 0, s = 0; d < dst_frames; d++) {
+				if (pos >= pitch) {
+					pos -= pitch;
+					prev = cur;
+					if (s < src_frames)
+						cur = ref_get(format, src, s * chans + c);
+				}
+				w = (pos << (16 - shift)) / (pitch >> shift);
+				ref_put(format, dst, d * chans + c,
+					ref_blend(format, prev, cur, w, pos * scale));
+				pos += LINEAR_DIV;
+				if (pos >= pitch)
+					s++;
+			}
+			old[c] = cur;
+		} else {
+			prev = 0;
+			pos = LINEAR_DIV - pitch;
+			for (s = 0, d = 0; s < src_frames && d < dst_frames; s++) {
+				cur = ref_get(format, src, s * chans + c);
+				pos += pitch;
+				if (pos >= LINEAR_DIV) {
+					pos -= LINEAR_DIV;
+					w = (pos << (32 - LINEAR_DIV_SHIFT)) /
+						(pitch >> (LINEAR_DIV_SHIFT - 16));
+					ref_put(format, dst, d++ * chans + c,
+						ref_blend(format, cur, prev, w, pos * scale));
+				}
+				prev = cur;
+			}
+		}
+	}
+}
+
+static void test_rate(snd_pcm_format_t format, unsigned int chans,
+		      unsigned int r, int layout)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	size_t frame_bytes = (size_t)chans * bytes;
+	int expand = rates[r].in < rates[r].out;
+	snd_pcm_uframes_t buffer_size, period_size, out_period;
+	unsigned int in_frames, out_frames, pitch, shift, p, i;
+	double old[MAX_CHANNELS];
+	unsigned char *src, *ref, *out;
+	size_t out_size;
+	snd_pcm_t *pcm;
+	long size;
+
+	if (test_pcm_open(&pcm, "pcm.test { type rate converter \"linear\""
+			  " slave { rate %u pcm out } }", rates[r].out) < 0)
+		return;
+	if (test_pcm_setup(pcm, test_access(layout), format, chans, rates[r].in,
+			   PERIOD_SIZE, BUFFER_SIZE) < 0 ||
+	    ALSA_CHECK(snd_pcm_get_params(pcm, &buffer_size, &period_size)) < 0) {
+		snd_pcm_close(pcm);
+		return;
+	}
+	/* whole periods, a partial one is converted only by a drain */
+	in_frames = PERIODS * period_size;
+	out_size = (size_t)in_frames * frame_bytes * 8;
+	src = malloc(in_frames * frame_bytes);
+	ref = calloc(1, out_size);
+	out = malloc(out_size);
+	/* random data reaches the extremes of the integer formats */
+	for (i = 0; i < in_frames * chans; i++) {
+		if (format == SND_PCM_FORMAT_FLOAT)
+			((float *)src)[i] = rand() / (RAND_MAX / 2.0) - 1.0;
+		else if (format == SND_PCM_FORMAT_S32)
+			((int32_t *)src)[i] = (uint32_t)rand() << 16 ^ rand();
+		else
+			((int16_t *)src)[i] = rand();
+	}
+	test_pcm_write(pcm, format, chans, layout, src, in_frames, CHUNK, NULL);
+	snd_pcm_close(pcm);
+	size = test_out_read(out, out_size);
+	out_frames = size > 0 ? size / frame_bytes : 0;
+	out_period = out_frames / PERIODS;
+	if (size <= 0 || size % frame_bytes || out_frames % PERIODS) {
+		fprintf(stderr, "%s, %u channels, %u -> %u, layout %d: %ld bytes\n",
+			snd_pcm_format_name(format), chans, rates[r].in, rates[r].out,
+			layout, size);
+		any_test_failed = 1;
+		goto out;
+	}
+
+	pitch = ref_pitch(period_size, out_period, &shift);
+	memset(old, 0, sizeof(old));
+	for (p = 0; p < PERIODS; p++)
+		ref_period(format, chans, expand, pitch, shift, old,
+			   src + p * period_size * frame_bytes, period_size,
+			   ref + p * out_period * frame_bytes, out_period);
+	if (memcmp(out, ref, out_frames * frame_bytes)) {
+		fprintf(stderr, "%s, %u channels, %u -> %u, layout %d: wrong output\n",
+			snd_pcm_format_name(format), chans, rates[r].in, rates[r].out,
+			layout);
+		any_test_failed = 1;
+	}
+ out:
+	free(out);
+	free(ref);
+	free(src);
+}
+
+static void test_all(void)
+{
+	unsigned int i, j, r;
+	int layout;
+
+	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+		for (j = 0; j < sizeof(channels) / sizeof(channels[0]); j++)
+			for (r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+				for (layout = 0; layout < LAYOUTS; layout++)
+					test_rate(formats[i], channels[j], r, layout);
+}
+
+int main(void)
+{
+	if (test_out_create() < 0)
+		return 1;
+	test_simd_levels(test_all);
+	unlink(test_out_path);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,285 @@
+#include <stdint.h>
+#include <math.h>
+#include <sys/mman.h>
+#include "pcm_test.h"
+
+/*
+ * The sinc_fast, sinc and sinc_best rate converters on FLOAT streams:
+ * 44.1k -> 48k and 48k -> 96k with a filter for each of their 160 and 2
+ * phases, a ratio with more phases than the bank whose filters are
+ * blended, and two downsampling ones with longer filters at a lower
+ * cutoff.  The dump must show the bank, a tone on the first channel must
+ * come out clean, and on downsampling a tone above the new Nyquist
+ * frequency on the second channel must be filtered out.  The output of
+ * each $LIBASOUND_SIMD level is compared with the generic one, within
+ * the rounding of their different summation orders.  The converted data
+ * is captured by the file plugin.
+ */
+
+#define CHANNELS	2
+#define PERIODS		24
+#define MAX_OUT		(PERIODS * 2400)	/* frames */
+#define TONE		997.0		/* Hz, in every pass band */
+#define AMPLITUDE	0.5
+#define SIMD_TOLERANCE	1e-5
+
+/* from pcm_rate_sinc.c */
+#define SINC_MAX_PHASES	512
+#define SINC_MAX_TAPS	1024
+
+static const struct {
+	const char *name;
+	unsigned int taps;		/* without downsampling */
+	unsigned int phases;		/* of a blended bank */
+	double snr;			/* dB, at least */
+	double stopband;		/* dB, at most */
+} qualities[] = {
+	{ "sinc_fast", 32, 64, 70, -60 },
+	{ "sinc", 64, 128, 95, -85 },
+	{ "sinc_best", 128, 256, 115, -110 },
+};
+
+static const struct {
+	unsigned int in, out;
+	unsigned int period;		/* of the client */
+	double alias;			/* Hz, a tone above the new Nyquist, or 0 */
+} rates[] = {
+	{ 44100, 48000, 441, 0 },	/* 147 -> 160 */
+	{ 48000, 96000, 480, 0 },	/* 1 -> 2 */
+	{ 22050, 48000, 1021, 0 },	/* 1021 -> 2223, blended */
+	{ 48000, 44100, 480, 23500 },	/* 160 -> 147 */
+	{ 96000, 32000, 300, 20000 },	/* 3 -> 1 */
+};
+
+#define QUALITIES	(sizeof(qualities) / sizeof(qualities[0]))
+#define RATES		(sizeof(rates) / sizeof(rates[0]))
+
+/* the output of LIBASOUND_SIMD=none, shared with the other levels */
+static float *generic;
+static long (*generic_frames)[RATES];
+
+static unsigned int gcd(unsigned int a, unsigned int b)
+{
+	while (b) {
+		unsigned int r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+/* the bank of sinc_init() for these periods */
+static void ref_bank(unsigned int q, unsigned int in_period,
+		     unsigned int out_period, unsigned int *taps,
+		     unsigned int *phases)
+{
+	unsigned int g = gcd(in_period, out_period);
+	unsigned int in = in_period / g, out = out_period / g;
+
+	*taps = qualities[q].taps;
+	if (in > out) {
+		*taps = ((uint64_t)*taps * in + out - 1) / out;
+		if (*taps > SINC_MAX_TAPS)
+			*taps = SINC_MAX_TAPS;
+	}
+	*taps = (*taps + 7) & ~7U;
+	*phases = out <= SINC_MAX_PHASES ? out : qualities[q].phases;
+}
+
+/* the taps, phases and bank kind of the dump */
+static int dump_bank(snd_pcm_t *pcm, unsigned int *taps, unsigned int *phases,
+		     char *kind)
+{
+	snd_output_t *out;
+	const char *text, *line;
+	int found = 0;
+
+	if (ALSA_CHECK(snd_output_buffer_open(&out)) < 0)
+		return 0;
+	snd_pcm_dump(pcm, out);
+	snd_output_buffer_string(out, (char **)&text);
+	for (line = text; line && !found; line = strchr(line, '\n')) {
+		if (*line == '\n')
+			line++;
+		found = sscanf(line, " %u taps, %u phases (%15[a-z])",
+			       taps, phases, kind) == 3;
+	}
+	snd_output_close(out);
+	return found;
+}
+
+/*
+ * Power of what is left of the samples after removing the best fitting
+ * tone at 'freq', and of that tone, from 'skip' on.
+ */
+static void fit_tone(const float *buf, unsigned int channel, unsigned int frames,
+		     unsigned int skip, double freq, double rate,
+		     double *signal, double *noise)
+{
+	double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0, a, b, det, e;
+	unsigned int i;
+
+	for (i = skip; i < frames; i++) {
+		double w = 2 * M_PI * freq * i / rate;
+		double y = buf[i * CHANNELS + channel];
+		ss += sin(w) * sin(w);
+		cc += cos(w) * cos(w);
+		sc += sin(w) * cos(w);
+		ys += y * sin(w);
+		yc += y * cos(w);
+	}
+	det = ss * cc - sc * sc;
+	a = (ys * cc - yc * sc) / det;
+	b = (yc * ss - ys * sc) / det;
+	*signal = *noise = 0;
+	for (i = skip; i < frames; i++) {
+		double w = 2 * M_PI * freq * i / rate;
+		double t = a * sin(w) + b * cos(w);
+		e = buf[i * CHANNELS + channel] - t;
+		*signal += t * t;
+		*noise += e * e;
+	}
+}
+
+static void test_rate(unsigned int q, unsigned int r, const char *level)
+{
+	size_t frame_bytes = CHANNELS * sizeof(float);
+	snd_pcm_uframes_t buffer_size, period_size;
+	unsigned int in_frames, out_frames, out_period, i;
+	unsigned int taps, phases, ref_taps, ref_phases;
+	double signal, noise, snr, alias;
+	float *src, *out, *ref;
+	char kind[16];
+	snd_pcm_t *pcm;
+	long size;
+
+	if (test_pcm_open(&pcm, "pcm.test { type rate converter \"%s\""
+			  " slave { rate %u pcm out } }", qualities[q].name,
+			  rates[r].out) < 0)
+		return;
+	if (test_pcm_setup(pcm, SND_PCM_ACCESS_RW_INTERLEAVED, SND_PCM_FORMAT_FLOAT,
+			   CHANNELS, rates[r].in, rates[r].period,
+			   rates[r].period * 4) < 0 ||
+	    ALSA_CHECK(snd_pcm_get_params(pcm, &buffer_size, &period_size)) < 0) {
+		snd_pcm_close(pcm);
+		return;
+	}
+	if (!dump_bank(pcm, &taps, &phases, kind)) {
+		fprintf(stderr, "%s, %u -> %u: no bank in the dump\n",
+			qualities[q].name, rates[r].in, rates[r].out);
+		any_test_failed = 1;
+		snd_pcm_close(pcm);
+		return;
+	}
+	/* whole periods, a partial one is converted only by a drain */
+	in_frames = PERIODS * period_size;
+	src = malloc(in_frames * frame_bytes);
+	out = malloc(MAX_OUT * frame_bytes);
+	for (i = 0; i < in_frames; i++) {
+		double t = (double)i / rates[r].in;
+		src[i * CHANNELS] = AMPLITUDE * sin(2 * M_PI * TONE * t);
+		src[i * CHANNELS + 1] = AMPLITUDE *
+			sin(2 * M_PI * (rates[r].alias ? rates[r].alias : 3 * TONE) * t);
+	}
+	test_pcm_write(pcm, SND_PCM_FORMAT_FLOAT, CHANNELS, INTERLEAVED,
+		       (const unsigned char *)src, in_frames, period_size, NULL);
+	snd_pcm_close(pcm);
+	size = test_out_read((unsigned char *)out, MAX_OUT * frame_bytes);
+	out_frames = size > 0 ? size / frame_bytes : 0;
+	out_period = out_frames / PERIODS;
+	if (size <= 0 || size % frame_bytes || out_frames % PERIODS) {
+		fprintf(stderr, "%s, %u -> %u: %ld bytes\n", qualities[q].name,
+			rates[r].in, rates[r].out, size);
+		any_test_failed = 1;
+		goto out;
+	}
+
+	/* a filter per phase, or blended ones of the quality */
+	ref_bank(q, period_size, out_period, &ref_taps, &ref_phases);
+	if (taps != ref_taps || phases != ref_phases ||
+	    strcmp(kind, ref_phases == out_period / gcd(period_size, out_period) ?
+		   "exact" : "interpolated")) {
+		fprintf(stderr, "%s, %u -> %u: %u taps, %u phases (%s), not %u, %u\n",
+			qualities[q].name, rates[r].in, rates[r].out, taps, phases,
+			kind, ref_taps, ref_phases);
+		any_test_failed = 1;
+	}
+
+	/* past the delay of the filter, which starts on silence */
+	/* at the rate of the periods, 48009.3 Hz for 1021 -> 2223 */
+	fit_tone(out, 0, out_frames, 4 * taps, TONE,
+		 (double)rates[r].in * out_period / period_size, &signal, &noise);
+	snr = 10 * log10(signal / noise);
+	if (snr < qualities[q].snr) {
+		fprintf(stderr, "%s, %u -> %u: SNR %.1f dB\n", qualities[q].name,
+			rates[r].in, rates[r].out, snr);
+		any_test_failed = 1;
+	}
+	if (rates[r].alias) {
+		noise = 0;
+		for (i = 4 * taps; i < out_frames; i++)
+			noise += (double)out[i * CHANNELS + 1] * out[i * CHANNELS + 1];
+		alias = 10 * log10(noise / (out_frames - 4 * taps) /
+				   (AMPLITUDE * AMPLITUDE / 2));
+		if (alias > qualities[q].stopband) {
+			fprintf(stderr, "%s, %u -> %u: %.0f Hz at %.1f dB\n",
+				qualities[q].name, rates[r].in, rates[r].out,
+				rates[r].alias, alias);
+			any_test_failed = 1;
+		}
+	}
+
+	/* every level sums the same products */
+	ref = generic + (q * RATES + r) * MAX_OUT * CHANNELS;
+	if (!strcmp(level, "none")) {
+		memcpy(ref, out, out_frames * frame_bytes);
+		generic_frames[q][r] = out_frames;
+	} else if (generic_frames[q][r] != (long)out_frames) {
+		fprintf(stderr, "%s, %u -> %u: %u frames, not %ld\n",
+			qualities[q].name, rates[r].in, rates[r].out, out_frames,
+			generic_frames[q][r]);
+		any_test_failed = 1;
+	} else {
+		for (i = 0; i < out_frames * CHANNELS; i++)
+			if (fabs(out[i] - ref[i]) > SIMD_TOLERANCE)
+				break;
+		if (i < out_frames * CHANNELS) {
+			fprintf(stderr, "%s, %u -> %u: frame %u differs from the generic one\n",
+				qualities[q].name, rates[r].in, rates[r].out,
+				i / CHANNELS);
+			any_test_failed = 1;
+		}
+	}
+ out:
+	free(out);
+	free(src);
+}
+
+static void test_all(void)
+{
+	const char *level = getenv("LIBASOUND_SIMD");
+	unsigned int q, r;
+
+	for (q = 0; q < QUALITIES; q++)
+		for (r = 0; r < RATES; r++)
+			test_rate(q, r, level ? level : "");
+}
+
+int main(void)
+{
+	size_t samples = QUALITIES * RATES * MAX_OUT * CHANNELS;
+	size_t size = samples * sizeof(float) + QUALITIES * sizeof(*generic_frames);
+
+	/* the levels run in children, "none" first */
+	generic = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (generic == MAP_FAILED)
+		return 1;
+	generic_frames = (long (*)[RATES])(generic + samples);
+	if (test_out_create() < 0)
+		return 1;
+	test_simd_levels(test_all);
+	unlink(test_out_path);
+	munmap(generic, size);
+	return TEST_EXIT_CODE();
+}
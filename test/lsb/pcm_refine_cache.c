@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+/*
+ * hw_params refine cache: reopening and configuring the same chain the
+ * same way is answered from the cache, gives the same setup, and a flush
+ * makes the next run walk the chain again.  A stale hit rejected by
+ * hw_params drops that entry alone, and the refine is done again.
+ */
+
+static const char chain[] =
+	"pcm.cached { type plug slave { pcm { type null } rate 48000 } }";
+
+/* the same identity over one or two channels, in the same generation */
+static const char wide[] =
+	"pcm.stale { type linear slave { pcm inner format S32_LE } }\n"
+	"pcm.inner { type null }";
+static const char narrow[] =
+	"pcm.stale { type linear slave { pcm inner format S32_LE } }\n"
+	"pcm.inner { type multi slaves.a { pcm { type null } channels 2 }"
+	" bindings { 0 { slave a channel 0 } 1 { slave a channel 1 } } }";
+
+struct setup {
+	snd_pcm_format_t format;
+	unsigned int channels, rate;
+	snd_pcm_uframes_t period_size, buffer_size;
+};
+
+static int open_chain(snd_pcm_t **pcmp, const char *name, const char *text)
+{
+	snd_config_t *conf;
+	snd_input_t *in;
+	int err;
+
+	if (ALSA_CHECK(snd_config_top(&conf)) < 0)
+		return -1;
+	ALSA_CHECK(snd_input_buffer_open(&in, text, strlen(text)));
+	ALSA_CHECK(snd_config_load(conf, in));
+	snd_input_close(in);
+	err = ALSA_CHECK(snd_pcm_open_lconf(pcmp, name, SND_PCM_STREAM_PLAYBACK,
+					    0, conf));
+	snd_config_delete(conf);
+	return err;
+}
+
+static int open_and_configure(struct setup *setup)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_hw_params_t *params;
+	snd_pcm_uframes_t size = 1024;
+	unsigned int rate = 44100;
+	int err;
+
+	err = open_chain(&pcm, "cached", chain);
+	if (err < 0)
+		return err;
+
+	snd_pcm_hw_params_alloca(&params);
+	ALSA_CHECK(snd_pcm_hw_params_any(pcm, params));
+	ALSA_CHECK(snd_pcm_hw_params_set_access(pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED));
+	ALSA_CHECK(snd_pcm_hw_params_set_format(pcm, params, SND_PCM_FORMAT_S16_LE));
+	ALSA_CHECK(snd_pcm_hw_params_set_channels(pcm, params, 2));
+	ALSA_CHECK(snd_pcm_hw_params_set_rate_near(pcm, params, &rate, NULL));
+	ALSA_CHECK(snd_pcm_hw_params_set_period_size_near(pcm, params, &size, NULL));
+	err = ALSA_CHECK(snd_pcm_hw_params(pcm, params));
+
+	memset(setup, 0, sizeof(*setup));
+	snd_pcm_hw_params_get_format(params, &setup->format);
+	snd_pcm_hw_params_get_channels(params, &setup->channels);
+	snd_pcm_hw_params_get_rate(params, &setup->rate, NULL);
+	snd_pcm_hw_params_get_period_size(params, &setup->period_size, NULL);
+	snd_pcm_hw_params_get_buffer_size(params, &setup->buffer_size);
+	snd_pcm_close(pcm);
+	return err;
+}
+
+/* hw_params of the first configuration left, the channels or an error */
+static int open_and_choose(const char *name, const char *text)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_hw_params_t *params;
+	snd_pcm_uframes_t size = 1024;
+	unsigned int channels = 0;
+	int err;
+
+	if (open_chain(&pcm, name, text) < 0)
+		return -1;
+	snd_pcm_hw_params_alloca(&params);
+	ALSA_CHECK(snd_pcm_hw_params_any(pcm, params));
+	ALSA_CHECK(snd_pcm_hw_params_set_access(pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED));
+	ALSA_CHECK(snd_pcm_hw_params_set_format(pcm, params, SND_PCM_FORMAT_S16_LE));
+	ALSA_CHECK(snd_pcm_hw_params_set_rate(pcm, params, 48000, 0));
+	ALSA_CHECK(snd_pcm_hw_params_set_period_size_near(pcm, params, &size, NULL));
+	err = snd_pcm_hw_params(pcm, params);
+	if (err >= 0)
+		snd_pcm_hw_params_get_channels(params, &channels);
+	snd_pcm_close(pcm);
+	return err < 0 ? err : (int)channels;
+}
+
+static void test_stale(void)
+{
+	unsigned long hits0, misses0, hits1, misses1;
+
+	/*
+	 * the slave lost a channel: the replayed refine lets one channel
+	 * be chosen, hw_params rejects it, and the refine is done again
+	 */
+	TEST_CHECK(open_and_choose("stale", wide) == 1);
+	TEST_CHECK(open_and_choose("stale", wide) == 1);
+	snd_pcm_refine_cache_stats(&hits0, &misses0);
+	TEST_CHECK(open_and_choose("stale", narrow) == 2);
+	snd_pcm_refine_cache_stats(&hits1, &misses1);
+	TEST_CHECK(hits1 > hits0);
+	TEST_CHECK(misses1 > misses0);
+	/*
+	 * the new result is cached, the refines before it still hit the
+	 * stale entries of the same parameters, which were kept
+	 */
+	TEST_CHECK(open_and_choose("stale", narrow) == 2);
+	snd_pcm_refine_cache_stats(&hits0, &misses0);
+	TEST_CHECK(misses0 == misses1);
+}
+
+int main(void)
+{
+	struct setup first, again, flushed;
+	unsigned long hits0, misses0, hits1, misses1, hits2, misses2;
+
+	setenv("LIBASOUND_REFINE_CACHE", "1", 1);
+
+	open_and_configure(&first);
+	snd_pcm_refine_cache_stats(&hits0, &misses0);
+	TEST_CHECK(misses0 > 0);
+
+	/* the same sequence of refines again */
+	open_and_configure(&again);
+	snd_pcm_refine_cache_stats(&hits1, &misses1);
+	TEST_CHECK(hits1 > hits0);
+	TEST_CHECK(misses1 == misses0);
+	TEST_CHECK(!memcmp(&first, &again, sizeof(first)));
+
+	/* nothing is left to be hit after a flush */
+	TEST_CHECK(snd_pcm_refine_cache_flush() > 0);
+	TEST_CHECK(snd_pcm_refine_cache_flush() == 0);
+	open_and_configure(&flushed);
+	snd_pcm_refine_cache_stats(&hits2, &misses2);
+	TEST_CHECK(hits2 - hits1 == hits0);
+	TEST_CHECK(misses2 - misses1 == misses0);
+	TEST_CHECK(!memcmp(&first, &flushed, sizeof(first)));
+
+	TEST_CHECK(first.rate == 44100);
+	TEST_CHECK(first.channels == 2);
+
+	test_stale();
+
+	snd_config_update_free_global();
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,232 @@
+#include <stdint.h>
+#include <math.h>
+#include "pcm_test.h"
+
+/*
+ * Mixing of the route plugin between the 8 to 32-bit formats against a
+ * sample by sample reference of its float sums: the sources are added in
+ * channel order, the sum is rounded to the nearest integer and saturated,
+ * and a single source at full volume is a plain copy.  The ttables cover
+ * copies, silent destinations, unity and attenuated sums, gains above one
+ * and negative gains, with interleaved, misaligned interleaved and
+ * non-interleaved client buffers, and with each $LIBASOUND_SIMD level.
+ * The mixed data is captured by the file plugin.
+ */
+
+#define MAX_ENTRIES	40
+#define FRAMES		1001
+#define CHUNK		97		/* odd lengths for the kernels */
+#define BUFFER_SIZE	256
+#define PERIOD_SIZE	64
+
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S8,
+	SND_PCM_FORMAT_U8,
+	SND_PCM_FORMAT_S16_LE,
+	SND_PCM_FORMAT_S16_BE,
+	SND_PCM_FORMAT_U16_LE,
+	SND_PCM_FORMAT_U16_BE,
+	SND_PCM_FORMAT_S24_LE,
+	SND_PCM_FORMAT_S24_BE,
+	SND_PCM_FORMAT_U24_LE,
+	SND_PCM_FORMAT_U24_BE,
+	SND_PCM_FORMAT_S32_LE,
+	SND_PCM_FORMAT_S32_BE,
+	SND_PCM_FORMAT_U32_LE,
+	SND_PCM_FORMAT_U32_BE,
+	SND_PCM_FORMAT_S24_3LE,
+	SND_PCM_FORMAT_S24_3BE,
+	SND_PCM_FORMAT_U24_3LE,
+	SND_PCM_FORMAT_U24_3BE,
+};
+
+#define NUM_FORMATS	(sizeof(formats) / sizeof(formats[0]))
+
+/* the client channel, the slave channel and the gain */
+struct entry {
+	unsigned int src, dst;
+	float gain;
+};
+
+static const struct {
+	const char *name;
+	unsigned int channels, slave_channels;
+	struct entry entries[MAX_ENTRIES];	/* up to a zero gain */
+} ttables[] = {
+	{ "swap", 2, 2,
+	  { { 0, 1, 1.0 }, { 1, 0, 1.0 } } },
+	{ "downmix", 2, 1,
+	  { { 0, 0, 0.5 }, { 1, 0, 0.5 } } },
+	{ "unity sums", 4, 2,	/* saturate */
+	  { { 0, 0, 1.0 }, { 2, 0, 1.0 }, { 1, 1, 1.0 }, { 3, 1, 1.0 },
+	    { 0, 1, 1.0 } } },
+	{ "5.1 to stereo", 6, 2,
+	  { { 0, 0, 1.0 }, { 2, 0, 0.7071068 }, { 3, 0, 0.5 }, { 4, 0, 0.7071068 },
+	    { 1, 1, 1.0 }, { 2, 1, 0.7071068 }, { 3, 1, 0.5 }, { 5, 1, 0.7071068 } } },
+	{ "upmix", 3, 8,	/* copies, silence and shared sources */
+	  { { 0, 0, 1.0 }, { 1, 1, 1.0 }, { 0, 2, 0.3 }, { 1, 2, 0.3 },
+	    { 2, 2, 0.4 }, { 2, 4, 1.0 }, { 2, 5, 1.5 }, { 0, 6, -0.25 },
+	    { 1, 6, 1.0 }, { 0, 7, 1.0 } } },
+	{ "16 to 3", 16, 3,
+	  { { 0, 0, 0.125 }, { 1, 0, 0.2 }, { 2, 0, 0.05 }, { 3, 0, 0.1 },
+	    { 4, 0, 0.0625 }, { 5, 0, 0.3 }, { 6, 0, 0.15 }, { 7, 0, 0.01 },
+	    { 8, 1, 1.0 }, { 9, 1, 1.0 }, { 10, 1, 1.0 }, { 11, 1, 1.0 },
+	    { 12, 1, 1.0 }, { 13, 1, 1.0 }, { 14, 1, 1.0 }, { 15, 1, 1.0 },
+	    { 15, 2, 2.0 }, { 0, 2, -1.0 }, { 7, 2, 0.999 } } },
+};
+
+/* the sample as a signed, MSB aligned 32-bit value */
+static uint32_t ref_load(snd_pcm_format_t format, const unsigned char *p)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int width = snd_pcm_format_width(format);
+	uint32_t word = 0, v;
+	unsigned int b;
+
+	for (b = 0; b < bytes; b++)
+		word = (word << 8) |
+			p[snd_pcm_format_big_endian(format) ? b : bytes - 1 - b];
+	v = word << (32 - width);
+	if (snd_pcm_format_unsigned(format))
+		v ^= 0x80000000;
+	return v;
+}
+
+/* truncate to the format, the padding of 24-bit in 32 is the sign */
+static void ref_store(snd_pcm_format_t format, unsigned char *p, uint32_t v)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int width = snd_pcm_format_width(format);
+	uint32_t word;
+	unsigned int b;
+
+	if (snd_pcm_format_unsigned(format))
+		v ^= 0x80000000;
+	word = v >> (32 - width);
+	if (bytes * 8 > width && (word & (1U << (width - 1))))
+		word |= ~0U << width;
+	for (b = 0; b < bytes; b++)
+		p[snd_pcm_format_big_endian(format) ? bytes - 1 - b : b] = word >> (8 * b);
+}
+
+/* one destination sample of a frame */
+static void ref_mix(unsigned int t, unsigned int dst, snd_pcm_format_t format,
+		    const unsigned char *frame, snd_pcm_format_t slave_format,
+		    unsigned char *out)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	const struct entry *e, *first = NULL;
+	unsigned int c, n = 0;
+	float sum = 0;
+	double r;
+
+	/* the sources are added in channel order */
+	for (c = 0; c < ttables[t].channels; c++)
+		for (e = ttables[t].entries; e->gain != 0; e++) {
+			if (e->src != c || e->dst != dst)
+				continue;
+			if (!n++)
+				first = e;
+			sum += (float)(int32_t)ref_load(format, frame + c * bytes) * e->gain;
+		}
+	if (!n) {
+		snd_pcm_format_set_silence(slave_format, out, 1);
+	} else if (n == 1 && first->gain == 1.0) {
+		ref_store(slave_format, out, ref_load(format, frame + first->src * bytes));
+	} else {
+		r = rint(sum);
+		if (r >= 2147483648.0)
+			ref_store(slave_format, out, 0x7fffffff);
+		else if (r < -2147483648.0)
+			ref_store(slave_format, out, 0x80000000);
+		else
+			ref_store(slave_format, out, (int32_t)r);
+	}
+}
+
+/* play the interleaved 'src' in the given layout, return the file size */
+static long play(snd_pcm_format_t format, snd_pcm_format_t slave_format,
+		 unsigned int t, int layout, const unsigned char *src,
+		 unsigned char *out, size_t out_size)
+{
+	unsigned int channels = ttables[t].channels;
+	const struct entry *e;
+	char ttable[1024];
+	snd_pcm_t *pcm;
+	int len = 0;
+
+	for (e = ttables[t].entries; e->gain != 0; e++)
+		len += snprintf(ttable + len, sizeof(ttable) - len, " %u.%u %.9g",
+				e->src, e->dst, e->gain);
+	if (test_pcm_open(&pcm, "pcm.test { type route slave { format %s channels %u"
+			  " pcm out } ttable {%s } }", snd_pcm_format_name(slave_format),
+			  ttables[t].slave_channels, ttable) < 0)
+		return -1;
+	if (test_pcm_setup(pcm, test_access(layout), format, channels, 48000,
+			   PERIOD_SIZE, BUFFER_SIZE) < 0) {
+		snd_pcm_close(pcm);
+		return -1;
+	}
+	test_pcm_write(pcm, format, channels, layout, src, FRAMES, CHUNK, NULL);
+	snd_pcm_close(pcm);
+	return test_out_read(out, out_size);
+}
+
+static void test_mix(snd_pcm_format_t format, snd_pcm_format_t slave_format,
+		     unsigned int t, int layout)
+{
+	unsigned int channels = ttables[t].channels;
+	unsigned int slave_channels = ttables[t].slave_channels;
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int slave_bytes = snd_pcm_format_physical_width(slave_format) / 8;
+	size_t in_size = (size_t)FRAMES * channels * bytes;
+	size_t out_size = (size_t)FRAMES * slave_channels * slave_bytes;
+	unsigned char *src = malloc(in_size);
+	unsigned char *ref = malloc(out_size);
+	unsigned char *out = malloc(out_size + 1);
+	unsigned int f, d;
+	size_t i;
+	long size;
+
+	/* random data reaches the extremes of every format */
+	for (i = 0; i < in_size; i++)
+		src[i] = rand();
+	for (f = 0; f < FRAMES; f++)
+		for (d = 0; d < slave_channels; d++)
+			ref_mix(t, d, format, src + f * channels * bytes, slave_format,
+				ref + (f * slave_channels + d) * slave_bytes);
+	size = play(format, slave_format, t, layout, src, out, out_size + 1);
+	if (size != (long)out_size || memcmp(out, ref, out_size)) {
+		fprintf(stderr, "%s -> %s, %s, layout %d: wrong output\n",
+			snd_pcm_format_name(format), snd_pcm_format_name(slave_format),
+			ttables[t].name, layout);
+		any_test_failed = 1;
+	}
+	free(out);
+	free(ref);
+	free(src);
+}
+
+static void test_all(void)
+{
+	unsigned int i, t;
+	int layout;
+
+	/* each format in, to itself and to another one */
+	for (i = 0; i < NUM_FORMATS; i++)
+		for (t = 0; t < sizeof(ttables) / sizeof(ttables[0]); t++)
+			for (layout = 0; layout < LAYOUTS; layout++) {
+				test_mix(formats[i], formats[i], t, layout);
+				test_mix(formats[i], formats[(i + 5) % NUM_FORMATS],
+					 t, layout);
+			}
+}
+
+int main(void)
+{
+	if (test_out_create() < 0)
+		return 1;
+	test_simd_levels(test_all);
+	unlink(test_out_path);
+	return TEST_EXIT_CODE();
+}
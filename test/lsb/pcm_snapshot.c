@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "test.h"
+#include <alsa/pcm_ioplug.h>
+
+/*
+ * snd_pcm_snapshot() against snd_pcm_status() and snd_pcm_delay() on an
+ * ioplug sink whose hardware position is moved by the test, and the
+ * consistency of the snapshots read by a second thread while the stream
+ * is written.
+ */
+
+#define BUFFER_SIZE	1024
+#define PERIOD_SIZE	256
+
+static snd_pcm_uframes_t played;	/* hw position set by the test */
+static volatile int done;
+
+static int sink_start(snd_pcm_ioplug_t *io ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int sink_stop(snd_pcm_ioplug_t *io ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static snd_pcm_sframes_t sink_pointer(snd_pcm_ioplug_t *io)
+{
+	return played % io->buffer_size;
+}
+
+static snd_pcm_sframes_t sink_transfer(snd_pcm_ioplug_t *io ATTRIBUTE_UNUSED,
+				       const snd_pcm_channel_area_t *areas ATTRIBUTE_UNUSED,
+				       snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
+				       snd_pcm_uframes_t size)
+{
+	return size;
+}
+
+static const snd_pcm_ioplug_callback_t sink_callback = {
+	.start = sink_start,
+	.stop = sink_stop,
+	.pointer = sink_pointer,
+	.transfer = sink_transfer,
+};
+
+static snd_pcm_ioplug_t sink = {
+	.version = SND_PCM_IOPLUG_VERSION,
+	.name = "snapshot test sink",
+	.poll_events = POLLOUT,
+	.callback = &sink_callback,
+};
+
+static int open_sink(snd_pcm_t **pcmp, int fd)
+{
+	snd_pcm_hw_params_t *params;
+	snd_pcm_sw_params_t *swparams;
+	int err;
+
+	sink.poll_fd = fd;
+	err = ALSA_CHECK(snd_pcm_ioplug_create(&sink, "snapshot",
+					       SND_PCM_STREAM_PLAYBACK,
+					       SND_PCM_NONBLOCK));
+	if (err < 0)
+		return err;
+	snd_pcm_ioplug_set_param_minmax(&sink, SND_PCM_IOPLUG_HW_CHANNELS, 2, 2);
+	snd_pcm_ioplug_set_param_minmax(&sink, SND_PCM_IOPLUG_HW_RATE, 48000, 48000);
+	snd_pcm_ioplug_set_param_minmax(&sink, SND_PCM_IOPLUG_HW_BUFFER_BYTES,
+					BUFFER_SIZE * 4, BUFFER_SIZE * 4);
+	snd_pcm_ioplug_set_param_minmax(&sink, SND_PCM_IOPLUG_HW_PERIOD_BYTES,
+					PERIOD_SIZE * 4, PERIOD_SIZE * 4);
+	*pcmp = sink.pcm;
+
+	snd_pcm_hw_params_alloca(&params);
+	snd_pcm_sw_params_alloca(&swparams);
+	ALSA_CHECK(snd_pcm_hw_params_any(*pcmp, params));
+	ALSA_CHECK(snd_pcm_hw_params_set_access(*pcmp, params, SND_PCM_ACCESS_RW_INTERLEAVED));
+	ALSA_CHECK(snd_pcm_hw_params_set_format(*pcmp, params, SND_PCM_FORMAT_S16_LE));
+	err = ALSA_CHECK(snd_pcm_hw_params(*pcmp, params));
+	if (err < 0)
+		return err;
+	/* started by the test */
+	ALSA_CHECK(snd_pcm_sw_params_current(*pcmp, swparams));
+	ALSA_CHECK(snd_pcm_sw_params_set_start_threshold(*pcmp, swparams, BUFFER_SIZE * 2));
+	ALSA_CHECK(snd_pcm_sw_params_set_stop_threshold(*pcmp, swparams, BUFFER_SIZE * 2));
+	return ALSA_CHECK(snd_pcm_sw_params(*pcmp, swparams));
+}
+
+/* compare the snapshot with what snd_pcm_status() and snd_pcm_delay() say */
+static void check_status(snd_pcm_t *pcm, snd_pcm_state_t state,
+			 snd_pcm_uframes_t avail)
+{
+	snd_pcm_status_t *status;
+	snd_pcm_state_t snap_state;
+	snd_pcm_uframes_t snap_avail;
+	snd_pcm_sframes_t snap_delay, delay;
+
+	snd_pcm_status_alloca(&status);
+	ALSA_CHECK(snd_pcm_status(pcm, status));
+	ALSA_CHECK(snd_pcm_snapshot(pcm, &snap_state, &snap_avail, &snap_delay, NULL));
+	TEST_CHECK(snd_pcm_status_get_state(status) == state);
+	TEST_CHECK(snd_pcm_status_get_avail(status) == avail);
+	TEST_CHECK(snap_state == state);
+	TEST_CHECK(snap_avail == avail);
+	TEST_CHECK(snap_delay == (snd_pcm_sframes_t)(BUFFER_SIZE - avail));
+
+	if (state != SND_PCM_STATE_RUNNING)
+		return;
+	ALSA_CHECK(snd_pcm_delay(pcm, &delay));
+	ALSA_CHECK(snd_pcm_snapshot(pcm, NULL, NULL, &snap_delay, NULL));
+	TEST_CHECK(snap_delay == delay);
+}
+
+static void test_against_status(snd_pcm_t *pcm)
+{
+	short buf[BUFFER_SIZE * 2];
+	snd_pcm_uframes_t avail;
+
+	memset(buf, 0, sizeof(buf));
+	played = 0;
+	ALSA_CHECK(snd_pcm_prepare(pcm));
+	check_status(pcm, SND_PCM_STATE_PREPARED, BUFFER_SIZE);
+
+	TEST_CHECK(snd_pcm_writei(pcm, buf, 600) == 600);
+	check_status(pcm, SND_PCM_STATE_PREPARED, BUFFER_SIZE - 600);
+
+	ALSA_CHECK(snd_pcm_start(pcm));
+	played = 200;
+	check_status(pcm, SND_PCM_STATE_RUNNING, BUFFER_SIZE - 400);
+
+	/* a wrap of the ring buffer */
+	TEST_CHECK(snd_pcm_writei(pcm, buf, 500) == 500);
+	played = 1000;
+	check_status(pcm, SND_PCM_STATE_RUNNING, BUFFER_SIZE - 100);
+
+	/* the snapshot keeps the last published values */
+	played = 1050;
+	ALSA_CHECK(snd_pcm_snapshot(pcm, NULL, &avail, NULL, NULL));
+	TEST_CHECK(avail == BUFFER_SIZE - 100);
+	TEST_CHECK(snd_pcm_avail(pcm) == BUFFER_SIZE - 50);
+	ALSA_CHECK(snd_pcm_snapshot(pcm, NULL, &avail, NULL, NULL));
+	TEST_CHECK(avail == BUFFER_SIZE - 50);
+
+	/* the pointers stay where the stream was stopped */
+	ALSA_CHECK(snd_pcm_drop(pcm));
+	check_status(pcm, SND_PCM_STATE_SETUP, BUFFER_SIZE - 50);
+}
+
+static void *reader(void *arg)
+{
+	snd_pcm_t *pcm = arg;
+	snd_pcm_state_t state;
+	snd_pcm_uframes_t avail;
+	snd_pcm_sframes_t delay;
+	snd_htimestamp_t tstamp, last = { 0, 0 };
+	unsigned long bad = 0;
+	int err;
+
+	while (!done) {
+		err = snd_pcm_snapshot(pcm, &state, &avail, &delay, &tstamp);
+		if (err == -EAGAIN)
+			continue;
+		if (err < 0 || avail > BUFFER_SIZE ||
+		    (snd_pcm_sframes_t)avail + delay != BUFFER_SIZE ||
+		    (state != SND_PCM_STATE_PREPARED && state != SND_PCM_STATE_RUNNING) ||
+		    tstamp.tv_sec < last.tv_sec ||
+		    (tstamp.tv_sec == last.tv_sec && tstamp.tv_nsec < last.tv_nsec))
+			bad++;
+		last = tstamp;
+	}
+	return (void *)bad;
+}
+
+static void test_concurrent(snd_pcm_t *pcm)
+{
+	short buf[BUFFER_SIZE * 2];
+	snd_pcm_status_t *status;
+	snd_pcm_sframes_t avail;
+	pthread_t thread;
+	void *bad;
+	int i;
+
+	memset(buf, 0, sizeof(buf));
+	snd_pcm_status_alloca(&status);
+	played = 0;
+	ALSA_CHECK(snd_pcm_prepare(pcm));
+	TEST_CHECK(snd_pcm_writei(pcm, buf, BUFFER_SIZE) == BUFFER_SIZE);
+	ALSA_CHECK(snd_pcm_start(pcm));
+
+	done = 0;
+	TEST_CHECK(pthread_create(&thread, NULL, reader, pcm) == 0);
+	for (i = 0; i < 200000; i++) {
+		played += 1 + i % 97;
+		avail = snd_pcm_avail_update(pcm);
+		if (avail > 0)
+			snd_pcm_writei(pcm, buf, avail);
+		if (!(i % 16))
+			snd_pcm_status(pcm, status);
+	}
+	done = 1;
+	pthread_join(thread, &bad);
+	TEST_CHECK(bad == NULL);
+	TEST_CHECK(snd_pcm_state(pcm) == SND_PCM_STATE_RUNNING);
+	ALSA_CHECK(snd_pcm_drop(pcm));
+}
+
+int main(void)
+{
+	snd_pcm_t *pcm;
+	int fds[2];
+
+	if (pipe(fds) < 0)
+		return 1;
+	if (open_sink(&pcm, fds[1]) < 0)
+		return TEST_EXIT_CODE();
+	test_against_status(pcm);
+	test_concurrent(pcm);
+	snd_pcm_close(pcm);
+	close(fds[0]);
+	close(fds[1]);
+	return TEST_EXIT_CODE();
+}
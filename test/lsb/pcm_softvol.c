@@ -0,0 +1,389 @@
+#include <stdint.h>
+#include <math.h>
+#include "pcm_test.h"
+
+/*
+ * Volume of the softvol plugin against a sample by sample reference of
+ * its 16.16 gains: the samples become floor(sample * vol / 65536),
+ * saturated, mute is silence, 0 dB is a plain copy, and a change of the
+ * control ramps over the next transfer to the new volume, reached on the
+ * last sample.  The control moves through equal and different channel
+ * volumes, mute, 0 dB and a gain above 0 dB, with interleaved, misaligned
+ * interleaved and non-interleaved client buffers, and with each
+ * $LIBASOUND_SIMD level.  The control is the card-less one of
+ * test/dummy_ctl.c, and the output is captured by the file plugin.
+ */
+
+#define FRAMES		1001
+#define CHUNK		97		/* odd lengths for the kernels */
+#define BUFFER_SIZE	256
+#define PERIOD_SIZE	64
+#define RESOLUTION	256
+#define ZERO_DB		-1		/* the control value at 0 dB */
+
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S16_LE,
+	SND_PCM_FORMAT_S16_BE,
+	SND_PCM_FORMAT_S24_LE,
+	SND_PCM_FORMAT_S24_3LE,
+	SND_PCM_FORMAT_S32_LE,
+	SND_PCM_FORMAT_S32_BE,
+	SND_PCM_FORMAT_FLOAT,
+};
+
+static const unsigned int channels[] = { 1, 2, 3, 8 };
+
+static const struct {
+	double min_dB, max_dB;
+} ranges[] = {
+	{ -60.0, 0.0 },
+	{ -40.0, 20.0 },	/* saturates above 0 dB */
+};
+
+/* the control values from the given chunk on */
+static const struct {
+	unsigned int chunk;
+	long left, right;
+} steps[] = {
+	{ 0, 200, 200 },
+	{ 2, 120, 120 },	/* ramps over the rest of the buffer */
+	{ 3, 120, 230 },
+	{ 5, 0, 0 },
+	{ 7, ZERO_DB, ZERO_DB },
+	{ 9, 255, 255 },
+	{ 10, 255, 3 },		/* the end of the stream */
+};
+
+/* test/dummy_ctl.la, see Makefile.am */
+#ifndef DUMMY_CTL_LIB
+#define DUMMY_CTL_LIB	""
+#endif
+
+/* let "hw:0" open the dummy control device */
+static const char config[] =
+	"ctl_type.dummy { lib \"" DUMMY_CTL_LIB "\" }\n"
+	"ctl.hw {\n"
+	"	@args [ CARD ]\n"
+	"	@args.CARD { type string default \"0\" }\n"
+	"	type dummy\n"
+	"	name \"Test Volume\"\n"
+	"	channels 2\n"
+	"	max 255\n"
+	"}\n";
+
+static char config_path[] = "/tmp/alsa-softvol-conf-XXXXXX";
+static snd_ctl_t *ctl;
+static unsigned int play_range;	/* of the stream being played */
+
+/* the volume table of the plugin */
+static void db_table(unsigned int r, unsigned int *table, unsigned int *zero)
+{
+	unsigned int max = RESOLUTION - 1, i;
+
+	if (ranges[r].max_dB == 0)
+		*zero = max;
+	else
+		*zero = (ranges[r].min_dB / (ranges[r].min_dB - ranges[r].max_dB)) * max;
+	for (i = 0; i <= max; i++) {
+		double db = ranges[r].min_dB +
+			(i * (ranges[r].max_dB - ranges[r].min_dB)) / max;
+		table[i] = pow(10.0, db / 20.0) * 65536;
+	}
+	table[*zero] = 0xffff;
+}
+
+/* the left, right and center factors for the control values */
+static void ref_scale(unsigned int r, long left, long right, unsigned int *scale)
+{
+	unsigned int table[RESOLUTION], zero;
+
+	db_table(r, table, &zero);
+	if (left == ZERO_DB)
+		left = zero;
+	if (right == ZERO_DB)
+		right = zero;
+	if (left == 0 && right == 0) {
+		scale[0] = scale[1] = scale[2] = 0;
+	} else if (left == (long)zero && right == (long)zero) {
+		scale[0] = scale[1] = scale[2] = 0xffff;
+	} else {
+		scale[0] = table[left];
+		scale[1] = table[right];
+		scale[2] = table[(left + right) / 2];
+	}
+}
+
+/* the factor of a stream channel: 2.0, 2.1, 4.0, 4.1, 5.1, 7.1 */
+static unsigned int scale_index(unsigned int ch, unsigned int channels)
+{
+	switch (ch) {
+	case 0:
+	case 2:
+		return channels == ch + 1 ? 2 : 0;
+	case 4:
+	case 5:
+		return 2;
+	default:
+		return ch & 1;
+	}
+}
+
+/* sample i, from 1, of a ramp of n from vol0 to vol1 */
+static void ref_gain(snd_pcm_format_t format, unsigned char *d,
+		     const unsigned char *s, unsigned int vol0,
+		     unsigned int vol1, unsigned int i, unsigned int n)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	int64_t step = 0, v;
+	uint64_t from = (uint64_t)vol0 << 16;
+	uint32_t vol, word = 0;
+	int32_t max, sample;
+	unsigned int b;
+	int big = snd_pcm_format_big_endian(format) > 0;
+
+	if (vol0 == vol1 && vol0 == 0) {
+		snd_pcm_format_set_silence(format, d, 1);
+		return;
+	}
+	if (vol0 == vol1 && vol0 == 0xffff) {
+		memcpy(d, s, bytes);
+		return;
+	}
+	if (format == SND_PCM_FORMAT_FLOAT) {
+		float gain = vol0 * (1.0 / (1 << 16)), fstep = 0, f;
+		if (vol0 != vol1)
+			fstep = ((float)(vol1 * (1.0 / (1 << 16))) - gain) / n;
+		memcpy(&f, s, sizeof(f));
+		f *= gain + fstep * (float)i;
+		memcpy(d, &f, sizeof(f));
+		return;
+	}
+	if (vol0 != vol1) {
+		step = ((int64_t)vol1 - vol0) * 65536 / (int64_t)n;
+		from = ((uint64_t)vol1 << 16) - step * (int64_t)n;
+	}
+	vol = (from + step * (int64_t)i) >> 16;
+
+	for (b = 0; b < bytes; b++)
+		word = (word << 8) | s[big ? b : bytes - 1 - b];
+	max = snd_pcm_format_width(format) == 24 ? 0x7fffff :
+		bytes == 2 ? 0x7fff : 0x7fffffff;
+	if (max == 0x7fffff)
+		sample = (int32_t)(word << 8) >> 8;
+	else if (bytes == 2)
+		sample = (int16_t)word;
+	else
+		sample = word;
+	v = ((int64_t)sample * vol) >> 16;
+	if (v > max)
+		v = max;
+	else if (v < -max - 1)
+		v = -max - 1;
+	for (b = 0; b < bytes; b++)
+		d[big ? bytes - 1 - b : b] = (uint64_t)v >> (8 * b);
+}
+
+/*
+ * One transfer of the plugin: without a ramp, or with the same one on
+ * all channels of interleaved frames, the samples are taken in order.
+ */
+static void ref_transfer(snd_pcm_format_t format, unsigned int channels,
+			 int layout, unsigned char *d, const unsigned char *s,
+			 unsigned int frames, const unsigned int *from,
+			 const unsigned int *scale)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	unsigned int ch, f, k, i = scale_index(0, channels);
+	int packed = layout != NONINTERLEAVED;
+
+	for (ch = 1; ch < channels; ch++) {
+		k = scale_index(ch, channels);
+		if (from[k] != from[i] || scale[k] != scale[i])
+			packed = 0;
+	}
+	for (f = 0; f < frames; f++)
+		for (ch = 0; ch < channels; ch++) {
+			size_t pos = (size_t)f * channels + ch;
+			k = scale_index(ch, channels);
+			if (packed)
+				ref_gain(format, d + pos * bytes, s + pos * bytes,
+					 from[k], scale[k], pos + 1, frames * channels);
+			else
+				ref_gain(format, d + pos * bytes, s + pos * bytes,
+					 from[k], scale[k], f + 1, frames);
+		}
+}
+
+static void ref_play(snd_pcm_format_t format, unsigned int r,
+		     unsigned int channels, int layout,
+		     const unsigned char *src, unsigned char *ref)
+{
+	size_t frame_bytes = (size_t)channels * snd_pcm_format_physical_width(format) / 8;
+	unsigned int from[3], scale[3], f, n, done = 0, chunk, k = 0, i;
+
+	for (chunk = 0; done < FRAMES; chunk++) {
+		if (k < sizeof(steps) / sizeof(steps[0]) && steps[k].chunk == chunk) {
+			ref_scale(r, steps[k].left, steps[k].right, scale);
+			if (!chunk)
+				memcpy(from, scale, sizeof(from));
+			k++;
+		}
+		f = FRAMES - done < CHUNK ? FRAMES - done : CHUNK;
+		/* the transfers stop at the end of the buffer */
+		while (f > 0) {
+			n = BUFFER_SIZE - done % BUFFER_SIZE;
+			if (n > f)
+				n = f;
+			ref_transfer(format, channels, layout, ref + done * frame_bytes,
+				     src + done * frame_bytes, n, from, scale);
+			for (i = 0; i < 3; i++)
+				from[i] = scale[i];
+			done += n;
+			f -= n;
+		}
+	}
+}
+
+static void set_volume(unsigned int r, long left, long right)
+{
+	unsigned int table[RESOLUTION], zero;
+	snd_ctl_elem_value_t *value;
+
+	db_table(r, table, &zero);
+	if (left == ZERO_DB)
+		left = zero;
+	if (right == ZERO_DB)
+		right = zero;
+	snd_ctl_elem_value_alloca(&value);
+	snd_ctl_elem_value_set_interface(value, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_value_set_name(value, "Test Volume");
+	snd_ctl_elem_value_set_integer(value, 0, left);
+	snd_ctl_elem_value_set_integer(value, 1, right);
+	ALSA_CHECK(snd_ctl_elem_write(ctl, value));
+}
+
+/* move the control before the chunks of the steps */
+static void step_volume(unsigned int chunk)
+{
+	unsigned int k;
+
+	for (k = 1; k < sizeof(steps) / sizeof(steps[0]); k++)
+		if (steps[k].chunk == chunk)
+			set_volume(play_range, steps[k].left, steps[k].right);
+}
+
+/*
+ * The control watcher of the plugin would pick the changes up at some
+ * later transfer; a forked child has no watcher and reads the control at
+ * each transfer, so that the ramps start where the reference expects.
+ */
+static long play(snd_pcm_format_t format, unsigned int r, unsigned int channels,
+		 int layout, const unsigned char *src, unsigned char *out,
+		 size_t out_size)
+{
+	snd_pcm_t *pcm;
+	int status;
+	pid_t pid;
+
+	set_volume(r, steps[0].left, steps[0].right);
+	if (test_pcm_open(&pcm, "pcm.test { type softvol slave.pcm out"
+			  " control { name \"Test Volume\" card 0 }"
+			  " min_dB %.1f max_dB %.1f resolution %d }",
+			  ranges[r].min_dB, ranges[r].max_dB, RESOLUTION) < 0)
+		return -1;
+	if (test_pcm_setup(pcm, test_access(layout), format, channels, 48000,
+			   PERIOD_SIZE, BUFFER_SIZE) < 0) {
+		snd_pcm_close(pcm);
+		return -1;
+	}
+	play_range = r;
+	pid = fork();
+	if (pid == 0) {
+		test_pcm_write(pcm, format, channels, layout, src, FRAMES, CHUNK,
+			       step_volume);
+		snd_pcm_close(pcm);
+		_exit(TEST_EXIT_CODE());
+	}
+	if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		any_test_failed = 1;
+	snd_pcm_close(pcm);
+	return test_out_read(out, out_size);
+}
+
+static void test_volume(snd_pcm_format_t format, unsigned int r,
+			unsigned int channels, int layout)
+{
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	size_t samples = (size_t)FRAMES * channels;
+	size_t out_size = samples * bytes;
+	unsigned char *src = malloc(out_size);
+	unsigned char *ref = malloc(out_size);
+	unsigned char *out = malloc(out_size + 1);
+	size_t i;
+	long size;
+
+	/* random data reaches the extremes of every format */
+	if (format == SND_PCM_FORMAT_FLOAT) {
+		for (i = 0; i < samples; i++) {
+			float f = (rand() - RAND_MAX / 2) * (4.0f / RAND_MAX);
+			memcpy(src + i * bytes, &f, sizeof(f));
+		}
+	} else {
+		for (i = 0; i < out_size; i++)
+			src[i] = rand();
+	}
+	ref_play(format, r, channels, layout, src, ref);
+	size = play(format, r, channels, layout, src, out, out_size + 1);
+	if (size != (long)out_size || memcmp(out, ref, out_size)) {
+		fprintf(stderr, "%s, %g to %g dB, %u channels, layout %d: wrong output\n",
+			snd_pcm_format_name(format), ranges[r].min_dB,
+			ranges[r].max_dB, channels, layout);
+		any_test_failed = 1;
+	}
+	free(out);
+	free(ref);
+	free(src);
+}
+
+static void test_all(void)
+{
+	unsigned int i, j, r;
+	int layout;
+
+	if (ALSA_CHECK(snd_ctl_open(&ctl, "hw:0", 0)) < 0)
+		return;
+	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+		for (r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++)
+			for (j = 0; j < sizeof(channels) / sizeof(channels[0]); j++)
+				for (layout = 0; layout < LAYOUTS; layout++)
+					test_volume(formats[i], r, channels[j], layout);
+	snd_ctl_close(ctl);
+}
+
+int main(void)
+{
+	int fd;
+
+	/* skipped without the dummy control */
+	if (access(DUMMY_CTL_LIB, R_OK) < 0)
+		return 77;
+	fd = mkstemp(config_path);
+	if (fd < 0)
+		return 1;
+	if (write(fd, config, strlen(config)) != (ssize_t)strlen(config)) {
+		close(fd);
+		unlink(config_path);
+		return 1;
+	}
+	close(fd);
+	setenv("ALSA_CONFIG_PATH", config_path, 1);
+	if (test_out_create() < 0) {
+		unlink(config_path);
+		return 1;
+	}
+	test_simd_levels(test_all);
+	unlink(test_out_path);
+	unlink(config_path);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,198 @@
+#include <stdint.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include "pcm_test.h"
+
+/*
+ * The control watcher of the softvol plugin: in the process which set the
+ * plugin up, a change of the control reaches the transfers through the
+ * watcher thread, and the transfers do not read the control themselves.
+ * A control which reports no events is not watched; each transfer reads
+ * it then, and sees the change as well.  The control is the card-less one
+ * of test/dummy_ctl.c, which counts the reads of its value; the output is
+ * captured by the file plugin.
+ */
+
+#define CHANNELS	2
+#define CHUNK		64
+#define CHUNKS		3
+#define BUFFER_SIZE	256
+#define PERIOD_SIZE	64
+#define SAMPLE		1000
+#define WAIT_MS		1000		/* for the watcher to read the change */
+
+/* test/dummy_ctl.la, see Makefile.am */
+#ifndef DUMMY_CTL_LIB
+#define DUMMY_CTL_LIB	""
+#endif
+
+/* let "hw:0" open the dummy control device, at 0 dB */
+static const char config[] =
+	"ctl_type.dummy { lib \"" DUMMY_CTL_LIB "\" }\n"
+	"ctl.hw {\n"
+	"	@args [ CARD ]\n"
+	"	@args.CARD { type string default \"0\" }\n"
+	"	type dummy\n"
+	"	name \"Test Volume\"\n"
+	"	channels 2\n"
+	"	max 255\n"
+	"	events %s\n"
+	"}\n";
+
+static char config_path[] = "/tmp/alsa-softvol-watch-conf-XXXXXX";
+
+static int write_config(int events)
+{
+	char text[sizeof(config) + 8];
+	int fd, len;
+
+	len = snprintf(text, sizeof(text), config, events ? "true" : "false");
+	fd = open(config_path, O_WRONLY | O_TRUNC);
+	if (fd < 0)
+		return -1;
+	if (write(fd, text, len) != len) {
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	setenv("ALSA_CONFIG_PATH", config_path, 1);
+	return 0;
+}
+
+static void mute(snd_ctl_t *ctl)
+{
+	snd_ctl_elem_value_t *value;
+
+	snd_ctl_elem_value_alloca(&value);
+	snd_ctl_elem_value_set_interface(value, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_value_set_name(value, "Test Volume");
+	snd_ctl_elem_value_set_integer(value, 0, 0);
+	snd_ctl_elem_value_set_integer(value, 1, 0);
+	TEST_CHECK(snd_ctl_elem_write(ctl, value) > 0);
+}
+
+static unsigned long load(const unsigned long *reads)
+{
+	return __atomic_load_n(reads, __ATOMIC_RELAXED);
+}
+
+static void write_chunk(snd_pcm_t *pcm, const int16_t *src)
+{
+	TEST_CHECK(snd_pcm_writei(pcm, src, CHUNK) == CHUNK);
+}
+
+/*
+ * Play a chunk at 0 dB, mute the control, then play the chunk ramping
+ * down and a silent one.  Run in a child, as the config and the dummy
+ * control are set up once per process.
+ */
+static void play(int events)
+{
+	static int16_t src[CHUNK * CHANNELS];
+	const unsigned long *reads;
+	unsigned long before;
+	snd_pcm_t *pcm;
+	snd_ctl_t *ctl;
+	void *lib;
+	int i;
+
+	for (i = 0; i < CHUNK * CHANNELS; i++)
+		src[i] = SAMPLE;
+	if (write_config(events) < 0 ||
+	    ALSA_CHECK(snd_ctl_open(&ctl, "hw:0", 0)) < 0)
+		_exit(1);
+	/* loaded by the control above, the same instance */
+	lib = snd_dlopen(DUMMY_CTL_LIB, RTLD_NOW, NULL, 0);
+	reads = lib ? snd_dlsym(lib, "dummy_ctl_reads", NULL) : NULL;
+	if (!reads) {
+		fprintf(stderr, "no dummy_ctl_reads in %s\n", DUMMY_CTL_LIB);
+		_exit(1);
+	}
+	if (test_pcm_open(&pcm, "pcm.test { type softvol slave.pcm out"
+			  " control { name \"Test Volume\" card 0 }"
+			  " min_dB -60.0 max_dB 0.0 resolution 256 }") < 0 ||
+	    test_pcm_setup(pcm, SND_PCM_ACCESS_RW_INTERLEAVED, SND_PCM_FORMAT_S16_LE,
+			   CHANNELS, 48000, PERIOD_SIZE, BUFFER_SIZE) < 0)
+		_exit(1);
+
+	before = load(reads);
+	write_chunk(pcm, src);
+	if (events)
+		TEST_CHECK(load(reads) == before);
+	else
+		TEST_CHECK(load(reads) > before);
+
+	before = load(reads);
+	mute(ctl);
+	if (events) {
+		/* read once by the watcher thread */
+		for (i = 0; i < WAIT_MS && load(reads) == before; i++)
+			usleep(1000);
+		TEST_CHECK(load(reads) == before + 1);
+		before = load(reads);
+	}
+	write_chunk(pcm, src);
+	write_chunk(pcm, src);
+	if (events)
+		TEST_CHECK(load(reads) == before);
+	else
+		TEST_CHECK(load(reads) >= before + 2);
+
+	snd_pcm_close(pcm);
+	snd_ctl_close(ctl);
+	snd_dlclose(lib);
+	_exit(TEST_EXIT_CODE());
+}
+
+static void test_watch(int events)
+{
+	size_t size = (size_t)CHUNK * CHUNKS * CHANNELS * 2;
+	int16_t *out = malloc(size + 1);
+	int status, i, wrong = 0;
+	pid_t pid;
+
+	pid = fork();
+	if (pid == 0)
+		play(events);
+	if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		any_test_failed = 1;
+
+	/* unchanged, then ramping down to silence on the last sample, then silent */
+	if (test_out_read((unsigned char *)out, size + 1) != (long)size) {
+		fprintf(stderr, "events %d: wrong output size\n", events);
+		any_test_failed = 1;
+	} else {
+		for (i = 0; i < CHUNK * CHANNELS; i++)
+			if (out[i] != SAMPLE)
+				wrong++;
+		for (i = 2 * CHUNK * CHANNELS - 1; i < CHUNK * CHUNKS * CHANNELS; i++)
+			if (out[i] != 0)
+				wrong++;
+		TEST_CHECK(wrong == 0);
+		TEST_CHECK(out[CHUNK * CHANNELS] != 0);
+	}
+	free(out);
+}
+
+int main(void)
+{
+	int fd;
+
+	/* skipped without the dummy control */
+	if (access(DUMMY_CTL_LIB, R_OK) < 0)
+		return 77;
+	fd = mkstemp(config_path);
+	if (fd < 0)
+		return 1;
+	close(fd);
+	if (test_out_create() < 0) {
+		unlink(config_path);
+		return 1;
+	}
+	test_watch(1);
+	test_watch(0);
+	unlink(test_out_path);
+	unlink(config_path);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+#include <alsa/pcm_ioplug.h>
+
+/*
+ * The xrun and recover counters of snd_pcm_stats_get() on an ioplug sink
+ * whose pointer callback reports an underrun when the test asks for it.
+ * Each xrun is counted once, however often it is seen again before the
+ * stream is prepared, also when only snd_pcm_recover() hears of it.
+ * Skipped when the library is built without --enable-pcm-stats.
+ */
+
+#define BUFFER_SIZE	1024
+#define PERIOD_SIZE	256
+#define CYCLES		3
+
+static int underrun;		/* set by the test */
+
+static int sink_start(snd_pcm_ioplug_t *io ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int sink_stop(snd_pcm_ioplug_t *io ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static snd_pcm_sframes_t sink_pointer(snd_pcm_ioplug_t *io ATTRIBUTE_UNUSED)
+{
+	return underrun ? -EPIPE : 0;
+}
+
+static snd_pcm_sframes_t sink_transfer(snd_pcm_ioplug_t *io ATTRIBUTE_UNUSED,
+				       const snd_pcm_channel_area_t *areas ATTRIBUTE_UNUSED,
+				       snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
+				       snd_pcm_uframes_t size)
+{
+	return size;
+}
+
+static const snd_pcm_ioplug_callback_t sink_callback = {
+	.start = sink_start,
+	.stop = sink_stop,
+	.pointer = sink_pointer,
+	.transfer = sink_transfer,
+};
+
+static snd_pcm_ioplug_t sink = {
+	.version = SND_PCM_IOPLUG_VERSION,
+	.name = "stats test sink",
+	.poll_events = POLLOUT,
+	.callback = &sink_callback,
+};
+
+static int open_sink(snd_pcm_t **pcmp, int fd)
+{
+	snd_pcm_hw_params_t *params;
+	int err;
+
+	sink.poll_fd = fd;
+	err = ALSA_CHECK(snd_pcm_ioplug_create(&sink, "stats",
+					       SND_PCM_STREAM_PLAYBACK,
+					       SND_PCM_NONBLOCK));
+	if (err < 0)
+		return err;
+	snd_pcm_ioplug_set_param_minmax(&sink, SND_PCM_IOPLUG_HW_CHANNELS, 2, 2);
+	snd_pcm_ioplug_set_param_minmax(&sink, SND_PCM_IOPLUG_HW_RATE, 48000, 48000);
+	snd_pcm_ioplug_set_param_minmax(&sink, SND_PCM_IOPLUG_HW_BUFFER_BYTES,
+					BUFFER_SIZE * 4, BUFFER_SIZE * 4);
+	snd_pcm_ioplug_set_param_minmax(&sink, SND_PCM_IOPLUG_HW_PERIOD_BYTES,
+					PERIOD_SIZE * 4, PERIOD_SIZE * 4);
+	*pcmp = sink.pcm;
+
+	snd_pcm_hw_params_alloca(&params);
+	ALSA_CHECK(snd_pcm_hw_params_any(*pcmp, params));
+	ALSA_CHECK(snd_pcm_hw_params_set_access(*pcmp, params, SND_PCM_ACCESS_RW_INTERLEAVED));
+	ALSA_CHECK(snd_pcm_hw_params_set_format(*pcmp, params, SND_PCM_FORMAT_S16_LE));
+	return ALSA_CHECK(snd_pcm_hw_params(*pcmp, params));
+}
+
+static unsigned long long counter(snd_pcm_t *pcm, snd_pcm_stat_t stat)
+{
+	unsigned long long value = 0;
+
+	ALSA_CHECK(snd_pcm_stats_get(pcm, stat, &value));
+	return value;
+}
+
+/* start the stream, then let the sink underrun */
+static void play_to_xrun(snd_pcm_t *pcm)
+{
+	static short period[PERIOD_SIZE * 2];
+
+	TEST_CHECK(snd_pcm_writei(pcm, period, PERIOD_SIZE) == PERIOD_SIZE);
+	TEST_CHECK(snd_pcm_state(pcm) == SND_PCM_STATE_RUNNING);
+	underrun = 1;
+}
+
+static void test_xruns(snd_pcm_t *pcm)
+{
+	static short period[PERIOD_SIZE * 2];
+	snd_pcm_status_t *status;
+	unsigned int i;
+
+	snd_pcm_status_alloca(&status);
+	for (i = 1; i <= CYCLES; i++) {
+		play_to_xrun(pcm);
+		/* detected by a transfer, then seen again */
+		TEST_CHECK(snd_pcm_writei(pcm, period, PERIOD_SIZE) == -EPIPE);
+		TEST_CHECK(counter(pcm, SND_PCM_STAT_XRUN) == i);
+		TEST_CHECK(snd_pcm_avail_update(pcm) == -EPIPE);
+		TEST_CHECK(snd_pcm_state(pcm) == SND_PCM_STATE_XRUN);
+		ALSA_CHECK(snd_pcm_status(pcm, status));
+		TEST_CHECK(snd_pcm_status_get_state(status) == SND_PCM_STATE_XRUN);
+		TEST_CHECK(counter(pcm, SND_PCM_STAT_XRUN) == i);
+		underrun = 0;
+		ALSA_CHECK(snd_pcm_recover(pcm, -EPIPE, 1));
+		TEST_CHECK(counter(pcm, SND_PCM_STAT_XRUN) == i);
+		TEST_CHECK(counter(pcm, SND_PCM_STAT_RECOVER) == i);
+		TEST_CHECK(snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED);
+	}
+
+	/* an xrun the application only passes to snd_pcm_recover() */
+	play_to_xrun(pcm);
+	underrun = 0;
+	ALSA_CHECK(snd_pcm_recover(pcm, -EPIPE, 1));
+	TEST_CHECK(counter(pcm, SND_PCM_STAT_XRUN) == CYCLES + 1);
+	TEST_CHECK(counter(pcm, SND_PCM_STAT_RECOVER) == CYCLES + 1);
+
+	/* a stream without an xrun counts none */
+	ALSA_CHECK(snd_pcm_stats_reset(pcm));
+	TEST_CHECK(snd_pcm_writei(pcm, period, PERIOD_SIZE) == PERIOD_SIZE);
+	TEST_CHECK(snd_pcm_avail_update(pcm) >= 0);
+	ALSA_CHECK(snd_pcm_drop(pcm));
+	TEST_CHECK(counter(pcm, SND_PCM_STAT_XRUN) == 0);
+	TEST_CHECK(counter(pcm, SND_PCM_STAT_RECOVER) == 0);
+}
+
+int main(void)
+{
+	unsigned long long value;
+	snd_pcm_t *pcm;
+	int fds[2];
+
+	if (pipe(fds) < 0)
+		return 1;
+	if (open_sink(&pcm, fds[1]) < 0)
+		return TEST_EXIT_CODE();
+	if (snd_pcm_stats_get(pcm, SND_PCM_STAT_XRUN, &value) == -ENOSYS) {
+		snd_pcm_close(pcm);
+		return 77;
+	}
+	test_xruns(pcm);
+	snd_pcm_close(pcm);
+	close(fds[0]);
+	close(fds[1]);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,209 @@
+#ifndef PCM_TEST_H_INCLUDED
+#define PCM_TEST_H_INCLUDED
+
+/*
+ * Helpers of the PCM plugin tests: a chain given as configuration text
+ * ending in the file plugin, the client buffer layouts it is played
+ * from, and the runs of a test at each $LIBASOUND_SIMD level.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "test.h"
+
+/* the client buffers: interleaved, at an odd address, one per channel */
+enum { INTERLEAVED, MISALIGNED, NONINTERLEAVED, LAYOUTS };
+
+#define TEST_MAX_CHANNELS	32
+
+/* written by the PCM "out" of test_pcm_open() */
+static char test_out_path[] = "/tmp/alsa-test-XXXXXX";
+
+static inline int test_out_create(void)
+{
+	int fd = mkstemp(test_out_path);
+
+	if (fd < 0)
+		return -1;
+	close(fd);
+	return 0;
+}
+
+/* the output of the last stream, its size or -1 */
+static inline long test_out_read(unsigned char *out, size_t size)
+{
+	FILE *file;
+	long len;
+
+	file = fopen(test_out_path, "rb");
+	if (!file)
+		return -1;
+	len = fread(out, 1, size, file);
+	fclose(file);
+	return len;
+}
+
+/*
+ * Open the playback PCM "test" of the configuration text; it can name
+ * the PCM "out" as its slave, which writes the raw data to
+ * test_out_path.
+ */
+static inline int __attribute__((format(printf, 2, 3)))
+test_pcm_open(snd_pcm_t **pcmp, const char *fmt, ...)
+{
+	char text[4096];
+	snd_config_t *conf;
+	snd_input_t *in;
+	va_list ap;
+	int len, err;
+
+	len = snprintf(text, sizeof(text),
+		       "pcm.out { type file slave.pcm { type null }"
+		       " file \"%s\" format raw }\n", test_out_path);
+	va_start(ap, fmt);
+	vsnprintf(text + len, sizeof(text) - len, fmt, ap);
+	va_end(ap);
+	if (ALSA_CHECK(snd_config_top(&conf)) < 0)
+		return -1;
+	ALSA_CHECK(snd_input_buffer_open(&in, text, strlen(text)));
+	ALSA_CHECK(snd_config_load(conf, in));
+	snd_input_close(in);
+	err = ALSA_CHECK(snd_pcm_open_lconf(pcmp, "test", SND_PCM_STREAM_PLAYBACK,
+					    0, conf));
+	snd_config_delete(conf);
+	return err;
+}
+
+static inline snd_pcm_access_t test_access(int layout)
+{
+	return layout == NONINTERLEAVED ? SND_PCM_ACCESS_RW_NONINTERLEAVED :
+		SND_PCM_ACCESS_RW_INTERLEAVED;
+}
+
+/* the nearest period and buffer sizes, see snd_pcm_get_params() */
+static inline int test_pcm_setup(snd_pcm_t *pcm, snd_pcm_access_t access,
+				 snd_pcm_format_t format, unsigned int channels,
+				 unsigned int rate, snd_pcm_uframes_t period_size,
+				 snd_pcm_uframes_t buffer_size)
+{
+	snd_pcm_hw_params_t *params;
+
+	snd_pcm_hw_params_alloca(&params);
+	ALSA_CHECK(snd_pcm_hw_params_any(pcm, params));
+	ALSA_CHECK(snd_pcm_hw_params_set_access(pcm, params, access));
+	ALSA_CHECK(snd_pcm_hw_params_set_format(pcm, params, format));
+	ALSA_CHECK(snd_pcm_hw_params_set_channels(pcm, params, channels));
+	ALSA_CHECK(snd_pcm_hw_params_set_rate(pcm, params, rate, 0));
+	ALSA_CHECK(snd_pcm_hw_params_set_period_size_near(pcm, params, &period_size, NULL));
+	ALSA_CHECK(snd_pcm_hw_params_set_buffer_size_near(pcm, params, &buffer_size));
+	return ALSA_CHECK(snd_pcm_hw_params(pcm, params));
+}
+
+/* the first sample of a byte is in the high nibble */
+static inline unsigned int test_get_nibble(const unsigned char *buf, size_t index)
+{
+	return index & 1 ? buf[index / 2] & 0x0f : buf[index / 2] >> 4;
+}
+
+static inline void test_put_nibble(unsigned char *buf, size_t index, unsigned int code)
+{
+	if (index & 1)
+		buf[index / 2] = (buf[index / 2] & 0xf0) | code;
+	else
+		buf[index / 2] = (buf[index / 2] & 0x0f) | (code << 4);
+}
+
+/*
+ * Write the interleaved 'src' from the given layout, each channel of a
+ * non-interleaved one at another misalignment.  The chunks of 'chunk'
+ * frames must start on a byte; 'step' is called before each of them.
+ */
+static inline void test_pcm_write(snd_pcm_t *pcm, snd_pcm_format_t format,
+				  unsigned int channels, int layout,
+				  const unsigned char *src, unsigned int frames,
+				  unsigned int chunk, void (*step)(unsigned int chunk))
+{
+	unsigned int bits = snd_pcm_format_physical_width(format);
+	size_t src_bytes = (size_t)frames * channels * bits / 8;
+	size_t plane_bytes = (size_t)frames * bits / 8 + TEST_MAX_CHANNELS;
+	unsigned char *buf, *planes[TEST_MAX_CHANNELS];
+	void *bufs[TEST_MAX_CHANNELS];
+	snd_pcm_sframes_t n;
+	unsigned int f, c, i, done = 0;
+
+	buf = malloc(src_bytes + 1);
+	for (c = 0; c < channels; c++)
+		planes[c] = calloc(1, plane_bytes);
+	if (layout == MISALIGNED) {
+		memcpy(buf + 1, src, src_bytes);
+	} else if (layout == NONINTERLEAVED) {
+		for (c = 0; c < channels; c++)
+			for (f = 0; f < frames; f++) {
+				if (bits == 4)
+					test_put_nibble(planes[c] + c, f,
+							test_get_nibble(src, (size_t)f * channels + c));
+				else
+					memcpy(planes[c] + c + f * bits / 8,
+					       src + ((size_t)f * channels + c) * bits / 8,
+					       bits / 8);
+			}
+	}
+	for (i = 0; done < frames; i++) {
+		if (step)
+			step(i);
+		f = frames - done < chunk ? frames - done : chunk;
+		switch (layout) {
+		case INTERLEAVED:
+			n = snd_pcm_writei(pcm, src + (size_t)done * channels * bits / 8, f);
+			break;
+		case MISALIGNED:
+			n = snd_pcm_writei(pcm, buf + 1 + (size_t)done * channels * bits / 8, f);
+			break;
+		default:
+			for (c = 0; c < channels; c++)
+				bufs[c] = planes[c] + c + (size_t)done * bits / 8;
+			n = snd_pcm_writen(pcm, bufs, f);
+			break;
+		}
+		if (n != (snd_pcm_sframes_t)f) {
+			TEST_CHECK(n == (snd_pcm_sframes_t)f);
+			break;
+		}
+		done += n;
+	}
+	for (c = 0; c < channels; c++)
+		free(planes[c]);
+	free(buf);
+}
+
+/* the SIMD level is read only once, so each one runs in a child */
+static inline void test_simd_levels(void (*test)(void))
+{
+	static const char *const levels[] = { "none", "sse2", "sse4.1", NULL };
+	unsigned int i;
+	int status;
+	pid_t pid;
+
+	for (i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+		pid = fork();
+		if (pid == 0) {
+			if (levels[i])
+				setenv("LIBASOUND_SIMD", levels[i], 1);
+			else
+				unsetenv("LIBASOUND_SIMD");
+			test();
+			exit(TEST_EXIT_CODE());
+		}
+		if (pid < 0 || waitpid(pid, &status, 0) < 0 ||
+		    !WIFEXITED(status) || WEXITSTATUS(status)) {
+			fprintf(stderr, "LIBASOUND_SIMD=%s failed\n",
+				levels[i] ? levels[i] : "(unset)");
+			any_test_failed = 1;
+		}
+	}
+}
+
+#endif
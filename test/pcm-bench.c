@@ -0,0 +1,496 @@
+/*
+ * PCM plugin chain throughput benchmark
+ *
+ * Plugin chains are built on top of the null PCM, so no hardware is
+ * needed.  Each chain is fed with interleaved periods via snd_pcm_writei()
+ * as fast as possible, and the throughput is reported in frames per second,
+ * nanoseconds per frame and (on x86) TSC cycles per frame.
+ *
+ * The cost of a single plugin is estimated by running every suffix of the
+ * chain separately, e.g. for plug,rate,route,null also rate,route,null and
+ * route,null, and subtracting the result of the next shorter chain.
+ *
+ * With -m, the results are printed as CSV with one line per chain and
+ * stage, suitable for comparing runs:
+ *
+ *   chain,stage,format,channels,period,frames,frames_per_sec,ns_per_frame,cycles_per_frame
+ *
+ * Plugins which need a control device (softvol) get the card-less one of
+ * dummy_ctl.c in place of the mixer of card 0, so that every chain runs
+ * without hardware and with the same volume setting.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include "../include/asoundlib.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#define MAX_STAGES	16
+#define APP_RATE	44100		/* stream rate */
+#define SLAVE_RATE	48000		/* rate plugin output */
+
+static const struct {
+	const char *name;
+	const char *stages;
+} default_chains[] = {
+	{ "null", "null" },
+	{ "linear", "linear,null" },
+	{ "route", "route,null" },
+	{ "rate", "rate,null" },
+	{ "softvol", "softvol,null" },
+	{ "plug-rate-route-softvol", "plug,rate,route,softvol,null" },
+	/* what a dmix stack does in software: convert, mix down, widen */
+	{ "dmix-like", "plug,route,linear,null" },
+};
+
+static const snd_pcm_format_t default_formats[] = {
+	SND_PCM_FORMAT_S16_LE,
+	SND_PCM_FORMAT_S32_LE,
+	SND_PCM_FORMAT_FLOAT_LE,
+};
+
+static const unsigned int default_channels[] = { 2, 6 };
+static const unsigned int default_periods[] = { 256, 1024, 4096 };
+
+static unsigned int duration = 200;		/* ms per measurement */
+static int machine = 0;				/* CSV output */
+static int breakdown = 1;			/* measure the chain suffixes */
+static int verbose = 0;
+
+struct result {
+	unsigned long long frames;
+	double ns;
+	double cycles;
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long long now_cycles(void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Write the configuration of stages[first..] nested into each other,
+ * the last one being the innermost slave.
+ */
+static int build_stage(char *buf, size_t size, char **stages, int first,
+		       int count, unsigned int channels)
+{
+	const char *stage = stages[first];
+	char slave[4096];
+	unsigned int c;
+	int len = 0;
+
+	if (first == count - 1) {
+		if (strcmp(stage, "null"))
+			return -EINVAL;
+		return snprintf(buf, size, "{ type null }");
+	}
+	if (build_stage(slave, sizeof(slave), stages, first + 1, count, channels) < 0)
+		return -EINVAL;
+	if (!strcmp(stage, "plug"))
+		return snprintf(buf, size, "{ type plug slave.pcm %s }", slave);
+	if (!strcmp(stage, "linear"))
+		return snprintf(buf, size,
+				"{ type linear slave { pcm %s format S32_LE } }",
+				slave);
+	if (!strcmp(stage, "rate"))
+		return snprintf(buf, size,
+				"{ type rate slave { pcm %s rate %d } }",
+				slave, SLAVE_RATE);
+	if (!strcmp(stage, "softvol"))
+		return snprintf(buf, size,
+				"{ type softvol slave.pcm %s "
+				"control { name \"PCM Bench Volume\" card 0 } }",
+				slave);
+	if (!strcmp(stage, "route")) {
+		/* every output is a mix of two inputs */
+		len = snprintf(buf, size, "{ type route slave { pcm %s channels %u } ttable {",
+			       slave, channels);
+		for (c = 0; c < channels && len < (int)size; c++)
+			len += snprintf(buf + len, size - len, " %u.%u 0.7 %u.%u 0.3",
+					c, c, (c + 1) % channels, c);
+		if (len < (int)size)
+			len += snprintf(buf + len, size - len, " } }");
+		return len;
+	}
+	return -EINVAL;
+}
+
+/* let "hw:0" and the other ctl names of the cards open the dummy device */
+static int setup_dummy_ctl(void)
+{
+#ifdef DUMMY_CTL_LIB
+	static const char text[] =
+		"ctl_type.dummy { lib \"" DUMMY_CTL_LIB "\" }\n"
+		"ctl.!hw {\n"
+		"	@args [ CARD ]\n"
+		"	@args.CARD { type string default \"0\" }\n"
+		"	type dummy\n"
+		"	name \"PCM Bench Volume\"\n"
+		"	value 200\n"
+		"}\n";
+	snd_input_t *in;
+	int err;
+
+	err = snd_config_update();
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, text, strlen(text));
+	if (err < 0)
+		return err;
+	err = snd_config_load(snd_config, in);
+	snd_input_close(in);
+	return err;
+#else
+	return -ENXIO;
+#endif
+}
+
+static int open_chain(snd_pcm_t **pcmp, char **stages, int first, int count,
+		      unsigned int channels)
+{
+	char def[8192], text[8192 + 16];
+	snd_config_t *conf;
+	snd_input_t *in;
+	int err;
+
+	err = build_stage(def, sizeof(def), stages, first, count, channels);
+	if (err < 0 || err >= (int)sizeof(def))
+		return -EINVAL;
+	snprintf(text, sizeof(text), "pcm.bench %s", def);
+	err = snd_config_top(&conf);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, text, strlen(text));
+	if (err < 0) {
+		snd_config_delete(conf);
+		return err;
+	}
+	err = snd_config_load(conf, in);
+	snd_input_close(in);
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcmp, "bench", SND_PCM_STREAM_PLAYBACK,
+					 0, conf);
+	snd_config_delete(conf);
+	return err;
+}
+
+static int setup_pcm(snd_pcm_t *pcm, snd_pcm_format_t format,
+		     unsigned int channels, snd_pcm_uframes_t period)
+{
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_sw_params_t *sw;
+	snd_pcm_uframes_t size = period;
+	int err;
+
+	snd_pcm_hw_params_alloca(&hw);
+	snd_pcm_sw_params_alloca(&sw);
+	if ((err = snd_pcm_hw_params_any(pcm, hw)) < 0 ||
+	    (err = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0 ||
+	    (err = snd_pcm_hw_params_set_format(pcm, hw, format)) < 0 ||
+	    (err = snd_pcm_hw_params_set_channels(pcm, hw, channels)) < 0 ||
+	    (err = snd_pcm_hw_params_set_rate(pcm, hw, APP_RATE, 0)) < 0 ||
+	    (err = snd_pcm_hw_params_set_period_size(pcm, hw, size, 0)) < 0)
+		return err;
+	size = period * 4;
+	if ((err = snd_pcm_hw_params_set_buffer_size_near(pcm, hw, &size)) < 0 ||
+	    (err = snd_pcm_hw_params(pcm, hw)) < 0)
+		return err;
+	if ((err = snd_pcm_sw_params_current(pcm, sw)) < 0 ||
+	    (err = snd_pcm_sw_params_set_start_threshold(pcm, sw, period)) < 0 ||
+	    (err = snd_pcm_sw_params(pcm, sw)) < 0)
+		return err;
+	return 0;
+}
+
+static int run_one(char **stages, int first, int count, snd_pcm_format_t format,
+		   unsigned int channels, snd_pcm_uframes_t period,
+		   void *buf, struct result *res)
+{
+	unsigned long long start, end, c0, c1;
+	snd_pcm_sframes_t frames;
+	snd_pcm_t *pcm;
+	int err;
+
+	err = open_chain(&pcm, stages, first, count, channels);
+	if (err < 0)
+		return err;
+	err = setup_pcm(pcm, format, channels, period);
+	if (err < 0)
+		goto out;
+	if (verbose && first == 0) {
+		snd_output_t *out;
+		snd_output_stdio_attach(&out, stderr, 0);
+		snd_pcm_dump(pcm, out);
+		snd_output_close(out);
+	}
+	/* warm up */
+	frames = snd_pcm_writei(pcm, buf, period);
+	if (frames < 0) {
+		err = frames;
+		goto out;
+	}
+	memset(res, 0, sizeof(*res));
+	start = now_ns();
+	c0 = now_cycles();
+	end = start + duration * 1000000ULL;
+	do {
+		frames = snd_pcm_writei(pcm, buf, period);
+		if (frames < 0) {
+			err = snd_pcm_recover(pcm, frames, 1);
+			if (err < 0)
+				goto out;
+			continue;
+		}
+		res->frames += frames;
+	} while (now_ns() < end);
+	c1 = now_cycles();
+	res->ns = now_ns() - start;
+	res->cycles = c1 - c0;
+	err = 0;
+ out:
+	snd_pcm_close(pcm);
+	return err;
+}
+
+static void fill_buffer(void *buf, snd_pcm_format_t format, unsigned int samples)
+{
+	unsigned int i;
+
+	for (i = 0; i < samples; i++) {
+		/* a triangle wave well below full scale */
+		int v = (int)(i % 512) - 256;
+		switch (format) {
+		case SND_PCM_FORMAT_S16_LE:
+			((short *)buf)[i] = v * 64;
+			break;
+		case SND_PCM_FORMAT_S32_LE:
+			((int *)buf)[i] = v * 64 * 65536;
+			break;
+		case SND_PCM_FORMAT_FLOAT_LE:
+			((float *)buf)[i] = v / 512.0f;
+			break;
+		default:
+			((unsigned char *)buf)[i] = i;
+			break;
+		}
+	}
+}
+
+static void print_result(const char *chain, const char *stage,
+			 snd_pcm_format_t format, unsigned int channels,
+			 snd_pcm_uframes_t period, const struct result *res,
+			 double ns_per_frame, double cycles_per_frame)
+{
+	double fps = res->frames * 1e9 / res->ns;
+
+	if (machine) {
+		printf("%s,%s,%s,%u,%lu,%llu,%.0f,%.3f,%.3f\n",
+		       chain, stage, snd_pcm_format_name(format), channels,
+		       period, res->frames, fps, ns_per_frame, cycles_per_frame);
+		return;
+	}
+	if (!strcmp(stage, "total"))
+		printf("%-24s %-8s %2u ch %5lu frames: %12.0f frames/s %9.3f ns/frame",
+		       chain, snd_pcm_format_name(format), channels, period,
+		       fps, ns_per_frame);
+	else
+		printf("%24s %-8s %32s %9.3f ns/frame", "", stage, "", ns_per_frame);
+#ifdef HAVE_TSC
+	printf(" %9.3f cycles/frame", cycles_per_frame);
+#endif
+	printf("\n");
+}
+
+static int bench_chain(const char *name, const char *spec, snd_pcm_format_t format,
+		       unsigned int channels, snd_pcm_uframes_t period)
+{
+	struct result res[MAX_STAGES];
+	int valid[MAX_STAGES];
+	char *stages[MAX_STAGES];
+	char *copy, *tok, *save;
+	int count = 0, i, err;
+	void *buf;
+
+	copy = strdup(spec);
+	if (!copy)
+		return -ENOMEM;
+	for (tok = strtok_r(copy, ",", &save); tok && count < MAX_STAGES;
+	     tok = strtok_r(NULL, ",", &save))
+		stages[count++] = tok;
+	if (!count || strcmp(stages[count - 1], "null")) {
+		fprintf(stderr, "%s: the chain must end with null\n", name);
+		free(copy);
+		return -EINVAL;
+	}
+	buf = malloc(period * channels * snd_pcm_format_physical_width(format) / 8);
+	if (!buf) {
+		free(copy);
+		return -ENOMEM;
+	}
+	fill_buffer(buf, format, period * channels);
+
+	err = run_one(stages, 0, count, format, channels, period, buf, &res[0]);
+	if (err < 0) {
+		if (machine)
+			printf("# %s,%s,%u,%lu skipped: %s\n", name,
+			       snd_pcm_format_name(format), channels, period,
+			       snd_strerror(err));
+		else
+			printf("%-24s %-8s %2u ch %5lu frames: skipped (%s)\n",
+			       name, snd_pcm_format_name(format), channels, period,
+			       snd_strerror(err));
+		goto out;
+	}
+	valid[0] = 1;
+	for (i = 1; i < count; i++)
+		valid[i] = breakdown &&
+			run_one(stages, i, count, format, channels, period,
+				buf, &res[i]) >= 0;
+	print_result(name, "total", format, channels, period, &res[0],
+		     res[0].ns / res[0].frames, res[0].cycles / res[0].frames);
+	/* a plugin costs what its chain takes more than the rest */
+	for (i = 0; breakdown && i < count - 1; i++) {
+		double ns, cycles;
+		if (!valid[i] || !valid[i + 1])
+			continue;
+		ns = res[i].ns / res[i].frames - res[i + 1].ns / res[i + 1].frames;
+		cycles = res[i].cycles / res[i].frames -
+			res[i + 1].cycles / res[i + 1].frames;
+		print_result(name, stages[i], format, channels, period, &res[i],
+			     ns, cycles);
+	}
+	err = 0;
+ out:
+	free(buf);
+	free(copy);
+	return err;
+}
+
+static void help(void)
+{
+	printf(
+"Usage: pcm-bench [OPTION]...\n"
+"-h,--help      help\n"
+"-c,--chain     plugin chain, comma separated, ending with null\n"
+"               (stages: plug, rate, route, linear, softvol, null)\n"
+"-f,--format    sample format (may be repeated)\n"
+"-C,--channels  count of channels (may be repeated)\n"
+"-p,--period    period size in frames (may be repeated)\n"
+"-t,--time      time per measurement in ms\n"
+"-s,--simple    don't measure the single plugins\n"
+"-m,--machine   CSV output\n"
+"-v,--verbose   dump the PCM setup\n"
+"\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct option long_option[] =
+	{
+		{"help", 0, NULL, 'h'},
+		{"chain", 1, NULL, 'c'},
+		{"format", 1, NULL, 'f'},
+		{"channels", 1, NULL, 'C'},
+		{"period", 1, NULL, 'p'},
+		{"time", 1, NULL, 't'},
+		{"simple", 0, NULL, 's'},
+		{"machine", 0, NULL, 'm'},
+		{"verbose", 0, NULL, 'v'},
+		{NULL, 0, NULL, 0},
+	};
+	snd_pcm_format_t formats[16];
+	unsigned int channels[16], periods[16];
+	const char *chain = NULL;
+	int nformats = 0, nchannels = 0, nperiods = 0;
+	int c, i, j, k, n;
+
+	while ((c = getopt_long(argc, argv, "hc:f:C:p:t:smv", long_option, NULL)) >= 0) {
+		switch (c) {
+		case 'h':
+			help();
+			return 0;
+		case 'c':
+			chain = optarg;
+			break;
+		case 'f':
+			if (nformats >= 16)
+				break;
+			formats[nformats] = snd_pcm_format_value(optarg);
+			if (formats[nformats] == SND_PCM_FORMAT_UNKNOWN) {
+				fprintf(stderr, "Invalid format %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			nformats++;
+			break;
+		case 'C':
+			if (nchannels < 16)
+				channels[nchannels++] = atoi(optarg);
+			break;
+		case 'p':
+			if (nperiods < 16)
+				periods[nperiods++] = atoi(optarg);
+			break;
+		case 't':
+			duration = atoi(optarg);
+			break;
+		case 's':
+			breakdown = 0;
+			break;
+		case 'm':
+			machine = 1;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			help();
+			return EXIT_FAILURE;
+		}
+	}
+	if (!nformats)
+		for (; nformats < (int)(sizeof(default_formats) / sizeof(default_formats[0])); nformats++)
+			formats[nformats] = default_formats[nformats];
+	if (!nchannels)
+		for (; nchannels < (int)(sizeof(default_channels) / sizeof(default_channels[0])); nchannels++)
+			channels[nchannels] = default_channels[nchannels];
+	if (!nperiods)
+		for (; nperiods < (int)(sizeof(default_periods) / sizeof(default_periods[0])); nperiods++)
+			periods[nperiods] = default_periods[nperiods];
+
+	if (setup_dummy_ctl() < 0)
+		fprintf(stderr, "No dummy control device, softvol needs card 0\n");
+	if (machine)
+		printf("chain,stage,format,channels,period,frames,frames_per_sec,ns_per_frame,cycles_per_frame\n");
+	n = chain ? 1 : sizeof(default_chains) / sizeof(default_chains[0]);
+	for (c = 0; c < n; c++) {
+		const char *name = chain ? chain : default_chains[c].name;
+		const char *spec = chain ? chain : default_chains[c].stages;
+		for (i = 0; i < nformats; i++)
+			for (j = 0; j < nchannels; j++)
+				for (k = 0; k < nperiods; k++)
+					bench_chain(name, spec, formats[i],
+						    channels[j], periods[k]);
+	}
+	snd_config_update_free_global();
+	return 0;
+}